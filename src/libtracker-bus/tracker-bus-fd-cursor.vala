@@ -17,10 +17,114 @@
  * Boston, MA  02110-1301, USA.
  */
 
+// Outstanding Steroids query call. The reply carries the variable names
+// and possibly an error, it is only sent once all rows are written, so
+// it is collected after the last row was read from the pipe.
+class Tracker.Bus.QueryRequest : Object {
+	Mutex mutex;
+	Cond cond;
+	MainContext context;
+	bool done;
+	DBusMessage reply;
+	Error error;
+	SourceFunc callback;
+	MainContext callback_context;
+
+	public QueryRequest (DBusConnection bus, DBusMessage message, Cancellable? cancellable) {
+		context = MainContext.ref_thread_default ();
+
+		bus.send_message_with_reply.begin (message, DBusSendMessageFlags.NONE, int.MAX, null, cancellable, (o, res) => {
+			mutex.lock ();
+			try {
+				reply = bus.send_message_with_reply.end (res);
+			} catch (Error e) {
+				error = e;
+			}
+			done = true;
+			cond.broadcast ();
+
+			SourceFunc? waiter = (owned) callback;
+			var waiter_context = callback_context;
+			mutex.unlock ();
+
+			if (waiter != null) {
+				waiter_context.invoke ((owned) waiter);
+			}
+		});
+	}
+
+	DBusMessage get_reply () throws Sparql.Error, IOError, DBusError {
+		if (error != null) {
+			Connection.handle_error (error);
+		}
+
+		Connection.handle_error_reply (reply);
+		return reply;
+	}
+
+	public DBusMessage wait () throws Sparql.Error, IOError, DBusError {
+		if (context.acquire ()) {
+			// nobody else runs the context the call was made from,
+			// e.g. the private one of a synchronous query
+			while (!done) {
+				context.iteration (true);
+			}
+			context.release ();
+		} else {
+			mutex.lock ();
+			while (!done) {
+				cond.wait (mutex);
+			}
+			mutex.unlock ();
+		}
+
+		return get_reply ();
+	}
+
+	public async DBusMessage wait_async () throws Sparql.Error, IOError, DBusError {
+		mutex.lock ();
+		if (!done) {
+			callback = wait_async.callback;
+			callback_context = MainContext.ref_thread_default ();
+			mutex.unlock ();
+			yield;
+		} else {
+			mutex.unlock ();
+		}
+
+		return get_reply ();
+	}
+}
+
+// Decodes the rows from the pipe as they are requested. At most
+// BUFFER_SIZE bytes, or a single row if that is larger, are buffered,
+// so the store blocks on the full pipe until the client catches up.
+// Rows come either in the original format, or in the typed v2 format
+// written by Steroids.QueryV2, see tracker-steroids.vala.
 class Tracker.Bus.FDCursor : Tracker.Sparql.Cursor {
+	const size_t BUFFER_SIZE = 65536;
+
+	Bus.Connection connection;
+	string sparql;
+	Variant? arguments;
+
+	QueryRequest request;
+	UnixInputStream input;
+	bool eof;
+	bool finished;
+	bool v2;
+
 	internal char* buffer;
-	internal ulong buffer_index;
-	internal ulong buffer_size;
+	size_t buffer_alloc;
+	// end of the v2 header, start of the current row, and of the
+	// data not decoded yet
+	size_t header_end;
+	size_t row_start;
+	size_t buffer_start;
+	size_t buffer_end;
+	// whether rows have been dropped from the buffer, rewinding then
+	// needs to run the query again
+	bool discarded;
 
 	internal int _n_columns;
 	internal int* offsets;
@@ -28,23 +132,392 @@ class Tracker.Bus.FDCursor : Tracker.Sparql.Cursor {
 	internal char* data;
 	internal string[] variable_names;
 
-	public FDCursor (char* buffer, ulong buffer_size, string[] variable_names) {
-		this.buffer = buffer;
-		this.buffer_size = buffer_size;
-		this.variable_names = variable_names;
-		_n_columns = variable_names.length;
+	// current row in the v2 format, strings are offsets from the row
+	// start, or -1 - their number in the dictionary
+	int[] v2_types;
+	int64[] v2_integers;
+	double[] v2_doubles;
+	long[] v2_strings;
+	string[] v2_formatted;
+	GenericArray<string> dictionary;
+	size_t read_pos;
+
+	public FDCursor (Bus.Connection connection, string sparql, Variant? arguments) {
+		this.connection = connection;
+		this.sparql = sparql;
+		this.arguments = arguments;
 	}
 
 	~FDCursor () {
 		free (buffer);
 	}
 
-	inline int buffer_read_int () {
-		int v = *((int*) (buffer + buffer_index));
+	void reset () {
+		eof = false;
+		finished = false;
+		discarded = false;
+		header_end = 0;
+		row_start = 0;
+		buffer_start = 0;
+		buffer_end = 0;
+		types = null;
+		offsets = null;
+		data = null;
+		variable_names = null;
+		dictionary = null;
+	}
+
+	// Sends the query and waits for the first row, errors that happen
+	// before any row is written are thrown here
+	internal async void start_async (Cancellable? cancellable) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError {
+		bool use_v2 = connection.supports_v2;
+
+		try {
+			yield send_async (use_v2, cancellable);
+		} catch (DBusError.UNKNOWN_METHOD e) {
+			if (!use_v2) {
+				throw e;
+			}
+
+			// older store, use the original format from now on
+			connection.supports_v2 = false;
+			yield send_async (false, cancellable);
+		}
+	}
+
+	async void send_async (bool use_v2, Cancellable? cancellable) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError {
+		reset ();
+		v2 = use_v2;
+		request = connection.send_query (sparql, arguments, v2, out input, cancellable);
+
+		if (v2) {
+			while (!decode_header_v2 ()) {
+				if (!yield fill_async (buffer_end - buffer_start + 1, cancellable)) {
+					yield finish_async ();
+					return;
+				}
+			}
+		} else {
+			if (!yield fill_async (sizeof (int), cancellable)) {
+				yield finish_async ();
+				return;
+			}
+
+			_n_columns = peek_int ();
+		}
+	}
+
+	void finish () throws Sparql.Error, IOError, DBusError {
+		input = null;
+		finished = true;
+		set_variable_names (request.wait ());
+	}
+
+	async void finish_async () throws Sparql.Error, IOError, DBusError {
+		input = null;
+		finished = true;
+		set_variable_names (yield request.wait_async ());
+	}
+
+	void set_variable_names (DBusMessage reply) {
+		variable_names = (string[]) reply.get_body ().get_child_value (0);
+		_n_columns = variable_names.length;
+	}
+
+	inline int peek_int () {
+		return *((int*) (buffer + buffer_start));
+	}
+
+	// Moves the current row and the unread data to the start of the
+	// buffer and grows it if @size unread bytes wouldn't fit
+	void make_room (size_t size) {
+		if (row_start > 0 &&
+		    (buffer_alloc - buffer_end < BUFFER_SIZE / 2 || buffer_start + size > buffer_alloc)) {
+			Memory.move (buffer, buffer + row_start, buffer_end - row_start);
+			buffer_end -= row_start;
+			buffer_start -= row_start;
+			row_start = 0;
+			discarded = true;
+		}
+
+		size_t wanted = size_t.max (BUFFER_SIZE, buffer_start + size);
+		if (buffer_alloc < wanted) {
+			buffer = (char*) realloc (buffer, wanted);
+			buffer_alloc = wanted;
+		}
+
+		if (data != null) {
+			set_row_pointers ();
+		}
+	}
+
+	unowned uint8[] free_space () {
+		unowned uint8[] space = (uint8[]) (buffer + buffer_end);
+		space.length = (int) (buffer_alloc - buffer_end);
+		return space;
+	}
+
+	// Reads from the pipe until @size unread bytes are buffered,
+	// returns false if the stream ended before
+	bool fill (size_t size, Cancellable? cancellable) throws GLib.Error {
+		while (buffer_end - buffer_start < size) {
+			if (eof) {
+				return false;
+			}
+
+			make_room (size);
+			ssize_t n = input.read (free_space (), cancellable);
+			if (n == 0) {
+				eof = true;
+			} else {
+				buffer_end += n;
+			}
+		}
+
+		return true;
+	}
+
+	async bool fill_async (size_t size, Cancellable? cancellable) throws GLib.Error {
+		while (buffer_end - buffer_start < size) {
+			if (eof) {
+				return false;
+			}
+
+			make_room (size);
+			ssize_t n = yield input.read_async (free_space (), Priority.DEFAULT, cancellable);
+			if (n == 0) {
+				eof = true;
+			} else {
+				buffer_end += n;
+			}
+		}
+
+		return true;
+	}
+
+	/* So, the make up on each cursor segment is:
+	 *
+	 * iteration = [4 bytes for number of columns,
+	 *              columns x 4 bytes for types
+	 *              columns x 4 bytes for offsets
+	 *              column data, NUL separated]
+	 *
+	 * Returns the size of the row at the start of the buffer, as far
+	 * as it can be known from the bytes available
+	 */
+	size_t row_size () {
+		size_t available = buffer_end - buffer_start;
+
+		if (available < sizeof (int)) {
+			return sizeof (int);
+		}
+
+		int n = peek_int ();
+		size_t header_size = sizeof (int) * (1 + 2 * n);
+
+		if (n == 0 || available < header_size) {
+			return header_size;
+		}
+
+		int last_offset = *((int*) (buffer + buffer_start + header_size - sizeof (int)));
+
+		return header_size + last_offset + 1;
+	}
+
+	void set_row_pointers () {
+		char* row = buffer + row_start;
+
+		if (v2) {
+			data = row;
+			return;
+		}
+
+		_n_columns = *((int*) row);
+
+		/* Storage of ints that will be cast to TrackerSparqlValueType enums,
+		 * also see get_value_type */
+		types = (int*) (row + sizeof (int));
+		offsets = (int*) (row + sizeof (int) * (1 + n_columns));
+		data = row + sizeof (int) * (1 + 2 * n_columns);
+	}
+
+	bool read_varint (out uint64 value) {
+		int shift = 0;
+
+		value = 0;
+
+		while (read_pos < buffer_end) {
+			uint8 byte = (uint8) buffer[read_pos++];
+
+			value |= (uint64) (byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0) {
+				return true;
+			}
+			shift += 7;
+		}
+
+		return false;
+	}
+
+	bool read_bytes (size_t size, out size_t offset) {
+		offset = read_pos;
+
+		if (buffer_end - read_pos < size) {
+			return false;
+		}
+
+		read_pos += size;
+		return true;
+	}
+
+	// Returns false if the header isn't complete yet
+	bool decode_header_v2 () {
+		uint64 n, length;
+		size_t offset;
+
+		read_pos = buffer_start;
+
+		if (!read_varint (out n)) {
+			return false;
+		}
+
+		var names = new string[(int) n];
+		for (int i = 0; i < (int) n; i++) {
+			if (!read_varint (out length) || !read_bytes ((size_t) length + 1, out offset)) {
+				return false;
+			}
+			names[i] = ((string) (buffer + offset)).dup ();
+		}
+
+		variable_names = (owned) names;
+		_n_columns = (int) n;
+
+		v2_types = new int[_n_columns];
+		v2_integers = new int64[_n_columns];
+		v2_doubles = new double[_n_columns];
+		v2_strings = new long[_n_columns];
+		v2_formatted = new string[_n_columns];
+		dictionary = new GenericArray<string> ();
+
+		header_end = read_pos;
+		buffer_start = read_pos;
+		row_start = read_pos;
+
+		return true;
+	}
+
+	// Returns false if the row isn't complete yet, the dictionary
+	// is then left as it was
+	bool decode_row_v2 () {
+		int dictionary_length = dictionary.length;
+		size_t offset;
+		uint64 value;
+
+		read_pos = buffer_start;
+
+		for (int i = 0; i < _n_columns; i++) {
+			if (!read_bytes (1, out offset)) {
+				dictionary.length = dictionary_length;
+				return false;
+			}
+
+			v2_types[i] = (uint8) buffer[offset];
+			v2_formatted[i] = null;
+
+			bool complete = true;
+
+			switch ((Sparql.ValueType) v2_types[i]) {
+			case Sparql.ValueType.UNBOUND:
+				break;
+			case Sparql.ValueType.INTEGER:
+				complete = read_varint (out value);
+				v2_integers[i] = (int64) (value >> 1) ^ -((int64) (value & 1));
+				break;
+			case Sparql.ValueType.DOUBLE:
+				complete = read_bytes (sizeof (double), out offset);
+				if (complete) {
+					Memory.copy (&v2_doubles[i], buffer + offset, sizeof (double));
+				}
+				break;
+			case Sparql.ValueType.BOOLEAN:
+				complete = read_bytes (1, out offset);
+				if (complete) {
+					v2_integers[i] = buffer[offset] != 0 ? 1 : 0;
+				}
+				break;
+			default:
+				complete = read_varint (out value);
+				if (!complete) {
+					break;
+				}
+
+				if ((value & 3) == 2) {
+					v2_strings[i] = -1 - (long) (value >> 2);
+				} else {
+					complete = read_bytes ((size_t) (value >> 2) + 1, out offset);
+					if (complete) {
+						v2_strings[i] = (long) (offset - buffer_start);
+						if ((value & 3) == 1) {
+							dictionary.add (((string) (buffer + offset)).dup ());
+						}
+					}
+				}
+				break;
+			}
+
+			if (!complete) {
+				dictionary.length = dictionary_length;
+				return false;
+			}
+		}
+
+		row_start = buffer_start;
+		set_row_pointers ();
+		buffer_start = read_pos;
+
+		return true;
+	}
+
+	// Decodes the next row if it is completely buffered, otherwise
+	// returns the number of unread bytes needed
+	size_t decode_row () {
+		if (v2) {
+			if (buffer_end > buffer_start && decode_row_v2 ()) {
+				return 0;
+			}
 
-		buffer_index += 4;
+			return buffer_end - buffer_start + 1;
+		}
+
+		size_t size = row_size ();
+
+		if (size > buffer_end - buffer_start) {
+			return size;
+		}
+
+		row_start = buffer_start;
+		set_row_pointers ();
+		buffer_start += size;
 
-		return v;
+		return 0;
+	}
+
+	// Same text as SQLite gives for REAL values in the original format
+	static string format_double (double value) {
+		char[] buf = new char[double.DTOSTR_BUF_SIZE];
+		string str = value.format (buf, "%.15g");
+
+		if (value.is_finite () && str.index_of_char ('.') < 0) {
+			int e = str.index_of_char ('e');
+
+			if (e < 0) {
+				str += ".0";
+			} else {
+				str = str.substring (0, e) + ".0" + str.substring (e);
+			}
+		}
+
+		return str;
 	}
 
 	public override int n_columns {
@@ -52,20 +525,67 @@ class Tracker.Bus.FDCursor : Tracker.Sparql.Cursor {
 	}
 
 	public override Sparql.ValueType get_value_type (int column)
-	requires (types != null) {
+	requires (data != null) {
 		/* Cast from int to enum */
-		return (Sparql.ValueType) types[column];
+		return (Sparql.ValueType) (v2 ? v2_types[column] : types[column]);
 	}
 
-	public override unowned string? get_variable_name (int column)
-	requires (variable_names != null) {
+	public override unowned string? get_variable_name (int column) {
+		if (variable_names == null) {
+			// the names come with the reply, which the store only
+			// sends after writing all rows, so read up to the end
+			try {
+				while (fill (buffer_end - buffer_start + BUFFER_SIZE, null)) {
+				}
+				set_variable_names (request.wait ());
+			} catch (Error e) {
+				warning ("Could not get variable names: %s", e.message);
+				return null;
+			}
+		}
+
 		return variable_names[column];
 	}
 
+	unowned string? get_string_v2 (int column) {
+		switch ((Sparql.ValueType) v2_types[column]) {
+		case Sparql.ValueType.UNBOUND:
+			return null;
+		case Sparql.ValueType.INTEGER:
+			if (v2_formatted[column] == null) {
+				v2_formatted[column] = v2_integers[column].to_string ();
+			}
+			return v2_formatted[column];
+		case Sparql.ValueType.DOUBLE:
+			if (v2_formatted[column] == null) {
+				v2_formatted[column] = format_double (v2_doubles[column]);
+			}
+			return v2_formatted[column];
+		case Sparql.ValueType.BOOLEAN:
+			return v2_integers[column] != 0 ? "true" : "false";
+		default:
+			long offset = v2_strings[column];
+
+			if (offset < 0) {
+				int index = (int) (-1 - offset);
+				return_val_if_fail (index < dictionary.length, null);
+				return dictionary[index];
+			}
+
+			return (string) (data + offset);
+		}
+	}
+
 	public override unowned string? get_string (int column, out long length = null)
 	requires (column < n_columns && data != null) {
 		unowned string str = null;
 
+		if (v2) {
+			str = get_string_v2 (column);
+			length = str != null ? str.length : 0;
+			return str;
+		}
+
 		// return null instead of empty string for unbound values
 		if (types[column] == Sparql.ValueType.UNBOUND) {
 			length = 0;
@@ -83,49 +603,113 @@ class Tracker.Bus.FDCursor : Tracker.Sparql.Cursor {
 		return str;
 	}
 
-	public override bool next (Cancellable? cancellable = null) throws GLib.Error {
-		int last_offset;
-
-		if (cancellable != null && cancellable.is_cancelled ()) {
-			throw new IOError.CANCELLED ("Operation was cancelled");
+	public override int64 get_integer (int column)
+	requires (column < n_columns && data != null) {
+		if (v2) {
+			return_val_if_fail (v2_types[column] == Sparql.ValueType.INTEGER, 0);
+			return v2_integers[column];
 		}
 
-		if (buffer_index >= buffer_size) {
-			return false;
+		return base.get_integer (column);
+	}
+
+	public override double get_double (int column)
+	requires (column < n_columns && data != null) {
+		if (v2) {
+			return_val_if_fail (v2_types[column] == Sparql.ValueType.DOUBLE, 0);
+			return v2_doubles[column];
 		}
 
-		/* So, the make up on each cursor segment is:
-		 *
-		 * iteration = [4 bytes for number of columns,
-		 *              columns x 4 bytes for types
-		 *              columns x 4 bytes for offsets]
-		 */
+		return base.get_double (column);
+	}
 
-		_n_columns = buffer_read_int ();
+	public override bool get_boolean (int column)
+	requires (column < n_columns && data != null) {
+		if (v2) {
+			return_val_if_fail (v2_types[column] == Sparql.ValueType.BOOLEAN, false);
+			return v2_integers[column] != 0;
+		}
 
-		/* Storage of ints that will be cast to TrackerSparqlValueType enums,
-		 * also see get_value_type */
-		types = (int*) (buffer + buffer_index);
-		buffer_index += sizeof (int) * n_columns;
+		return base.get_boolean (column);
+	}
 
-		offsets = (int*) (buffer + buffer_index);
-		buffer_index += sizeof (int) * (n_columns - 1);
-		last_offset = buffer_read_int ();
+	public override bool next (Cancellable? cancellable = null) throws GLib.Error {
+		if (cancellable != null && cancellable.is_cancelled ()) {
+			throw new IOError.CANCELLED ("Operation was cancelled");
+		}
 
-		data = buffer + buffer_index;
+		if (input == null && !finished) {
+			// rewound after rows were dropped
+			var context = new MainContext ();
+			var loop = new MainLoop (context, false);
+			context.push_thread_default ();
+			AsyncResult async_res = null;
+			start_async.begin (cancellable, (o, res) => {
+				async_res = res;
+				loop.quit ();
+			});
+			loop.run ();
+			context.pop_thread_default ();
+			start_async.end (async_res);
+		}
 
-		buffer_index += last_offset + 1;
+		// the current row can be dropped from the buffer now
+		row_start = buffer_start;
+		data = null;
+
+		size_t size;
+		while ((size = decode_row ()) > 0) {
+			if (finished || !fill (size, cancellable)) {
+				if (!finished) {
+					finish ();
+				}
+				return false;
+			}
+		}
 
 		return true;
 	}
 
 	public override async bool next_async (Cancellable? cancellable = null) throws GLib.Error {
-		// next never blocks
-		return next (cancellable);
+		if (cancellable != null && cancellable.is_cancelled ()) {
+			throw new IOError.CANCELLED ("Operation was cancelled");
+		}
+
+		if (input == null && !finished) {
+			yield start_async (cancellable);
+		}
+
+		// the current row can be dropped from the buffer now
+		row_start = buffer_start;
+		data = null;
+
+		size_t size;
+		while ((size = decode_row ()) > 0) {
+			if (finished || !yield fill_async (size, cancellable)) {
+				if (!finished) {
+					yield finish_async ();
+				}
+				return false;
+			}
+		}
+
+		return true;
 	}
 
 	public override void rewind () {
-		buffer_index = 0;
-		data = buffer;
+		if (!discarded) {
+			// all rows are still buffered, the dictionary is built
+			// up again while decoding them
+			row_start = header_end;
+			buffer_start = header_end;
+			data = null;
+			if (dictionary != null) {
+				dictionary.length = 0;
+			}
+		} else {
+			// drop the pipe, the query is sent again on next ()
+			input = null;
+			finished = false;
+		}
 	}
 }
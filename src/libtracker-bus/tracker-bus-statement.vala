@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2017, Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+// The query is prepared by the store, which keeps its translation
+// cached, values are sent along with the query on every execution
+public class Tracker.Bus.Statement : Tracker.Sparql.Statement {
+	HashTable<string,Variant> values;
+
+	public Statement (Bus.Connection conn, string sparql) {
+		Object (connection: conn, sparql: sparql);
+		this.values = new HashTable<string,Variant> (str_hash, str_equal);
+	}
+
+	public override void bind_int (string name, int64 value) {
+		values.insert (name, new Variant.int64 (value));
+	}
+
+	public override void bind_boolean (string name, bool value) {
+		values.insert (name, new Variant.boolean (value));
+	}
+
+	public override void bind_string (string name, string value) {
+		values.insert (name, new Variant.string (value));
+	}
+
+	public override void bind_double (string name, double value) {
+		values.insert (name, new Variant.double (value));
+	}
+
+	public override void bind_datetime (string name, DateTime value) {
+		values.insert (name, new Variant.string (value.format ("%FT%T%:z")));
+	}
+
+	public override void clear_bindings () {
+		values.remove_all ();
+	}
+
+	Variant get_arguments () {
+		var builder = new VariantBuilder (new VariantType ("a{sv}"));
+
+		values.foreach ((name, value) => {
+			builder.add ("{sv}", name, value);
+		});
+
+		return builder.end ();
+	}
+
+	public override Sparql.Cursor execute (Cancellable? cancellable = null) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError {
+		// use separate main context for sync operation
+		var context = new MainContext ();
+		var loop = new MainLoop (context, false);
+		context.push_thread_default ();
+		AsyncResult async_res = null;
+		execute_async.begin (cancellable, (o, res) => {
+			async_res = res;
+			loop.quit ();
+		});
+		loop.run ();
+		context.pop_thread_default ();
+		return execute_async.end (async_res);
+	}
+
+	public async override Sparql.Cursor execute_async (Cancellable? cancellable = null) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError {
+		var conn = (Bus.Connection) connection;
+		return yield conn.execute_query_async (sparql, get_arguments (), cancellable);
+	}
+}
@@ -21,6 +21,9 @@ public class Tracker.Bus.Connection : Tracker.Sparql.Connection {
 	DBusConnection bus;
 	string dbus_name;
 
+	// cleared once the store turns out not to know Steroids.QueryV2
+	internal bool supports_v2 = true;
+
 	public Connection (string dbus_name) throws Sparql.Error, IOError, DBusError, GLib.Error {
 		this.dbus_name = dbus_name;
 		bus = GLib.Bus.get_sync (Tracker.IPC.bus ());
@@ -47,9 +50,9 @@ public class Tracker.Bus.Connection : Tracker.Sparql.Connection {
 		output = new UnixOutputStream (pipefd[1], true);
 	}
 
-	void handle_error_reply (DBusMessage message) throws Sparql.Error, IOError, DBusError {
+	internal static void handle_error (Error error) throws Sparql.Error, IOError, DBusError {
 		try {
-			message.to_gerror ();
+			throw error.copy ();
 		} catch (IOError e_io) {
 			throw e_io;
 		} catch (Sparql.Error e_sparql) {
@@ -61,13 +64,40 @@ public class Tracker.Bus.Connection : Tracker.Sparql.Connection {
 		}
 	}
 
-	void send_query (string sparql, UnixOutputStream output, Cancellable? cancellable, AsyncReadyCallback? callback) throws GLib.IOError, GLib.Error {
-		var message = new DBusMessage.method_call (dbus_name, Tracker.DBUS_OBJECT_STEROIDS, Tracker.DBUS_INTERFACE_STEROIDS, "Query");
+	internal static void handle_error_reply (DBusMessage message) throws Sparql.Error, IOError, DBusError {
+		try {
+			message.to_gerror ();
+		} catch (Error e) {
+			handle_error (e);
+		}
+	}
+
+	// Sends the query, the results can be read from @input as the store
+	// writes them, in the v2 format if @v2 is set
+	internal QueryRequest send_query (string sparql, Variant? arguments, bool v2, out UnixInputStream input, Cancellable? cancellable) throws GLib.IOError, GLib.Error {
+		DBusMessage message;
+		UnixOutputStream output;
 		var fd_list = new UnixFDList ();
-		message.set_body (new Variant ("(sh)", sparql, fd_list.append (output.fd)));
+
+		pipe (out input, out output);
+
+		if (v2) {
+			if (arguments == null) {
+				arguments = new Variant.array (VariantType.VARDICT.element (), null);
+			}
+			message = new DBusMessage.method_call (dbus_name, Tracker.DBUS_OBJECT_STEROIDS, Tracker.DBUS_INTERFACE_STEROIDS, "QueryV2");
+			message.set_body (new Variant ("(s@a{sv}h)", sparql, arguments, fd_list.append (output.fd)));
+		} else if (arguments != null) {
+			// a{sv} with the values of the ~parameters in the query
+			message = new DBusMessage.method_call (dbus_name, Tracker.DBUS_OBJECT_STEROIDS, Tracker.DBUS_INTERFACE_STEROIDS, "QueryStatement");
+			message.set_body (new Variant ("(s@a{sv}h)", sparql, arguments, fd_list.append (output.fd)));
+		} else {
+			message = new DBusMessage.method_call (dbus_name, Tracker.DBUS_OBJECT_STEROIDS, Tracker.DBUS_INTERFACE_STEROIDS, "Query");
+			message.set_body (new Variant ("(sh)", sparql, fd_list.append (output.fd)));
+		}
 		message.set_unix_fd_list (fd_list);
 
-		bus.send_message_with_reply.begin (message, DBusSendMessageFlags.NONE, int.MAX, null, cancellable, callback);
+		return new QueryRequest (bus, message, cancellable);
 	}
 
 	public override Sparql.Cursor query (string sparql, Cancellable? cancellable) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError {
@@ -86,41 +116,17 @@ public class Tracker.Bus.Connection : Tracker.Sparql.Connection {
 	}
 
 	public async override Sparql.Cursor query_async (string sparql, Cancellable? cancellable = null) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError {
-		UnixInputStream input;
-		UnixOutputStream output;
-		pipe (out input, out output);
-
-		// send D-Bus request
-		AsyncResult dbus_res = null;
-		bool received_result = false;
-		send_query (sparql, output, cancellable, (o, res) => {
-			dbus_res = res;
-			if (received_result) {
-				query_async.callback ();
-			}
-		});
-
-		output = null;
-
-		// receive query results via FD
-		var mem_stream = new MemoryOutputStream (null, GLib.realloc, GLib.free);
-
-		try {
-			yield mem_stream.splice_async (input, OutputStreamSpliceFlags.CLOSE_SOURCE | OutputStreamSpliceFlags.CLOSE_TARGET, Priority.DEFAULT, cancellable);
-		} finally {
-			// wait for D-Bus reply
-			received_result = true;
-			if (dbus_res == null) {
-				yield;
-			}
-		}
+		return yield execute_query_async (sparql, null, cancellable);
+	}
 
-		var reply = bus.send_message_with_reply.end (dbus_res);
-		handle_error_reply (reply);
+	public override Sparql.Statement? query_statement (string sparql, Cancellable? cancellable = null) throws Sparql.Error {
+		return new Bus.Statement (this, sparql);
+	}
 
-		string[] variable_names = (string[]) reply.get_body ().get_child_value (0);
-		mem_stream.close ();
-		return new FDCursor (mem_stream.steal_data (), mem_stream.data_size, variable_names);
+	internal async Sparql.Cursor execute_query_async (string sparql, Variant? arguments, Cancellable? cancellable) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError {
+		var cursor = new FDCursor (this, sparql, arguments);
+		yield cursor.start_async (cancellable);
+		return cursor;
 	}
 
 	void send_update (string method, UnixInputStream input, Cancellable? cancellable, AsyncReadyCallback? callback) throws GLib.Error, GLib.IOError {
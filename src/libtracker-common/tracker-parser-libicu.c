@@ -67,11 +67,23 @@ struct TrackerParser {
 	gint                   utxt_size;
 	/* Original offset of each UChar in the input txt string */
 	gint32                *offsets;
+	/* Number of elements allocated in utxt and offsets */
+	gint                   utxt_alloc;
 
-	/* The word-break iterator */
+	/* Converter and word-break iterator, kept across resets as
+	 * opening those is far more expensive than reusing them */
+	UConverter            *converter;
 	UBreakIterator        *bi;
+	gchar                 *bi_locale;
 
-	/* Cursor, as index of the utxt array of bytes */
+	/* ASCII-only text is tokenized straight from txt, if the
+	 * word-break rules for ascii_rules_locale are the root ones */
+	gboolean               ascii;
+	gboolean               ascii_rules;
+	gchar                 *ascii_rules_locale;
+
+	/* Cursor, as index of the utxt array of bytes (or of txt,
+	 * for ASCII-only text) */
 	gsize                  cursor;
 };
 
@@ -207,26 +219,19 @@ tracker_parser_unaccent_nfkd_string (gpointer  str,
 }
 
 static gchar *
-convert_UChar_to_utf8 (const UChar *word,
+convert_UChar_to_utf8 (UConverter  *converter,
+                       const UChar *word,
                        gsize        uchar_len,
                        gsize       *utf8_len)
 {
 	gchar *utf8_str;
 	UErrorCode icu_error = U_ZERO_ERROR;
-	UConverter *converter;
 	gsize new_utf8_len;
 
+	g_return_val_if_fail (converter, NULL);
 	g_return_val_if_fail (word, NULL);
 	g_return_val_if_fail (utf8_len, NULL);
 
-	/* Open converter UChar to UTF-16BE */
-	converter = ucnv_open ("UTF-8", &icu_error);
-	if (!converter) {
-		g_warning ("Cannot open UTF-8 converter: '%s'",
-		           U_FAILURE (icu_error) ? u_errorName (icu_error) : "none");
-		return NULL;
-	}
-
 	/* A character encoded in 2 bytes in UTF-16 may get expanded to 3 or 4 bytes
 	 *  in UTF-8. */
 	utf8_str = g_malloc (2 * uchar_len * sizeof (UChar) + 1);
@@ -242,12 +247,50 @@ convert_UChar_to_utf8 (const UChar *word,
 		g_warning ("Cannot convert from UChar to UTF-8: '%s'",
 		           u_errorName (icu_error));
 		g_free (utf8_str);
-		ucnv_close (converter);
 		return NULL;
 	}
 
 	*utf8_len = new_utf8_len;
-	ucnv_close (converter);
+
+	return utf8_str;
+}
+
+/* Stop word check and stemming, common to all words once lowercased
+ * (or casefolded and normalized) and in UTF-8. Takes ownership of
+ * utf8_str.
+ */
+static gchar *
+process_word_utf8 (TrackerParser *parser,
+                   gchar         *utf8_str,
+                   gsize          length,
+                   gboolean      *stop_word)
+{
+	/* Check if stop word */
+	if (parser->ignore_stop_words) {
+		*stop_word = tracker_language_is_stop_word (parser->language,
+		                                            utf8_str);
+	}
+
+	/* Stemming needed? */
+	if (utf8_str &&
+	    parser->enable_stemmer) {
+		gchar *stemmed;
+
+		/* Input for stemmer ALWAYS in UTF-8, as well as output */
+		stemmed = tracker_language_stem_word (parser->language,
+		                                      utf8_str,
+		                                      length);
+
+		/* Log after stemming */
+		tracker_parser_message_hex ("    After stemming",
+		                            stemmed, strlen (stemmed));
+
+		/* If stemmed wanted and succeeded, free previous and return it */
+		if (stemmed) {
+			g_free (utf8_str);
+			return stemmed;
+		}
+	}
 
 	return utf8_str;
 }
@@ -345,43 +388,19 @@ process_word_uchar (TrackerParser         *parser,
 	}
 
 	/* Finally, convert to UTF-8 */
-	utf8_str = convert_UChar_to_utf8 (normalized_buffer,
+	utf8_str = convert_UChar_to_utf8 (parser->converter,
+	                                  normalized_buffer,
 	                                  new_word_length,
 	                                  &new_word_length);
+	if (!utf8_str)
+		return NULL;
 
 	/* Log after unaccenting */
 	tracker_parser_message_hex ("   After UTF8 conversion",
 	                            utf8_str,
 	                            new_word_length);
 
-	/* Check if stop word */
-	if (parser->ignore_stop_words) {
-		*stop_word = tracker_language_is_stop_word (parser->language,
-		                                            utf8_str);
-	}
-
-	/* Stemming needed? */
-	if (utf8_str &&
-	    parser->enable_stemmer) {
-		gchar *stemmed;
-
-		/* Input for stemmer ALWAYS in UTF-8, as well as output */
-		stemmed = tracker_language_stem_word (parser->language,
-		                                      utf8_str,
-		                                      new_word_length);
-
-		/* Log after stemming */
-		tracker_parser_message_hex ("    After stemming",
-		                            stemmed, strlen (stemmed));
-
-		/* If stemmed wanted and succeeded, free previous and return it */
-		if (stemmed) {
-			g_free (utf8_str);
-			return stemmed;
-		}
-	}
-
-	return utf8_str;
+	return process_word_utf8 (parser, utf8_str, new_word_length, stop_word);
 }
 
 static gboolean
@@ -425,6 +444,138 @@ parser_check_forced_wordbreaks (const UChar *buffer,
 	return FALSE;
 }
 
+/* libicu word-break rules treat '@' as a letter */
+#define IS_ASCII_LETTER(c)    (g_ascii_isalpha (c) || (c) == '@')
+#define IS_ASCII_WORD_CHAR(c) (IS_ASCII_LETTER (c) || g_ascii_isdigit (c) || (c) == '_')
+
+/* Returns the end of the segment starting at pos, following the
+ * same word-break rules libicu applies to ASCII text: letters,
+ * digits and underscores make up words, an apostrophe joins letters
+ * or digits on both sides (as in "can't"), and commas or semicolons
+ * join digits (as in "1,000"). Dots are always forced wordbreaks.
+ * Any other character is a segment of its own.
+ */
+static gsize
+parser_ascii_word_end (const gchar *txt,
+                       gsize        pos,
+                       gsize        txt_size)
+{
+	if (!IS_ASCII_WORD_CHAR (txt[pos]))
+		return pos + 1;
+
+	for (pos++; pos < txt_size; pos++) {
+		gchar prev, next;
+
+		if (IS_ASCII_WORD_CHAR (txt[pos]))
+			continue;
+
+		if (pos + 1 >= txt_size)
+			break;
+
+		prev = txt[pos - 1];
+		next = txt[pos + 1];
+
+		if (txt[pos] == '\'' &&
+		    ((IS_ASCII_LETTER (prev) && IS_ASCII_LETTER (next)) ||
+		     (g_ascii_isdigit (prev) && g_ascii_isdigit (next)))) {
+			pos++;
+		} else if ((txt[pos] == ',' || txt[pos] == ';') &&
+		           g_ascii_isdigit (prev) && g_ascii_isdigit (next)) {
+			pos++;
+		} else {
+			break;
+		}
+	}
+
+	return pos;
+}
+
+/* parser_ascii_word_end() only follows the root word-break rules,
+ * some locales (e.g. POSIX, fi or sv) tailor those, so ask libicu
+ * where the rules for the locale come from.
+ */
+static gboolean
+parser_locale_has_ascii_rules (TrackerParser *parser,
+                               const gchar   *locale)
+{
+	UErrorCode error = U_ZERO_ERROR;
+	UBreakIterator *bi;
+	const gchar *actual_locale = NULL;
+
+	if (parser->ascii_rules_locale &&
+	    g_strcmp0 (locale, parser->ascii_rules_locale) == 0)
+		return parser->ascii_rules;
+
+	bi = ubrk_open (UBRK_WORD, locale, NULL, 0, &error);
+
+	if (U_SUCCESS (error))
+		actual_locale = ubrk_getLocaleByType (bi, ULOC_ACTUAL_LOCALE, &error);
+
+	parser->ascii_rules = (U_SUCCESS (error) && actual_locale &&
+	                       (actual_locale[0] == '\0' ||
+	                        strcmp (actual_locale, "root") == 0));
+
+	if (bi)
+		ubrk_close (bi);
+
+	g_free (parser->ascii_rules_locale);
+	parser->ascii_rules_locale = g_strdup (locale);
+
+	return parser->ascii_rules;
+}
+
+/* ASCII-only text needs no casefolding, normalization or unaccenting,
+ * so there's no point in converting it to UChars and back.
+ */
+static gboolean
+parser_next_ascii (TrackerParser *parser,
+                   gint          *byte_offset_start,
+                   gint          *byte_offset_end,
+                   gboolean      *stop_word)
+{
+	while (parser->cursor < parser->txt_size) {
+		const gchar *word;
+		gsize word_start, word_length;
+		gchar *processed_word;
+
+		word_start = parser->cursor;
+		parser->cursor = parser_ascii_word_end (parser->txt,
+		                                        parser->cursor,
+		                                        parser->txt_size);
+		word = &parser->txt[word_start];
+		word_length = parser->cursor - word_start;
+
+		/* Ignore the word if longer than the maximum allowed */
+		if (word_length >= parser->max_word_length)
+			continue;
+
+		/* Ignore the word if not an allowed word start */
+		if (!g_ascii_isalpha (word[0]) &&
+		    !IS_UNDERSCORE_UCS4 ((guint32) word[0]) &&
+		    (parser->ignore_numbers || !g_ascii_isdigit (word[0])))
+			continue;
+
+		if (parser->ignore_reserved_words &&
+		    tracker_parser_is_reserved_word_utf8 (word, word_length))
+			continue;
+
+		processed_word = g_ascii_strdown (word, MIN (word_length, WORD_BUFFER_LENGTH));
+		processed_word = process_word_utf8 (parser, processed_word,
+		                                    strlen (processed_word),
+		                                    stop_word);
+
+		*byte_offset_start = word_start;
+		*byte_offset_end = parser->cursor;
+
+		parser->word_length = strlen (processed_word);
+		parser->word = processed_word;
+
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
 static gboolean
 parser_next (TrackerParser *parser,
              gint          *byte_offset_start,
@@ -441,6 +592,13 @@ parser_next (TrackerParser *parser,
 
 	g_return_val_if_fail (parser, FALSE);
 
+	if (parser->ascii) {
+		return parser_next_ascii (parser,
+		                          byte_offset_start,
+		                          byte_offset_end,
+		                          stop_word);
+	}
+
 	/* Loop to look for next valid word */
 	while (!processed_word &&
 	       parser->cursor < parser->utxt_size) {
@@ -592,6 +750,12 @@ tracker_parser_free (TrackerParser *parser)
 		ubrk_close (parser->bi);
 	}
 
+	if (parser->converter) {
+		ucnv_close (parser->converter);
+	}
+
+	g_free (parser->bi_locale);
+	g_free (parser->ascii_rules_locale);
 	g_free (parser->utxt);
 	g_free (parser->offsets);
 
@@ -612,9 +776,10 @@ tracker_parser_reset (TrackerParser *parser,
                       gboolean       ignore_numbers)
 {
 	UErrorCode error = U_ZERO_ERROR;
-	UConverter *converter;
 	UChar *last_uchar;
 	const gchar *last_utf8;
+	const gchar *locale;
+	gint i;
 
 	g_return_if_fail (parser != NULL);
 	g_return_if_fail (txt != NULL);
@@ -637,14 +802,8 @@ tracker_parser_reset (TrackerParser *parser,
 	g_free (parser->word);
 	parser->word = NULL;
 
-	if (parser->bi) {
-		ubrk_close (parser->bi);
-		parser->bi = NULL;
-	}
-	g_free (parser->utxt);
-	parser->utxt = NULL;
-	g_free (parser->offsets);
-	parser->offsets = NULL;
+	parser->utxt_size = 0;
+	parser->ascii = FALSE;
 
 	parser->word_position = 0;
 
@@ -653,25 +812,40 @@ tracker_parser_reset (TrackerParser *parser,
 	if (parser->txt_size == 0)
 		return;
 
-	/* Open converter UTF-8 to UChar */
-	converter = ucnv_open ("UTF-8", &error);
-	if (!converter) {
-		g_warning ("Cannot open UTF-8 converter: '%s'",
-		           U_FAILURE (error) ? u_errorName (error) : "none");
+	for (i = 0; i < txt_size && IS_ASCII_UCS4 ((guchar) txt[i]); i++)
+		;
+
+	if (i == txt_size &&
+	    parser_locale_has_ascii_rules (parser, setlocale (LC_CTYPE, NULL))) {
+		parser->ascii = TRUE;
 		return;
 	}
 
-	/* Allocate UChars and offsets buffers */
-	parser->utxt_size = txt_size + 1;
-	parser->utxt = g_malloc (parser->utxt_size * sizeof (UChar));
-	parser->offsets = g_malloc (parser->utxt_size * sizeof (gint32));
+	/* Open converter UTF-8 to UChar, or reset the one we have */
+	if (!parser->converter) {
+		parser->converter = ucnv_open ("UTF-8", &error);
+		if (!parser->converter) {
+			g_warning ("Cannot open UTF-8 converter: '%s'",
+			           U_FAILURE (error) ? u_errorName (error) : "none");
+			return;
+		}
+	} else {
+		ucnv_reset (parser->converter);
+	}
+
+	/* Grow UChars and offsets buffers if needed */
+	if (txt_size + 1 > parser->utxt_alloc) {
+		parser->utxt_alloc = txt_size + 1;
+		parser->utxt = g_renew (UChar, parser->utxt, parser->utxt_alloc);
+		parser->offsets = g_renew (gint32, parser->offsets, parser->utxt_alloc);
+	}
 
 	/* last_uchar and last_utf8 will be also an output parameter! */
 	last_uchar = parser->utxt;
 	last_utf8 = parser->txt;
 
 	/* Convert to UChars storing offsets */
-	ucnv_toUnicode (converter,
+	ucnv_toUnicode (parser->converter,
 	                &last_uchar,
 	                &parser->utxt[txt_size],
 	                &last_utf8,
@@ -683,36 +857,46 @@ tracker_parser_reset (TrackerParser *parser,
 		/* Proper UChar array size is now given by 'last_uchar' */
 		parser->utxt_size = last_uchar - parser->utxt;
 
-		/* Open word-break iterator */
-		parser->bi = ubrk_open(UBRK_WORD,
-		                       setlocale (LC_CTYPE, NULL),
-		                       parser->utxt,
-		                       parser->utxt_size,
-		                       &error);
+		/* Word-break rules depend on the locale */
+		locale = setlocale (LC_CTYPE, NULL);
+
+		if (parser->bi && g_strcmp0 (locale, parser->bi_locale) != 0) {
+			ubrk_close (parser->bi);
+			parser->bi = NULL;
+		}
+
+		if (parser->bi) {
+			ubrk_setText (parser->bi,
+			              parser->utxt,
+			              parser->utxt_size,
+			              &error);
+		} else {
+			/* Open word-break iterator */
+			parser->bi = ubrk_open (UBRK_WORD,
+			                        locale,
+			                        parser->utxt,
+			                        parser->utxt_size,
+			                        &error);
+			g_free (parser->bi_locale);
+			parser->bi_locale = g_strdup (locale);
+		}
+
 		if (U_SUCCESS (error)) {
 			/* Find FIRST word in the UChar array */
 			parser->cursor = ubrk_first (parser->bi);
 		}
 	}
 
-	/* If any error happened, reset buffers */
+	/* If any error happened, leave no text to iterate */
 	if (U_FAILURE (error)) {
 		g_warning ("Error initializing libicu support: '%s'",
 		           u_errorName (error));
-		/* Reset buffers */
-		g_free (parser->utxt);
-		parser->utxt = NULL;
-		g_free (parser->offsets);
-		parser->offsets = NULL;
 		parser->utxt_size = 0;
 		if (parser->bi) {
 			ubrk_close (parser->bi);
 			parser->bi = NULL;
 		}
 	}
-
-	/* Close converter */
-	ucnv_close (converter);
 }
 
 const gchar *
@@ -39,6 +39,7 @@
 #include "tracker-class.h"
 #include "tracker-data-manager.h"
 #include "tracker-data-update.h"
+#include "tracker-db-backup.h"
 #include "tracker-db-interface-sqlite.h"
 #include "tracker-db-manager.h"
 #include "tracker-db-journal.h"
@@ -65,6 +66,9 @@
 
 #define ZLIBBUFSIZ 8192
 
+/* Number of translated SPARQL queries kept around for reuse */
+#define QUERY_CACHE_SIZE 256
+
 struct _TrackerDataManager {
 	GObject parent_instance;
 
@@ -89,6 +93,7 @@ struct _TrackerDataManager {
 	TrackerDBManager *db_manager;
 	TrackerOntologies *ontologies;
 	TrackerData *data_update;
+	TrackerSparqlQueryCache *query_cache;
 
 	gchar *status;
 };
@@ -3534,6 +3539,9 @@ tracker_data_ontology_import_finished (TrackerDataManager *manager)
 		tracker_property_set_db_schema_changed (properties[i], FALSE);
 		tracker_property_set_cardinality_changed (properties[i], FALSE);
 	}
+
+	/* Plans translated while the ontology was being imported are stale */
+	tracker_sparql_query_cache_clear (manager->query_cache);
 }
 
 static gboolean
@@ -4001,6 +4009,113 @@ tracker_data_manager_new (TrackerDBManagerFlags   flags,
 	return manager;
 }
 
+static TrackerDBManager *
+open_db_manager (TrackerDataManager     *manager,
+                 TrackerDBManagerFlags   flags,
+                 gboolean               *first_time,
+                 GError                **error)
+{
+	return tracker_db_manager_new (flags,
+	                               manager->cache_location,
+	                               manager->data_location,
+	                               first_time,
+	                               manager->restoring_backup,
+	                               FALSE,
+	                               manager->select_cache_size,
+	                               manager->update_cache_size,
+	                               busy_callback, manager, "",
+	                               G_OBJECT (manager),
+	                               error);
+}
+
+/* The write statements kept on the properties must go before the
+ * connection they were prepared on is closed.
+ */
+static void
+clear_property_statements (TrackerDataManager *manager)
+{
+	TrackerProperty **properties;
+	guint i, n_properties;
+
+	if (!manager->ontologies) {
+		return;
+	}
+
+	properties = tracker_ontologies_get_properties (manager->ontologies, &n_properties);
+	for (i = 0; i < n_properties; i++) {
+		tracker_property_clear_statements (properties[i]);
+	}
+}
+
+#ifndef DISABLE_JOURNAL
+/* Cuts off damaged entries at the end of the active journal, which
+ * would otherwise get the restored snapshot recreated again.
+ */
+static void
+truncate_damaged_journal (TrackerDataManager *manager)
+{
+	TrackerDBJournalReader *reader;
+	TrackerDBJournal *writer;
+	gsize size;
+
+	if (tracker_db_journal_reader_verify_last (manager->data_location, NULL)) {
+		return;
+	}
+
+	/* There's no such chunk, so this reads the active journal only */
+	reader = tracker_db_journal_reader_new_from_chunk (manager->data_location, G_MAXINT, NULL);
+	if (!reader) {
+		return;
+	}
+
+	while (tracker_db_journal_reader_next (reader, NULL))
+		;
+
+	size = tracker_db_journal_reader_get_size_of_correct (reader);
+	tracker_db_journal_reader_free (reader);
+
+	writer = tracker_db_journal_new (manager->data_location, FALSE, NULL);
+	if (writer) {
+		tracker_db_journal_truncate (writer, size);
+		tracker_db_journal_free (writer, NULL);
+	}
+}
+
+/* Replaces the database that was just recreated with the journal
+ * snapshot, so only the journal chunks after it need replaying.
+ */
+static gboolean
+restore_snapshot (TrackerDataManager  *manager,
+                  GFile               *snapshot,
+                  gboolean            *first_time,
+                  GError             **error)
+{
+	TrackerDBManagerFlags flags;
+	GError *internal_error = NULL;
+	GFile *db_file;
+
+	db_file = g_file_new_for_path (tracker_db_manager_get_file (manager->db_manager));
+	clear_property_statements (manager);
+	g_clear_pointer (&manager->db_manager, tracker_db_manager_free);
+
+	if (tracker_db_backup_snapshot (snapshot, db_file, &internal_error)) {
+		truncate_damaged_journal (manager);
+		flags = manager->flags & ~TRACKER_DB_MANAGER_FORCE_REINDEX;
+	} else {
+		g_warning ("Could not restore database snapshot: %s", internal_error->message);
+		g_clear_error (&internal_error);
+		/* Start over with an empty database */
+		flags = manager->flags | TRACKER_DB_MANAGER_FORCE_REINDEX;
+	}
+
+	g_object_unref (db_file);
+
+	manager->db_manager = open_db_manager (manager, flags, first_time, error);
+
+	return manager->db_manager != NULL;
+}
+#endif /* DISABLE_JOURNAL */
+
 static gboolean
 tracker_data_manager_initable_init (GInitable     *initable,
                                     GCancellable  *cancellable,
@@ -4019,6 +4134,7 @@ tracker_data_manager_initable_init (GInitable     *initable,
 	GError *internal_error = NULL;
 #ifndef DISABLE_JOURNAL
 	gboolean read_journal;
+	gint snapshot_chunk = 0;
 #endif
 
 	if (manager->initialized) {
@@ -4042,18 +4158,11 @@ tracker_data_manager_initable_init (GInitable     *initable,
 	/* Make sure we initialize all other modules we depend on */
 	manager->data_update = tracker_data_new (manager);
 	manager->ontologies = tracker_ontologies_new ();
+	manager->query_cache = tracker_sparql_query_cache_new (QUERY_CACHE_SIZE);
 
-	manager->db_manager = tracker_db_manager_new (manager->flags,
-	                                              manager->cache_location,
-	                                              manager->data_location,
-	                                              &is_first_time_index,
-	                                              manager->restoring_backup,
-	                                              FALSE,
-	                                              manager->select_cache_size,
-	                                              manager->update_cache_size,
-	                                              busy_callback, manager, "",
-	                                              G_OBJECT (manager),
-	                                              &internal_error);
+	manager->db_manager = open_db_manager (manager, manager->flags,
+	                                       &is_first_time_index,
+	                                       &internal_error);
 	if (!manager->db_manager) {
 		g_propagate_error (error, internal_error);
 		return FALSE;
@@ -4063,6 +4172,34 @@ tracker_data_manager_initable_init (GInitable     *initable,
 
 	tracker_data_manager_update_status (manager, "Initializing data manager");
 
+#ifndef DISABLE_JOURNAL
+	if (manager->journal_check && is_first_time_index && !read_only) {
+		GFile *snapshot;
+
+		snapshot = tracker_db_journal_find_snapshot (manager->data_location, &snapshot_chunk);
+
+		if (snapshot) {
+			tracker_data_manager_update_status (manager, "Restoring snapshot");
+
+			if (!restore_snapshot (manager, snapshot, &is_first_time_index, &internal_error)) {
+				g_object_unref (snapshot);
+				g_propagate_error (error, internal_error);
+				return FALSE;
+			}
+
+			if (is_first_time_index) {
+				/* Chunks older than the snapshot are likely gone,
+				 * the replay further below restores what is left */
+				snapshot_chunk = 0;
+			} else {
+				g_info ("Restored database snapshot of journal chunk %d", snapshot_chunk);
+			}
+
+			g_object_unref (snapshot);
+		}
+	}
+#endif /* DISABLE_JOURNAL */
+
 	iface = tracker_db_manager_get_writable_db_interface (manager->db_manager);
 
 #ifndef DISABLE_JOURNAL
@@ -4663,10 +4800,25 @@ tracker_data_manager_initable_init (GInitable     *initable,
 
 skip_ontology_check:
 
+	if (!read_only) {
+		/* Indexes dropped by an interrupted bulk load come back
+		 * before anything else is written */
+		tracker_data_recover_bulk_load (manager->data_update, &internal_error);
+
+		if (internal_error) {
+			g_clear_pointer (&uri_id_map, g_hash_table_unref);
+			g_propagate_error (error, internal_error);
+			return FALSE;
+		}
+	}
+
 #ifndef DISABLE_JOURNAL
-	if (read_journal) {
-		/* Start replay */
+	if (read_journal || snapshot_chunk > 0) {
+		/* Start replay, after a restored snapshot only the newer
+		 * journal chunks are replayed */
+		manager->in_journal_replay = TRUE;
 		tracker_data_replay_journal (manager->data_update,
+		                             snapshot_chunk,
 		                             busy_callback,
 		                             manager,
 		                             "Replaying journal",
@@ -4676,6 +4828,7 @@ skip_ontology_check:
 			if (g_error_matches (internal_error, TRACKER_DB_INTERFACE_ERROR, TRACKER_DB_NO_SPACE)) {
 				GError *n_error = NULL;
 				tracker_db_manager_remove_all (manager->db_manager);
+				clear_property_statements (manager);
 				g_clear_pointer (&manager->db_manager, tracker_db_manager_free);
 				/* Call may fail without notice, we're in error handling already.
 				 * When fails it means that close() of journal file failed. */
@@ -4686,13 +4839,13 @@ skip_ontology_check:
 				}
 			}
 
-			g_hash_table_unref (uri_id_map);
+			g_clear_pointer (&uri_id_map, g_hash_table_unref);
 			g_propagate_error (error, internal_error);
 			return FALSE;
 		}
 
 		manager->in_journal_replay = FALSE;
-		g_hash_table_unref (uri_id_map);
+		g_clear_pointer (&uri_id_map, g_hash_table_unref);
 	}
 
 	/* open journal for writing */
@@ -4736,6 +4889,8 @@ skip_ontology_check:
 		tracker_ontologies_sort (manager->ontologies);
 	}
 
+	tracker_sparql_query_cache_clear (manager->query_cache);
+
 	manager->initialized = TRUE;
 
 	/* This is the only one which doesn't show the 'OPERATION' part */
@@ -4801,6 +4956,11 @@ tracker_data_manager_dispose (GObject *object)
 	GError *error = NULL;
 	gboolean readonly = TRUE;
 
+	if (manager->data_update) {
+		/* the snapshot reads from the database being closed */
+		tracker_data_wait_snapshot (manager->data_update);
+	}
+
 	if (manager->db_manager) {
 		readonly = (tracker_db_manager_get_flags (manager->db_manager, NULL, NULL) & TRACKER_DB_MANAGER_READONLY) != 0;
 
@@ -4828,6 +4988,7 @@ tracker_data_manager_dispose (GObject *object)
 			tracker_db_interface_execute_query (iface, NULL, "VACUUM");
 		}
 
+		clear_property_statements (manager);
 		g_clear_pointer (&manager->db_manager, tracker_db_manager_free);
 	}
 
@@ -4863,6 +5024,7 @@ tracker_data_manager_finalize (GObject *object)
 
 	g_clear_object (&manager->ontologies);
 	g_clear_object (&manager->data_update);
+	g_clear_object (&manager->query_cache);
 
 	G_OBJECT_CLASS (tracker_data_manager_parent_class)->finalize (object);
 }
@@ -4959,6 +5121,12 @@ tracker_data_manager_get_data (TrackerDataManager *manager)
 	return manager->data_update;
 }
 
+TrackerSparqlQueryCache *
+tracker_data_manager_get_query_cache (TrackerDataManager *manager)
+{
+	return manager->query_cache;
+}
+
 void
 tracker_data_manager_shutdown (TrackerDataManager *manager)
 {
@@ -33,6 +33,7 @@ G_BEGIN_DECLS
 
 typedef struct _TrackerDataManager TrackerDataManager;
 typedef struct _TrackerDataManagerClass TrackerDataManagerClass;
+typedef struct _TrackerSparqlQueryCache TrackerSparqlQueryCache;
 
 #include <libtracker-common/tracker-common.h>
 #include <libtracker-sparql/tracker-sparql.h>
@@ -82,6 +83,7 @@ TrackerDBInterface * tracker_data_manager_get_db_interface    (TrackerDataManage
 TrackerDBInterface * tracker_data_manager_get_writable_db_interface (TrackerDataManager *manager);
 TrackerDBInterface * tracker_data_manager_get_wal_db_interface (TrackerDataManager *manager);
 TrackerData *        tracker_data_manager_get_data            (TrackerDataManager *manager);
+TrackerSparqlQueryCache * tracker_data_manager_get_query_cache (TrackerDataManager *manager);
 
 gboolean tracker_data_manager_init_fts               (TrackerDBInterface     *interface,
 						      gboolean                create);
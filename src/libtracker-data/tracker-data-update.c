@@ -32,6 +32,7 @@
 #include "tracker-data-manager.h"
 #include "tracker-data-update.h"
 #include "tracker-data-query.h"
+#include "tracker-db-backup.h"
 #include "tracker-db-interface-sqlite.h"
 #include "tracker-db-manager.h"
 #include "tracker-db-journal.h"
@@ -39,11 +40,21 @@
 #include "tracker-property.h"
 #include "tracker-sparql-query.h"
 
+/* rows of multiple value properties inserted with a single statement */
+#define MULTI_VALUE_BATCH_SIZE 32
+
+/* URIs looked up with a single statement while bulk loading */
+#define PREFETCH_BATCH_SIZE 100
+
+/* FTS index pages merged once no deferred FTS updates are left */
+#define FTS_IDLE_MERGE_PAGES 500
+
 typedef struct _TrackerDataUpdateBuffer TrackerDataUpdateBuffer;
 typedef struct _TrackerDataUpdateBufferResource TrackerDataUpdateBufferResource;
 typedef struct _TrackerDataUpdateBufferPredicate TrackerDataUpdateBufferPredicate;
 typedef struct _TrackerDataUpdateBufferProperty TrackerDataUpdateBufferProperty;
 typedef struct _TrackerDataUpdateBufferTable TrackerDataUpdateBufferTable;
+typedef struct _TrackerDataUpdateBufferRow TrackerDataUpdateBufferRow;
 typedef struct _TrackerDataBlankBuffer TrackerDataBlankBuffer;
 typedef struct _TrackerStatementDelegate TrackerStatementDelegate;
 typedef struct _TrackerCommitDelegate TrackerCommitDelegate;
@@ -51,10 +62,16 @@ typedef struct _TrackerCommitDelegate TrackerCommitDelegate;
 struct _TrackerDataUpdateBuffer {
 	/* string -> integer */
 	GHashTable *resource_cache;
+	/* set of URIs known not to have an ID yet, see
+	 * tracker_data_prefetch_resource_ids() */
+	GHashTable *resource_misses;
 	/* string -> TrackerDataUpdateBufferResource */
 	GHashTable *resources;
 	/* integer -> TrackerDataUpdateBufferResource */
 	GHashTable *resources_by_id;
+	/* TrackerProperty -> GArray of TrackerDataUpdateBufferRow, rows
+	 * waiting to be inserted together while the buffer is flushed */
+	GHashTable *multi_value_inserts;
 
 	/* the following two fields are valid per sqlite transaction, not just for same subject */
 	/* TrackerClass -> integer */
@@ -62,6 +79,8 @@ struct _TrackerDataUpdateBuffer {
 
 #if HAVE_TRACKER_FTS
 	gboolean fts_ever_updated;
+	/* FTS updates were skipped during a bulk load */
+	gboolean fts_rebuild;
 #endif
 };
 
@@ -99,10 +118,17 @@ struct _TrackerDataUpdateBufferTable {
 	gboolean delete_value;
 	gboolean multiple_values;
 	TrackerClass *class;
+	/* for multiple value tables */
+	TrackerProperty *property;
 	/* TrackerDataUpdateBufferProperty */
 	GArray *properties;
 };
 
+struct _TrackerDataUpdateBufferRow {
+	gint id;
+	TrackerDataUpdateBufferProperty *property;
+};
+
 /* buffer for anonymous blank nodes
  * that are not yet in the database */
 struct _TrackerDataBlankBuffer {
@@ -159,6 +185,18 @@ struct _TrackerData {
 	gint max_ontology_id;
 
 	TrackerDBJournal *journal_writer;
+	/* journal chunk at the last commit, -1 before the first one */
+	gint journal_chunk;
+	/* snapshot being written, at most one at a time */
+	GThread *snapshot_thread;
+	gint snapshot_running;
+
+	gboolean bulk_load;
+	/* the bulk load began in the current transaction, it ends
+	 * with a rollback */
+	gboolean bulk_load_uncommitted;
+	/* SQL of the indexes dropped for the bulk load */
+	GPtrArray *bulk_indexes;
 };
 
 struct _TrackerDataClass {
@@ -176,6 +214,7 @@ static gint         ensure_resource_id         (TrackerData      *data,
                                                 const gchar      *uri,
                                                 gboolean         *create);
 static void         cache_insert_value         (TrackerData      *data,
+                                                TrackerProperty  *field,
                                                 const gchar      *table_name,
                                                 const gchar      *field_name,
                                                 gboolean          transient,
@@ -462,6 +501,17 @@ tracker_data_update_get_next_modseq (TrackerData *data)
 static void
 tracker_data_init (TrackerData *data)
 {
+	data->journal_chunk = -1;
+}
+
+static void
+tracker_data_finalize (GObject *object)
+{
+	TrackerData *data = TRACKER_DATA (object);
+
+	tracker_data_wait_snapshot (data);
+
+	G_OBJECT_CLASS (tracker_data_parent_class)->finalize (object);
 }
 
 static void
@@ -507,6 +557,7 @@ tracker_data_class_init (TrackerDataClass *klass)
 
 	object_class->set_property = tracker_data_set_property;
 	object_class->get_property = tracker_data_get_property;
+	object_class->finalize = tracker_data_finalize;
 
 	g_object_class_install_property (object_class,
 	                                 PROP_MANAGER,
@@ -585,7 +636,7 @@ cache_ensure_table (TrackerData *data,
 
 		g_value_init (&gvalue, G_TYPE_INT64);
 		g_value_set_int64 (&gvalue, get_transaction_modseq (data));
-		cache_insert_value (data, "rdfs:Resource", "tracker:modified",
+		cache_insert_value (data, NULL, "rdfs:Resource", "tracker:modified",
 		                    TRUE, &gvalue, 0,
 		                    FALSE, FALSE, FALSE);
 	}
@@ -612,8 +663,9 @@ cache_insert_row (TrackerData  *data,
 }
 
 static void
-cache_insert_value (TrackerData *data,
-                    const gchar *table_name,
+cache_insert_value (TrackerData     *data,
+                    TrackerProperty *field,
+                    const gchar     *table_name,
                     const gchar *field_name,
                     gboolean     transient,
                     GValue      *value,
@@ -637,6 +689,9 @@ cache_insert_value (TrackerData *data,
 	property.date_time = date_time;
 
 	table = cache_ensure_table (data, table_name, multiple_values, transient);
+	if (multiple_values) {
+		table->property = field;
+	}
 	g_array_append_val (table->properties, property);
 }
 
@@ -652,8 +707,9 @@ cache_delete_row (TrackerData  *data,
 }
 
 static void
-cache_delete_value (TrackerData *data,
-                    const gchar *table_name,
+cache_delete_value (TrackerData     *data,
+                    TrackerProperty *field,
+                    const gchar     *table_name,
                     const gchar *field_name,
                     gboolean     transient,
                     GValue      *value,
@@ -674,6 +730,9 @@ cache_delete_value (TrackerData *data,
 
 	table = cache_ensure_table (data, table_name, multiple_values, transient);
 	table->delete_value = TRUE;
+	if (multiple_values) {
+		table->property = field;
+	}
 	g_array_append_val (table->properties, property);
 }
 
@@ -687,6 +746,11 @@ query_resource_id (TrackerData *data,
 	id = GPOINTER_TO_INT (g_hash_table_lookup (data->update_buffer.resource_cache, uri));
 	iface = tracker_data_manager_get_writable_db_interface (data->manager);
 
+	if (id == 0 && data->update_buffer.resource_misses &&
+	    g_hash_table_contains (data->update_buffer.resource_misses, uri)) {
+		return 0;
+	}
+
 	if (id == 0) {
 		id = tracker_data_query_resource_id (data->manager, iface, uri);
 
@@ -828,6 +892,181 @@ add_class_count (TrackerData  *data,
 	                     GINT_TO_POINTER (old_count_entry + count));
 }
 
+/* Returns the statement for @kind on the table of @property, it is
+ * prepared on first use and then kept on the property. The batch
+ * insert statement inserts MULTI_VALUE_BATCH_SIZE rows at once. */
+static TrackerDBStatement *
+get_multi_value_statement (TrackerData               *data,
+                           TrackerProperty           *property,
+                           TrackerPropertyStatement   kind,
+                           GError                   **error)
+{
+	TrackerDBInterface *iface;
+	TrackerDBStatement *stmt;
+	const gchar *table_name, *name;
+	GString *sql;
+	gint i, n_rows;
+
+	stmt = tracker_property_get_statement (property, kind);
+	if (stmt) {
+		return stmt;
+	}
+
+	iface = tracker_data_manager_get_writable_db_interface (data->manager);
+	table_name = tracker_property_get_table_name (property);
+	name = tracker_property_get_name (property);
+
+	if (kind == TRACKER_PROPERTY_STATEMENT_DELETE) {
+		stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_NONE, error,
+		                                              "DELETE FROM \"%s\" WHERE ID = ? AND \"%s\" = ?",
+		                                              table_name, name);
+	} else {
+		gboolean date_time;
+
+		date_time = tracker_property_get_data_type (property) == TRACKER_PROPERTY_TYPE_DATETIME;
+		n_rows = (kind == TRACKER_PROPERTY_STATEMENT_INSERT_BATCH) ? MULTI_VALUE_BATCH_SIZE : 1;
+
+		sql = g_string_new (NULL);
+
+		if (date_time) {
+			g_string_append_printf (sql, "INSERT OR IGNORE INTO \"%s\" (ID, \"%s\", \"%s:localDate\", \"%s:localTime\", \"%s:graph\") VALUES ",
+			                        table_name, name, name, name, name);
+		} else {
+			g_string_append_printf (sql, "INSERT OR IGNORE INTO \"%s\" (ID, \"%s\", \"%s:graph\") VALUES ",
+			                        table_name, name, name);
+		}
+
+		for (i = 0; i < n_rows; i++) {
+			if (i > 0) {
+				g_string_append (sql, ", ");
+			}
+			g_string_append (sql, date_time ? "(?, ?, ?, ?, ?)" : "(?, ?, ?)");
+		}
+
+		stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_NONE, error,
+		                                              "%s", sql->str);
+		g_string_free (sql, TRUE);
+	}
+
+	if (stmt) {
+		tracker_property_set_statement (property, kind, stmt);
+		g_object_unref (stmt);
+	}
+
+	return stmt;
+}
+
+static void
+bind_multi_value_row (TrackerDBStatement         *stmt,
+                      gint                       *param,
+                      TrackerDataUpdateBufferRow *row)
+{
+	tracker_db_statement_bind_int (stmt, (*param)++, row->id);
+	statement_bind_gvalue (stmt, param, &row->property->value);
+
+	if (row->property->graph != 0) {
+		tracker_db_statement_bind_int (stmt, (*param)++, row->property->graph);
+	} else {
+		tracker_db_statement_bind_null (stmt, (*param)++);
+	}
+}
+
+/* Inserts the rows queued for the table of @property, so that
+ * statements on that table see them */
+static gboolean
+flush_multi_value_inserts (TrackerData      *data,
+                           TrackerProperty  *property,
+                           GError          **error)
+{
+	TrackerDBStatement *stmt;
+	GArray *rows;
+	GError *actual_error = NULL;
+	guint i, j;
+	gint param;
+
+	rows = g_hash_table_lookup (data->update_buffer.multi_value_inserts, property);
+	if (!rows || rows->len == 0) {
+		return TRUE;
+	}
+
+	for (i = 0; i < rows->len && !actual_error; ) {
+		if (rows->len - i >= MULTI_VALUE_BATCH_SIZE) {
+			stmt = get_multi_value_statement (data, property, TRACKER_PROPERTY_STATEMENT_INSERT_BATCH, &actual_error);
+			if (!stmt) {
+				break;
+			}
+
+			param = 0;
+			for (j = 0; j < MULTI_VALUE_BATCH_SIZE; j++) {
+				bind_multi_value_row (stmt, &param, &g_array_index (rows, TrackerDataUpdateBufferRow, i++));
+			}
+		} else {
+			stmt = get_multi_value_statement (data, property, TRACKER_PROPERTY_STATEMENT_INSERT, &actual_error);
+			if (!stmt) {
+				break;
+			}
+
+			param = 0;
+			bind_multi_value_row (stmt, &param, &g_array_index (rows, TrackerDataUpdateBufferRow, i++));
+		}
+
+		tracker_db_statement_execute (stmt, &actual_error);
+	}
+
+	g_array_set_size (rows, 0);
+
+	if (actual_error) {
+		g_propagate_error (error, actual_error);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Multiple value rows are queued per property while the buffer is
+ * flushed, so rows of several resources go into one statement */
+static void
+queue_multi_value_insert (TrackerData                      *data,
+                          TrackerProperty                  *property,
+                          gint                              id,
+                          TrackerDataUpdateBufferProperty  *value,
+                          GError                          **error)
+{
+	TrackerDataUpdateBufferRow row;
+	GArray *rows;
+
+	rows = g_hash_table_lookup (data->update_buffer.multi_value_inserts, property);
+	if (!rows) {
+		rows = g_array_sized_new (FALSE, FALSE, sizeof (TrackerDataUpdateBufferRow), MULTI_VALUE_BATCH_SIZE);
+		g_hash_table_insert (data->update_buffer.multi_value_inserts, property, rows);
+	}
+
+	row.id = id;
+	row.property = value;
+	g_array_append_val (rows, row);
+
+	if (rows->len >= MULTI_VALUE_BATCH_SIZE) {
+		flush_multi_value_inserts (data, property, error);
+	}
+}
+
+static gboolean
+flush_all_multi_value_inserts (TrackerData  *data,
+                               GError      **error)
+{
+	GHashTableIter iter;
+	TrackerProperty *property;
+
+	g_hash_table_iter_init (&iter, data->update_buffer.multi_value_inserts);
+	while (g_hash_table_iter_next (&iter, (gpointer*) &property, NULL)) {
+		if (!flush_multi_value_inserts (data, property, error)) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
 static void
 tracker_data_resource_buffer_flush (TrackerData  *data,
                                     GError      **error)
@@ -849,47 +1088,20 @@ tracker_data_resource_buffer_flush (TrackerData  *data,
 			for (i = 0; i < table->properties->len; i++) {
 				property = &g_array_index (table->properties, TrackerDataUpdateBufferProperty, i);
 
-				if (table->delete_value) {
+				if (!table->delete_value) {
+					queue_multi_value_insert (data, table->property, data->resource_buffer->id, property, &actual_error);
+				} else if (flush_multi_value_inserts (data, table->property, &actual_error)) {
 					/* delete rows for multiple value properties */
-					stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE, &actual_error,
-					                                              "DELETE FROM \"%s\" WHERE ID = ? AND \"%s\" = ?",
-					                                              table_name,
-					                                              property->name);
-				} else if (property->date_time) {
-					stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE, &actual_error,
-					                                              "INSERT OR IGNORE INTO \"%s\" (ID, \"%s\", \"%s:localDate\", \"%s:localTime\", \"%s:graph\") VALUES (?, ?, ?, ?, ?)",
-					                                              table_name,
-					                                              property->name,
-					                                              property->name,
-					                                              property->name,
-					                                              property->name);
-				} else {
-					stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE, &actual_error,
-					                                              "INSERT OR IGNORE INTO \"%s\" (ID, \"%s\", \"%s:graph\") VALUES (?, ?, ?)",
-					                                              table_name,
-					                                              property->name,
-					                                              property->name);
-				}
-
-				if (actual_error) {
-					g_propagate_error (error, actual_error);
-					return;
-				}
-
-				param = 0;
-
-				tracker_db_statement_bind_int (stmt, param++, data->resource_buffer->id);
-				statement_bind_gvalue (stmt, &param, &property->value);
+					stmt = get_multi_value_statement (data, table->property, TRACKER_PROPERTY_STATEMENT_DELETE, &actual_error);
 
-				if (property->graph != 0) {
-					tracker_db_statement_bind_int (stmt, param++, property->graph);
-				} else {
-					tracker_db_statement_bind_null (stmt, param++);
+					if (stmt) {
+						param = 0;
+						tracker_db_statement_bind_int (stmt, param++, data->resource_buffer->id);
+						statement_bind_gvalue (stmt, &param, &property->value);
+						tracker_db_statement_execute (stmt, &actual_error);
+					}
 				}
 
-				tracker_db_statement_execute (stmt, &actual_error);
-				g_object_unref (stmt);
-
 				if (actual_error) {
 					g_propagate_error (error, actual_error);
 					return;
@@ -899,15 +1111,19 @@ tracker_data_resource_buffer_flush (TrackerData  *data,
 			GString *sql, *values_sql;
 
 			if (table->delete_row) {
+				TrackerProperty *rdf_type;
+
+				rdf_type = tracker_ontologies_get_rdf_type (tracker_data_manager_get_ontologies (data->manager));
+
 				/* remove entry from rdf:type table */
-				stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE, &actual_error,
-				                                              "DELETE FROM \"rdfs:Resource_rdf:type\" WHERE ID = ? AND \"rdf:type\" = ?");
+				if (flush_multi_value_inserts (data, rdf_type, &actual_error)) {
+					stmt = get_multi_value_statement (data, rdf_type, TRACKER_PROPERTY_STATEMENT_DELETE, &actual_error);
 
-				if (stmt) {
-					tracker_db_statement_bind_int (stmt, 0, data->resource_buffer->id);
-					tracker_db_statement_bind_int (stmt, 1, ensure_resource_id (data, tracker_class_get_uri (table->class), NULL));
-					tracker_db_statement_execute (stmt, &actual_error);
-					g_object_unref (stmt);
+					if (stmt) {
+						tracker_db_statement_bind_int (stmt, 0, data->resource_buffer->id);
+						tracker_db_statement_bind_int (stmt, 1, ensure_resource_id (data, tracker_class_get_uri (table->class), NULL));
+						tracker_db_statement_execute (stmt, &actual_error);
+					}
 				}
 
 				if (actual_error) {
@@ -1059,7 +1275,10 @@ tracker_data_resource_buffer_flush (TrackerData  *data,
 	}
 
 #if HAVE_TRACKER_FTS
-	if (data->resource_buffer->fts_updated) {
+	if (data->resource_buffer->fts_updated && data->bulk_load) {
+		/* the whole index is rebuilt at the end of the bulk load */
+		data->update_buffer.fts_rebuild = TRUE;
+	} else if (data->resource_buffer->fts_updated) {
 		TrackerProperty *prop;
 		GArray *values;
 		GPtrArray *properties, *text;
@@ -1132,6 +1351,12 @@ tracker_data_update_buffer_flush (TrackerData  *data,
 			}
 		}
 
+		if (!actual_error) {
+			flush_all_multi_value_inserts (data, error);
+		}
+
+		/* queued rows point into the resource buffers */
+		g_hash_table_remove_all (data->update_buffer.multi_value_inserts);
 		g_hash_table_remove_all (data->update_buffer.resources_by_id);
 	} else {
 		g_hash_table_iter_init (&iter, data->update_buffer.resources);
@@ -1143,6 +1368,12 @@ tracker_data_update_buffer_flush (TrackerData  *data,
 			}
 		}
 
+		if (!actual_error) {
+			flush_all_multi_value_inserts (data, error);
+		}
+
+		/* queued rows point into the resource buffers */
+		g_hash_table_remove_all (data->update_buffer.multi_value_inserts);
 		g_hash_table_remove_all (data->update_buffer.resources);
 	}
 	data->resource_buffer = NULL;
@@ -1165,12 +1396,23 @@ tracker_data_update_buffer_clear (TrackerData *data)
 	g_hash_table_remove_all (data->update_buffer.resources);
 	g_hash_table_remove_all (data->update_buffer.resources_by_id);
 	g_hash_table_remove_all (data->update_buffer.resource_cache);
+	g_hash_table_remove_all (data->update_buffer.resource_misses);
 	data->resource_buffer = NULL;
 
 #if HAVE_TRACKER_FTS
 	data->update_buffer.fts_ever_updated = FALSE;
 #endif
 
+	if (data->bulk_load_uncommitted) {
+		/* the dropped indexes are back */
+		data->bulk_load = FALSE;
+		data->bulk_load_uncommitted = FALSE;
+		g_clear_pointer (&data->bulk_indexes, g_ptr_array_unref);
+#if HAVE_TRACKER_FTS
+		data->update_buffer.fts_rebuild = FALSE;
+#endif
+	}
+
 	if (data->update_buffer.class_counts) {
 		/* revert class count changes */
 
@@ -1307,7 +1549,8 @@ cache_create_service_decomposed (TrackerData  *data,
 	ontologies = tracker_data_manager_get_ontologies (data->manager);
 
 	g_value_set_int64 (&gvalue, class_id);
-	cache_insert_value (data, "rdfs:Resource_rdf:type", "rdf:type",
+	cache_insert_value (data, tracker_ontologies_get_rdf_type (ontologies),
+	                    "rdfs:Resource_rdf:type", "rdf:type",
 	                    FALSE, &gvalue, final_graph_id,
 	                    TRUE, FALSE, FALSE);
 
@@ -1369,7 +1612,7 @@ cache_create_service_decomposed (TrackerData  *data,
 			g_value_init (&gvalue_copy, G_VALUE_TYPE (v));
 			g_value_copy (v, &gvalue_copy);
 
-			cache_insert_value (data,
+			cache_insert_value (data, *domain_indexes,
 			                    tracker_class_get_name (cl),
 			                    tracker_property_get_name (*domain_indexes),
 			                    tracker_property_get_transient (*domain_indexes),
@@ -1574,7 +1817,8 @@ get_old_property_values (TrackerData      *data,
 
 			iface = tracker_data_manager_get_writable_db_interface (data->manager);
 
-			if (!data->resource_buffer->fts_updated && !data->resource_buffer->create) {
+			if (!data->resource_buffer->fts_updated && !data->resource_buffer->create &&
+			    !data->bulk_load) {
 				TrackerOntologies *ontologies;
 				guint i, n_props;
 				TrackerProperty   **properties, *prop;
@@ -1753,7 +1997,7 @@ process_domain_indexes (TrackerData     *data,
 			g_value_init (&gvalue_copy, G_VALUE_TYPE (gvalue));
 			g_value_copy (gvalue, &gvalue_copy);
 
-			cache_insert_value (data,
+			cache_insert_value (data, property,
 			                    tracker_class_get_name (*domain_index_classes),
 			                    field_name,
 			                    tracker_property_get_transient (property),
@@ -1867,7 +2111,7 @@ cache_insert_metadata_decomposed (TrackerData      *data,
 		g_value_unset (&gvalue);
 
 	} else {
-		cache_insert_value (data, table_name, field_name,
+		cache_insert_value (data, property, table_name, field_name,
 		                    tracker_property_get_transient (property),
 		                    &gvalue,
 		                    graph != NULL ? ensure_graph_id (data, graph, NULL) : graph_id,
@@ -2082,7 +2326,7 @@ cache_update_metadata_decomposed (TrackerData      *data,
 		g_value_set_int64 (&gvalue, value_id);
 	}
 
-	cache_insert_value (data, table_name, field_name,
+	cache_insert_value (data, property, table_name, field_name,
 	                    tracker_property_get_transient (property),
 	                    &gvalue,
 	                    graph != NULL ? ensure_graph_id (data, graph, NULL) : graph_id,
@@ -2140,7 +2384,7 @@ delete_metadata_decomposed (TrackerData      *data,
 		/* value not found */
 		g_value_unset (&gvalue);
 	} else {
-		cache_delete_value (data, table_name, field_name,
+		cache_delete_value (data, property, table_name, field_name,
 		                    tracker_property_get_transient (property),
 		                    &gvalue, multiple_values,
 		                    tracker_property_get_fulltext_indexed (property),
@@ -2156,7 +2400,7 @@ delete_metadata_decomposed (TrackerData      *data,
 					GValue gvalue_copy = { 0 };
 					g_value_init (&gvalue_copy, G_VALUE_TYPE (&gvalue));
 					g_value_copy (&gvalue, &gvalue_copy);
-					cache_delete_value (data,
+					cache_delete_value (data, property,
 					                    tracker_class_get_name (*domain_index_classes),
 					                    field_name,
 					                    tracker_property_get_transient (property),
@@ -2338,7 +2582,7 @@ cache_delete_resource_type_full (TrackerData  *data,
 			g_value_copy (old_gvalue, &gvalue);
 
 			value_set_remove_value (old_values, &gvalue);
-			cache_delete_value (data, table_name, field_name,
+			cache_delete_value (data, prop, table_name, field_name,
 			                    tracker_property_get_transient (prop),
 			                    &gvalue, multiple_values,
 			                    tracker_property_get_fulltext_indexed (prop),
@@ -2354,7 +2598,7 @@ cache_delete_resource_type_full (TrackerData  *data,
 						GValue gvalue_copy = { 0 };
 						g_value_init (&gvalue_copy, G_VALUE_TYPE (&gvalue));
 						g_value_copy (&gvalue, &gvalue_copy);
-						cache_delete_value (data,
+						cache_delete_value (data, prop,
 						                    tracker_class_get_name (*domain_index_classes),
 						                    field_name,
 						                    tracker_property_get_transient (prop),
@@ -3500,10 +3744,12 @@ tracker_data_begin_transaction (TrackerData  *data,
 
 	if (data->update_buffer.resource_cache == NULL) {
 		data->update_buffer.resource_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+		data->update_buffer.resource_misses = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 		/* used for normal transactions */
 		data->update_buffer.resources = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) resource_buffer_free);
 		/* used for journal replay */
 		data->update_buffer.resources_by_id = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) resource_buffer_free);
+		data->update_buffer.multi_value_inserts = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) g_array_unref);
 	}
 
 	data->resource_buffer = NULL;
@@ -3550,6 +3796,113 @@ tracker_data_begin_transaction_for_replay (TrackerData  *data,
 	data->resource_time = time;
 }
 
+#ifndef DISABLE_JOURNAL
+typedef struct {
+	TrackerData *data;
+	TrackerDBBackupSnapshot *snapshot;
+	GFile *data_location;
+	gint chunk;
+} SnapshotJob;
+
+static gpointer
+snapshot_thread_func (gpointer user_data)
+{
+	SnapshotJob *job = user_data;
+	GFile *destination;
+	GError *error = NULL;
+
+	destination = tracker_db_journal_get_snapshot_file (job->data_location, job->chunk);
+
+	if (tracker_db_backup_snapshot_write (job->snapshot, destination, &error)) {
+		g_info ("Took database snapshot of journal chunk %d", job->chunk);
+		tracker_db_journal_prune (job->data_location, job->chunk);
+	} else {
+		g_warning ("Could not take database snapshot: %s", error->message);
+		g_error_free (error);
+	}
+
+	tracker_db_backup_snapshot_free (job->snapshot);
+	g_object_unref (destination);
+	g_object_unref (job->data_location);
+	g_atomic_int_set (&job->data->snapshot_running, FALSE);
+	g_slice_free (SnapshotJob, job);
+
+	return NULL;
+}
+
+/* Copies the database after the journal got rotated, so replaying the
+ * journal only needs the chunks that came after the snapshot. The copy
+ * is pinned right after the commit that rotated the journal, when the
+ * database contains exactly what was written to the rotated chunks,
+ * and written out on a thread of its own so updates don't wait for it.
+ * Rotations while a snapshot is still being written get none, as do
+ * those during a bulk load, whose dropped indexes would be missing.
+ */
+static void
+take_snapshot (TrackerData *data)
+{
+	TrackerDBManager *db_manager;
+	TrackerDBBackupSnapshot *snapshot;
+	SnapshotJob *job;
+	GFile *db_file;
+	GError *error = NULL;
+	gint chunk;
+
+	chunk = tracker_db_journal_get_chunk (data->journal_writer);
+
+	if (chunk == data->journal_chunk) {
+		return;
+	}
+
+	if (data->journal_chunk < 0) {
+		/* the database contains more than the chunks so far,
+		 * start with the next rotation */
+		data->journal_chunk = chunk;
+		return;
+	}
+
+	data->journal_chunk = chunk;
+
+	if (data->bulk_load || g_atomic_int_get (&data->snapshot_running)) {
+		return;
+	}
+
+	tracker_data_wait_snapshot (data);
+
+	db_manager = tracker_data_manager_get_db_manager (data->manager);
+	db_file = g_file_new_for_path (tracker_db_manager_get_file (db_manager));
+	snapshot = tracker_db_backup_snapshot_open (db_file, &error);
+	g_object_unref (db_file);
+
+	if (!snapshot) {
+		g_warning ("Could not take database snapshot: %s", error->message);
+		g_error_free (error);
+		return;
+	}
+
+	job = g_slice_new0 (SnapshotJob);
+	job->data = data;
+	job->snapshot = snapshot;
+	job->data_location = tracker_data_manager_get_data_location (data->manager);
+	job->chunk = chunk;
+
+	g_atomic_int_set (&data->snapshot_running, TRUE);
+	data->snapshot_thread = g_thread_new ("tracker-snapshot", snapshot_thread_func, job);
+}
+#endif /* DISABLE_JOURNAL */
+
+/* Waits for the database snapshot being written, if any */
+void
+tracker_data_wait_snapshot (TrackerData *data)
+{
+#ifndef DISABLE_JOURNAL
+	if (data->snapshot_thread) {
+		g_thread_join (data->snapshot_thread);
+		data->snapshot_thread = NULL;
+	}
+#endif /* DISABLE_JOURNAL */
+}
+
 void
 tracker_data_commit_transaction (TrackerData  *data,
                                  GError      **error)
@@ -3582,6 +3935,10 @@ tracker_data_commit_transaction (TrackerData  *data,
 		g_assert (data->journal_writer != NULL);
 		if (data->has_persistent || data->in_ontology_transaction) {
 			tracker_db_journal_commit_db_transaction (data->journal_writer, &actual_error);
+
+			if (!actual_error && !data->in_ontology_transaction) {
+				take_snapshot (data);
+			}
 		} else {
 			/* If we only had transient properties, then we must not write
 			 * anything to the journal. So we roll it back, but only the
@@ -3607,6 +3964,7 @@ tracker_data_commit_transaction (TrackerData  *data,
 	data->resource_time = 0;
 	data->in_transaction = FALSE;
 	data->in_ontology_transaction = FALSE;
+	data->bulk_load_uncommitted = FALSE;
 
 	if (data->update_buffer.class_counts) {
 		/* successful transaction, no need to rollback class counts,
@@ -3625,6 +3983,7 @@ tracker_data_commit_transaction (TrackerData  *data,
 	g_hash_table_remove_all (data->update_buffer.resources);
 	g_hash_table_remove_all (data->update_buffer.resources_by_id);
 	g_hash_table_remove_all (data->update_buffer.resource_cache);
+	g_hash_table_remove_all (data->update_buffer.resource_misses);
 
 	data->in_journal_replay = FALSE;
 }
@@ -3751,301 +4110,948 @@ tracker_data_load_turtle_file (TrackerData  *data,
 }
 
 void
-tracker_data_sync (TrackerData *data)
+tracker_data_load_turtle_file_bulk (TrackerData  *data,
+                                    GFile        *file,
+                                    GError      **error)
 {
-#ifndef DISABLE_JOURNAL
-	TrackerDBJournal *writer;
-
-	writer = tracker_data_manager_get_journal_writer (data->manager);
-	if (writer)
-		tracker_db_journal_fsync (writer);
+	g_return_if_fail (G_IS_FILE (file));
 
-	writer = tracker_data_manager_get_ontology_writer (data->manager);
-	if (writer)
-		tracker_db_journal_fsync (writer);
-#endif
+	tracker_turtle_reader_load_bulk (file, data, error);
 }
 
-#ifndef DISABLE_JOURNAL
-
+/* Bulk loading keeps the regular insert path, so the resulting database
+ * is the same, but skips the work that can be done once at the end:
+ * secondary indexes are dropped and created again afterwards, and the
+ * FTS index is rebuilt from its content view rather than updated per
+ * resource. Unique indexes stay, INSERT OR IGNORE on multiple value
+ * tables depends on them. So do the "_ID" indexes on multiple value
+ * tables, without them every delete of a resource or of one of its
+ * values scans the whole table. A bulk load may span several
+ * transactions.
+ *
+ * The dropped indexes are written to the BulkLoadIndexes table in the
+ * same transaction as the DROP INDEX statements, so a bulk load that
+ * is interrupted after a commit is finished by
+ * tracker_data_recover_bulk_load() on the next start.
+ */
 void
-tracker_data_replay_journal (TrackerData          *data,
-                             TrackerBusyCallback   busy_callback,
-                             gpointer              busy_user_data,
-                             const gchar          *busy_status,
-                             GError              **error)
+tracker_data_begin_bulk_load (TrackerData  *data,
+                              GError      **error)
 {
-	GError *journal_error = NULL;
-	TrackerProperty *rdf_type = NULL;
-	gint last_operation_type = 0;
-	const gchar *uri;
-	GError *n_error = NULL;
-	GFile *data_location;
-	TrackerDBJournalReader *reader;
-	TrackerOntologies *ontologies;
+	TrackerDBInterface *iface;
+	TrackerDBStatement *stmt;
+	TrackerDBCursor *cursor = NULL;
+	GPtrArray *names;
+	GError *actual_error = NULL;
+	guint i;
 
-	ontologies = tracker_data_manager_get_ontologies (data->manager);
-	rdf_type = tracker_ontologies_get_rdf_type (ontologies);
+	g_return_if_fail (data->in_transaction);
+	g_return_if_fail (!data->bulk_load);
 
-	data_location = tracker_data_manager_get_data_location (data->manager);
-	reader = tracker_db_journal_reader_new (data_location, &n_error);
-	g_object_unref (data_location);
+	iface = tracker_data_manager_get_writable_db_interface (data->manager);
 
-	if (!reader) {
-		/* This is fatal (doesn't happen when file doesn't exist, does happen
-		 * when for some other reason the reader can't be created) */
-		g_propagate_error (error, n_error);
+	stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_NONE, &actual_error,
+	                                              "SELECT name, sql FROM sqlite_master "
+	                                              "WHERE type = 'index' AND sql IS NOT NULL "
+	                                              "AND sql NOT LIKE 'CREATE UNIQUE %%' "
+	                                              "AND name NOT LIKE '%%\\_ID' ESCAPE '\\'");
+
+	if (stmt) {
+		cursor = tracker_db_statement_start_cursor (stmt, &actual_error);
+		g_object_unref (stmt);
+	}
+
+	if (!cursor) {
+		g_propagate_error (error, actual_error);
 		return;
 	}
 
-	while (tracker_db_journal_reader_next (reader, &journal_error)) {
-		TrackerDBJournalEntryType type;
-		const gchar *object;
-		gint graph_id, subject_id, predicate_id, object_id;
+	names = g_ptr_array_new_with_free_func (g_free);
+	data->bulk_indexes = g_ptr_array_new_with_free_func (g_free);
 
-		type = tracker_db_journal_reader_get_entry_type (reader);
-		if (type == TRACKER_DB_JOURNAL_RESOURCE) {
-			GError *new_error = NULL;
-			TrackerDBInterface *iface;
-			TrackerDBStatement *stmt;
-			gint id;
+	while (tracker_db_cursor_iter_next (cursor, NULL, &actual_error)) {
+		g_ptr_array_add (names, g_strdup (tracker_db_cursor_get_string (cursor, 0, NULL)));
+		g_ptr_array_add (data->bulk_indexes, g_strdup (tracker_db_cursor_get_string (cursor, 1, NULL)));
+	}
 
-			tracker_db_journal_reader_get_resource (reader, &id, &uri);
+	g_object_unref (cursor);
 
-			iface = tracker_data_manager_get_writable_db_interface (data->manager);
+	if (!actual_error) {
+		tracker_db_interface_execute_query (iface, &actual_error, "SAVEPOINT bulk_load");
+	}
 
-			stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE, &new_error,
-			                                              "INSERT INTO Resource (ID, Uri) VALUES (?, ?)");
+	for (i = 0; !actual_error && i < names->len; i++) {
+		tracker_db_interface_execute_query (iface, &actual_error, "DROP INDEX \"%s\"",
+		                                    (gchar *) g_ptr_array_index (names, i));
+	}
 
-			if (stmt) {
-				tracker_db_statement_bind_int (stmt, 0, id);
-				tracker_db_statement_bind_text (stmt, 1, uri);
-				tracker_db_statement_execute (stmt, &new_error);
-				g_object_unref (stmt);
-			}
+	g_ptr_array_unref (names);
 
-			if (new_error) {
-				g_warning ("Journal replay error: '%s'", new_error->message);
-				g_error_free (new_error);
-			}
+	if (!actual_error) {
+		tracker_db_interface_execute_query (iface, &actual_error,
+		                                    "CREATE TABLE BulkLoadIndexes (Sql TEXT NOT NULL)");
+	}
 
-		} else if (type == TRACKER_DB_JOURNAL_START_TRANSACTION) {
-			tracker_data_begin_transaction_for_replay (data, tracker_db_journal_reader_get_time (reader), NULL);
-		} else if (type == TRACKER_DB_JOURNAL_END_TRANSACTION) {
-			GError *new_error = NULL;
-			tracker_data_update_buffer_might_flush (data, &new_error);
+	for (i = 0; !actual_error && i < data->bulk_indexes->len; i++) {
+		stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_NONE, &actual_error,
+		                                              "INSERT INTO BulkLoadIndexes (Sql) VALUES (?)");
 
-			tracker_data_commit_transaction (data, &new_error);
-			if (new_error) {
-				/* Out of disk is an unrecoverable fatal error */
-				if (g_error_matches (new_error, TRACKER_DB_INTERFACE_ERROR, TRACKER_DB_NO_SPACE)) {
-					g_propagate_error (error, new_error);
-					return;
+		if (stmt) {
+			tracker_db_statement_bind_text (stmt, 0, g_ptr_array_index (data->bulk_indexes, i));
+			tracker_db_statement_execute (stmt, &actual_error);
+			g_object_unref (stmt);
+		}
+	}
+
+	if (actual_error) {
+		/* keep the indexes if any of it failed */
+		tracker_db_interface_execute_query (iface, NULL, "ROLLBACK TO bulk_load");
+		tracker_db_interface_execute_query (iface, NULL, "RELEASE bulk_load");
+		g_clear_pointer (&data->bulk_indexes, g_ptr_array_unref);
+		g_propagate_error (error, actual_error);
+		return;
+	}
+
+	tracker_db_interface_execute_query (iface, NULL, "RELEASE bulk_load");
+
+	data->bulk_load = TRUE;
+	data->bulk_load_uncommitted = TRUE;
+}
+
+void
+tracker_data_end_bulk_load (TrackerData  *data,
+                            GError      **error)
+{
+	TrackerDBInterface *iface;
+	GError *actual_error = NULL;
+	guint i;
+
+	g_return_if_fail (data->in_transaction);
+	g_return_if_fail (data->bulk_load);
+
+	iface = tracker_data_manager_get_writable_db_interface (data->manager);
+
+	tracker_data_update_buffer_flush (data, &actual_error);
+
+	for (i = 0; !actual_error && i < data->bulk_indexes->len; i++) {
+		tracker_db_interface_execute_query (iface, &actual_error, "%s",
+		                                    (gchar *) g_ptr_array_index (data->bulk_indexes, i));
+	}
+
+	if (!actual_error) {
+		tracker_db_interface_execute_query (iface, &actual_error, "DROP TABLE BulkLoadIndexes");
+	}
+
+#if HAVE_TRACKER_FTS
+	if (!actual_error && data->update_buffer.fts_rebuild) {
+		tracker_db_interface_sqlite_fts_rebuild_tokens (iface);
+		data->update_buffer.fts_ever_updated = TRUE;
+	}
+
+	data->update_buffer.fts_rebuild = FALSE;
+#endif
+
+	data->bulk_load = FALSE;
+	data->bulk_load_uncommitted = FALSE;
+	g_clear_pointer (&data->bulk_indexes, g_ptr_array_unref);
+
+	if (actual_error) {
+		g_propagate_error (error, actual_error);
+	}
+}
+
+/* Finishes a bulk load left behind by a previous run, whose dropped
+ * indexes were committed. The FTS index was not updated since it
+ * started, so it is rebuilt as a whole.
+ */
+void
+tracker_data_recover_bulk_load (TrackerData  *data,
+                                GError      **error)
+{
+	TrackerDBInterface *iface;
+	TrackerDBStatement *stmt;
+	TrackerDBCursor *cursor = NULL;
+	GPtrArray *indexes;
+	GError *actual_error = NULL;
+	guint i;
+
+	g_return_if_fail (!data->in_transaction);
+
+	iface = tracker_data_manager_get_writable_db_interface (data->manager);
+
+	stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_NONE, &actual_error,
+	                                              "SELECT 1 FROM sqlite_master "
+	                                              "WHERE type = 'table' AND name = 'BulkLoadIndexes'");
+
+	if (stmt) {
+		cursor = tracker_db_statement_start_cursor (stmt, &actual_error);
+		g_object_unref (stmt);
+	}
+
+	if (!cursor) {
+		g_propagate_error (error, actual_error);
+		return;
+	}
+
+	if (!tracker_db_cursor_iter_next (cursor, NULL, &actual_error)) {
+		/* no bulk load was interrupted */
+		g_object_unref (cursor);
+		if (actual_error) {
+			g_propagate_error (error, actual_error);
+		}
+		return;
+	}
+
+	g_clear_object (&cursor);
+
+	g_info ("Recovering from an interrupted bulk load");
+
+	stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_NONE, &actual_error,
+	                                              "SELECT Sql FROM BulkLoadIndexes");
+
+	if (stmt) {
+		cursor = tracker_db_statement_start_cursor (stmt, &actual_error);
+		g_object_unref (stmt);
+	}
+
+	if (!cursor) {
+		g_propagate_error (error, actual_error);
+		return;
+	}
+
+	indexes = g_ptr_array_new_with_free_func (g_free);
+
+	while (tracker_db_cursor_iter_next (cursor, NULL, &actual_error)) {
+		g_ptr_array_add (indexes, g_strdup (tracker_db_cursor_get_string (cursor, 0, NULL)));
+	}
+
+	g_object_unref (cursor);
+
+	if (!actual_error) {
+		tracker_db_interface_start_transaction (iface);
+
+		for (i = 0; !actual_error && i < indexes->len; i++) {
+			tracker_db_interface_execute_query (iface, &actual_error, "%s",
+			                                    (gchar *) g_ptr_array_index (indexes, i));
+		}
+
+		if (!actual_error) {
+			tracker_db_interface_execute_query (iface, &actual_error, "DROP TABLE BulkLoadIndexes");
+		}
+
+#if HAVE_TRACKER_FTS
+		if (!actual_error) {
+			tracker_db_interface_sqlite_fts_rebuild_tokens (iface);
+		}
+#endif
+
+		if (actual_error) {
+			tracker_db_interface_execute_query (iface, NULL, "ROLLBACK");
+		} else {
+			tracker_db_interface_end_db_transaction (iface, &actual_error);
+		}
+	}
+
+	g_ptr_array_unref (indexes);
+
+	if (actual_error) {
+		g_propagate_error (error, actual_error);
+	}
+}
+
+/* Looks up the IDs of @uris with a few statements rather than one per
+ * URI. URIs without an ID are remembered until the end of the
+ * transaction, so ensure_resource_id() doesn't query them again.
+ */
+void
+tracker_data_prefetch_resource_ids (TrackerData  *data,
+                                    gchar       **uris,
+                                    gint          n_uris,
+                                    GError      **error)
+{
+	TrackerDBInterface *iface;
+	GPtrArray *pending;
+	GError *actual_error = NULL;
+	guint i, j;
+
+	g_return_if_fail (data->in_transaction);
+
+	pending = g_ptr_array_new ();
+
+	for (i = 0; i < n_uris; i++) {
+		if (uris[i] == NULL ||
+		    g_hash_table_contains (data->update_buffer.resource_cache, uris[i]) ||
+		    g_hash_table_contains (data->update_buffer.resource_misses, uris[i])) {
+			continue;
+		}
+
+		/* missing until found below */
+		g_hash_table_add (data->update_buffer.resource_misses, g_strdup (uris[i]));
+		g_ptr_array_add (pending, uris[i]);
+	}
+
+	iface = tracker_data_manager_get_writable_db_interface (data->manager);
+
+	for (i = 0; i < pending->len && !actual_error; i += PREFETCH_BATCH_SIZE) {
+		TrackerDBStatement *stmt;
+		TrackerDBCursor *cursor = NULL;
+		GString *sql;
+
+		sql = g_string_new ("SELECT ID, Uri FROM Resource WHERE Uri IN (?");
+		for (j = 1; j < PREFETCH_BATCH_SIZE; j++) {
+			g_string_append (sql, ", ?");
+		}
+		g_string_append_c (sql, ')');
+
+		stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_SELECT, &actual_error,
+		                                              "%s", sql->str);
+		g_string_free (sql, TRUE);
+
+		if (stmt) {
+			for (j = 0; j < PREFETCH_BATCH_SIZE; j++) {
+				if (i + j < pending->len) {
+					tracker_db_statement_bind_text (stmt, j, g_ptr_array_index (pending, i + j));
 				} else {
-					g_warning ("Journal replay error: '%s'", new_error->message);
-					g_clear_error (&new_error);
+					tracker_db_statement_bind_null (stmt, j);
 				}
 			}
-		} else if (type == TRACKER_DB_JOURNAL_INSERT_STATEMENT ||
-		           type == TRACKER_DB_JOURNAL_UPDATE_STATEMENT) {
-			GError *new_error = NULL;
-			TrackerProperty *property = NULL;
 
-			tracker_db_journal_reader_get_statement (reader, &graph_id, &subject_id, &predicate_id, &object);
+			cursor = tracker_db_statement_start_cursor (stmt, &actual_error);
+			g_object_unref (stmt);
+		}
 
-			if (last_operation_type == -1) {
-				tracker_data_update_buffer_flush (data, &new_error);
-				if (new_error) {
-					g_warning ("Journal replay error: '%s'", new_error->message);
-					g_clear_error (&new_error);
-				}
-			}
-			last_operation_type = 1;
+		if (!cursor) {
+			break;
+		}
 
-			uri = tracker_ontologies_get_uri_by_id (ontologies, predicate_id);
-			if (uri) {
-				property = tracker_ontologies_get_property_by_uri (ontologies, uri);
-			}
+		while (tracker_db_cursor_iter_next (cursor, NULL, &actual_error)) {
+			const gchar *uri;
 
-			if (property) {
-				resource_buffer_switch (data, NULL, NULL, subject_id);
+			uri = tracker_db_cursor_get_string (cursor, 1, NULL);
+			g_hash_table_remove (data->update_buffer.resource_misses, uri);
+			g_hash_table_insert (data->update_buffer.resource_cache, g_strdup (uri),
+			                     GINT_TO_POINTER (tracker_db_cursor_get_int (cursor, 0)));
+		}
 
-				if (type == TRACKER_DB_JOURNAL_UPDATE_STATEMENT) {
-					cache_update_metadata_decomposed (data, property, object, 0, NULL, graph_id, &new_error);
-				} else {
-					cache_insert_metadata_decomposed (data, property, object, 0, NULL, graph_id, &new_error);
-				}
-				if (new_error) {
-					g_warning ("Journal replay error: '%s'", new_error->message);
-					g_clear_error (&new_error);
-				}
+		g_object_unref (cursor);
+	}
 
-			} else {
-				g_warning ("Journal replay error: 'property with ID %d doesn't exist'", predicate_id);
-			}
+	g_ptr_array_unref (pending);
 
-		} else if (type == TRACKER_DB_JOURNAL_INSERT_STATEMENT_ID ||
-		           type == TRACKER_DB_JOURNAL_UPDATE_STATEMENT_ID) {
-			GError *new_error = NULL;
-			TrackerClass *class = NULL;
-			TrackerProperty *property = NULL;
+	if (actual_error) {
+		/* nothing is known about the URIs that weren't looked up */
+		g_hash_table_remove_all (data->update_buffer.resource_misses);
+		g_propagate_error (error, actual_error);
+	}
+}
 
-			tracker_db_journal_reader_get_statement_id (reader, &graph_id, &subject_id, &predicate_id, &object_id);
+/* While deferred, FTS updates only record the resources whose text
+ * changed, tracker_data_flush_fts() indexes them in batches later on.
+ */
+void
+tracker_data_set_fts_deferred (TrackerData *data,
+                               gboolean     deferred)
+{
+#if HAVE_TRACKER_FTS
+	TrackerDBInterface *iface;
 
-			if (last_operation_type == -1) {
-				tracker_data_update_buffer_flush (data, &new_error);
-				if (new_error) {
-					g_warning ("Journal replay error: '%s'", new_error->message);
-					g_clear_error (&new_error);
-				}
-			}
-			last_operation_type = 1;
+	g_return_if_fail (!data->in_transaction);
 
-			uri = tracker_ontologies_get_uri_by_id (ontologies, predicate_id);
-			if (uri) {
-				property = tracker_ontologies_get_property_by_uri (ontologies, uri);
-			}
+	iface = tracker_data_manager_get_writable_db_interface (data->manager);
+	tracker_db_interface_sqlite_fts_set_deferred (iface, deferred);
+#endif
+}
 
-			if (property) {
-				if (tracker_property_get_data_type (property) != TRACKER_PROPERTY_TYPE_RESOURCE) {
-					g_warning ("Journal replay error: 'property with ID %d does not account URIs'", predicate_id);
-				} else {
-					resource_buffer_switch (data, NULL, NULL, subject_id);
+gboolean
+tracker_data_get_fts_deferred (TrackerData *data)
+{
+#if HAVE_TRACKER_FTS
+	TrackerDBInterface *iface;
 
-					if (property == rdf_type) {
-						uri = tracker_ontologies_get_uri_by_id (ontologies, object_id);
-						if (uri) {
-							class = tracker_ontologies_get_class_by_uri (ontologies, uri);
-						}
-						if (class) {
-							cache_create_service_decomposed (data, class, NULL, graph_id);
-						} else {
-							g_warning ("Journal replay error: 'class with ID %d not found in the ontology'", object_id);
-						}
-					} else {
-						GError *new_error = NULL;
+	iface = tracker_data_manager_get_writable_db_interface (data->manager);
+	return tracker_db_interface_sqlite_fts_get_deferred (iface);
+#else
+	return FALSE;
+#endif
+}
 
-						/* add value to metadata database */
-						if (type == TRACKER_DB_JOURNAL_UPDATE_STATEMENT_ID) {
-							cache_update_metadata_decomposed (data, property, NULL, object_id, NULL, graph_id, &new_error);
-						} else {
-							cache_insert_metadata_decomposed (data, property, NULL, object_id, NULL, graph_id, &new_error);
-						}
+/* Indexes up to @max_resources resources left pending by deferred
+ * FTS updates, returns how many were indexed. Once none are left,
+ * some merge work is done so queries don't pay for the segments
+ * written meanwhile.
+ */
+gint
+tracker_data_flush_fts (TrackerData  *data,
+                        gint          max_resources,
+                        GError      **error)
+{
+#if HAVE_TRACKER_FTS
+	TrackerDBInterface *iface;
+	GError *actual_error = NULL;
+	gint n_flushed;
 
-						if (new_error) {
-							g_warning ("Journal replay error: '%s'", new_error->message);
-							g_error_free (new_error);
-						}
-					}
-				}
-			} else {
-				g_warning ("Journal replay error: 'property with ID %d doesn't exist'", predicate_id);
+	g_return_val_if_fail (!data->in_transaction, 0);
+	g_return_val_if_fail (max_resources > 0, 0);
+
+	iface = tracker_data_manager_get_writable_db_interface (data->manager);
+	n_flushed = tracker_db_interface_sqlite_fts_flush_pending (iface, max_resources,
+	                                                            &actual_error);
+
+	if (actual_error) {
+		g_propagate_error (error, actual_error);
+		return 0;
+	}
+
+	if (n_flushed > 0 && n_flushed < max_resources)
+		tracker_db_interface_sqlite_fts_merge (iface, FTS_IDLE_MERGE_PAGES);
+
+	return n_flushed;
+#else
+	return 0;
+#endif
+}
+
+void
+tracker_data_sync (TrackerData *data)
+{
+#ifndef DISABLE_JOURNAL
+	TrackerDBJournal *writer;
+
+	writer = tracker_data_manager_get_journal_writer (data->manager);
+	if (writer)
+		tracker_db_journal_fsync (writer);
+
+	writer = tracker_data_manager_get_ontology_writer (data->manager);
+	if (writer)
+		tracker_db_journal_fsync (writer);
+#endif
+}
+
+#ifndef DISABLE_JOURNAL
+
+/* The journal is decoded and checked on a separate thread, while the
+ * entries decoded before are applied. Consecutive journal transactions
+ * are applied within one SQLite transaction, each keeping its own time,
+ * and index and FTS maintenance is left for the end of the replay, see
+ * tracker_data_begin_bulk_load().
+ */
+
+/* journal entries decoded at once, batches only end with a transaction */
+#define REPLAY_BATCH_SIZE 4096
+/* batches going back and forth between both threads */
+#define REPLAY_N_BATCHES 4
+/* statements applied before the SQLite transaction is committed */
+#define REPLAY_COMMIT_SIZE 100000
+
+typedef struct {
+	TrackerDBJournalEntryType type;
+	gint64 time;
+	gint g_id;
+	gint s_id;
+	gint p_id;
+	gint o_id;
+	/* resource URI or object string, owned by the batch */
+	const gchar *str;
+} ReplayEntry;
+
+typedef struct {
+	GArray *entries;
+	GStringChunk *strings;
+	gdouble progress;
+	GError *error;
+	gboolean last;
+} ReplayBatch;
+
+typedef struct {
+	TrackerDBJournalReader *reader;
+	GAsyncQueue *free_batches;
+	GAsyncQueue *full_batches;
+	gint stop;
+} ReplayDecoder;
+
+static ReplayBatch *
+replay_batch_new (void)
+{
+	ReplayBatch *batch;
+
+	batch = g_slice_new0 (ReplayBatch);
+	batch->entries = g_array_sized_new (FALSE, FALSE, sizeof (ReplayEntry), REPLAY_BATCH_SIZE);
+	batch->strings = g_string_chunk_new (64 * 1024);
+
+	return batch;
+}
+
+static void
+replay_batch_free (ReplayBatch *batch)
+{
+	g_array_unref (batch->entries);
+	g_string_chunk_free (batch->strings);
+	g_clear_error (&batch->error);
+	g_slice_free (ReplayBatch, batch);
+}
+
+static gpointer
+replay_decoder_thread (gpointer user_data)
+{
+	ReplayDecoder *decoder = user_data;
+	ReplayBatch *batch;
+	gboolean last = FALSE;
+
+	while (!last) {
+		guint complete = 0;
+
+		batch = g_async_queue_pop (decoder->free_batches);
+		g_array_set_size (batch->entries, 0);
+		g_string_chunk_clear (batch->strings);
+		g_clear_error (&batch->error);
+		batch->last = FALSE;
+
+		while (!batch->last &&
+		       (batch->entries->len < REPLAY_BATCH_SIZE || complete < batch->entries->len)) {
+			ReplayEntry entry = { 0 };
+			const gchar *str = NULL;
+
+			if (g_atomic_int_get (&decoder->stop) ||
+			    !tracker_db_journal_reader_next (decoder->reader, &batch->error)) {
+				/* a transaction cut short is not replayed */
+				g_array_set_size (batch->entries, complete);
+				batch->last = TRUE;
+				break;
 			}
 
-		} else if (type == TRACKER_DB_JOURNAL_DELETE_STATEMENT) {
-			GError *new_error = NULL;
-			TrackerProperty *property = NULL;
+			entry.type = tracker_db_journal_reader_get_entry_type (decoder->reader);
 
-			tracker_db_journal_reader_get_statement (reader, &graph_id, &subject_id, &predicate_id, &object);
+			switch (entry.type) {
+			case TRACKER_DB_JOURNAL_START_TRANSACTION:
+				entry.time = tracker_db_journal_reader_get_time (decoder->reader);
+				break;
+			case TRACKER_DB_JOURNAL_RESOURCE:
+				tracker_db_journal_reader_get_resource (decoder->reader, &entry.s_id, &str);
+				break;
+			case TRACKER_DB_JOURNAL_INSERT_STATEMENT:
+			case TRACKER_DB_JOURNAL_UPDATE_STATEMENT:
+			case TRACKER_DB_JOURNAL_DELETE_STATEMENT:
+				tracker_db_journal_reader_get_statement (decoder->reader, &entry.g_id, &entry.s_id, &entry.p_id, &str);
+				break;
+			case TRACKER_DB_JOURNAL_INSERT_STATEMENT_ID:
+			case TRACKER_DB_JOURNAL_UPDATE_STATEMENT_ID:
+			case TRACKER_DB_JOURNAL_DELETE_STATEMENT_ID:
+				tracker_db_journal_reader_get_statement_id (decoder->reader, &entry.g_id, &entry.s_id, &entry.p_id, &entry.o_id);
+				break;
+			default:
+				break;
+			}
 
-			if (last_operation_type == 1) {
-				tracker_data_update_buffer_flush (data, &new_error);
-				if (new_error) {
-					g_warning ("Journal replay error: '%s'", new_error->message);
-					g_clear_error (&new_error);
-				}
+			if (str) {
+				entry.str = g_string_chunk_insert (batch->strings, str);
 			}
-			last_operation_type = -1;
 
-			resource_buffer_switch (data, NULL, NULL, subject_id);
+			g_array_append_val (batch->entries, entry);
 
-			uri = tracker_ontologies_get_uri_by_id (ontologies, predicate_id);
-			if (uri) {
-				property = tracker_ontologies_get_property_by_uri (ontologies, uri);
+			if (entry.type == TRACKER_DB_JOURNAL_END_TRANSACTION) {
+				complete = batch->entries->len;
 			}
+		}
 
-			if (property) {
-				GError *new_error = NULL;
+		batch->progress = tracker_db_journal_reader_get_progress (decoder->reader);
+		last = batch->last;
+		g_async_queue_push (decoder->full_batches, batch);
+	}
 
-				if (object && rdf_type == property) {
-					TrackerClass *class;
+	return NULL;
+}
 
-					class = tracker_ontologies_get_class_by_uri (ontologies, object);
-					if (class != NULL) {
-						cache_delete_resource_type (data, class, NULL, graph_id);
-					} else {
-						g_warning ("Journal replay error: 'class with '%s' not found in the ontology'", object);
-					}
-				} else {
-					delete_metadata_decomposed (data, property, object, 0, &new_error);
-				}
+static void
+replay_flush (TrackerData *data)
+{
+	GError *new_error = NULL;
+
+	tracker_data_update_buffer_flush (data, &new_error);
+	if (new_error) {
+		g_warning ("Journal replay error: '%s'", new_error->message);
+		g_clear_error (&new_error);
+	}
+}
+
+/* Applies one journal entry, only errors that end the replay are set */
+static void
+replay_entry (TrackerData        *data,
+              const ReplayEntry  *entry,
+              gboolean            bulk,
+              gint               *last_operation_type,
+              guint              *n_statements,
+              GError            **error)
+{
+	TrackerOntologies *ontologies;
+	TrackerProperty *rdf_type;
+	const gchar *uri;
+
+	ontologies = tracker_data_manager_get_ontologies (data->manager);
+	rdf_type = tracker_ontologies_get_rdf_type (ontologies);
 
+	if (entry->type == TRACKER_DB_JOURNAL_RESOURCE) {
+		GError *new_error = NULL;
+		TrackerDBInterface *iface;
+		TrackerDBStatement *stmt;
+
+		iface = tracker_data_manager_get_writable_db_interface (data->manager);
+
+		stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE, &new_error,
+		                                              "INSERT INTO Resource (ID, Uri) VALUES (?, ?)");
+
+		if (stmt) {
+			tracker_db_statement_bind_int (stmt, 0, entry->s_id);
+			tracker_db_statement_bind_text (stmt, 1, entry->str);
+			tracker_db_statement_execute (stmt, &new_error);
+			g_object_unref (stmt);
+		}
+
+		if (new_error) {
+			g_warning ("Journal replay error: '%s'", new_error->message);
+			g_error_free (new_error);
+		}
+
+	} else if (entry->type == TRACKER_DB_JOURNAL_START_TRANSACTION) {
+		if (!data->in_transaction) {
+			GError *new_error = NULL;
+
+			tracker_data_begin_transaction_for_replay (data, entry->time, NULL);
+
+			if (bulk && data->in_transaction && !data->bulk_load) {
+				tracker_data_begin_bulk_load (data, &new_error);
 				if (new_error) {
 					g_warning ("Journal replay error: '%s'", new_error->message);
-					g_error_free (new_error);
+					g_clear_error (&new_error);
 				}
-
-			} else {
-				g_warning ("Journal replay error: 'property with ID %d doesn't exist'", predicate_id);
 			}
+		} else {
+			/* next transaction within the same SQLite transaction,
+			 * the previous one was flushed with its own time */
+			data->resource_time = entry->time;
+		}
+	} else if (entry->type == TRACKER_DB_JOURNAL_END_TRANSACTION) {
+		replay_flush (data);
 
-		} else if (type == TRACKER_DB_JOURNAL_DELETE_STATEMENT_ID) {
+		if (*n_statements >= REPLAY_COMMIT_SIZE) {
 			GError *new_error = NULL;
-			TrackerClass *class = NULL;
-			TrackerProperty *property = NULL;
 
-			tracker_db_journal_reader_get_statement_id (reader, &graph_id, &subject_id, &predicate_id, &object_id);
+			*n_statements = 0;
 
-			if (last_operation_type == 1) {
-				tracker_data_update_buffer_flush (data, &new_error);
-				if (new_error) {
+			tracker_data_commit_transaction (data, &new_error);
+			if (new_error) {
+				/* Out of disk is an unrecoverable fatal error */
+				if (g_error_matches (new_error, TRACKER_DB_INTERFACE_ERROR, TRACKER_DB_NO_SPACE)) {
+					g_propagate_error (error, new_error);
+					return;
+				} else {
 					g_warning ("Journal replay error: '%s'", new_error->message);
 					g_clear_error (&new_error);
 				}
 			}
-			last_operation_type = -1;
+		}
+	} else if (entry->type == TRACKER_DB_JOURNAL_INSERT_STATEMENT ||
+	           entry->type == TRACKER_DB_JOURNAL_UPDATE_STATEMENT) {
+		GError *new_error = NULL;
+		TrackerProperty *property = NULL;
+
+		(*n_statements)++;
+
+		if (*last_operation_type == -1) {
+			replay_flush (data);
+		}
+		*last_operation_type = 1;
 
-			uri = tracker_ontologies_get_uri_by_id (ontologies, predicate_id);
-			if (uri) {
-				property = tracker_ontologies_get_property_by_uri (ontologies, uri);
+		uri = tracker_ontologies_get_uri_by_id (ontologies, entry->p_id);
+		if (uri) {
+			property = tracker_ontologies_get_property_by_uri (ontologies, uri);
+		}
+
+		if (property) {
+			resource_buffer_switch (data, NULL, NULL, entry->s_id);
+
+			if (entry->type == TRACKER_DB_JOURNAL_UPDATE_STATEMENT) {
+				cache_update_metadata_decomposed (data, property, entry->str, 0, NULL, entry->g_id, &new_error);
+			} else {
+				cache_insert_metadata_decomposed (data, property, entry->str, 0, NULL, entry->g_id, &new_error);
+			}
+			if (new_error) {
+				g_warning ("Journal replay error: '%s'", new_error->message);
+				g_clear_error (&new_error);
 			}
 
-			if (property) {
+		} else {
+			g_warning ("Journal replay error: 'property with ID %d doesn't exist'", entry->p_id);
+		}
+
+	} else if (entry->type == TRACKER_DB_JOURNAL_INSERT_STATEMENT_ID ||
+	           entry->type == TRACKER_DB_JOURNAL_UPDATE_STATEMENT_ID) {
+		TrackerClass *class = NULL;
+		TrackerProperty *property = NULL;
+
+		(*n_statements)++;
+
+		if (*last_operation_type == -1) {
+			replay_flush (data);
+		}
+		*last_operation_type = 1;
+
+		uri = tracker_ontologies_get_uri_by_id (ontologies, entry->p_id);
+		if (uri) {
+			property = tracker_ontologies_get_property_by_uri (ontologies, uri);
+		}
 
-				resource_buffer_switch (data, NULL, NULL, subject_id);
+		if (property) {
+			if (tracker_property_get_data_type (property) != TRACKER_PROPERTY_TYPE_RESOURCE) {
+				g_warning ("Journal replay error: 'property with ID %d does not account URIs'", entry->p_id);
+			} else {
+				resource_buffer_switch (data, NULL, NULL, entry->s_id);
 
 				if (property == rdf_type) {
-					uri = tracker_ontologies_get_uri_by_id (ontologies, object_id);
+					uri = tracker_ontologies_get_uri_by_id (ontologies, entry->o_id);
 					if (uri) {
 						class = tracker_ontologies_get_class_by_uri (ontologies, uri);
 					}
 					if (class) {
-						cache_delete_resource_type (data, class, NULL, graph_id);
+						cache_create_service_decomposed (data, class, NULL, entry->g_id);
 					} else {
-						g_warning ("Journal replay error: 'class with ID %d not found in the ontology'", object_id);
+						g_warning ("Journal replay error: 'class with ID %d not found in the ontology'", entry->o_id);
 					}
 				} else {
 					GError *new_error = NULL;
 
-					delete_metadata_decomposed (data, property, NULL, object_id, &new_error);
+					/* add value to metadata database */
+					if (entry->type == TRACKER_DB_JOURNAL_UPDATE_STATEMENT_ID) {
+						cache_update_metadata_decomposed (data, property, NULL, entry->o_id, NULL, entry->g_id, &new_error);
+					} else {
+						cache_insert_metadata_decomposed (data, property, NULL, entry->o_id, NULL, entry->g_id, &new_error);
+					}
 
 					if (new_error) {
 						g_warning ("Journal replay error: '%s'", new_error->message);
 						g_error_free (new_error);
 					}
 				}
+			}
+		} else {
+			g_warning ("Journal replay error: 'property with ID %d doesn't exist'", entry->p_id);
+		}
+
+	} else if (entry->type == TRACKER_DB_JOURNAL_DELETE_STATEMENT) {
+		TrackerProperty *property = NULL;
+
+		(*n_statements)++;
+
+		if (*last_operation_type == 1) {
+			replay_flush (data);
+		}
+		*last_operation_type = -1;
+
+		resource_buffer_switch (data, NULL, NULL, entry->s_id);
+
+		uri = tracker_ontologies_get_uri_by_id (ontologies, entry->p_id);
+		if (uri) {
+			property = tracker_ontologies_get_property_by_uri (ontologies, uri);
+		}
+
+		if (property) {
+			GError *new_error = NULL;
+
+			if (entry->str && rdf_type == property) {
+				TrackerClass *class;
+
+				class = tracker_ontologies_get_class_by_uri (ontologies, entry->str);
+				if (class != NULL) {
+					cache_delete_resource_type (data, class, NULL, entry->g_id);
+				} else {
+					g_warning ("Journal replay error: 'class with '%s' not found in the ontology'", entry->str);
+				}
+			} else {
+				delete_metadata_decomposed (data, property, entry->str, 0, &new_error);
+			}
+
+			if (new_error) {
+				g_warning ("Journal replay error: '%s'", new_error->message);
+				g_error_free (new_error);
+			}
+
+		} else {
+			g_warning ("Journal replay error: 'property with ID %d doesn't exist'", entry->p_id);
+		}
+
+	} else if (entry->type == TRACKER_DB_JOURNAL_DELETE_STATEMENT_ID) {
+		TrackerClass *class = NULL;
+		TrackerProperty *property = NULL;
+
+		(*n_statements)++;
+
+		if (*last_operation_type == 1) {
+			replay_flush (data);
+		}
+		*last_operation_type = -1;
+
+		uri = tracker_ontologies_get_uri_by_id (ontologies, entry->p_id);
+		if (uri) {
+			property = tracker_ontologies_get_property_by_uri (ontologies, uri);
+		}
+
+		if (property) {
+
+			resource_buffer_switch (data, NULL, NULL, entry->s_id);
+
+			if (property == rdf_type) {
+				uri = tracker_ontologies_get_uri_by_id (ontologies, entry->o_id);
+				if (uri) {
+					class = tracker_ontologies_get_class_by_uri (ontologies, uri);
+				}
+				if (class) {
+					cache_delete_resource_type (data, class, NULL, entry->g_id);
+				} else {
+					g_warning ("Journal replay error: 'class with ID %d not found in the ontology'", entry->o_id);
+				}
 			} else {
-				g_warning ("Journal replay error: 'property with ID %d doesn't exist'", predicate_id);
+				GError *new_error = NULL;
+
+				delete_metadata_decomposed (data, property, NULL, entry->o_id, &new_error);
+
+				if (new_error) {
+					g_warning ("Journal replay error: '%s'", new_error->message);
+					g_error_free (new_error);
+				}
+			}
+		} else {
+			g_warning ("Journal replay error: 'property with ID %d doesn't exist'", entry->p_id);
+		}
+	}
+}
+
+/* Commits what is left of the replay and restores indexes */
+static void
+replay_finish (TrackerData  *data,
+               GError      **error)
+{
+	GError *new_error = NULL;
+
+	if (data->bulk_load) {
+		if (!data->in_transaction) {
+			tracker_data_begin_transaction_for_replay (data, time (NULL), &new_error);
+			if (new_error) {
+				g_propagate_error (error, new_error);
+				return;
 			}
 		}
 
+		tracker_data_end_bulk_load (data, &new_error);
+		if (new_error) {
+			g_warning ("Journal replay error: '%s'", new_error->message);
+			g_clear_error (&new_error);
+		}
+	}
+
+	if (data->in_transaction) {
+		tracker_data_commit_transaction (data, &new_error);
+		if (new_error) {
+			if (g_error_matches (new_error, TRACKER_DB_INTERFACE_ERROR, TRACKER_DB_NO_SPACE)) {
+				g_propagate_error (error, new_error);
+			} else {
+				g_warning ("Journal replay error: '%s'", new_error->message);
+				g_clear_error (&new_error);
+			}
+		}
+	}
+}
+
+void
+tracker_data_replay_journal (TrackerData          *data,
+                             gint                  snapshot_chunk,
+                             TrackerBusyCallback   busy_callback,
+                             gpointer              busy_user_data,
+                             const gchar          *busy_status,
+                             GError              **error)
+{
+	GError *journal_error = NULL;
+	GError *replay_error = NULL;
+	gint last_operation_type = 0;
+	guint n_statements = 0;
+	GError *n_error = NULL;
+	GFile *data_location;
+	TrackerDBJournalReader *reader;
+	ReplayDecoder decoder = { 0 };
+	ReplayBatch *batch;
+	GThread *thread;
+	gboolean done = FALSE;
+	guint i;
+
+	data_location = tracker_data_manager_get_data_location (data->manager);
+	if (snapshot_chunk > 0) {
+		/* the database was restored from a snapshot of this chunk */
+		reader = tracker_db_journal_reader_new_from_chunk (data_location, snapshot_chunk + 1, &n_error);
+	} else {
+		reader = tracker_db_journal_reader_new (data_location, &n_error);
+	}
+	g_object_unref (data_location);
+
+	if (!reader) {
+		/* This is fatal (doesn't happen when file doesn't exist, does happen
+		 * when for some other reason the reader can't be created) */
+		g_propagate_error (error, n_error);
+		return;
+	}
+
+	decoder.reader = reader;
+	decoder.free_batches = g_async_queue_new_full ((GDestroyNotify) replay_batch_free);
+	decoder.full_batches = g_async_queue_new_full ((GDestroyNotify) replay_batch_free);
+
+	for (i = 0; i < REPLAY_N_BATCHES; i++) {
+		g_async_queue_push (decoder.free_batches, replay_batch_new ());
+	}
+
+	thread = g_thread_new ("journal-replay", replay_decoder_thread, &decoder);
+
+	while (!done && !replay_error) {
+		batch = g_async_queue_pop (decoder.full_batches);
+		done = batch->last;
+
+		for (i = 0; i < batch->entries->len && !replay_error; i++) {
+			replay_entry (data, &g_array_index (batch->entries, ReplayEntry, i),
+			              snapshot_chunk == 0,
+			              &last_operation_type, &n_statements, &replay_error);
+		}
+
+		if (batch->error) {
+			journal_error = batch->error;
+			batch->error = NULL;
+		}
+
 		if (busy_callback) {
-			busy_callback (busy_status,
-			               tracker_db_journal_reader_get_progress (reader),
-			               busy_user_data);
+			busy_callback (busy_status, batch->progress, busy_user_data);
 		}
+
+		g_async_queue_push (decoder.free_batches, batch);
+	}
+
+	/* wait for the decoder, which stops early after fatal errors */
+	g_atomic_int_set (&decoder.stop, TRUE);
+
+	while (!done) {
+		batch = g_async_queue_pop (decoder.full_batches);
+		done = batch->last;
+		g_async_queue_push (decoder.free_batches, batch);
 	}
 
+	g_thread_join (thread);
+	g_async_queue_unref (decoder.free_batches);
+	g_async_queue_unref (decoder.full_batches);
+
+	if (!replay_error) {
+		replay_finish (data, &replay_error);
+	}
+
+	if (replay_error) {
+		g_clear_error (&journal_error);
+		tracker_db_journal_reader_free (reader);
+		g_propagate_error (error, replay_error);
+		return;
+	}
 
 	if (journal_error) {
 		GError *n_error = NULL;
@@ -4089,6 +5095,7 @@ tracker_data_replay_journal (TrackerData          *data,
 
 void
 tracker_data_replay_journal (TrackerData          *data,
+                             gint                  snapshot_chunk,
                              TrackerBusyCallback   busy_callback,
                              gpointer              busy_user_data,
                              const gchar          *busy_status,
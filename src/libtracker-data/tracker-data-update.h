@@ -127,9 +127,30 @@ void     tracker_data_update_buffer_might_flush     (TrackerData               *
 void     tracker_data_load_turtle_file              (TrackerData               *data,
                                                      GFile                     *file,
                                                      GError                   **error);
+void     tracker_data_load_turtle_file_bulk         (TrackerData               *data,
+                                                     GFile                     *file,
+                                                     GError                   **error);
+void     tracker_data_begin_bulk_load               (TrackerData               *data,
+                                                     GError                   **error);
+void     tracker_data_end_bulk_load                 (TrackerData               *data,
+                                                     GError                   **error);
+void     tracker_data_recover_bulk_load             (TrackerData               *data,
+                                                     GError                   **error);
+void     tracker_data_prefetch_resource_ids         (TrackerData               *data,
+                                                     gchar                    **uris,
+                                                     gint                       n_uris,
+                                                     GError                   **error);
 
+void     tracker_data_set_fts_deferred              (TrackerData               *data,
+                                                     gboolean                   deferred);
+gboolean tracker_data_get_fts_deferred              (TrackerData               *data);
+gint     tracker_data_flush_fts                     (TrackerData               *data,
+                                                     gint                       max_resources,
+                                                     GError                   **error);
 void     tracker_data_sync                          (TrackerData               *data);
+void     tracker_data_wait_snapshot                 (TrackerData               *data);
 void     tracker_data_replay_journal                (TrackerData               *data,
+                                                     gint                       snapshot_chunk,
                                                      TrackerBusyCallback        busy_callback,
                                                      gpointer                   busy_user_data,
                                                      const gchar               *busy_status,
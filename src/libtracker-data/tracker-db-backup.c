@@ -85,58 +85,50 @@ backup_info_free (gpointer user_data)
 	g_slice_free (BackupInfo, info);
 }
 
-static void
-backup_job (GTask        *task,
-            gpointer      source_object,
-            gpointer      task_data,
-            GCancellable *cancellable)
+/* Copies @src_db to @destination through @temp_file. If @src_db is
+ * within a read transaction, the copy is what that transaction sees.
+ */
+static gboolean
+backup_db (sqlite3  *src_db,
+           GFile    *destination,
+           GFile    *temp_file,
+           GError  **error)
 {
-	BackupInfo *info = task_data;
-
-	GFile *parent_file, *temp_file;
-	gchar *temp_path, *src_path;
+	GError *internal_error = NULL;
+	gchar *temp_path;
 
-	sqlite3 *src_db = NULL;
 	sqlite3 *temp_db = NULL;
 	sqlite3_backup *backup = NULL;
 
-	src_path = g_file_get_path (info->file);
-	parent_file = g_file_get_parent (info->destination);
-	temp_file = g_file_get_child (parent_file, TRACKER_DB_BACKUP_META_FILENAME_T);
 	g_file_delete (temp_file, NULL, NULL);
 	temp_path = g_file_get_path (temp_file);
 
-	if (sqlite3_open_v2 (src_path, &src_db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK) {
-		g_set_error (&info->error, TRACKER_DB_BACKUP_ERROR, TRACKER_DB_BACKUP_ERROR_UNKNOWN,
-		             "Could not open sqlite3 database:'%s'", src_path);
-	}
-
-	if (!info->error && sqlite3_open (temp_path, &temp_db) != SQLITE_OK) {
-		g_set_error (&info->error, TRACKER_DB_BACKUP_ERROR, TRACKER_DB_BACKUP_ERROR_UNKNOWN,
+	if (sqlite3_open (temp_path, &temp_db) != SQLITE_OK) {
+		g_set_error (&internal_error, TRACKER_DB_BACKUP_ERROR, TRACKER_DB_BACKUP_ERROR_UNKNOWN,
 		             "Could not open sqlite3 database:'%s'", temp_path);
 	}
 
-	if (!info->error) {
+	if (!internal_error) {
 		backup = sqlite3_backup_init (temp_db, "main", src_db, "main");
 
 		if (!backup) {
-			g_set_error (&info->error, TRACKER_DB_BACKUP_ERROR, TRACKER_DB_BACKUP_ERROR_UNKNOWN,
-				     "Unable to initialize sqlite3 backup from '%s' to '%s'", src_path, temp_path);
+			g_set_error (&internal_error, TRACKER_DB_BACKUP_ERROR, TRACKER_DB_BACKUP_ERROR_UNKNOWN,
+				     "Unable to initialize sqlite3 backup to '%s'", temp_path);
 		}
 	}
 
-	if (!info->error && sqlite3_backup_step (backup, -1) != SQLITE_DONE) {
-		g_set_error (&info->error, TRACKER_DB_BACKUP_ERROR, TRACKER_DB_BACKUP_ERROR_UNKNOWN,
+	if (!internal_error && sqlite3_backup_step (backup, -1) != SQLITE_DONE) {
+		g_set_error (&internal_error, TRACKER_DB_BACKUP_ERROR, TRACKER_DB_BACKUP_ERROR_UNKNOWN,
 		             "Unable to complete sqlite3 backup");
 	}
 
 	if (backup) {
 		if (sqlite3_backup_finish (backup) != SQLITE_OK) {
-			if (info->error) {
+			if (internal_error) {
 				/* sqlite3_backup_finish can provide more detailed error message */
-				g_clear_error (&info->error);
+				g_clear_error (&internal_error);
 			}
-			g_set_error (&info->error,
+			g_set_error (&internal_error,
 			             TRACKER_DB_BACKUP_ERROR,
 			             TRACKER_DB_BACKUP_ERROR_UNKNOWN,
 				     "Unable to finish sqlite3 backup: %s",
@@ -150,20 +142,78 @@ backup_job (GTask        *task,
 		temp_db = NULL;
 	}
 
-	if (src_db) {
+	if (!internal_error) {
+		g_file_move (temp_file, destination,
+		             G_FILE_COPY_OVERWRITE,
+		             NULL, NULL, NULL,
+		             &internal_error);
+	}
+
+	g_free (temp_path);
+
+	if (internal_error) {
+		g_propagate_error (error, internal_error);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static sqlite3 *
+open_source_db (GFile   *file,
+                GError **error)
+{
+	sqlite3 *src_db = NULL;
+	gchar *src_path;
+
+	src_path = g_file_get_path (file);
+
+	if (sqlite3_open_v2 (src_path, &src_db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK) {
+		g_set_error (error, TRACKER_DB_BACKUP_ERROR, TRACKER_DB_BACKUP_ERROR_UNKNOWN,
+		             "Could not open sqlite3 database:'%s'", src_path);
 		sqlite3_close (src_db);
 		src_db = NULL;
 	}
 
-	if (!info->error) {
-		g_file_move (temp_file, info->destination,
-		             G_FILE_COPY_OVERWRITE,
-		             NULL, NULL, NULL,
-		             &info->error);
+	g_free (src_path);
+
+	return src_db;
+}
+
+static gboolean
+backup_file (GFile   *file,
+             GFile   *destination,
+             GFile   *temp_file,
+             GError **error)
+{
+	sqlite3 *src_db;
+	gboolean retval;
+
+	src_db = open_source_db (file, error);
+	if (!src_db) {
+		return FALSE;
 	}
 
-	g_free (src_path);
-	g_free (temp_path);
+	retval = backup_db (src_db, destination, temp_file, error);
+	sqlite3_close (src_db);
+
+	return retval;
+}
+
+static void
+backup_job (GTask        *task,
+            gpointer      source_object,
+            gpointer      task_data,
+            GCancellable *cancellable)
+{
+	BackupInfo *info = task_data;
+	GFile *parent_file, *temp_file;
+
+	parent_file = g_file_get_parent (info->destination);
+	temp_file = g_file_get_child (parent_file, TRACKER_DB_BACKUP_META_FILENAME_T);
+
+	backup_file (info->file, info->destination, temp_file, &info->error);
+
 	g_object_unref (temp_file);
 	g_object_unref (parent_file);
 
@@ -197,3 +247,101 @@ tracker_db_backup_save (GFile                   *destination,
 	g_object_unref (task);
 }
 
+
+static GFile *
+get_temp_file (GFile *destination)
+{
+	GFile *temp_file;
+	gchar *path, *temp_path;
+
+	path = g_file_get_path (destination);
+	temp_path = g_strconcat (path, ".tmp", NULL);
+	temp_file = g_file_new_for_path (temp_path);
+	g_free (temp_path);
+	g_free (path);
+
+	return temp_file;
+}
+
+/* Copies the database synchronously, readers of the destination never
+ * see a partial copy. Used to restore journal snapshots.
+ */
+gboolean
+tracker_db_backup_snapshot (GFile   *file,
+                            GFile   *destination,
+                            GError **error)
+{
+	GFile *temp_file;
+	gboolean retval;
+
+	temp_file = get_temp_file (destination);
+	retval = backup_file (file, destination, temp_file, error);
+
+	if (!retval) {
+		g_file_delete (temp_file, NULL, NULL);
+	}
+
+	g_object_unref (temp_file);
+
+	return retval;
+}
+
+/* Journal snapshots are taken in two steps. The database as it is at
+ * the time of tracker_db_backup_snapshot_open() is held in a read
+ * transaction of a separate connection, which can then be copied by
+ * tracker_db_backup_snapshot_write() from any thread while updates
+ * go on. Later commits are not part of the copy, but the database
+ * keeps the WAL from being checkpointed past it until it is freed.
+ */
+TrackerDBBackupSnapshot *
+tracker_db_backup_snapshot_open (GFile   *file,
+                                 GError **error)
+{
+	sqlite3 *src_db;
+
+	src_db = open_source_db (file, error);
+	if (!src_db) {
+		return NULL;
+	}
+
+	/* the read transaction starts with the first read */
+	if (sqlite3_exec (src_db, "BEGIN; SELECT COUNT(*) FROM sqlite_master",
+	                  NULL, NULL, NULL) != SQLITE_OK) {
+		g_set_error (error, TRACKER_DB_BACKUP_ERROR, TRACKER_DB_BACKUP_ERROR_UNKNOWN,
+		             "Could not start snapshot transaction: %s",
+		             sqlite3_errmsg (src_db));
+		sqlite3_close (src_db);
+		return NULL;
+	}
+
+	return (TrackerDBBackupSnapshot *) src_db;
+}
+
+gboolean
+tracker_db_backup_snapshot_write (TrackerDBBackupSnapshot  *snapshot,
+                                  GFile                    *destination,
+                                  GError                  **error)
+{
+	GFile *temp_file;
+	gboolean retval;
+
+	temp_file = get_temp_file (destination);
+	retval = backup_db ((sqlite3 *) snapshot, destination, temp_file, error);
+
+	if (!retval) {
+		g_file_delete (temp_file, NULL, NULL);
+	}
+
+	g_object_unref (temp_file);
+
+	return retval;
+}
+
+void
+tracker_db_backup_snapshot_free (TrackerDBBackupSnapshot *snapshot)
+{
+	sqlite3 *src_db = (sqlite3 *) snapshot;
+
+	sqlite3_exec (src_db, "COMMIT", NULL, NULL, NULL);
+	sqlite3_close (src_db);
+}
@@ -37,6 +37,8 @@ typedef enum {
 
 typedef void (*TrackerDBBackupFinished)   (GError *error, gpointer user_data);
 
+typedef struct _TrackerDBBackupSnapshot TrackerDBBackupSnapshot;
+
 GQuark    tracker_db_backup_error_quark (void);
 
 void      tracker_db_backup_save        (GFile                   *destination,
@@ -44,6 +46,17 @@ void      tracker_db_backup_save        (GFile                   *destination,
                                          TrackerDBBackupFinished  callback,
                                          gpointer                 user_data,
                                          GDestroyNotify           destroy);
+gboolean  tracker_db_backup_snapshot    (GFile                   *file,
+                                         GFile                   *destination,
+                                         GError                 **error);
+
+TrackerDBBackupSnapshot *
+          tracker_db_backup_snapshot_open  (GFile                    *file,
+                                            GError                  **error);
+gboolean  tracker_db_backup_snapshot_write (TrackerDBBackupSnapshot  *snapshot,
+                                            GFile                    *destination,
+                                            GError                  **error);
+void      tracker_db_backup_snapshot_free  (TrackerDBBackupSnapshot  *snapshot);
 
 G_END_DECLS
 
@@ -55,6 +55,12 @@
 #include "tracker-db-manager.h"
 #include "tracker-data-enum-types.h"
 
+/* FTS5 defaults, and the values used while indexing is deferred */
+#define FTS_DEFAULT_AUTOMERGE 4
+#define FTS_DEFAULT_CRISISMERGE 16
+#define FTS_DEFERRED_AUTOMERGE 8
+#define FTS_DEFERRED_CRISISMERGE 64
+
 typedef struct {
 	TrackerDBStatement *head;
 	TrackerDBStatement *tail;
@@ -89,6 +95,8 @@ struct TrackerDBInterface {
 	TrackerDBStatementLru update_stmt_lru;
 
 	gchar *fts_properties;
+	gboolean fts_content_table;
+	gboolean fts_deferred;
 
 	/* Used if TRACKER_DB_INTERFACE_USE_MUTEX is set */
 	GMutex mutex;
@@ -1608,23 +1616,14 @@ _fts_create_properties (GHashTable *properties)
 	return (gchar **) g_ptr_array_free (cols, FALSE);
 }
 
-void
-tracker_db_interface_sqlite_fts_init (TrackerDBInterface  *db_interface,
-                                      GHashTable          *properties,
-                                      GHashTable          *multivalued,
-                                      gboolean             create)
-{
 #if HAVE_TRACKER_FTS
+static void
+tracker_db_interface_sqlite_fts_set_properties (TrackerDBInterface *db_interface,
+                                                GHashTable         *properties)
+{
 	GStrv fts_columns;
 
-	tracker_fts_init_db (db_interface->db, db_interface, properties);
-
-	if (create &&
-	    !tracker_fts_create_table (db_interface->db, "fts5",
-				       properties, multivalued)) {
-		g_warning ("FTS tables creation failed");
-	}
-
+	g_clear_pointer (&db_interface->fts_properties, g_free);
 	fts_columns = _fts_create_properties (properties);
 
 	if (fts_columns) {
@@ -1642,6 +1641,74 @@ tracker_db_interface_sqlite_fts_init (TrackerDBInterface  *db_interface,
 		                                              FALSE);
 		g_strfreev (fts_columns);
 	}
+}
+
+/* Resources whose FTS columns changed while indexing is deferred.
+ * The first change keeps a copy of the text the index still holds,
+ * so the stale tokens can be deleted when the resource is indexed.
+ */
+static gboolean
+tracker_db_interface_sqlite_fts_create_pending (TrackerDBInterface *db_interface)
+{
+	GError *error = NULL;
+
+	if (!db_interface->fts_content_table || !db_interface->fts_properties)
+		return FALSE;
+
+	tracker_db_interface_execute_query (db_interface, &error,
+	                                    "CREATE TABLE IF NOT EXISTS fts_pending "
+	                                    "(ID INTEGER PRIMARY KEY %s, \"Indexed\" INTEGER)",
+	                                    db_interface->fts_properties);
+
+	if (error) {
+		g_warning ("Could not create FTS pending table: %s", error->message);
+		g_error_free (error);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+#endif
+
+void
+tracker_db_interface_sqlite_fts_init (TrackerDBInterface  *db_interface,
+                                      GHashTable          *properties,
+                                      GHashTable          *multivalued,
+                                      gboolean             create)
+{
+#if HAVE_TRACKER_FTS
+	tracker_fts_init_db (db_interface->db, db_interface, properties);
+
+	if (create &&
+	    !tracker_fts_create_table (db_interface->db, "fts5",
+				       properties, multivalued)) {
+		g_warning ("FTS tables creation failed");
+	}
+
+	db_interface->fts_content_table = tracker_fts_has_content_table (db_interface->db);
+	tracker_db_interface_sqlite_fts_set_properties (db_interface, properties);
+
+	if (!create &&
+	    (db_interface->flags & TRACKER_DB_INTERFACE_READONLY) == 0 &&
+	    g_hash_table_size (properties) > 0 &&
+	    !tracker_fts_update_rank_function (db_interface->db, "fts5")) {
+		g_warning ("Could not update the FTS rank function");
+	}
+
+	/* Whoever writes next might not defer indexing, so catch up
+	 * on anything left pending by a previous writer.
+	 */
+	if ((db_interface->flags & TRACKER_DB_INTERFACE_READONLY) == 0 &&
+	    tracker_db_interface_sqlite_fts_create_pending (db_interface)) {
+		GError *error = NULL;
+
+		tracker_db_interface_sqlite_fts_flush_pending (db_interface, G_MAXINT, &error);
+
+		if (error) {
+			g_warning ("Could not index pending FTS text: %s", error->message);
+			g_error_free (error);
+		}
+	}
 #endif
 }
 
@@ -1655,6 +1722,10 @@ tracker_db_interface_sqlite_fts_alter_table (TrackerDBInterface  *db_interface,
 	if (!tracker_fts_alter_table (db_interface->db, "fts5", properties, multivalued)) {
 		g_critical ("Failed to update FTS columns");
 	}
+
+	db_interface->fts_content_table = tracker_fts_has_content_table (db_interface->db);
+	tracker_db_interface_sqlite_fts_set_properties (db_interface, properties);
+	tracker_db_interface_sqlite_fts_create_pending (db_interface);
 }
 
 static gchar *
@@ -1695,13 +1766,117 @@ tracker_db_interface_sqlite_fts_create_delete_all_query (TrackerDBInterface *db_
 	insert_str = g_string_new (NULL);
 	g_string_append_printf (insert_str,
 	                        "INSERT INTO fts5 (fts5, rowid %s) "
-	                        "SELECT 'delete', rowid %s FROM fts_view "
+	                        "SELECT 'delete', rowid %s FROM %s "
 	                        "WHERE rowid = ?",
 	                        db_interface->fts_properties,
-	                        db_interface->fts_properties);
+	                        db_interface->fts_properties,
+	                        db_interface->fts_content_table ?
+	                        "fts_content" : "fts_view");
 	return g_string_free (insert_str, FALSE);
 }
 
+static gboolean
+tracker_db_interface_sqlite_fts_execute_content (TrackerDBInterface  *db_interface,
+                                                 int                  id,
+                                                 const gchar         *query,
+                                                 const gchar        **text)
+{
+	TrackerDBStatement *stmt;
+	GError *error = NULL;
+	gint i = 0;
+
+	stmt = tracker_db_interface_create_statement (db_interface,
+	                                              TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE,
+	                                              &error,
+	                                              "%s", query);
+
+	if (!stmt || error) {
+		g_warning ("Could not create FTS content statement: %s",
+		           error ? error->message : "No error given");
+		g_clear_error (&error);
+		return FALSE;
+	}
+
+	for (i = 0; text && text[i] != NULL; i++) {
+		tracker_db_statement_bind_text (stmt, i, text[i]);
+	}
+
+	tracker_db_statement_bind_int (stmt, i, id);
+	tracker_db_statement_execute (stmt, &error);
+	g_object_unref (stmt);
+
+	if (error) {
+		g_warning ("Could not update FTS content: %s", error->message);
+		g_error_free (error);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Keeps the text of the given properties in the content table, so
+ * snippets and deletions don't need to read the property tables.
+ */
+static gboolean
+tracker_db_interface_sqlite_fts_update_content (TrackerDBInterface  *db_interface,
+                                                int                  id,
+                                                const gchar        **properties,
+                                                const gchar        **text)
+{
+	GString *update_str;
+	gboolean retval;
+	gint i;
+
+	if (!tracker_db_interface_sqlite_fts_execute_content (db_interface, id,
+	                                                      "INSERT OR IGNORE INTO fts_content (ID) VALUES (?)",
+	                                                      NULL)) {
+		return FALSE;
+	}
+
+	update_str = g_string_new ("UPDATE fts_content SET ");
+
+	for (i = 0; properties[i] != NULL; i++) {
+		if (i != 0)
+			g_string_append_c (update_str, ',');
+		g_string_append_printf (update_str, "\"%s\" = ?", properties[i]);
+	}
+
+	g_string_append (update_str, " WHERE ID = ?");
+
+	retval = tracker_db_interface_sqlite_fts_execute_content (db_interface, id,
+	                                                          update_str->str,
+	                                                          text);
+	g_string_free (update_str, TRUE);
+
+	return retval;
+}
+
+static gboolean
+tracker_db_interface_sqlite_fts_mark_pending (TrackerDBInterface *db_interface,
+                                              int                 id)
+{
+	gchar *query;
+	gboolean retval;
+
+	/* Only the first change since the last flush is recorded, the
+	 * index still holds the text as it was back then.
+	 */
+	query = g_strdup_printf ("INSERT OR IGNORE INTO fts_pending (ID %s, \"Indexed\") "
+	                         "SELECT ID %s, 1 FROM fts_content WHERE ID = ?",
+	                         db_interface->fts_properties,
+	                         db_interface->fts_properties);
+	retval = tracker_db_interface_sqlite_fts_execute_content (db_interface, id,
+	                                                          query, NULL);
+	g_free (query);
+
+	if (!retval)
+		return FALSE;
+
+	return tracker_db_interface_sqlite_fts_execute_content (db_interface, id,
+	                                                        "INSERT OR IGNORE INTO fts_pending (ID, \"Indexed\") VALUES (?, 0)",
+	                                                        NULL);
+}
+
 gboolean
 tracker_db_interface_sqlite_fts_update_text (TrackerDBInterface  *db_interface,
                                              int                  id,
@@ -1713,6 +1888,12 @@ tracker_db_interface_sqlite_fts_update_text (TrackerDBInterface  *db_interface,
 	gchar *query;
 	gint i;
 
+	if (db_interface->fts_deferred) {
+		return (tracker_db_interface_sqlite_fts_mark_pending (db_interface, id) &&
+		        tracker_db_interface_sqlite_fts_update_content (db_interface, id,
+		                                                        properties, text));
+	}
+
 	query = tracker_db_interface_sqlite_fts_create_query (db_interface,
 	                                                      FALSE, properties);
 	stmt = tracker_db_interface_create_statement (db_interface,
@@ -1744,6 +1925,11 @@ tracker_db_interface_sqlite_fts_update_text (TrackerDBInterface  *db_interface,
                 return FALSE;
         }
 
+        if (db_interface->fts_content_table) {
+                return tracker_db_interface_sqlite_fts_update_content (db_interface, id,
+                                                                       properties, text);
+        }
+
         return TRUE;
 }
 
@@ -1758,6 +1944,9 @@ tracker_db_interface_sqlite_fts_delete_text (TrackerDBInterface  *db_interface,
 	const gchar *properties[] = { property, NULL };
 	gchar *query;
 
+	if (db_interface->fts_deferred)
+		return tracker_db_interface_sqlite_fts_mark_pending (db_interface, rowid);
+
 	query = tracker_db_interface_sqlite_fts_create_query (db_interface,
 	                                                      TRUE, properties);
 	stmt = tracker_db_interface_create_statement (db_interface,
@@ -1795,6 +1984,13 @@ tracker_db_interface_sqlite_fts_delete_id (TrackerDBInterface *db_interface,
 	GError *error = NULL;
 	gchar *query;
 
+	if (db_interface->fts_deferred) {
+		return (tracker_db_interface_sqlite_fts_mark_pending (db_interface, id) &&
+		        tracker_db_interface_sqlite_fts_execute_content (db_interface, id,
+		                                                         "DELETE FROM fts_content WHERE ID = ?",
+		                                                         NULL));
+	}
+
 	query = tracker_db_interface_sqlite_fts_create_delete_all_query (db_interface);
 	stmt = tracker_db_interface_create_statement (db_interface,
 	                                              TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE,
@@ -1821,6 +2017,12 @@ tracker_db_interface_sqlite_fts_delete_id (TrackerDBInterface *db_interface,
 		return FALSE;
 	}
 
+	if (db_interface->fts_content_table) {
+		return tracker_db_interface_sqlite_fts_execute_content (db_interface, id,
+		                                                        "DELETE FROM fts_content WHERE ID = ?",
+		                                                        NULL);
+	}
+
 	return TRUE;
 }
 
@@ -1830,6 +2032,134 @@ tracker_db_interface_sqlite_fts_rebuild_tokens (TrackerDBInterface *interface)
 	tracker_fts_rebuild_tokens (interface->db, "fts5");
 }
 
+/* Indexes up to @max_resources pending resources in one go, within
+ * a savepoint so it works both inside and outside transactions.
+ * Returns the number of resources that were indexed.
+ */
+gint
+tracker_db_interface_sqlite_fts_flush_pending (TrackerDBInterface  *db_interface,
+                                               gint                 max_resources,
+                                               GError             **error)
+{
+	const gchar *queries[3];
+	gchar *delete_old, *insert_new;
+	GError *inner_error = NULL;
+	gint i, n_flushed = 0;
+
+	if (!db_interface->fts_content_table || !db_interface->fts_properties)
+		return 0;
+
+	/* Stale tokens go first, then the current text is tokenized
+	 * for all resources in the batch at once.
+	 */
+	delete_old = g_strdup_printf ("INSERT INTO fts5 (fts5, rowid %s) "
+	                              "SELECT 'delete', ID %s FROM fts_pending "
+	                              "WHERE \"Indexed\" = 1 AND ID IN "
+	                              "(SELECT ID FROM fts_pending ORDER BY ID LIMIT ?)",
+	                              db_interface->fts_properties,
+	                              db_interface->fts_properties);
+	insert_new = g_strdup_printf ("INSERT INTO fts5 (rowid %s) "
+	                              "SELECT ID %s FROM fts_content WHERE ID IN "
+	                              "(SELECT ID FROM fts_pending ORDER BY ID LIMIT ?)",
+	                              db_interface->fts_properties,
+	                              db_interface->fts_properties);
+	queries[0] = delete_old;
+	queries[1] = insert_new;
+	queries[2] = "DELETE FROM fts_pending WHERE ID IN "
+	             "(SELECT ID FROM fts_pending ORDER BY ID LIMIT ?)";
+
+	tracker_db_interface_execute_query (db_interface, &inner_error,
+	                                    "SAVEPOINT fts_flush");
+
+	for (i = 0; i < G_N_ELEMENTS (queries) && !inner_error; i++) {
+		TrackerDBStatement *stmt;
+
+		stmt = tracker_db_interface_create_statement (db_interface,
+		                                              TRACKER_DB_STATEMENT_CACHE_TYPE_UPDATE,
+		                                              &inner_error,
+		                                              "%s", queries[i]);
+		if (!stmt)
+			break;
+
+		tracker_db_statement_bind_int (stmt, 0, max_resources);
+		tracker_db_statement_execute (stmt, &inner_error);
+		g_object_unref (stmt);
+	}
+
+	if (!inner_error) {
+		n_flushed = sqlite3_changes (db_interface->db);
+	} else {
+		tracker_db_interface_execute_query (db_interface, NULL,
+		                                    "ROLLBACK TO fts_flush");
+	}
+
+	tracker_db_interface_execute_query (db_interface, NULL,
+	                                    "RELEASE fts_flush");
+	g_free (delete_old);
+	g_free (insert_new);
+
+	if (inner_error) {
+		g_propagate_error (error, inner_error);
+		return 0;
+	}
+
+	return n_flushed;
+}
+
+/* With deferred indexing, updates only change the content table and
+ * record the resource as pending, tokenizing is left for
+ * tracker_db_interface_sqlite_fts_flush_pending().
+ */
+void
+tracker_db_interface_sqlite_fts_set_deferred (TrackerDBInterface *db_interface,
+                                              gboolean            deferred)
+{
+	if (deferred == db_interface->fts_deferred)
+		return;
+
+	/* Needs the content table, older databases stay synchronous */
+	if (deferred && !tracker_db_interface_sqlite_fts_create_pending (db_interface))
+		return;
+
+	if (!deferred) {
+		GError *error = NULL;
+
+		tracker_db_interface_sqlite_fts_flush_pending (db_interface, G_MAXINT, &error);
+
+		if (error) {
+			g_warning ("Could not index pending FTS text: %s", error->message);
+			g_error_free (error);
+		}
+	}
+
+	/* Batches are large enough already, so merge less eagerly */
+	if (deferred) {
+		tracker_fts_set_merge_config (db_interface->db, "fts5",
+		                              FTS_DEFERRED_AUTOMERGE,
+		                              FTS_DEFERRED_CRISISMERGE);
+	} else {
+		tracker_fts_set_merge_config (db_interface->db, "fts5",
+		                              FTS_DEFAULT_AUTOMERGE,
+		                              FTS_DEFAULT_CRISISMERGE);
+	}
+
+	db_interface->fts_deferred = deferred;
+}
+
+gboolean
+tracker_db_interface_sqlite_fts_get_deferred (TrackerDBInterface *db_interface)
+{
+	return db_interface->fts_deferred;
+}
+
+/* Does a bounded amount of merge work, meant for idle times */
+void
+tracker_db_interface_sqlite_fts_merge (TrackerDBInterface *db_interface,
+                                       gint                n_pages)
+{
+	tracker_fts_merge (db_interface->db, "fts5", n_pages);
+}
+
 #endif
 
 void
@@ -2029,6 +2359,9 @@ tracker_db_interface_lru_lookup (TrackerDBInterface          *db_interface,
 	 * c) Forced Non-Cached: in case of a stmt being already in use, we can't
 	 *    reuse it (you can't use two different loops on a sqlite3_stmt, of
 	 *    course). This happens with recursive uses of a cursor, for example.
+	 *    A stmt is also in use while someone other than the LRU holds a
+	 *    reference, e.g. another thread sharing this interface may be
+	 *    binding values to it before starting its cursor.
 	 */
 
 	stmt = g_hash_table_lookup (db_interface->dynamic_statements,
@@ -2040,7 +2373,8 @@ tracker_db_interface_lru_lookup (TrackerDBInterface          *db_interface,
 
 	/* a) Cached */
 
-	if (stmt && stmt->stmt_is_used) {
+	if (stmt->stmt_is_used ||
+	    g_atomic_int_get (&G_OBJECT (stmt)->ref_count) > 1) {
 		/* c) Forced non-cached
 		 * prepared statement is still in use, create new uncached one
 		 */
@@ -2210,9 +2544,14 @@ tracker_db_interface_create_statement (TrackerDBInterface           *db_interfac
 
 	g_free (full_query);
 
+	/* Take the reference with the lock held, so other threads
+	 * see the stmt in use from now on.
+	 */
+	g_object_ref_sink (stmt);
+
 	tracker_db_interface_unlock (db_interface);
 
-	return g_object_ref_sink (stmt);
+	return stmt;
 }
 
 static void
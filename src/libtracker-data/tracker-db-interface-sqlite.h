@@ -78,6 +78,15 @@ void                tracker_db_interface_sqlite_fts_update_rollback    (TrackerD
 
 void                tracker_db_interface_sqlite_fts_rebuild_tokens     (TrackerDBInterface       *interface);
 
+void                tracker_db_interface_sqlite_fts_set_deferred       (TrackerDBInterface       *interface,
+                                                                        gboolean                  deferred);
+gboolean            tracker_db_interface_sqlite_fts_get_deferred       (TrackerDBInterface       *interface);
+gint                tracker_db_interface_sqlite_fts_flush_pending      (TrackerDBInterface       *interface,
+                                                                        gint                      max_resources,
+                                                                        GError                  **error);
+void                tracker_db_interface_sqlite_fts_merge              (TrackerDBInterface       *interface,
+                                                                        gint                      n_pages);
+
 #endif
 
 G_END_DECLS
@@ -676,6 +676,13 @@ tracker_db_journal_get_size (TrackerDBJournal *writer)
 	return writer->cur_size;
 }
 
+/* Number of the last chunk rotated by this writer, 0 if none was */
+gint
+tracker_db_journal_get_chunk (TrackerDBJournal *writer)
+{
+	return writer->cur_journal_file;
+}
+
 gboolean
 tracker_db_journal_start_transaction (TrackerDBJournal *jwriter,
                                       time_t            time)
@@ -1235,6 +1242,7 @@ static gboolean
 db_journal_reader_init (TrackerDBJournalReader  *jreader,
                         gboolean                 global_reader,
                         const gchar             *filename,
+                        guint                    skip_chunks,
                         GFile                   *data_location,
                         GError                 **error)
 {
@@ -1246,7 +1254,7 @@ db_journal_reader_init (TrackerDBJournalReader  *jreader,
 	jreader->filename = g_strdup (filename);
 	g_set_object (&jreader->journal_location, data_location);
 
-	jreader->current_file = 0;
+	jreader->current_file = skip_chunks;
 	if (global_reader) {
 		filename_open = reader_get_next_filepath (jreader);
 	} else {
@@ -1294,7 +1302,39 @@ tracker_db_journal_reader_new (GFile   *data_location,
 
 	reader = g_new0 (TrackerDBJournalReader, 1);
 
-	if (!db_journal_reader_init (reader, TRUE, filename, data_location, &n_error)) {
+	if (!db_journal_reader_init (reader, TRUE, filename, 0, data_location, &n_error)) {
+		if (n_error)
+			g_propagate_error (error, n_error);
+		g_clear_pointer (&reader, g_free);
+	}
+
+	g_free (filename);
+
+	return reader;
+}
+
+/* Reads the journal starting at the given rotated chunk, or at the
+ * active journal file if that chunk wasn't rotated yet.
+ */
+TrackerDBJournalReader  *
+tracker_db_journal_reader_new_from_chunk (GFile   *data_location,
+                                          gint     chunk,
+                                          GError **error)
+{
+	TrackerDBJournalReader *reader;
+	GError *n_error = NULL;
+	gchar *filename;
+	GFile *child;
+
+	g_return_val_if_fail (chunk > 0, NULL);
+
+	child = g_file_get_child (data_location, TRACKER_DB_JOURNAL_FILENAME);
+	filename = g_file_get_path (child);
+	g_object_unref (child);
+
+	reader = g_new0 (TrackerDBJournalReader, 1);
+
+	if (!db_journal_reader_init (reader, TRUE, filename, chunk - 1, data_location, &n_error)) {
 		if (n_error)
 			g_propagate_error (error, n_error);
 		g_clear_pointer (&reader, g_free);
@@ -1320,7 +1360,7 @@ tracker_db_journal_reader_ontology_new (GFile   *data_location,
 
 	reader = g_new0 (TrackerDBJournalReader, 1);
 
-	if (!db_journal_reader_init (reader, TRUE, filename, data_location, &n_error)) {
+	if (!db_journal_reader_init (reader, TRUE, filename, 0, data_location, &n_error)) {
 		g_propagate_error (error, n_error);
 		g_clear_pointer (&reader, g_free);
 	}
@@ -1764,7 +1804,7 @@ tracker_db_journal_reader_verify_last (GFile   *data_location,
 	filename = g_file_get_path (child);
 	g_object_unref (child);
 
-	if (db_journal_reader_init (&jreader, FALSE, filename, data_location, &n_error)) {
+	if (db_journal_reader_init (&jreader, FALSE, filename, 0, data_location, &n_error)) {
 
 		if (jreader.end != jreader.current) {
 			entry_size_check = read_uint32 (jreader.end - 4);
@@ -2153,6 +2193,147 @@ tracker_db_journal_remove (TrackerDBJournal *writer)
 	g_free (path);
 }
 
+/* Returns the chunk number in a rotated chunk or snapshot file name,
+ * 0 for anything else. */
+static gint
+journal_chunk_from_name (const gchar  *name,
+                         const gchar **suffix)
+{
+	const gchar *ptr;
+	gchar *end;
+	gint64 chunk;
+
+	if (!g_str_has_prefix (name, TRACKER_DB_JOURNAL_FILENAME ".")) {
+		return 0;
+	}
+
+	ptr = name + strlen (TRACKER_DB_JOURNAL_FILENAME ".");
+
+	if (!g_ascii_isdigit (*ptr)) {
+		return 0;
+	}
+
+	chunk = g_ascii_strtoll (ptr, &end, 10);
+
+	if (chunk <= 0 || chunk > G_MAXINT) {
+		return 0;
+	}
+
+	*suffix = end;
+
+	return (gint) chunk;
+}
+
+/* Snapshots are named after the last journal chunk they contain, so the
+ * rotated chunk numbering keeps increasing when every older chunk got
+ * pruned, and removing the journal removes them too.
+ */
+GFile *
+tracker_db_journal_get_snapshot_file (GFile *data_location,
+                                      gint   chunk)
+{
+	GFile *file;
+	gchar *name;
+
+	name = g_strdup_printf (TRACKER_DB_JOURNAL_FILENAME ".%d" TRACKER_DB_JOURNAL_SNAPSHOT_SUFFIX,
+	                        chunk);
+	file = g_file_get_child (data_location, name);
+	g_free (name);
+
+	return file;
+}
+
+GFile *
+tracker_db_journal_find_snapshot (GFile *data_location,
+                                  gint  *chunk)
+{
+	GDir *journal_dir;
+	const gchar *f;
+	gchar *directory;
+	gint last = 0;
+
+	directory = g_file_get_path (data_location);
+	journal_dir = g_dir_open (directory, 0, NULL);
+	g_free (directory);
+
+	if (!journal_dir) {
+		return NULL;
+	}
+
+	while ((f = g_dir_read_name (journal_dir)) != NULL) {
+		const gchar *suffix;
+		gint cur;
+
+		cur = journal_chunk_from_name (f, &suffix);
+
+		if (cur > last && strcmp (suffix, TRACKER_DB_JOURNAL_SNAPSHOT_SUFFIX) == 0) {
+			last = cur;
+		}
+	}
+
+	g_dir_close (journal_dir);
+
+	if (last == 0) {
+		return NULL;
+	}
+
+	if (chunk) {
+		*chunk = last;
+	}
+
+	return tracker_db_journal_get_snapshot_file (data_location, last);
+}
+
+/* Removes the rotated chunks and snapshots older than the given chunk,
+ * everything up to that chunk must be contained in a snapshot.
+ */
+void
+tracker_db_journal_prune (GFile *data_location,
+                          gint   chunk)
+{
+	const gchar *dirs[3] = { NULL, NULL, NULL };
+	gchar *directory;
+	guint i;
+
+	directory = g_file_get_path (data_location);
+
+	dirs[0] = directory;
+	dirs[1] = rotating_settings.do_rotating ? rotating_settings.rotate_to : NULL;
+
+	for (i = 0; dirs[i] != NULL; i++) {
+		GDir *journal_dir;
+		const gchar *f;
+
+		journal_dir = g_dir_open (dirs[i], 0, NULL);
+		if (!journal_dir) {
+			continue;
+		}
+
+		while ((f = g_dir_read_name (journal_dir)) != NULL) {
+			const gchar *suffix;
+			gchar *fullpath;
+			gint cur;
+
+			cur = journal_chunk_from_name (f, &suffix);
+
+			if (cur == 0 || cur >= chunk) {
+				continue;
+			}
+
+			fullpath = g_build_filename (dirs[i], f, NULL);
+			g_info ("  Pruning journal chunk:'%s'", fullpath);
+			if (g_unlink (fullpath) == -1) {
+				g_info ("Could not unlink rotated journal: %m");
+			}
+			g_free (fullpath);
+		}
+
+		g_dir_close (journal_dir);
+	}
+
+	g_free (directory);
+}
+
 #else /* DISABLE_JOURNAL */
 void
 tracker_db_journal_set_rotating (gboolean     do_rotating,
@@ -31,6 +31,7 @@ G_BEGIN_DECLS
 #define TRACKER_DB_JOURNAL_ERROR              tracker_db_journal_error_quark()
 #define TRACKER_DB_JOURNAL_FILENAME          "tracker-store.journal"
 #define TRACKER_DB_JOURNAL_ONTOLOGY_FILENAME "tracker-store.ontology.journal"
+#define TRACKER_DB_JOURNAL_SNAPSHOT_SUFFIX   ".snapshot"
 
 enum {
 	TRACKER_DB_JOURNAL_ERROR_UNKNOWN = 0,
@@ -73,6 +74,7 @@ gboolean     tracker_db_journal_free                         (TrackerDBJournal
                                                               GError           **error);
 
 gsize        tracker_db_journal_get_size                     (TrackerDBJournal  *writer);
+gint         tracker_db_journal_get_chunk                    (TrackerDBJournal  *writer);
 
 void         tracker_db_journal_set_rotating                 (gboolean     do_rotating,
                                                               gsize        chunk_size,
@@ -129,12 +131,26 @@ gboolean     tracker_db_journal_truncate                     (TrackerDBJournal
 
 void         tracker_db_journal_remove                       (TrackerDBJournal *writer);
 
+/*
+ * Snapshot API
+ */
+GFile *      tracker_db_journal_get_snapshot_file            (GFile         *data_location,
+                                                              gint           chunk);
+GFile *      tracker_db_journal_find_snapshot                (GFile         *data_location,
+                                                              gint          *chunk);
+void         tracker_db_journal_prune                        (GFile         *data_location,
+                                                              gint           chunk);
+
 /*
  * Reader API
  */
 TrackerDBJournalReader *
              tracker_db_journal_reader_new                   (GFile         *data_location,
                                                               GError       **error);
+TrackerDBJournalReader *
+             tracker_db_journal_reader_new_from_chunk        (GFile         *data_location,
+                                                              gint           chunk,
+                                                              GError       **error);
 TrackerDBJournalReader *
              tracker_db_journal_reader_ontology_new          (GFile         *data_location,
                                                               GError       **error);
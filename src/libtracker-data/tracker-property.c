@@ -74,6 +74,9 @@ struct _TrackerPropertyPrivate {
 	gboolean       cardinality_changed;
 	gboolean       orig_multiple_values;
 
+	/* TrackerDBStatement, see TrackerPropertyStatement */
+	GObject       *statements[TRACKER_PROPERTY_N_STATEMENTS];
+
 	TrackerOntologies *ontologies;
 };
 
@@ -163,6 +166,8 @@ property_finalize (GObject *object)
 	g_free (priv->name);
 	g_free (priv->table_name);
 
+	tracker_property_clear_statements (TRACKER_PROPERTY (object));
+
 	if (priv->is_new_domain_index) {
 		g_ptr_array_unref (priv->is_new_domain_index);
 	}
@@ -1050,6 +1055,9 @@ tracker_property_set_multiple_values (TrackerProperty *property,
 	priv = GET_PRIV (property);
 
 	priv->multiple_values = value;
+
+	/* the values move to a different table */
+	tracker_property_clear_statements (property);
 }
 
 void
@@ -1167,3 +1175,49 @@ tracker_property_set_ontologies (TrackerProperty   *property,
 
 	priv->ontologies = ontologies;
 }
+
+struct TrackerDBStatement *
+tracker_property_get_statement (TrackerProperty          *property,
+                                TrackerPropertyStatement  kind)
+{
+	TrackerPropertyPrivate *priv;
+
+	g_return_val_if_fail (TRACKER_IS_PROPERTY (property), NULL);
+	g_return_val_if_fail (kind < TRACKER_PROPERTY_N_STATEMENTS, NULL);
+
+	priv = GET_PRIV (property);
+
+	return (struct TrackerDBStatement *) priv->statements[kind];
+}
+
+void
+tracker_property_set_statement (TrackerProperty           *property,
+                                TrackerPropertyStatement   kind,
+                                struct TrackerDBStatement *stmt)
+{
+	TrackerPropertyPrivate *priv;
+
+	g_return_if_fail (TRACKER_IS_PROPERTY (property));
+	g_return_if_fail (kind < TRACKER_PROPERTY_N_STATEMENTS);
+
+	priv = GET_PRIV (property);
+
+	g_set_object (&priv->statements[kind], (GObject *) stmt);
+}
+
+/* Statements must be dropped before the connection they were
+ * prepared on is closed, or whenever the table changes */
+void
+tracker_property_clear_statements (TrackerProperty *property)
+{
+	TrackerPropertyPrivate *priv;
+	gint i;
+
+	g_return_if_fail (TRACKER_IS_PROPERTY (property));
+
+	priv = GET_PRIV (property);
+
+	for (i = 0; i < TRACKER_PROPERTY_N_STATEMENTS; i++) {
+		g_clear_object (&priv->statements[i]);
+	}
+}
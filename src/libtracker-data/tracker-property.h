@@ -48,6 +48,17 @@ typedef enum {
 
 GType        tracker_property_type_get_type  (void) G_GNUC_CONST;
 
+/*
+ * Write statements on the table of a multiple valued property, kept
+ * on the property so they are prepared once per connection
+ */
+typedef enum {
+	TRACKER_PROPERTY_STATEMENT_INSERT,
+	TRACKER_PROPERTY_STATEMENT_INSERT_BATCH,
+	TRACKER_PROPERTY_STATEMENT_DELETE,
+	TRACKER_PROPERTY_N_STATEMENTS
+} TrackerPropertyStatement;
+
 /*
  * TrackerProperty
  */
@@ -162,6 +173,14 @@ void                tracker_property_reset_super_properties  (TrackerProperty
 void                tracker_property_set_ontologies          (TrackerProperty      *property,
                                                               TrackerOntologies    *ontologies);
 
+struct TrackerDBStatement *
+                    tracker_property_get_statement           (TrackerProperty      *property,
+                                                              TrackerPropertyStatement kind);
+void                tracker_property_set_statement           (TrackerProperty      *property,
+                                                              TrackerPropertyStatement kind,
+                                                              struct TrackerDBStatement *stmt);
+void                tracker_property_clear_statements        (TrackerProperty      *property);
+
 G_END_DECLS
 
 #endif /* __LIBTRACKER_DATA_PROPERTY_H__ */
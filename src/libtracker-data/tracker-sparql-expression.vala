@@ -1146,6 +1146,20 @@ class Tracker.Sparql.Expression : Object {
 			}
 
 			return PropertyType.INTEGER;
+		case SparqlTokenType.PARAMETERIZED_VAR:
+			next ();
+
+			// always bound, even in no_cache mode, the value is
+			// only known when the statement is executed
+			sql.append ("?");
+
+			var binding = new LiteralBinding ();
+			binding.parameter = get_last_string ().substring (1);
+			query.bindings.append (binding);
+
+			append_collate (sql);
+			// the type is taken from the other operand in comparisons
+			return PropertyType.UNKNOWN;
 		case SparqlTokenType.VAR:
 			next ();
 			string variable_name = get_last_string ().substring (1);
@@ -1540,11 +1554,30 @@ class Tracker.Sparql.Expression : Object {
 		return translate_additive_expression (sql);
 	}
 
+	// A ~parameter making up a whole operand takes the type of the other
+	// operand, so a string value is converted the same way as a literal
+	// in its place, e.g. to a timestamp when compared to a xsd:dateTime
+	void infer_parameter_type (uint first, uint last, PropertyType optype, PropertyType other_type) {
+		if (last != first + 1 || optype != PropertyType.UNKNOWN || other_type == PropertyType.UNKNOWN) {
+			return;
+		}
+
+		var binding = query.bindings.nth_data (first);
+		if (binding.parameter != null && binding.data_type == PropertyType.UNKNOWN) {
+			binding.data_type = other_type;
+		}
+	}
+
 	PropertyType process_relational_expression (StringBuilder sql, long begin, uint n_bindings, PropertyType op1type, string operator) throws Sparql.Error {
+		// TODO: improve performance (linked list)
+		uint n_op1_bindings = query.bindings.length ();
 		sql.insert (begin, "(");
 		sql.append (operator);
 		var op2type = translate_numeric_expression (sql);
 		sql.append (")");
+		uint n_op2_bindings = query.bindings.length ();
+		infer_parameter_type (n_bindings, n_op1_bindings, op1type, op2type);
+		infer_parameter_type (n_op1_bindings, n_op2_bindings, op2type, op1type);
 		if ((op1type == PropertyType.DATETIME && op2type == PropertyType.STRING)
 		    || (op1type == PropertyType.STRING && op2type == PropertyType.DATETIME)) {
 			// TODO: improve performance (linked list)
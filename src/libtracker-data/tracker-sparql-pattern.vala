@@ -40,6 +40,9 @@ namespace Tracker.Sparql {
 
 				if (subject != null) {
 					// single subject
+					// the generated SQL depends on the stored types of the subject
+					query.cacheable = false;
+
 					var subject_id = Tracker.Data.query_resource_id (manager, iface, subject);
 
 					DBCursor cursor = null;
@@ -90,6 +93,9 @@ namespace Tracker.Sparql {
 					}
 				} else if (object != null) {
 					// single object
+					// the generated SQL depends on the stored types of the object
+					query.cacheable = false;
+
 					var object_id = Data.query_resource_id (manager, iface, object);
 
 					var stmt = iface.create_statement (DBStatementCacheType.SELECT,
@@ -179,6 +185,8 @@ class Tracker.Sparql.Pattern : Object {
 	public string[] fts_variables;
 	internal StringBuilder? match_str;
 	public bool queries_fts_data = false;
+	// variable ranked in a ORDER BY DESC(fts:rank(?var)) LIMIT n query
+	string? fts_top_k_variable;
 
 	Data.Manager manager;
 
@@ -254,6 +262,50 @@ class Tracker.Sparql.Pattern : Object {
 
 	TripleContext? triple_context;
 
+	string? parse_fts_top_k_variable () throws Sparql.Error {
+		string uri;
+
+		// only called ahead of the WHERE pattern, no SQL is generated
+		var location = get_location ();
+		query.skip_braces ();
+
+		if (!accept (SparqlTokenType.ORDER) ||
+		    !accept (SparqlTokenType.BY) ||
+		    !accept (SparqlTokenType.DESC) ||
+		    !accept (SparqlTokenType.OPEN_PARENS)) {
+			set_location (location);
+			return null;
+		}
+
+		if (accept (SparqlTokenType.IRI_REF)) {
+			uri = get_last_string (1);
+		} else if (accept (SparqlTokenType.PN_PREFIX)) {
+			string ns = get_last_string ();
+			expect (SparqlTokenType.COLON);
+			uri = query.resolve_prefixed_name (ns, get_last_string ().substring (1));
+		} else {
+			set_location (location);
+			return null;
+		}
+
+		string? variable = null;
+
+		if (uri == "http://www.tracker-project.org/ontologies/fts#rank" &&
+		    accept (SparqlTokenType.OPEN_PARENS) &&
+		    accept (SparqlTokenType.VAR)) {
+			variable = get_last_string ().substring (1);
+
+			if (!accept (SparqlTokenType.CLOSE_PARENS) ||
+			    !accept (SparqlTokenType.CLOSE_PARENS) ||
+			    current () != SparqlTokenType.LIMIT) {
+				variable = null;
+			}
+		}
+
+		set_location (location);
+		return variable;
+	}
+
 	internal SelectContext translate_select (StringBuilder sql, bool subquery = false, bool scalar_subquery = false) throws Sparql.Error {
 		SelectContext result;
 
@@ -288,11 +340,16 @@ class Tracker.Sparql.Pattern : Object {
 
 		optional (SparqlTokenType.WHERE);
 
+		var old_fts_top_k_variable = fts_top_k_variable;
+		fts_top_k_variable = parse_fts_top_k_variable ();
+
 		var pattern = translate_group_graph_pattern (pattern_sql);
 		foreach (var key in pattern.var_set.get_keys ()) {
 			context.var_set.insert (key, VariableState.BOUND);
 		}
 
+		fts_top_k_variable = old_fts_top_k_variable;
+
 		// process select variables
 		var after_where = get_location ();
 		set_location (select_variables_location);
@@ -696,10 +753,34 @@ class Tracker.Sparql.Pattern : Object {
 		sql.truncate (sql.len - 2);
 
 		sql.append (" FROM ");
-		bool first = true;
+
+		// In top-K queries, have the FTS table drive the join so FTS5
+		// returns matches already sorted by rank and SQLite can stop
+		// as soon as the LIMIT is reached
+		DataTable? fts_table = null;
+		if (fts_top_k_variable != null && fts_subject != null &&
+		    fts_subject.name == fts_top_k_variable) {
+			foreach (DataTable table in triple_context.tables) {
+				if (table.sql_db_tablename == "fts5") {
+					fts_table = table;
+					break;
+				}
+			}
+		}
+
+		var tables = new List<DataTable> ();
 		foreach (DataTable table in triple_context.tables) {
+			if (table == fts_table) {
+				tables.prepend (table);
+			} else {
+				tables.append (table);
+			}
+		}
+
+		bool first = true;
+		foreach (DataTable table in tables) {
 			if (!first) {
-				sql.append (", ");
+				sql.append (fts_table != null ? " CROSS JOIN " : ", ");
 			} else {
 				first = false;
 			}
@@ -1350,8 +1431,17 @@ class Tracker.Sparql.Pattern : Object {
 	void parse_object (StringBuilder sql, bool in_simple_optional = false) throws Sparql.Error {
 		long begin_sql_len = sql.len;
 
-		bool object_is_var;
-		string object = parse_var_or_term (sql, out object_is_var);
+		bool object_is_var = false;
+		bool object_is_parameter = false;
+		string object;
+
+		if (accept (SparqlTokenType.PARAMETERIZED_VAR)) {
+			// value is bound when the statement is executed
+			object_is_parameter = true;
+			object = get_last_string ().substring (1);
+		} else {
+			object = parse_var_or_term (sql, out object_is_var);
+		}
 
 		string db_table = null;
 		bool rdftype = false;
@@ -1370,7 +1460,7 @@ class Tracker.Sparql.Pattern : Object {
 			prop = ontologies.get_property_by_uri (current_predicate);
 
 			if (current_predicate == "http://www.w3.org/1999/02/22-rdf-syntax-ns#type"
-			    && !object_is_var && current_graph == null) {
+			    && !object_is_var && !object_is_parameter && current_graph == null) {
 				// rdf:type query
 				// avoid special casing if GRAPH is used as graph matching is not supported when using class tables
 				rdftype = true;
@@ -1383,6 +1473,10 @@ class Tracker.Sparql.Pattern : Object {
 			} else if (prop == null) {
 				if (current_predicate == "http://www.tracker-project.org/ontologies/fts#match") {
 					// fts:match
+					if (object_is_parameter) {
+						// the match expression is inlined in the SQL
+						throw get_error ("parameters are not supported with fts:match");
+					}
 					db_table = "fts5";
 					share_table = false;
 					is_fts_match = true;
@@ -1393,7 +1487,8 @@ class Tracker.Sparql.Pattern : Object {
 			} else {
 				if (current_predicate == "http://www.w3.org/2000/01/rdf-schema#domain"
 				    && current_subject_is_var
-				    && !object_is_var) {
+				    && !object_is_var
+				    && !object_is_parameter) {
 					// rdfs:domain
 					var domain = ontologies.get_class_by_uri (object);
 					if (domain == null) {
@@ -1472,6 +1567,9 @@ class Tracker.Sparql.Pattern : Object {
 			table = get_table (current_subject, db_table, share_table, out newtable);
 		} else {
 			// variable in predicate
+			if (object_is_parameter) {
+				throw get_error ("parameters are not supported with variable predicates");
+			}
 			newtable = true;
 			table = new DataTable ();
 			table.predicate_variable = context.predicate_variable_map.lookup (context.get_variable (current_predicate));
@@ -1576,7 +1674,11 @@ class Tracker.Sparql.Pattern : Object {
 				                   context.get_variable (current_subject).name);
 			} else {
 				var binding = new LiteralBinding ();
-				binding.literal = object;
+				if (object_is_parameter) {
+					binding.parameter = object;
+				} else {
+					binding.literal = object;
+				}
 				// binding.data_type = triple.object.type;
 				binding.table = table;
 				if (prop != null) {
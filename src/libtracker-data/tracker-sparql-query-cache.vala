@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2017, Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+namespace Tracker.Sparql {
+	// Result of translating a SELECT or ASK query, everything that is
+	// needed to execute it again without scanning and translating
+	class QueryPlan : Object {
+		public string sql;
+		public bool no_cache;
+		// Literals to bind, in statement parameter order
+		public PropertyType[] literal_types;
+		public string[] literals;
+		// Name of the ~parameter bound at each position, null for
+		// literals taken from the query itself
+		public string?[] parameters;
+		// Result columns
+		public PropertyType[] types;
+		public string[] variable_names;
+	}
+}
+
+// Maps SPARQL query strings to their translated plans, one per Data.Manager.
+// The cache is dropped as a whole whenever the ontology changes.
+public class Tracker.Sparql.QueryCache : Object {
+	HashTable<string,QueryPlan> plans;
+	// Insertion order, oldest first, used for eviction
+	Queue<string> order;
+	Mutex mutex = Mutex ();
+
+	// Ontologies the cached plans were translated against
+	unowned Ontologies? ontologies;
+
+	public uint max_entries { get; construct; }
+
+	uint _hits;
+	uint _misses;
+
+	public uint hits {
+		get { return AtomicUint.get (ref _hits); }
+	}
+
+	public uint misses {
+		get { return AtomicUint.get (ref _misses); }
+	}
+
+	public uint size {
+		get {
+			mutex.lock ();
+			uint result = plans.size ();
+			mutex.unlock ();
+			return result;
+		}
+	}
+
+	public QueryCache (uint max_entries) {
+		Object (max_entries: max_entries);
+	}
+
+	construct {
+		plans = new HashTable<string,QueryPlan>.full (str_hash, str_equal, g_free, g_object_unref);
+		order = new Queue<string> ();
+	}
+
+	void clear_unlocked () {
+		plans.remove_all ();
+		order.clear ();
+	}
+
+	internal QueryPlan? lookup (Ontologies ontologies, string query) {
+		QueryPlan? plan = null;
+
+		mutex.lock ();
+		if (this.ontologies != ontologies) {
+			clear_unlocked ();
+			this.ontologies = ontologies;
+		} else {
+			plan = plans.lookup (query);
+		}
+		mutex.unlock ();
+
+		if (plan != null) {
+			AtomicUint.inc (ref _hits);
+		} else {
+			AtomicUint.inc (ref _misses);
+		}
+
+		return plan;
+	}
+
+	internal void insert (Ontologies ontologies, string query, QueryPlan plan) {
+		if (max_entries == 0) {
+			return;
+		}
+
+		mutex.lock ();
+		if (this.ontologies != ontologies) {
+			clear_unlocked ();
+			this.ontologies = ontologies;
+		}
+
+		// Another thread may have translated the same query meanwhile
+		if (!plans.contains (query)) {
+			while (order.length >= max_entries) {
+				plans.remove (order.pop_head ());
+			}
+
+			plans.insert (query, plan);
+			order.push_tail (query);
+		}
+		mutex.unlock ();
+	}
+
+	public void clear () {
+		mutex.lock ();
+		clear_unlocked ();
+		this.ontologies = null;
+		mutex.unlock ();
+	}
+}
@@ -62,6 +62,8 @@ namespace Tracker.Sparql {
 	class LiteralBinding : DataBinding {
 		public bool is_fts_match;
 		public string literal;
+		// Name of the ~parameter providing the value, if any
+		public string? parameter;
 	}
 
 	// Represents a mapping of a SPARQL variable to a SQL table and column
@@ -249,6 +251,13 @@ public class Tracker.Sparql.Query : Object {
 
 	public bool no_cache { get; set; }
 
+	// Whether the translated SQL depends only on the query text and
+	// the ontology, and thus may be reused through the QueryCache
+	internal bool cacheable = true;
+
+	// Set by prepare ()
+	QueryPlan? plan;
+
 	public Query (Data.Manager manager, string query) {
 		no_cache = false; /* Start with false, expression sets it */
 		tokens = new TokenInfo[BUFFER_SIZE];
@@ -427,19 +436,27 @@ public class Tracker.Sparql.Query : Object {
 	}
 
 
-	public DBCursor? execute_cursor () throws DBInterfaceError, Sparql.Error, DateError {
+	QueryPlan translate () throws DBInterfaceError, Sparql.Error, DateError {
+		var result = new QueryPlan ();
 
 		prepare_execute ();
 
 		switch (current ()) {
 		case SparqlTokenType.SELECT:
-			return execute_select_cursor ();
+			SelectContext context;
+			result.sql = get_select_query (out context);
+			result.types = context.types;
+			result.variable_names = context.variable_names;
+			break;
 		case SparqlTokenType.CONSTRUCT:
 			throw get_internal_error ("CONSTRUCT is not supported");
 		case SparqlTokenType.DESCRIBE:
 			throw get_internal_error ("DESCRIBE is not supported");
 		case SparqlTokenType.ASK:
-			return execute_ask_cursor ();
+			result.sql = get_ask_query ();
+			result.types = new PropertyType[] { PropertyType.BOOLEAN };
+			result.variable_names = new string[] { "result" };
+			break;
 		case SparqlTokenType.INSERT:
 		case SparqlTokenType.DELETE:
 		case SparqlTokenType.DROP:
@@ -447,6 +464,85 @@ public class Tracker.Sparql.Query : Object {
 		default:
 			throw get_error ("expected SELECT or ASK");
 		}
+
+		result.no_cache = no_cache;
+
+		PropertyType[] literal_types = {};
+		string[] literals = {};
+		string?[] parameters = {};
+		foreach (LiteralBinding binding in bindings) {
+			literal_types += binding.data_type;
+			literals += binding.literal;
+			parameters += binding.parameter;
+		}
+		result.literal_types = literal_types;
+		result.literals = literals;
+		result.parameters = parameters;
+
+		return result;
+	}
+
+	// Translates the query, or picks up an earlier translation from the
+	// QueryCache. Later executions of this object reuse the plan.
+	public void prepare () throws DBInterfaceError, Sparql.Error, DateError {
+		if (plan != null) {
+			return;
+		}
+
+		var cache = manager.get_query_cache ();
+		var ontologies = manager.get_ontologies ();
+
+		plan = cache.lookup (ontologies, query_string);
+
+		if (plan == null) {
+			plan = translate ();
+
+			if (cacheable) {
+				cache.insert (ontologies, query_string, plan);
+			}
+		}
+	}
+
+	// Returns the SQL the query translates to, with its literals and
+	// ~parameters left as statement parameters.
+	public string get_sql () throws DBInterfaceError, Sparql.Error, DateError {
+		prepare ();
+
+		return plan.sql;
+	}
+
+	public DBCursor? execute_cursor () throws DBInterfaceError, Sparql.Error, DateError {
+		return execute_cursor_with_parameters (null);
+	}
+
+	// Executes the query with the values of its ~parameters taken from
+	// @parameters, supported value types are int64, double, boolean and
+	// string. The translated plan and the prepared SQLite statement are
+	// shared by all executions of the same query string.
+	public DBCursor? execute_cursor_with_parameters (HashTable<string,Variant>? parameters) throws DBInterfaceError, Sparql.Error, DateError {
+		prepare ();
+
+		var iface = manager.get_db_interface ();
+		var stmt = iface.create_statement (plan.no_cache ? DBStatementCacheType.NONE : DBStatementCacheType.SELECT, "%s", plan.sql);
+
+		for (int i = 0; i < plan.literals.length; i++) {
+			if (plan.parameters[i] == null) {
+				bind_literal (stmt, i, plan.literal_types[i], plan.literals[i]);
+				continue;
+			}
+
+			Variant? value = null;
+			if (parameters != null) {
+				value = parameters.lookup (plan.parameters[i]);
+			}
+			if (value == null) {
+				throw new Sparql.Error.TYPE ("Parameter `%s' has no bound value".printf (plan.parameters[i]));
+			}
+
+			bind_parameter (stmt, i, plan.literal_types[i], plan.parameters[i], value);
+		}
+
+		return stmt.start_sparql_cursor (plan.types, plan.variable_names);
 	}
 
 	public Variant? execute_update (bool blank) throws GLib.Error {
@@ -513,29 +609,51 @@ public class Tracker.Sparql.Query : Object {
 		return result;
 	}
 
+	static void bind_literal (DBStatement stmt, int i, PropertyType data_type, string literal) throws Sparql.Error, DateError {
+		if (data_type == PropertyType.BOOLEAN) {
+			if (literal == "true" || literal == "1") {
+				stmt.bind_int (i, 1);
+			} else if (literal == "false" || literal == "0") {
+				stmt.bind_int (i, 0);
+			} else {
+				throw new Sparql.Error.TYPE ("`%s' is not a valid boolean".printf (literal));
+			}
+		} else if (data_type == PropertyType.DATE) {
+			stmt.bind_int (i, (int) string_to_date (literal + "T00:00:00Z", null));
+		} else if (data_type == PropertyType.DATETIME) {
+			stmt.bind_double (i, string_to_date (literal, null));
+		} else if (data_type == PropertyType.INTEGER) {
+			stmt.bind_int (i, int.parse (literal));
+		} else {
+			stmt.bind_text (i, literal);
+		}
+	}
+
+	static void bind_parameter (DBStatement stmt, int i, PropertyType data_type, string name, Variant value) throws Sparql.Error, DateError {
+		if (value.is_of_type (VariantType.INT64)) {
+			stmt.bind_int (i, value.get_int64 ());
+		} else if (value.is_of_type (VariantType.DOUBLE)) {
+			stmt.bind_double (i, value.get_double ());
+		} else if (value.is_of_type (VariantType.BOOLEAN)) {
+			stmt.bind_int (i, value.get_boolean () ? 1 : 0);
+		} else if (value.is_of_type (VariantType.STRING)) {
+			// strings get the same conversions as literals in the query
+			bind_literal (stmt, i, data_type, value.get_string ());
+		} else {
+			throw new Sparql.Error.TYPE ("Unsupported type `%s' for parameter `%s'".printf (value.get_type_string (), name));
+		}
+	}
+
 	DBStatement prepare_for_exec (DBInterface iface, string sql) throws DBInterfaceError, Sparql.Error, DateError {
 		var stmt = iface.create_statement (no_cache ? DBStatementCacheType.NONE : DBStatementCacheType.SELECT, "%s", sql);
 
 		// set literals specified in query
 		int i = 0;
 		foreach (LiteralBinding binding in bindings) {
-			if (binding.data_type == PropertyType.BOOLEAN) {
-				if (binding.literal == "true" || binding.literal == "1") {
-					stmt.bind_int (i, 1);
-				} else if (binding.literal == "false" || binding.literal == "0") {
-					stmt.bind_int (i, 0);
-				} else {
-					throw new Sparql.Error.TYPE ("`%s' is not a valid boolean".printf (binding.literal));
-				}
-			} else if (binding.data_type == PropertyType.DATE) {
-				stmt.bind_int (i, (int) string_to_date (binding.literal + "T00:00:00Z", null));
-			} else if (binding.data_type == PropertyType.DATETIME) {
-				stmt.bind_double (i, string_to_date (binding.literal, null));
-			} else if (binding.data_type == PropertyType.INTEGER) {
-				stmt.bind_int (i, int.parse (binding.literal));
-			} else {
-				stmt.bind_text (i, binding.literal);
+			if (binding.parameter != null) {
+				throw new Sparql.Error.UNSUPPORTED ("Parameters are only supported in SELECT and ASK queries");
 			}
+			bind_literal (stmt, i, binding.data_type, binding.literal);
 			i++;
 		}
 
@@ -560,14 +678,6 @@ public class Tracker.Sparql.Query : Object {
 		return sql.str;
 	}
 
-	DBCursor? execute_select_cursor () throws DBInterfaceError, Sparql.Error, DateError {
-		SelectContext context;
-		string sql = get_select_query (out context);
-		var iface = manager.get_db_interface ();
-
-		return exec_sql_cursor (iface, sql, context.types, context.variable_names);
-	}
-
 	string get_ask_query () throws DBInterfaceError, Sparql.Error, DateError {
 		// ASK query
 
@@ -599,11 +709,6 @@ public class Tracker.Sparql.Query : Object {
 		return sql.str;
 	}
 
-	DBCursor? execute_ask_cursor () throws DBInterfaceError, Sparql.Error, DateError {
-		var iface = manager.get_db_interface ();
-		return exec_sql_cursor (iface, get_ask_query (), new PropertyType[] { PropertyType.BOOLEAN }, new string[] { "result" });
-	}
-
 	private void parse_from_or_into_param () throws Sparql.Error {
 		if (accept (SparqlTokenType.IRI_REF)) {
 			current_graph = get_last_string (1);
@@ -853,7 +958,7 @@ public class Tracker.Sparql.Query : Object {
 		return n_unbound;
 	}
 
-	void skip_braces () throws Sparql.Error {
+	internal void skip_braces () throws Sparql.Error {
 		expect (SparqlTokenType.OPEN_BRACE);
 		int n_braces = 1;
 		while (n_braces > 0) {
@@ -706,6 +706,14 @@ public class Tracker.SparqlScanner : Object {
 					current++;
 				}
 				break;
+			case '~':
+				type = SparqlTokenType.NONE;
+				current++;
+				while (current < end && is_varname_char (current[0])) {
+					type = SparqlTokenType.PARAMETERIZED_VAR;
+					current++;
+				}
+				break;
 			case '@':
 				type = SparqlTokenType.NONE;
 				current++;
@@ -1109,6 +1117,7 @@ public enum Tracker.SparqlTokenType {
 	OPTIONAL,
 	OR,
 	ORDER,
+	PARAMETERIZED_VAR,
 	PLUS,
 	PN_PREFIX,
 	PREFIX,
@@ -1233,6 +1242,7 @@ public enum Tracker.SparqlTokenType {
 		case OPTIONAL: return "`OPTIONAL'";
 		case OR: return "`OR'";
 		case ORDER: return "`ORDER'";
+		case PARAMETERIZED_VAR: return "parameterized variable";
 		case PLUS: return "`+'";
 		case PN_PREFIX: return "prefixed name";
 		case PREFIX: return "`PREFIX'";
@@ -404,6 +404,139 @@ public class Tracker.TurtleReader : Object {
 		}
 	}
 
+	const int BULK_BATCH_SIZE = 1000;
+	const int BULK_N_BATCHES = 4;
+
+	struct Triple {
+		public string? graph;
+		public string subject;
+		public string predicate;
+		public string object;
+		public bool object_is_uri;
+	}
+
+	class Batch {
+		public Triple[] triples = new Triple[BULK_BATCH_SIZE];
+		public int length;
+		public bool last;
+		public Error? error;
+	}
+
+	// Like load (), but the file is parsed on a separate thread while
+	// the previous batch of triples is inserted, the IDs of the URIs in
+	// a batch are looked up together, and the index work is left for
+	// the end, see tracker_data_begin_bulk_load ()
+	public static void load_bulk (File file, Data.Update data) throws Error, FileError, Sparql.Error, DateError, DBInterfaceError {
+		var reader = new TurtleReader (file);
+		var free_batches = new AsyncQueue<Batch> ();
+		var full_batches = new AsyncQueue<Batch> ();
+		int stop = 0;
+
+		// batches go back and forth between both threads, which
+		// bounds the memory used when parsing is faster
+		for (int i = 0; i < BULK_N_BATCHES; i++) {
+			free_batches.push (new Batch ());
+		}
+
+		var parser = new Thread<void*> ("turtle-parser", () => {
+			bool last = false;
+
+			while (!last) {
+				var batch = free_batches.pop ();
+				batch.length = 0;
+				batch.last = false;
+
+				try {
+					while (batch.length < BULK_BATCH_SIZE && AtomicInt.get (ref stop) == 0) {
+						if (!reader.next ()) {
+							batch.last = true;
+							break;
+						}
+
+						Triple triple = { reader.graph, reader.subject, reader.predicate, reader.object, reader.object_is_uri };
+						batch.triples[batch.length++] = triple;
+					}
+				} catch (Sparql.Error e) {
+					batch.error = e;
+					batch.last = true;
+				}
+
+				if (AtomicInt.get (ref stop) != 0) {
+					batch.last = true;
+				}
+
+				last = batch.last;
+				full_batches.push ((owned) batch);
+			}
+
+			return null;
+		});
+
+		Batch? batch = null;
+		bool done = false;
+
+		try {
+			data.begin_transaction ();
+
+			try {
+				data.begin_bulk_load ();
+
+				while (!done) {
+					batch = full_batches.pop ();
+					done = batch.last;
+
+					if (batch.error != null) {
+						throw batch.error;
+					}
+
+					string[] uris = {};
+					for (int i = 0; i < batch.length; i++) {
+						if (batch.triples[i].graph != null) {
+							uris += batch.triples[i].graph;
+						}
+						uris += batch.triples[i].subject;
+						if (batch.triples[i].object_is_uri) {
+							uris += batch.triples[i].object;
+						}
+					}
+
+					data.prefetch_resource_ids (uris);
+
+					for (int i = 0; i < batch.length; i++) {
+						if (batch.triples[i].object_is_uri) {
+							data.insert_statement_with_uri (batch.triples[i].graph, batch.triples[i].subject, batch.triples[i].predicate, batch.triples[i].object);
+						} else {
+							data.insert_statement_with_string (batch.triples[i].graph, batch.triples[i].subject, batch.triples[i].predicate, batch.triples[i].object);
+						}
+						data.update_buffer_might_flush ();
+					}
+
+					free_batches.push ((owned) batch);
+				}
+
+				data.end_bulk_load ();
+			} catch (Error e) {
+				data.rollback_transaction ();
+				throw e;
+			}
+
+			data.commit_transaction ();
+		} finally {
+			// the parser thread uses the reader, wait for it
+			AtomicInt.set (ref stop, 1);
+
+			while (!done) {
+				if (batch != null) {
+					free_batches.push ((owned) batch);
+				}
+				batch = full_batches.pop ();
+				done = batch.last;
+			}
+
+			parser.join ();
+		}
+	}
+
 	[CCode (cname = "uuid_generate")]
 	public extern static void uuid_generate ([CCode (array_length = false)] uchar[] uuid);
 }
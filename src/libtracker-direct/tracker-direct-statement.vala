@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2017, Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+public class Tracker.Direct.Statement : Tracker.Sparql.Statement {
+	// Keeps the translated query, so every execution runs the same SQL
+	// and gets the same SQLite statement from the SELECT statement cache
+	Sparql.Query query;
+	HashTable<string,Variant> values;
+
+	public Statement (Direct.Connection conn, string sparql, Sparql.Query query) {
+		Object (connection: conn, sparql: sparql);
+		this.query = query;
+		this.values = new HashTable<string,Variant> (str_hash, str_equal);
+	}
+
+	public override void bind_int (string name, int64 value) {
+		values.insert (name, new Variant.int64 (value));
+	}
+
+	public override void bind_boolean (string name, bool value) {
+		values.insert (name, new Variant.boolean (value));
+	}
+
+	public override void bind_string (string name, string value) {
+		values.insert (name, new Variant.string (value));
+	}
+
+	public override void bind_double (string name, double value) {
+		values.insert (name, new Variant.double (value));
+	}
+
+	public override void bind_datetime (string name, DateTime value) {
+		values.insert (name, new Variant.string (value.format ("%FT%T%:z")));
+	}
+
+	public override void clear_bindings () {
+		values.remove_all ();
+	}
+
+	HashTable<string,Variant> copy_values () {
+		var copy = new HashTable<string,Variant> (str_hash, str_equal);
+		values.foreach ((name, value) => {
+			copy.insert (name, value);
+		});
+		return copy;
+	}
+
+	public override Sparql.Cursor execute (Cancellable? cancellable = null) throws Sparql.Error, IOError {
+		var conn = (Direct.Connection) connection;
+		return conn.execute_query (query, values, cancellable);
+	}
+
+	public async override Sparql.Cursor execute_async (Cancellable? cancellable = null) throws Sparql.Error, IOError {
+		// run in a separate thread
+		Sparql.Error sparql_error = null;
+		IOError io_error = null;
+		Sparql.Cursor result = null;
+		var conn = (Direct.Connection) connection;
+		var parameters = copy_values ();
+		var context = MainContext.get_thread_default ();
+
+		IOSchedulerJob.push ((job, cancellable) => {
+			try {
+				result = conn.execute_query (query, parameters, cancellable);
+			} catch (IOError e_io) {
+				io_error = e_io;
+			} catch (Sparql.Error e_spql) {
+				sparql_error = e_spql;
+			}
+
+			context.invoke (() => {
+				execute_async.callback ();
+				return false;
+			});
+
+			return false;
+		}, Priority.DEFAULT, cancellable);
+
+		yield;
+
+		if (cancellable != null && cancellable.is_cancelled ()) {
+			throw new IOError.CANCELLED ("Operation was cancelled");
+		} else if (sparql_error != null) {
+			throw sparql_error;
+		} else if (io_error != null) {
+			throw io_error;
+		} else {
+			return result;
+		}
+	}
+}
@@ -26,7 +26,9 @@ public class Tracker.Direct.Connection : Tracker.Sparql.Connection, AsyncInitabl
 
 	Data.Manager data_manager;
 
-	// Mutex to hold datamanager
+	// Serializes writers among themselves. Queries don't take it, they
+	// run on the pool of read-only interfaces kept by the DB manager,
+	// where WAL gives each statement a consistent snapshot.
 	private Mutex mutex = Mutex ();
 	Thread<void*> thread;
 
@@ -80,10 +82,12 @@ public class Tracker.Direct.Connection : Tracker.Sparql.Connection, AsyncInitabl
 
 	private class TurtleTask : Task {
 		public File file;
+		public Sparql.LoadFlags flags;
 
-		public TurtleTask (File file, Cancellable? cancellable) {
+		public TurtleTask (File file, Sparql.LoadFlags flags, Cancellable? cancellable) {
 			this.type = TaskType.TURTLE;
 			this.file = file;
+			this.flags = flags;
 			this.priority = Priority.DEFAULT;
 			this.cancellable = cancellable;
 		}
@@ -162,7 +166,7 @@ public class Tracker.Direct.Connection : Tracker.Sparql.Connection, AsyncInitabl
 					break;
 				case TaskType.TURTLE:
 					TurtleTask turtle_task = (TurtleTask) task;
-					load (turtle_task.file, turtle_task.cancellable);
+					load_with_flags (turtle_task.file, turtle_task.flags, turtle_task.cancellable);
 					break;
 				default:
 					break;
@@ -219,12 +223,11 @@ public class Tracker.Direct.Connection : Tracker.Sparql.Connection, AsyncInitabl
 		base.dispose ();
         }
 
-	Sparql.Cursor query_unlocked (string sparql) throws Sparql.Error, DBusError {
+	internal Sparql.Query prepare_query (string sparql) throws Sparql.Error {
 		try {
 			var query_object = new Sparql.Query (data_manager, sparql);
-			var cursor = query_object.execute_cursor ();
-			cursor.connection = this;
-			return cursor;
+			query_object.prepare ();
+			return query_object;
 		} catch (DBInterfaceError e) {
 			throw new Sparql.Error.INTERNAL (e.message);
 		} catch (DateError e) {
@@ -232,21 +235,31 @@ public class Tracker.Direct.Connection : Tracker.Sparql.Connection, AsyncInitabl
 		}
 	}
 
-	public override Sparql.Cursor query (string sparql, Cancellable? cancellable) throws Sparql.Error, IOError, DBusError {
+	// Runs on a pooled read-only interface, may be called from any thread
+	// concurrently with other queries and with updates
+	internal Sparql.Cursor execute_query (Sparql.Query query_object, HashTable<string,Variant>? parameters, Cancellable? cancellable) throws Sparql.Error, IOError {
 		// Check here for early cancellation, just in case
 		// the operation can be entirely avoided
 		if (cancellable != null && cancellable.is_cancelled ()) {
 			throw new IOError.CANCELLED ("Operation was cancelled");
 		}
 
-		mutex.lock ();
 		try {
-			return query_unlocked (sparql);
-		} finally {
-			mutex.unlock ();
+			var cursor = query_object.execute_cursor_with_parameters (parameters);
+			cursor.connection = this;
+			return cursor;
+		} catch (DBInterfaceError e) {
+			throw new Sparql.Error.INTERNAL (e.message);
+		} catch (DateError e) {
+			throw new Sparql.Error.PARSE (e.message);
 		}
 	}
 
+	public override Sparql.Cursor query (string sparql, Cancellable? cancellable) throws Sparql.Error, IOError, DBusError {
+		var query_object = new Sparql.Query (data_manager, sparql);
+		return execute_query (query_object, null, cancellable);
+	}
+
 	public async override Sparql.Cursor query_async (string sparql, Cancellable? cancellable) throws Sparql.Error, IOError, DBusError {
 		// run in a separate thread
 		Sparql.Error sparql_error = null;
@@ -289,6 +302,10 @@ public class Tracker.Direct.Connection : Tracker.Sparql.Connection, AsyncInitabl
 		}
 	}
 
+	public override Sparql.Statement? query_statement (string sparql, Cancellable? cancellable = null) throws Sparql.Error {
+		return new Direct.Statement (this, sparql, prepare_query (sparql));
+	}
+
 	public override void update (string sparql, int priority = GLib.Priority.DEFAULT, Cancellable? cancellable = null) throws Sparql.Error, IOError, DBusError, GLib.Error {
 		mutex.lock ();
 		try {
@@ -335,18 +352,29 @@ public class Tracker.Direct.Connection : Tracker.Sparql.Connection, AsyncInitabl
 	}
 
 	public override void load (File file, Cancellable? cancellable = null) throws Sparql.Error, IOError, DBusError {
+		load_with_flags (file, Sparql.LoadFlags.NONE, cancellable);
+	}
+
+	public async override void load_async (File file, Cancellable? cancellable = null) throws Sparql.Error, IOError, DBusError {
+		yield load_with_flags_async (file, Sparql.LoadFlags.NONE, cancellable);
+	}
+
+	public override void load_with_flags (File file, Sparql.LoadFlags flags, Cancellable? cancellable = null) throws Sparql.Error, IOError, DBusError {
 		mutex.lock ();
 		try {
 			var data = data_manager.get_data ();
-			data.load_turtle_file (file);
+			if ((flags & Sparql.LoadFlags.BULK) != 0)
+				data.load_turtle_file_bulk (file);
+			else
+				data.load_turtle_file (file);
 		} finally {
 			mutex.unlock ();
 		}
 	}
 
-	public async override void load_async (File file, Cancellable? cancellable = null) throws Sparql.Error, IOError, DBusError {
-		var task = new TurtleTask (file, cancellable);
-		task.callback = load_async.callback;
+	public async override void load_with_flags_async (File file, Sparql.LoadFlags flags, Cancellable? cancellable = null) throws Sparql.Error, IOError, DBusError {
+		var task = new TurtleTask (file, flags, cancellable);
+		task.callback = load_with_flags_async.callback;
 		update_queue.push (task);
 		yield;
 
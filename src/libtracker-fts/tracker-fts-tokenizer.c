@@ -24,6 +24,7 @@
 #include "config.h"
 
 #include <assert.h>
+#include <math.h>
 #include <string.h>
 
 #include <libtracker-common/tracker-parser.h>
@@ -37,6 +38,11 @@
 typedef struct TrackerTokenizerData TrackerTokenizerData;
 typedef struct TrackerTokenizer TrackerTokenizer;
 typedef struct TrackerTokenizerFunctionData TrackerTokenizerFunctionData;
+typedef struct TrackerBM25Data TrackerBM25Data;
+
+/* BM25 parameters, as in the FTS5 builtin bm25() */
+#define BM25_K1 1.2
+#define BM25_B  0.75
 
 struct TrackerTokenizerData {
 	TrackerLanguage *language;
@@ -58,6 +64,16 @@ struct TrackerTokenizerFunctionData {
 	gchar **property_names;
 };
 
+/* Computed once per statement, and kept as FTS5 auxdata */
+struct TrackerBM25Data {
+	int n_columns;
+	int n_phrases;
+	gdouble *weights;  /* Per column */
+	gdouble *avg_size; /* Per column */
+	gdouble *idf;      /* Per phrase */
+	int *freqs;        /* Per phrase and column, for the current row */
+};
+
 static int
 tracker_tokenizer_create (void           *data,
                           const char    **argv,
@@ -383,6 +399,175 @@ tracker_rank_function (const Fts5ExtensionApi  *api,
 	}
 }
 
+static int
+count_phrase_rows_func (const Fts5ExtensionApi *api,
+                        Fts5Context            *fts_ctx,
+                        void                   *user_data)
+{
+	sqlite3_int64 *n_rows = user_data;
+
+	(*n_rows)++;
+
+	return SQLITE_OK;
+}
+
+static void
+tracker_bm25_data_free (TrackerBM25Data *bm25)
+{
+	g_free (bm25->weights);
+	g_free (bm25->avg_size);
+	g_free (bm25->idf);
+	g_free (bm25->freqs);
+	g_free (bm25);
+}
+
+static TrackerBM25Data *
+tracker_bm25_data_new (const Fts5ExtensionApi       *api,
+                       Fts5Context                  *fts_ctx,
+                       TrackerTokenizerFunctionData *data,
+                       GHashTable                   *weights,
+                       int                          *rc)
+{
+	TrackerBM25Data *bm25;
+	sqlite3_int64 n_rows, n_tokens;
+	int i;
+
+	bm25 = g_new0 (TrackerBM25Data, 1);
+	bm25->n_columns = api->xColumnCount (fts_ctx);
+	bm25->n_phrases = api->xPhraseCount (fts_ctx);
+	bm25->weights = g_new0 (gdouble, bm25->n_columns);
+	bm25->avg_size = g_new0 (gdouble, bm25->n_columns);
+	bm25->idf = g_new0 (gdouble, bm25->n_phrases);
+	bm25->freqs = g_new0 (int, bm25->n_phrases * bm25->n_columns);
+
+	*rc = api->xRowCount (fts_ctx, &n_rows);
+
+	for (i = 0; *rc == SQLITE_OK && i < bm25->n_columns; i++) {
+		const gchar *property = data->property_names[i];
+
+		bm25->weights[i] = GPOINTER_TO_UINT (g_hash_table_lookup (weights, property));
+		*rc = api->xColumnTotalSize (fts_ctx, i, &n_tokens);
+		bm25->avg_size[i] = (n_rows > 0) ? (gdouble) n_tokens / n_rows : 0;
+	}
+
+	for (i = 0; *rc == SQLITE_OK && i < bm25->n_phrases; i++) {
+		sqlite3_int64 n_hits = 0;
+		gdouble idf;
+
+		*rc = api->xQueryPhrase (fts_ctx, i, &n_hits,
+		                         count_phrase_rows_func);
+
+		/* Keep very common phrases from scoring negatively */
+		idf = log ((n_rows - n_hits + 0.5) / (n_hits + 0.5));
+		bm25->idf[i] = MAX (idf, 1e-6);
+	}
+
+	if (*rc != SQLITE_OK) {
+		tracker_bm25_data_free (bm25);
+		return NULL;
+	}
+
+	return bm25;
+}
+
+/* BM25 over each column, scaled by the tracker:weight of the
+ * property. Higher values are better matches, as with tracker_rank().
+ */
+static void
+tracker_bm25_function (const Fts5ExtensionApi  *api,
+                       Fts5Context             *fts_ctx,
+                       sqlite3_context         *ctx,
+                       int                      n_args,
+                       sqlite3_value          **args)
+{
+	TrackerTokenizerFunctionData *data;
+	TrackerBM25Data *bm25;
+	int i, rc = SQLITE_OK, n_hits;
+	gdouble rank = 0;
+
+	if (n_args != 0) {
+		sqlite3_result_error (ctx, "Invalid argument count", -1);
+		return;
+	}
+
+	bm25 = api->xGetAuxdata (fts_ctx, FALSE);
+
+	if (!bm25) {
+		GHashTable *weights;
+
+		data = api->xUserData (fts_ctx);
+		weights = get_fts_weights (data->interface, ctx);
+
+		if (!weights) {
+			sqlite3_result_error (ctx, "Could not read FTS weights", -1);
+			return;
+		}
+
+		bm25 = tracker_bm25_data_new (api, fts_ctx, data, weights, &rc);
+
+		if (!bm25) {
+			sqlite3_result_error_code (ctx, rc);
+			return;
+		}
+
+		rc = api->xSetAuxdata (fts_ctx, bm25,
+		                       (void (*) (void *)) tracker_bm25_data_free);
+
+		if (rc != SQLITE_OK) {
+			sqlite3_result_error_code (ctx, rc);
+			return;
+		}
+	}
+
+	memset (bm25->freqs, 0,
+	        sizeof (int) * bm25->n_phrases * bm25->n_columns);
+
+	rc = api->xInstCount (fts_ctx, &n_hits);
+
+	for (i = 0; rc == SQLITE_OK && i < n_hits; i++) {
+		int phrase, col, offset;
+
+		rc = api->xInst (fts_ctx, i, &phrase, &col, &offset);
+
+		if (rc == SQLITE_OK)
+			bm25->freqs[phrase * bm25->n_columns + col]++;
+	}
+
+	for (i = 0; rc == SQLITE_OK && i < bm25->n_columns; i++) {
+		gdouble norm;
+		int n_tokens, phrase;
+
+		if (bm25->weights[i] == 0)
+			continue;
+
+		rc = api->xColumnSize (fts_ctx, i, &n_tokens);
+
+		if (rc != SQLITE_OK || n_tokens <= 0)
+			continue;
+
+		norm = BM25_K1 * (1 - BM25_B + BM25_B * n_tokens /
+		                  MAX (bm25->avg_size[i], 1));
+
+		for (phrase = 0; phrase < bm25->n_phrases; phrase++) {
+			gdouble freq;
+
+			freq = bm25->freqs[phrase * bm25->n_columns + i];
+
+			if (freq == 0)
+				continue;
+
+			rank += bm25->weights[i] * bm25->idf[phrase] *
+				(freq * (BM25_K1 + 1)) / (freq + norm);
+		}
+	}
+
+	if (rc == SQLITE_OK) {
+		sqlite3_result_double (ctx, rank);
+	} else {
+		sqlite3_result_error_code (ctx, rc);
+	}
+}
+
 static fts5_api *
 get_fts5_api (sqlite3 *db) {
 	int rc = SQLITE_OK;
@@ -469,5 +654,11 @@ tracker_tokenizer_initialize (sqlite3             *db,
 	                      &tracker_rank_function,
 	                      (GDestroyNotify) tracker_tokenizer_function_data_free);
 
+	/* BM25 rank */
+	func_data = tracker_tokenizer_function_data_new (interface, property_names);
+	api->xCreateFunction (api, "tracker_bm25", func_data,
+	                      &tracker_bm25_function,
+	                      (GDestroyNotify) tracker_tokenizer_function_data_free);
+
 	return TRUE;
 }
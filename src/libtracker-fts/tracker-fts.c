@@ -35,6 +35,10 @@ int sqlite3_fts5_init ();
 
 #endif
 
+#define RANK_FUNCTION "tracker_bm25()"
+/* Rank function of the tables created before fts_metadata */
+#define LEGACY_RANK_FUNCTION "tracker_rank()"
+
 static gchar **
 get_fts_properties (GHashTable  *tables)
 {
@@ -78,28 +82,157 @@ tracker_fts_init_db (sqlite3            *db,
 	return retval;
 }
 
+gboolean
+tracker_fts_has_content_table (sqlite3 *db)
+{
+	sqlite3_stmt *stmt;
+	gboolean found = FALSE;
+
+	if (sqlite3_prepare_v2 (db,
+	                        "SELECT 1 FROM sqlite_master "
+	                        "WHERE type='table' AND name='fts_content'",
+	                        -1, &stmt, NULL) != SQLITE_OK)
+		return FALSE;
+
+	found = (sqlite3_step (stmt) == SQLITE_ROW);
+	sqlite3_finalize (stmt);
+
+	return found;
+}
+
+/* Fills the content table from the property tables. Updates keep
+ * it in sync afterwards, so this is only needed when the FTS columns
+ * change or a bulk load skipped those updates.
+ */
+static gboolean
+fill_content_table (sqlite3 *db)
+{
+	gint rc;
+
+	rc = sqlite3_exec (db, "DELETE FROM fts_content", NULL, NULL, NULL);
+
+	if (rc == SQLITE_OK) {
+		rc = sqlite3_exec (db,
+		                   "INSERT INTO fts_content SELECT * FROM fts_view",
+		                   NULL, NULL, NULL);
+	}
+
+	return (rc == SQLITE_OK);
+}
+
+static gboolean
+get_rank_function (sqlite3      *db,
+                   const gchar  *table_name,
+                   gchar       **rank_function)
+{
+	sqlite3_stmt *stmt;
+	gchar *query;
+	gint rc;
+
+	*rank_function = NULL;
+
+	query = g_strdup_printf ("SELECT v FROM \"%s_config\" WHERE k = 'rank'",
+	                         table_name);
+	rc = sqlite3_prepare_v2 (db, query, -1, &stmt, NULL);
+	g_free (query);
+
+	if (rc != SQLITE_OK)
+		return FALSE;
+
+	if (sqlite3_step (stmt) == SQLITE_ROW)
+		*rank_function = g_strdup ((const gchar *) sqlite3_column_text (stmt, 0));
+
+	sqlite3_finalize (stmt);
+
+	return TRUE;
+}
+
+static gboolean
+set_rank_function (sqlite3     *db,
+                   const gchar *table_name,
+                   const gchar *rank_function)
+{
+	gchar *query;
+	gint rc;
+
+	query = g_strdup_printf ("INSERT INTO %s(%s, rank) VALUES('rank', '%s')",
+	                         table_name, table_name, rank_function);
+	rc = sqlite3_exec (db, query, NULL, NULL, NULL);
+	g_free (query);
+
+	return (rc == SQLITE_OK);
+}
+
+/* Returns NULL on databases from before fts_metadata */
+static gchar *
+get_default_rank_function (sqlite3 *db)
+{
+	sqlite3_stmt *stmt;
+	gchar *rank_function = NULL;
+
+	if (sqlite3_prepare_v2 (db, "SELECT Value FROM fts_metadata WHERE Key = 'default-rank'",
+	                        -1, &stmt, NULL) != SQLITE_OK)
+		return NULL;
+
+	if (sqlite3_step (stmt) == SQLITE_ROW)
+		rank_function = g_strdup ((const gchar *) sqlite3_column_text (stmt, 0));
+
+	sqlite3_finalize (stmt);
+
+	return rank_function;
+}
+
+static gboolean
+set_default_rank_function (sqlite3     *db,
+                           const gchar *rank_function)
+{
+	gchar *query;
+	gint rc;
+
+	rc = sqlite3_exec (db,
+	                   "CREATE TABLE IF NOT EXISTS fts_metadata "
+	                   "(Key TEXT NOT NULL PRIMARY KEY, Value TEXT)",
+	                   NULL, NULL, NULL);
+
+	if (rc != SQLITE_OK)
+		return FALSE;
+
+	query = g_strdup_printf ("INSERT OR REPLACE INTO fts_metadata (Key, Value) "
+	                         "VALUES ('default-rank', '%s')", rank_function);
+	rc = sqlite3_exec (db, query, NULL, NULL, NULL);
+	g_free (query);
+
+	return (rc == SQLITE_OK);
+}
+
 gboolean
 tracker_fts_create_table (sqlite3    *db,
                           gchar      *table_name,
                           GHashTable *tables,
                           GHashTable *grouped_columns)
 {
-	GString *str, *from, *fts;
+	GString *str, *from, *ids, *content, *fts;
 	GHashTableIter iter;
 	gchar *index_table;
 	GList *columns;
+	gboolean grouped = FALSE;
 	gint rc;
 
 	if (g_hash_table_size (tables) == 0)
 		return TRUE;
 
-	/* Create view on tables/columns marked as FTS-indexed */
+	/* Create view on tables/columns marked as FTS-indexed, it's
+	 * only read to fill the content table.
+	 */
 	g_hash_table_iter_init (&iter, tables);
 	str = g_string_new ("CREATE VIEW fts_view AS SELECT Resource.ID as rowid ");
 	from = g_string_new ("FROM Resource ");
+	ids = g_string_new (NULL);
+
+	content = g_string_new ("CREATE TABLE fts_content (ID INTEGER PRIMARY KEY");
 
 	fts = g_string_new ("CREATE VIRTUAL TABLE ");
-	g_string_append_printf (fts, "%s USING fts5(content=\"fts_view\", ",
+	g_string_append_printf (fts, "%s USING fts5(content=\"fts_content\", ",
 				table_name);
 
 	while (g_hash_table_iter_next (&iter, (gpointer *) &index_table,
@@ -110,6 +243,7 @@ tracker_fts_create_table (sqlite3    *db,
 				g_string_append_printf (str, ", group_concat(\"%s\".\"%s\")",
 							index_table,
 							(gchar *) columns->data);
+				grouped = TRUE;
 			} else {
 				g_string_append_printf (str, ", \"%s\".\"%s\"",
 							index_table,
@@ -118,6 +252,8 @@ tracker_fts_create_table (sqlite3    *db,
 
 			g_string_append_printf (str, " AS \"%s\" ",
 						(gchar *) columns->data);
+			g_string_append_printf (content, ", \"%s\"",
+						(gchar *) columns->data);
 			g_string_append_printf (fts, "\"%s\", ",
 						(gchar *) columns->data);
 
@@ -127,11 +263,22 @@ tracker_fts_create_table (sqlite3    *db,
 		g_string_append_printf (from, "LEFT OUTER JOIN \"%s\" ON "
 					" Resource.ID = \"%s\".ID ",
 					index_table, index_table);
+
+		if (ids->len > 0)
+			g_string_append (ids, " UNION ");
+		g_string_append_printf (ids, "SELECT ID FROM \"%s\"", index_table);
 	}
 
 	g_string_append (str, from->str);
 	g_string_free (from, TRUE);
 
+	/* Leave out resources without any indexed property */
+	g_string_append_printf (str, "WHERE Resource.ID IN (%s) ", ids->str);
+	g_string_free (ids, TRUE);
+
+	if (grouped)
+		g_string_append (str, "GROUP BY Resource.ID");
+
 	rc = sqlite3_exec(db, str->str, NULL, NULL, NULL);
 	g_string_free (str, TRUE);
 
@@ -140,6 +287,13 @@ tracker_fts_create_table (sqlite3    *db,
 		return FALSE;
 	}
 
+	g_string_append (content, ")");
+	rc = sqlite3_exec (db, content->str, NULL, NULL, NULL);
+	g_string_free (content, TRUE);
+
+	if (rc != SQLITE_OK)
+		return FALSE;
+
 	g_string_append (fts, "tokenize=TrackerTokenizer)");
 	rc = sqlite3_exec(db, fts->str, NULL, NULL, NULL);
 	g_string_free (fts, TRUE);
@@ -147,14 +301,48 @@ tracker_fts_create_table (sqlite3    *db,
 	if (rc != SQLITE_OK)
 		return FALSE;
 
-	str = g_string_new (NULL);
-	g_string_append_printf (str,
-	                        "INSERT INTO %s(%s, rank) VALUES('rank', 'tracker_rank()')",
-	                        table_name, table_name);
-	rc = sqlite3_exec (db, str->str, NULL, NULL, NULL);
-	g_string_free (str, TRUE);
+	return (set_rank_function (db, table_name, RANK_FUNCTION) &&
+	        set_default_rank_function (db, RANK_FUNCTION));
+}
 
-	return (rc == SQLITE_OK);
+/* The rank function is kept in the FTS5 config table, where it may
+ * also be changed to select another ranker, e.g. tracker_rank().
+ * The default each table got is recorded in fts_metadata, so only
+ * tables still ranking with an older default are switched to the
+ * current one. Only queries are affected, the index needs no rebuild.
+ */
+gboolean
+tracker_fts_update_rank_function (sqlite3     *db,
+                                  const gchar *table_name)
+{
+	gchar *old_default, *rank_function;
+	gboolean retval = TRUE;
+
+	old_default = get_default_rank_function (db);
+
+	if (g_strcmp0 (old_default, RANK_FUNCTION) == 0) {
+		g_free (old_default);
+		return TRUE;
+	}
+
+	if (!get_rank_function (db, table_name, &rank_function)) {
+		g_free (old_default);
+		return FALSE;
+	}
+
+	if (!rank_function ||
+	    g_strcmp0 (rank_function,
+	               old_default ? old_default : LEGACY_RANK_FUNCTION) == 0) {
+		retval = set_rank_function (db, table_name, RANK_FUNCTION);
+	}
+
+	if (retval)
+		retval = set_default_rank_function (db, RANK_FUNCTION);
+
+	g_free (rank_function);
+	g_free (old_default);
+
+	return retval;
 }
 
 gboolean
@@ -172,6 +360,15 @@ tracker_fts_alter_table (sqlite3    *db,
 	rc = sqlite3_exec (db, query, NULL, NULL, NULL);
 	g_free (query);
 
+	query = g_strdup_printf ("DROP TABLE IF EXISTS fts_content");
+	rc = sqlite3_exec (db, query, NULL, NULL, NULL);
+	g_free (query);
+
+	/* The index is rebuilt from scratch below */
+	query = g_strdup_printf ("DROP TABLE IF EXISTS fts_pending");
+	rc = sqlite3_exec (db, query, NULL, NULL, NULL);
+	g_free (query);
+
 	query = g_strdup_printf ("DROP TABLE %s", tmp_name);
 	rc = sqlite3_exec (db, query, NULL, NULL, NULL);
 	g_free (query);
@@ -185,12 +382,7 @@ tracker_fts_alter_table (sqlite3    *db,
 		return FALSE;
 	}
 
-	query = g_strdup_printf ("INSERT INTO %s (rowid) SELECT rowid FROM fts_view",
-				 tmp_name);
-	rc = sqlite3_exec (db, query, NULL, NULL, NULL);
-	g_free (query);
-
-	if (rc != SQLITE_OK) {
+	if (!fill_content_table (db)) {
 		g_free (tmp_name);
 		return FALSE;
 	}
@@ -220,9 +412,59 @@ tracker_fts_rebuild_tokens (sqlite3     *db,
 {
 	gchar *query;
 
+	/* Bulk loads leave the content table behind, and anything
+	 * still pending is indexed by the rebuild below.
+	 */
+	if (tracker_fts_has_content_table (db)) {
+		fill_content_table (db);
+		sqlite3_exec (db, "DELETE FROM fts_pending", NULL, NULL, NULL);
+	}
+
 	/* This special query rebuilds the tokens in the given FTS table */
 	query = g_strdup_printf ("INSERT INTO %s(%s) VALUES('rebuild')",
 				 table_name, table_name);
 	sqlite3_exec(db, query, NULL, NULL, NULL);
 	g_free (query);
 }
+
+/* FTS5 merges segments as they're written, higher values trade
+ * query speed for less merge work on each write.
+ */
+gboolean
+tracker_fts_set_merge_config (sqlite3     *db,
+                              const gchar *table_name,
+                              gint         automerge,
+                              gint         crisismerge)
+{
+	gchar *query;
+	gint rc;
+
+	query = g_strdup_printf ("INSERT INTO %s(%s, rank) VALUES('automerge', %d)",
+	                         table_name, table_name, automerge);
+	rc = sqlite3_exec (db, query, NULL, NULL, NULL);
+	g_free (query);
+
+	if (rc != SQLITE_OK)
+		return FALSE;
+
+	query = g_strdup_printf ("INSERT INTO %s(%s, rank) VALUES('crisismerge', %d)",
+	                         table_name, table_name, crisismerge);
+	rc = sqlite3_exec (db, query, NULL, NULL, NULL);
+	g_free (query);
+
+	return (rc == SQLITE_OK);
+}
+
+/* Does up to @n_pages worth of merge work on the index */
+void
+tracker_fts_merge (sqlite3     *db,
+                   const gchar *table_name,
+                   gint         n_pages)
+{
+	gchar *query;
+
+	query = g_strdup_printf ("INSERT INTO %s(%s, rank) VALUES('merge', %d)",
+	                         table_name, table_name, n_pages);
+	sqlite3_exec (db, query, NULL, NULL, NULL);
+	g_free (query);
+}
@@ -42,6 +42,16 @@ gboolean    tracker_fts_alter_table      (sqlite3    *db,
                                           GHashTable *grouped_columns);
 void        tracker_fts_rebuild_tokens   (sqlite3     *db,
                                           const gchar *table_name);
+gboolean    tracker_fts_has_content_table (sqlite3 *db);
+gboolean    tracker_fts_update_rank_function (sqlite3     *db,
+                                              const gchar *table_name);
+gboolean    tracker_fts_set_merge_config (sqlite3     *db,
+                                          const gchar *table_name,
+                                          gint         automerge,
+                                          gint         crisismerge);
+void        tracker_fts_merge            (sqlite3     *db,
+                                          const gchar *table_name,
+                                          gint         n_pages);
 
 G_END_DECLS
 
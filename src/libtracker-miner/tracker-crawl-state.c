@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2017, Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <glib/gstdio.h>
+
+#include <gvdb/gvdb-builder.h>
+#include <gvdb/gvdb-reader.h>
+
+#include "tracker-crawl-state.h"
+
+#define ENTRY_VARIANT_TYPE "(tttu)"
+
+/* The state file is removed as soon as it's loaded, and only written
+ * back on a clean shutdown. If the miner doesn't get to shut down
+ * cleanly, the next run finds no state and checks everything.
+ */
+struct _TrackerCrawlState {
+	GFile *file;
+
+	/* Entries from the previous run */
+	GvdbTable *table;
+	GvdbTable *directories;
+
+	/* Entries found in sync during this run, by URI */
+	GHashTable *entries;
+};
+
+static GvdbTable *
+crawl_state_load (const gchar *path,
+                  gint64       folder_count)
+{
+	GvdbTable *table;
+	GVariant *value;
+	GError *error = NULL;
+	gboolean valid;
+
+	table = gvdb_table_new (path, FALSE, &error);
+
+	if (!table) {
+		if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+			g_warning ("Could not load crawl state from '%s': %s",
+			           path, error->message);
+		}
+
+		g_error_free (error);
+		return NULL;
+	}
+
+	/* A different folder count means the store was modified
+	 * or replaced behind our back, nothing can be trusted.
+	 */
+	value = gvdb_table_get_value (table, "folder-count");
+	valid = (value &&
+	         g_variant_is_of_type (value, G_VARIANT_TYPE_INT64) &&
+	         g_variant_get_int64 (value) == folder_count);
+
+	if (value) {
+		g_variant_unref (value);
+	}
+
+	if (!valid) {
+		g_debug ("Discarding stale crawl state from '%s'", path);
+		gvdb_table_unref (table);
+		return NULL;
+	}
+
+	return table;
+}
+
+TrackerCrawlState *
+tracker_crawl_state_new (GFile  *file,
+                         gint64  folder_count)
+{
+	TrackerCrawlState *state;
+	gchar *path;
+
+	g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+	state = g_slice_new0 (TrackerCrawlState);
+	state->file = g_object_ref (file);
+	state->entries = g_hash_table_new_full (g_str_hash, g_str_equal,
+	                                        g_free, g_free);
+
+	path = g_file_get_path (file);
+
+	if (path) {
+		if (folder_count >= 0) {
+			state->table = crawl_state_load (path, folder_count);
+		}
+
+		if (state->table) {
+			state->directories = gvdb_table_get_table (state->table,
+			                                           "directories");
+		}
+
+		/* The table stays mapped */
+		g_unlink (path);
+		g_free (path);
+	}
+
+	return state;
+}
+
+void
+tracker_crawl_state_free (TrackerCrawlState *state)
+{
+	if (state->directories) {
+		gvdb_table_unref (state->directories);
+	}
+
+	if (state->table) {
+		gvdb_table_unref (state->table);
+	}
+
+	g_hash_table_unref (state->entries);
+	g_object_unref (state->file);
+	g_slice_free (TrackerCrawlState, state);
+}
+
+/* Returns TRUE if @entry describes @directory as it was when
+ * last found in sync with the store.
+ */
+gboolean
+tracker_crawl_state_lookup (TrackerCrawlState      *state,
+                            GFile                  *directory,
+                            TrackerCrawlStateEntry *entry)
+{
+	TrackerCrawlStateEntry stored;
+	GVariant *value;
+	gchar *uri;
+
+	if (!state->directories) {
+		return FALSE;
+	}
+
+	uri = g_file_get_uri (directory);
+	value = gvdb_table_get_value (state->directories, uri);
+	g_free (uri);
+
+	if (!value) {
+		return FALSE;
+	}
+
+	if (!g_variant_is_of_type (value, G_VARIANT_TYPE (ENTRY_VARIANT_TYPE))) {
+		g_variant_unref (value);
+		return FALSE;
+	}
+
+	g_variant_get (value, ENTRY_VARIANT_TYPE,
+	               &stored.mtime, &stored.inode,
+	               &stored.digest, &stored.n_children);
+	g_variant_unref (value);
+
+	return (stored.mtime == entry->mtime &&
+	        stored.inode == entry->inode &&
+	        stored.digest == entry->digest &&
+	        stored.n_children == entry->n_children);
+}
+
+void
+tracker_crawl_state_insert (TrackerCrawlState      *state,
+                            GFile                  *directory,
+                            TrackerCrawlStateEntry *entry)
+{
+	g_hash_table_insert (state->entries,
+	                     g_file_get_uri (directory),
+	                     g_memdup (entry, sizeof (TrackerCrawlStateEntry)));
+}
+
+void
+tracker_crawl_state_remove (TrackerCrawlState *state,
+                            GFile             *directory)
+{
+	gchar *uri;
+
+	uri = g_file_get_uri (directory);
+	g_hash_table_remove (state->entries, uri);
+	g_free (uri);
+}
+
+/* Only entries inserted during this run are saved, anything
+ * that wasn't checked again is checked in full next time.
+ */
+gboolean
+tracker_crawl_state_save (TrackerCrawlState  *state,
+                          gint64              folder_count,
+                          GError            **error)
+{
+	GHashTable *root_table, *table;
+	GHashTableIter iter;
+	GvdbItem *item;
+	gpointer key, value;
+	gchar *path, *dir;
+	gboolean retval;
+
+	path = g_file_get_path (state->file);
+
+	if (!path) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+		             "Crawl state file must be local");
+		return FALSE;
+	}
+
+	dir = g_path_get_dirname (path);
+	g_mkdir_with_parents (dir, 0700);
+	g_free (dir);
+
+	root_table = gvdb_hash_table_new (NULL, NULL);
+
+	item = gvdb_hash_table_insert (root_table, "folder-count");
+	gvdb_item_set_value (item, g_variant_new_int64 (folder_count));
+
+	table = gvdb_hash_table_new (root_table, "directories");
+	g_hash_table_iter_init (&iter, state->entries);
+
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		TrackerCrawlStateEntry *entry = value;
+
+		item = gvdb_hash_table_insert (table, key);
+		gvdb_item_set_value (item,
+		                     g_variant_new (ENTRY_VARIANT_TYPE,
+		                                    entry->mtime, entry->inode,
+		                                    entry->digest, entry->n_children));
+	}
+
+	g_hash_table_unref (table);
+
+	retval = gvdb_table_write_contents (root_table, path, FALSE, error);
+
+	g_hash_table_unref (root_table);
+	g_free (path);
+
+	return retval;
+}
+
+/* Folds a directory child into the entry digest, the result
+ * doesn't depend on the order children are added in.
+ */
+void
+tracker_crawl_state_entry_add_child (TrackerCrawlStateEntry *entry,
+                                     const gchar            *name,
+                                     GFileType               file_type,
+                                     guint64                 mtime)
+{
+	guint64 hash = G_GUINT64_CONSTANT (14695981039346656037);
+	const guchar *p;
+
+	/* FNV-1a */
+	for (p = (const guchar *) name; *p; p++) {
+		hash ^= *p;
+		hash *= G_GUINT64_CONSTANT (1099511628211);
+	}
+
+	hash ^= file_type;
+	hash *= G_GUINT64_CONSTANT (1099511628211);
+	hash ^= mtime;
+	hash *= G_GUINT64_CONSTANT (1099511628211);
+
+	entry->digest += hash;
+	entry->n_children++;
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2017, Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __LIBTRACKER_MINER_CRAWL_STATE_H__
+#define __LIBTRACKER_MINER_CRAWL_STATE_H__
+
+#if !defined (__LIBTRACKER_MINER_H_INSIDE__) && !defined (TRACKER_COMPILATION)
+#error "Only <libtracker-miner/tracker-miner.h> can be included directly."
+#endif
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* Directories found in sync with the store on a previous run, so
+ * their contents don't need checking again if unchanged on disk.
+ */
+typedef struct _TrackerCrawlState TrackerCrawlState;
+
+typedef struct {
+	guint64 mtime;
+	guint64 inode;
+	guint64 digest;
+	guint n_children;
+} TrackerCrawlStateEntry;
+
+TrackerCrawlState * tracker_crawl_state_new    (GFile                  *file,
+                                                gint64                  folder_count);
+void                tracker_crawl_state_free   (TrackerCrawlState      *state);
+
+gboolean            tracker_crawl_state_lookup (TrackerCrawlState      *state,
+                                                GFile                  *directory,
+                                                TrackerCrawlStateEntry *entry);
+void                tracker_crawl_state_insert (TrackerCrawlState      *state,
+                                                GFile                  *directory,
+                                                TrackerCrawlStateEntry *entry);
+void                tracker_crawl_state_remove (TrackerCrawlState      *state,
+                                                GFile                  *directory);
+
+gboolean            tracker_crawl_state_save   (TrackerCrawlState      *state,
+                                                gint64                  folder_count,
+                                                GError                **error);
+
+void                tracker_crawl_state_entry_add_child (TrackerCrawlStateEntry *entry,
+                                                         const gchar            *name,
+                                                         GFileType               file_type,
+                                                         guint64                 mtime);
+
+G_END_DECLS
+
+#endif /* __LIBTRACKER_MINER_CRAWL_STATE_H__ */
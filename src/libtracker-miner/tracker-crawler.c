@@ -41,9 +41,16 @@
 
 #define MAX_SIMULTANEOUS_ITEMS       64
 
+/* Number of queued directories per worker thread that are
+ * enumerated ahead of the main loop checking their contents.
+ */
+#define DIRECTORIES_AHEAD_PER_WORKER 8
+
 typedef struct DirectoryChildData DirectoryChildData;
 typedef struct DirectoryProcessingData DirectoryProcessingData;
 typedef struct DirectoryRootInfo DirectoryRootInfo;
+typedef struct EnumerateJob EnumerateJob;
+typedef struct CrawlerResults CrawlerResults;
 
 typedef struct {
 	TrackerCrawler *crawler;
@@ -62,10 +69,42 @@ struct DirectoryChildData {
 struct DirectoryProcessingData {
 	GNode *node;
 	GSList *children;
+	EnumerateJob *job;
 	guint was_inspected : 1;
 	guint ignored_by_content : 1;
 };
 
+/* A directory enumerated in a worker thread, the worker only
+ * touches the fields up to error.
+ */
+struct EnumerateJob {
+	TrackerDataProvider *data_provider;
+	GFile *dir_file;
+	gchar *attributes;
+	TrackerDirectoryFlags flags;
+	GCancellable *cancellable;
+
+	GList *files;
+	GError *error;
+
+	/* Main thread only, NULL if the directory was
+	 * dropped while being enumerated.
+	 */
+	DirectoryProcessingData *dir_data;
+	guint done : 1;
+};
+
+/* Finished jobs are handed back to the main loop here,
+ * it may outlive the crawler.
+ */
+struct CrawlerResults {
+	volatile gint ref_count;
+	volatile gint dispatch_pending;
+	GAsyncQueue *queue;
+	GMainContext *context;
+	GWeakRef crawler;
+};
+
 struct DirectoryRootInfo {
 	GFile *directory;
 	GNode *tree;
@@ -109,6 +148,11 @@ struct TrackerCrawlerPrivate {
 	gboolean        was_started;
 
 	gint            max_depth;
+
+	/* Worker threads enumerating directories */
+	GThreadPool    *workers;
+	guint           n_workers;
+	CrawlerResults *results;
 };
 
 enum {
@@ -147,6 +191,20 @@ static void     data_provider_begin      (TrackerCrawler          *crawler,
 static void     data_provider_end        (TrackerCrawler          *crawler,
                                           DirectoryRootInfo       *info);
 static void     directory_root_info_free (DirectoryRootInfo *info);
+static void     enumerate_job_free       (EnumerateJob      *job);
+static void     enumerate_job_run        (EnumerateJob      *job,
+                                          CrawlerResults    *results);
+static void     crawler_results_unref    (CrawlerResults    *results);
+static gboolean process_func_start       (TrackerCrawler    *crawler);
+static gboolean directory_processing_data_should_iterate (DirectoryRootInfo       *info,
+                                                          DirectoryProcessingData *dir_data);
+static void     enumerate_job_start        (TrackerCrawler          *crawler,
+                                            DirectoryRootInfo       *info,
+                                            DirectoryProcessingData *dir_data);
+static void     enumerate_job_finish       (TrackerCrawler          *crawler,
+                                            DirectoryProcessingData *dir_data);
+static void     enumerate_jobs_start_ahead (TrackerCrawler          *crawler,
+                                            DirectoryRootInfo       *info);
 
 
 static guint signals[LAST_SIGNAL] = { 0, };
@@ -315,6 +373,15 @@ crawler_finalize (GObject *object)
 	g_queue_foreach (priv->directories, (GFunc) directory_root_info_free, NULL);
 	g_queue_free (priv->directories);
 
+	if (priv->workers) {
+		/* Jobs left are cancelled, so this doesn't block for long */
+		g_thread_pool_free (priv->workers, FALSE, TRUE);
+	}
+
+	if (priv->results) {
+		crawler_results_unref (priv->results);
+	}
+
 	g_free (priv->file_attributes);
 
 	if (priv->data_provider) {
@@ -455,6 +522,15 @@ directory_processing_data_new (GNode *node)
 static void
 directory_processing_data_free (DirectoryProcessingData *data)
 {
+	if (data->job) {
+		if (data->job->done) {
+			enumerate_job_free (data->job);
+		} else {
+			/* Freed once the worker hands it back */
+			data->job->dir_data = NULL;
+		}
+	}
+
 	g_slist_foreach (data->children, (GFunc) directory_child_data_free, NULL);
 	g_slist_free (data->children);
 
@@ -612,13 +688,31 @@ process_next (TrackerCrawler *crawler)
 	}
 
 	if (dir_data) {
-		gint depth = g_node_depth (dir_data->node) - 1;
 		gboolean iterate;
 
-		iterate = (info->max_depth >= 0) ? depth < info->max_depth : TRUE;
+		iterate = directory_processing_data_should_iterate (info, dir_data);
 
-		/* One directory inside the tree hierarchy is being inspected */
-		if (!dir_data->was_inspected) {
+		if (!dir_data->was_inspected && priv->workers) {
+			/* Crawler may have been already stopped while we were waiting for the
+			 *  check_directory return value, so only enumerate if running. The
+			 *  root directory job is always started by tracker_crawler_start().
+			 */
+			if (priv->is_running && (iterate || dir_data->job)) {
+				if (!dir_data->job) {
+					enumerate_job_start (crawler, info, dir_data);
+				}
+
+				if (dir_data->job->done) {
+					enumerate_job_finish (crawler, dir_data);
+				} else {
+					/* Resumed once a worker is done with it */
+					stop_idle = TRUE;
+				}
+			} else {
+				dir_data->was_inspected = TRUE;
+			}
+		} else if (!dir_data->was_inspected) {
+			/* One directory inside the tree hierarchy is being inspected */
 			dir_data->was_inspected = TRUE;
 
 			/* Crawler may have been already stopped while we were waiting for the
@@ -662,6 +756,10 @@ process_next (TrackerCrawler *crawler)
 
 				child_dir_data = directory_processing_data_new (child_node);
 				g_queue_push_tail (info->directory_processing_queue, child_dir_data);
+
+				if (priv->workers) {
+					enumerate_jobs_start_ahead (crawler, info);
+				}
 			}
 
 			directory_child_data_free (child_data);
@@ -669,6 +767,10 @@ process_next (TrackerCrawler *crawler)
 			/* No (more) children, or directory ignored. stop processing. */
 			g_queue_pop_head (info->directory_processing_queue);
 			directory_processing_data_free (dir_data);
+
+			if (priv->workers && priv->is_running) {
+				enumerate_jobs_start_ahead (crawler, info);
+			}
 		}
 	} else if (!dir_data && info) {
 		/* Current directory being crawled doesn't have anything else
@@ -765,43 +867,41 @@ data_provider_data_new (TrackerCrawler          *crawler,
 }
 
 static void
-data_provider_data_process (DataProviderData *dpd)
+directory_processing_data_check_contents (TrackerCrawler          *crawler,
+                                          DirectoryProcessingData *dir_info,
+                                          GFile                   *dir_file)
 {
-	TrackerCrawler *crawler;
 	GSList *l;
 	GList *children = NULL;
 	gboolean use;
 
-	crawler = dpd->crawler;
-
-	for (l = dpd->dir_info->children; l; l = l->next) {
+	for (l = dir_info->children; l; l = l->next) {
 		DirectoryChildData *child_data;
 
 		child_data = l->data;
 		children = g_list_prepend (children, child_data->child);
 	}
 
-	g_signal_emit (crawler, signals[CHECK_DIRECTORY_CONTENTS], 0, dpd->dir_file, children, &use);
+	g_signal_emit (crawler, signals[CHECK_DIRECTORY_CONTENTS], 0, dir_file, children, &use);
 	g_list_free (children);
 
 	if (!use) {
-		dpd->dir_info->ignored_by_content = TRUE;
+		dir_info->ignored_by_content = TRUE;
 		/* FIXME: Update stats */
 		return;
 	}
 }
 
+/* Takes ownership of @files */
 static void
-data_provider_data_add (DataProviderData *dpd)
+directory_processing_data_add_files (TrackerCrawler          *crawler,
+                                     DirectoryProcessingData *dir_info,
+                                     GFile                   *parent,
+                                     GList                   *files)
 {
-	TrackerCrawler *crawler;
-	GFile *parent;
 	GList *l;
 
-	crawler = dpd->crawler;
-	parent = dpd->dir_file;
-
-	for (l = dpd->files; l; l = l->next) {
+	for (l = files; l; l = l->next) {
 		GFileInfo *info;
 		GFile *child;
 		const gchar *child_name;
@@ -821,13 +921,30 @@ data_provider_data_add (DataProviderData *dpd)
 			                         (GDestroyNotify) g_object_unref);
 		}
 
-		directory_processing_data_add_child (dpd->dir_info, child, is_dir);
+		directory_processing_data_add_child (dir_info, child, is_dir);
 
 		g_object_unref (child);
 		g_object_unref (info);
 	}
 
-	g_list_free (dpd->files);
+	g_list_free (files);
+}
+
+static void
+data_provider_data_process (DataProviderData *dpd)
+{
+	directory_processing_data_check_contents (dpd->crawler,
+	                                          dpd->dir_info,
+	                                          dpd->dir_file);
+}
+
+static void
+data_provider_data_add (DataProviderData *dpd)
+{
+	directory_processing_data_add_files (dpd->crawler,
+	                                     dpd->dir_info,
+	                                     dpd->dir_file,
+	                                     dpd->files);
 	dpd->files = NULL;
 }
 
@@ -990,6 +1107,235 @@ data_provider_begin_cb (GObject      *object,
 	                                    dpd);
 }
 
+static gchar *
+crawler_get_enumerate_attributes (TrackerCrawler *crawler)
+{
+	if (crawler->priv->file_attributes) {
+		return g_strconcat (FILE_ATTRIBUTES ",",
+		                    crawler->priv->file_attributes,
+		                    NULL);
+	}
+
+	return g_strdup (FILE_ATTRIBUTES);
+}
+
+static CrawlerResults *
+crawler_results_new (TrackerCrawler *crawler)
+{
+	CrawlerResults *results;
+
+	results = g_slice_new0 (CrawlerResults);
+	results->ref_count = 1;
+	results->queue = g_async_queue_new_full ((GDestroyNotify) enumerate_job_free);
+	results->context = g_main_context_ref_thread_default ();
+	g_weak_ref_init (&results->crawler, crawler);
+
+	return results;
+}
+
+static CrawlerResults *
+crawler_results_ref (CrawlerResults *results)
+{
+	g_atomic_int_inc (&results->ref_count);
+	return results;
+}
+
+static void
+crawler_results_unref (CrawlerResults *results)
+{
+	if (!g_atomic_int_dec_and_test (&results->ref_count)) {
+		return;
+	}
+
+	g_async_queue_unref (results->queue);
+	g_main_context_unref (results->context);
+	g_weak_ref_clear (&results->crawler);
+	g_slice_free (CrawlerResults, results);
+}
+
+static gboolean
+crawler_results_dispatch (gpointer user_data)
+{
+	CrawlerResults *results = user_data;
+	TrackerCrawler *crawler;
+	EnumerateJob *job;
+
+	/* Reset first, so jobs pushed while draining schedule
+	 * a new dispatch.
+	 */
+	g_atomic_int_set (&results->dispatch_pending, FALSE);
+	crawler = g_weak_ref_get (&results->crawler);
+
+	while ((job = g_async_queue_try_pop (results->queue)) != NULL) {
+		if (!crawler || !job->dir_data) {
+			/* Directory is gone, nobody waits for this */
+			enumerate_job_free (job);
+			continue;
+		}
+
+		job->done = TRUE;
+	}
+
+	if (crawler) {
+		if (crawler->priv->is_running) {
+			process_func_start (crawler);
+		}
+
+		g_object_unref (crawler);
+	}
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+crawler_results_push (CrawlerResults *results,
+                      EnumerateJob   *job)
+{
+	g_async_queue_push (results->queue, job);
+
+	/* Only one dispatch is scheduled at a time, it handles
+	 * every job finished in the meantime.
+	 */
+	if (g_atomic_int_compare_and_exchange (&results->dispatch_pending, FALSE, TRUE)) {
+		GSource *source;
+
+		source = g_idle_source_new ();
+		g_source_set_callback (source,
+		                       crawler_results_dispatch,
+		                       crawler_results_ref (results),
+		                       (GDestroyNotify) crawler_results_unref);
+		g_source_attach (source, results->context);
+		g_source_unref (source);
+	}
+}
+
+static void
+enumerate_job_free (EnumerateJob *job)
+{
+	g_object_unref (job->data_provider);
+	g_object_unref (job->dir_file);
+	g_object_unref (job->cancellable);
+	g_free (job->attributes);
+	g_list_free_full (job->files, g_object_unref);
+	g_clear_error (&job->error);
+
+	g_slice_free (EnumerateJob, job);
+}
+
+/* Runs in a worker thread */
+static void
+enumerate_job_run (EnumerateJob   *job,
+                   CrawlerResults *results)
+{
+	GFileEnumerator *enumerator;
+	GFileInfo *info;
+
+	enumerator = tracker_data_provider_begin (job->data_provider,
+	                                          job->dir_file,
+	                                          job->attributes,
+	                                          job->flags,
+	                                          job->cancellable,
+	                                          &job->error);
+
+	if (enumerator) {
+		while ((info = g_file_enumerator_next_file (enumerator,
+		                                            job->cancellable,
+		                                            &job->error)) != NULL) {
+			job->files = g_list_prepend (job->files, info);
+		}
+
+		g_file_enumerator_close (enumerator, NULL, NULL);
+		g_object_unref (enumerator);
+	}
+
+	job->files = g_list_reverse (job->files);
+	crawler_results_push (results, job);
+}
+
+static void
+enumerate_job_start (TrackerCrawler          *crawler,
+                     DirectoryRootInfo       *info,
+                     DirectoryProcessingData *dir_data)
+{
+	EnumerateJob *job;
+
+	job = g_slice_new0 (EnumerateJob);
+	job->data_provider = g_object_ref (crawler->priv->data_provider);
+	job->dir_file = g_object_ref (dir_data->node->data);
+	job->attributes = crawler_get_enumerate_attributes (crawler);
+	job->flags = info->flags;
+	job->cancellable = g_object_ref (crawler->priv->cancellable);
+	job->dir_data = dir_data;
+	dir_data->job = job;
+
+	g_thread_pool_push (crawler->priv->workers, job, NULL);
+}
+
+static void
+enumerate_job_finish (TrackerCrawler          *crawler,
+                      DirectoryProcessingData *dir_data)
+{
+	EnumerateJob *job;
+
+	job = dir_data->job;
+	dir_data->job = NULL;
+	dir_data->was_inspected = TRUE;
+
+	if (job->error) {
+		if (!g_error_matches (job->error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			gchar *uri = g_file_get_uri (job->dir_file);
+			g_warning ("Could not enumerate container / directory '%s', %s",
+			           uri, job->error->message);
+			g_free (uri);
+		}
+	} else {
+		directory_processing_data_add_files (crawler, dir_data,
+		                                     job->dir_file,
+		                                     job->files);
+		job->files = NULL;
+		directory_processing_data_check_contents (crawler, dir_data,
+		                                          job->dir_file);
+	}
+
+	enumerate_job_free (job);
+}
+
+static gboolean
+directory_processing_data_should_iterate (DirectoryRootInfo       *info,
+                                          DirectoryProcessingData *dir_data)
+{
+	gint depth = g_node_depth (dir_data->node) - 1;
+
+	return (info->max_depth >= 0) ? depth < info->max_depth : TRUE;
+}
+
+/* Keeps the workers busy with the directories following
+ * the one being processed, the window bounds memory use.
+ */
+static void
+enumerate_jobs_start_ahead (TrackerCrawler    *crawler,
+                            DirectoryRootInfo *info)
+{
+	guint n_ahead, i;
+	GList *l;
+
+	n_ahead = crawler->priv->n_workers * DIRECTORIES_AHEAD_PER_WORKER;
+
+	for (l = info->directory_processing_queue->head, i = 0;
+	     l && i < n_ahead;
+	     l = l->next, i++) {
+		DirectoryProcessingData *dir_data = l->data;
+
+		if (dir_data->job || dir_data->was_inspected) {
+			continue;
+		}
+
+		if (directory_processing_data_should_iterate (info, dir_data)) {
+			enumerate_job_start (crawler, info, dir_data);
+		}
+	}
+}
+
 static void
 data_provider_begin (TrackerCrawler          *crawler,
                      DirectoryRootInfo       *info,
@@ -1007,13 +1353,7 @@ data_provider_begin (TrackerCrawler          *crawler,
 	dpd = data_provider_data_new (crawler, info, dir_data);
 	info->dpd = dpd;
 
-	if (crawler->priv->file_attributes) {
-		attrs = g_strconcat (FILE_ATTRIBUTES ",",
-		                     crawler->priv->file_attributes,
-		                     NULL);
-	} else {
-		attrs = g_strdup (FILE_ATTRIBUTES);
-	}
+	attrs = crawler_get_enumerate_attributes (crawler);
 
 	tracker_data_provider_begin_async (crawler->priv->data_provider,
 	                                   dpd->dir_file,
@@ -1095,8 +1435,14 @@ tracker_crawler_start (TrackerCrawler        *crawler,
 
 	dir_data = g_queue_peek_head (info->directory_processing_queue);
 
-	if (dir_data)
-		data_provider_begin (crawler, info, dir_data);
+	if (dir_data) {
+		if (priv->workers) {
+			/* Processing starts once the job is handed back */
+			enumerate_job_start (crawler, info, dir_data);
+		} else {
+			data_provider_begin (crawler, info, dir_data);
+		}
+	}
 
 	return TRUE;
 }
@@ -1196,6 +1542,55 @@ tracker_crawler_set_throttle (TrackerCrawler *crawler,
 	}
 }
 
+/**
+ * tracker_crawler_set_n_workers:
+ * @crawler: a #TrackerCrawler
+ * @n_workers: number of threads enumerating directories, or 0
+ *
+ * Makes @crawler enumerate directories in up to @n_workers threads,
+ * ahead of the main loop checking their contents. The data provider
+ * must support tracker_data_provider_begin() being called from
+ * several threads. Signals are still emitted from the main loop, in
+ * the same order. If @n_workers is 0, directories are enumerated
+ * asynchronously one at a time, which is the default.
+ *
+ * This may only be called while @crawler is not running.
+ **/
+void
+tracker_crawler_set_n_workers (TrackerCrawler *crawler,
+                               guint           n_workers)
+{
+	TrackerCrawlerPrivate *priv;
+
+	g_return_if_fail (TRACKER_IS_CRAWLER (crawler));
+	g_return_if_fail (!crawler->priv->is_running);
+
+	priv = crawler->priv;
+	priv->n_workers = n_workers;
+
+	if (n_workers == 0) {
+		if (priv->workers) {
+			g_thread_pool_free (priv->workers, FALSE, TRUE);
+			priv->workers = NULL;
+		}
+
+		return;
+	}
+
+	if (!priv->results) {
+		priv->results = crawler_results_new (crawler);
+	}
+
+	if (priv->workers) {
+		g_thread_pool_set_max_threads (priv->workers, n_workers, NULL);
+	} else {
+		priv->workers = g_thread_pool_new ((GFunc) enumerate_job_run,
+		                                   priv->results,
+		                                   n_workers, FALSE,
+		                                   NULL);
+	}
+}
+
 /**
  * tracker_crawler_set_file_attributes:
  * @crawler: a #TrackerCrawler
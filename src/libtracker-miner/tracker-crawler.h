@@ -82,6 +82,8 @@ void            tracker_crawler_pause        (TrackerCrawler *crawler);
 void            tracker_crawler_resume       (TrackerCrawler *crawler);
 void            tracker_crawler_set_throttle (TrackerCrawler *crawler,
                                               gdouble         throttle);
+void            tracker_crawler_set_n_workers (TrackerCrawler *crawler,
+                                               guint           n_workers);
 
 void            tracker_crawler_set_file_attributes (TrackerCrawler *crawler,
 						     const gchar    *file_attributes);
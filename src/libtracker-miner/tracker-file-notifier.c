@@ -27,15 +27,26 @@
 #include "tracker-file-notifier.h"
 #include "tracker-file-system.h"
 #include "tracker-crawler.h"
+#include "tracker-crawl-state.h"
 #include "tracker-monitor.h"
 
 static GQuark quark_property_iri = 0;
+static GQuark quark_property_iri_queried = 0;
+static GQuark quark_property_store_known = 0;
 static GQuark quark_property_store_mtime = 0;
 static GQuark quark_property_filesystem_mtime = 0;
 static gboolean force_check_updated = FALSE;
+static guint crawler_n_workers = 0;
+static guint monitor_event_window = 0;
 
 #define MAX_DEPTH 1
 
+/* Default limit of threads enumerating directories while crawling */
+#define MAX_CRAWLER_WORKERS 4
+
+/* Maximum number of files looked up in a single IRI query */
+#define IRI_BATCH_SIZE 100
+
 enum {
 	PROP_0,
 	PROP_INDEXING_TREE,
@@ -51,6 +62,7 @@ enum {
 	DIRECTORY_STARTED,
 	DIRECTORY_FINISHED,
 	FINISHED,
+	FILE_IRI_RESOLVED,
 	LAST_SIGNAL
 };
 
@@ -66,7 +78,13 @@ typedef struct {
 	guint directories_ignored;
 	guint files_found;
 	guint files_ignored;
+
+	/* current_dir as found on disk, and whether it was
+	 * found out of sync with the store.
+	 */
+	TrackerCrawlStateEntry current_dir_state;
 	guint current_dir_content_filtered : 1;
+	guint current_dir_changed : 1;
 } RootData;
 
 typedef struct {
@@ -88,6 +106,17 @@ typedef struct {
 	GList *pending_index_roots;
 	RootData *current_index_root;
 
+	/* Batched IRI lookups, files are grouped by
+	 * parent directory until the next idle.
+	 */
+	GHashTable *iri_batches;
+	GHashTable *iri_pending;
+	guint iri_flush_id;
+
+	/* Directories known to be in sync since the last run */
+	TrackerCrawlState *crawl_state;
+	gint64 folder_count;
+
 	guint stopped : 1;
 } TrackerFileNotifierPrivate;
 
@@ -104,6 +133,11 @@ typedef struct {
 	gint max_depth;
 } SparqlStartData;
 
+typedef struct {
+	TrackerFileNotifier *notifier;
+	GPtrArray *files;
+} SparqlIrisData;
+
 static gboolean crawl_directories_start (TrackerFileNotifier *notifier);
 static void     sparql_files_query_start (TrackerFileNotifier  *notifier,
                                           GFile               **files,
@@ -310,6 +344,7 @@ file_notifier_traverse_tree_foreach (GFile    *file,
 
 	if (store_mtime && !disk_mtime) {
 		/* In store but not in disk, delete */
+		priv->current_index_root->current_dir_changed = TRUE;
 		g_signal_emit (notifier, signals[FILE_DELETED], 0, file);
 
 		g_free (store_mtime);
@@ -317,9 +352,11 @@ file_notifier_traverse_tree_foreach (GFile    *file,
 		return TRUE;
 	} else if (disk_mtime && !store_mtime) {
 		/* In disk but not in store, create */
+		priv->current_index_root->current_dir_changed = TRUE;
 		g_signal_emit (notifier, signals[FILE_CREATED], 0, file);
 	} else if (store_mtime && disk_mtime && *disk_mtime != *store_mtime) {
 		/* Mtime changed, update */
+		priv->current_index_root->current_dir_changed = TRUE;
 		g_signal_emit (notifier, signals[FILE_UPDATED], 0, file, FALSE);
 	} else if (!store_mtime && !disk_mtime) {
 		/* what are we doing with such file? should happen rarely,
@@ -452,6 +489,17 @@ file_notifier_add_node_foreach (GNode    *node,
 		time_ptr = g_new (guint64, 1);
 		*time_ptr = time;
 
+		if (depth == 1) {
+			priv->current_index_root->current_dir_state.mtime = time;
+			priv->current_index_root->current_dir_state.inode =
+				g_file_info_get_attribute_uint64 (file_info,
+				                                  G_FILE_ATTRIBUTE_UNIX_INODE);
+		} else if (depth == MAX_DEPTH + 1) {
+			tracker_crawl_state_entry_add_child (&priv->current_index_root->current_dir_state,
+			                                     g_file_info_get_name (file_info),
+			                                     file_type, time);
+		}
+
 		tracker_file_system_set_property (priv->file_system, canonical,
 		                                  quark_property_filesystem_mtime,
 		                                  time_ptr);
@@ -620,12 +668,14 @@ sparql_contents_check_deleted (TrackerFileNotifier *notifier,
 			canonical = _insert_store_info (notifier, file,
 							file_type,
 			                                iri, 0);
+			priv->current_index_root->current_dir_changed = TRUE;
 			g_signal_emit (notifier, signals[FILE_DELETED], 0, canonical);
 		} else if (priv->current_index_root->current_dir_content_filtered ||
 		           !tracker_indexing_tree_file_is_indexable (priv->indexing_tree,
 		                                                     canonical,
 		                                                     file_type)) {
 			/* File is there, but is not indexable anymore, remove too */
+			priv->current_index_root->current_dir_changed = TRUE;
 			g_signal_emit (notifier, signals[FILE_DELETED], 0, canonical);
 		}
 
@@ -649,6 +699,7 @@ crawl_directory_in_current_root (TrackerFileNotifier *notifier)
 		return FALSE;
 
 	priv->current_index_root->current_dir = directory;
+	priv->current_index_root->current_dir_state = (TrackerCrawlStateEntry) { 0 };
 
 	if (priv->cancellable)
 		g_object_unref (priv->cancellable);
@@ -681,8 +732,22 @@ finish_current_directory (TrackerFileNotifier *notifier,
 
 	priv = notifier->priv;
 	directory = priv->current_index_root->current_dir;
+
+	if (priv->crawl_state) {
+		if (!interrupted &&
+		    !priv->current_index_root->current_dir_changed &&
+		    !priv->current_index_root->current_dir_content_filtered &&
+		    priv->current_index_root->current_dir_state.mtime != 0) {
+			tracker_crawl_state_insert (priv->crawl_state, directory,
+			                            &priv->current_index_root->current_dir_state);
+		} else {
+			tracker_crawl_state_remove (priv->crawl_state, directory);
+		}
+	}
+
 	priv->current_index_root->current_dir = NULL;
 	priv->current_index_root->current_dir_content_filtered = FALSE;
+	priv->current_index_root->current_dir_changed = FALSE;
 
 	/* If crawling was interrupted, we take all collected info as invalid.
 	 * Otherwise we dispose regular files here, only directories are
@@ -1027,6 +1092,50 @@ crawl_directories_start (TrackerFileNotifier *notifier)
 	return FALSE;
 }
 
+static gboolean
+file_notifier_is_directory_unchanged (TrackerFileNotifier *notifier)
+{
+	TrackerFileNotifierPrivate *priv = notifier->priv;
+	RootData *root_data = priv->current_index_root;
+
+	if (!priv->crawl_state || G_UNLIKELY (force_check_updated)) {
+		return FALSE;
+	}
+
+	if ((root_data->flags & TRACKER_DIRECTORY_FLAG_CHECK_DELETED) != 0 ||
+	    root_data->current_dir_content_filtered ||
+	    root_data->current_dir_state.mtime == 0) {
+		return FALSE;
+	}
+
+	return tracker_crawl_state_lookup (priv->crawl_state,
+	                                   root_data->current_dir,
+	                                   &root_data->current_dir_state);
+}
+
+/* Drops what was gathered for the store comparison, subdirectories
+ * are still crawled, and are known to be in the store.
+ */
+static void
+file_notifier_skip_directory_contents (TrackerFileNotifier *notifier)
+{
+	TrackerFileNotifierPrivate *priv = notifier->priv;
+	GPtrArray *query_files = priv->current_index_root->query_files;
+	guint i;
+
+	for (i = 0; i < query_files->len; i++) {
+		GFile *file = g_ptr_array_index (query_files, i);
+
+		tracker_file_system_unset_property (priv->file_system, file,
+		                                    quark_property_filesystem_mtime);
+		tracker_file_system_set_property (priv->file_system, file,
+		                                  quark_property_store_known,
+		                                  GINT_TO_POINTER (TRUE));
+	}
+
+	g_ptr_array_set_size (query_files, 0);
+}
+
 static void
 crawler_finished_cb (TrackerCrawler *crawler,
                      gboolean        was_interrupted,
@@ -1048,10 +1157,16 @@ crawler_finished_cb (TrackerCrawler *crawler,
 
 	directory = priv->current_index_root->current_dir;
 
-	if (priv->current_index_root->query_files->len > 0 &&
+	if (file_notifier_is_directory_unchanged (notifier)) {
+		/* Found in sync last time, and nothing changed since */
+		file_notifier_skip_directory_contents (notifier);
+		finish_current_directory (notifier, FALSE);
+	} else if (priv->current_index_root->query_files->len > 0 &&
 	    (directory == priv->current_index_root->root ||
 	     tracker_file_system_get_property (priv->file_system,
-	                                       directory, quark_property_iri))) {
+	                                       directory, quark_property_iri) ||
+	     tracker_file_system_steal_property (priv->file_system,
+	                                         directory, quark_property_store_known))) {
 		sparql_files_query_start (notifier,
                                   (GFile**) priv->current_index_root->query_files->pdata,
 		                          priv->current_index_root->query_files->len, max_depth);
@@ -1096,6 +1211,33 @@ notifier_queue_file (TrackerFileNotifier   *notifier,
 }
 
 /* Monitor signal handlers */
+/* Changes noticed at runtime may still be in the miner queues
+ * by shutdown, so don't trust the containing directory.
+ */
+static void
+file_notifier_crawl_state_invalidate (TrackerFileNotifier *notifier,
+                                      GFile               *file,
+                                      gboolean             is_directory)
+{
+	TrackerFileNotifierPrivate *priv = notifier->priv;
+	GFile *parent;
+
+	if (!priv->crawl_state) {
+		return;
+	}
+
+	if (is_directory) {
+		tracker_crawl_state_remove (priv->crawl_state, file);
+	}
+
+	parent = g_file_get_parent (file);
+
+	if (parent) {
+		tracker_crawl_state_remove (priv->crawl_state, parent);
+		g_object_unref (parent);
+	}
+}
+
 static void
 monitor_item_created_cb (TrackerMonitor *monitor,
                          GFile          *file,
@@ -1107,6 +1249,8 @@ monitor_item_created_cb (TrackerMonitor *monitor,
 	GFileType file_type;
 	GFile *canonical;
 
+	file_notifier_crawl_state_invalidate (notifier, file, is_directory);
+
 	file_type = (is_directory) ? G_FILE_TYPE_DIRECTORY : G_FILE_TYPE_REGULAR;
 
 	if (!tracker_indexing_tree_file_is_indexable (priv->indexing_tree,
@@ -1184,6 +1328,8 @@ monitor_item_updated_cb (TrackerMonitor *monitor,
 	GFileType file_type;
 	GFile *canonical;
 
+	file_notifier_crawl_state_invalidate (notifier, file, is_directory);
+
 	file_type = (is_directory) ? G_FILE_TYPE_DIRECTORY : G_FILE_TYPE_REGULAR;
 
 	if (!tracker_indexing_tree_file_is_indexable (priv->indexing_tree,
@@ -1214,6 +1360,8 @@ monitor_item_attribute_updated_cb (TrackerMonitor *monitor,
 	GFile *canonical;
 	GFileType file_type;
 
+	file_notifier_crawl_state_invalidate (notifier, file, is_directory);
+
 	file_type = (is_directory) ? G_FILE_TYPE_DIRECTORY : G_FILE_TYPE_REGULAR;
 
 	if (!tracker_indexing_tree_file_is_indexable (priv->indexing_tree,
@@ -1244,6 +1392,8 @@ monitor_item_deleted_cb (TrackerMonitor *monitor,
 	GFile *canonical;
 	GFileType file_type;
 
+	file_notifier_crawl_state_invalidate (notifier, file, is_directory);
+
 	file_type = (is_directory) ? G_FILE_TYPE_DIRECTORY : G_FILE_TYPE_REGULAR;
 
 	/* Remove monitors if any */
@@ -1333,6 +1483,9 @@ monitor_item_moved_cb (TrackerMonitor *monitor,
 	priv = notifier->priv;
 	tracker_indexing_tree_get_root (priv->indexing_tree, other_file, &flags);
 
+	file_notifier_crawl_state_invalidate (notifier, file, is_directory);
+	file_notifier_crawl_state_invalidate (notifier, other_file, is_directory);
+
 	if (!is_source_monitored) {
 		if (is_directory) {
 			/* Remove monitors if any */
@@ -1603,13 +1756,77 @@ indexing_tree_child_updated (TrackerIndexingTree *indexing_tree,
 	}
 }
 
+static gint64
+file_notifier_query_folder_count (TrackerFileNotifier  *notifier,
+                                  GError              **error)
+{
+	TrackerFileNotifierPrivate *priv;
+	TrackerSparqlCursor *cursor;
+	gint64 folder_count = -1;
+	GError *inner_error = NULL;
+
+	priv = notifier->priv;
+	cursor = tracker_sparql_connection_query (priv->connection,
+	                                          "SELECT COUNT(?f) { ?f a nfo:Folder }",
+	                                          NULL, &inner_error);
+
+	if (!inner_error && tracker_sparql_cursor_next (cursor, NULL, &inner_error)) {
+		folder_count = tracker_sparql_cursor_get_integer (cursor, 0);
+		tracker_sparql_cursor_close (cursor);
+	}
+
+	g_clear_object (&cursor);
+
+	if (inner_error) {
+		g_propagate_error (error, inner_error);
+		return -1;
+	}
+
+	return folder_count;
+}
+
+static void
+file_notifier_save_crawl_state (TrackerFileNotifier *notifier)
+{
+	TrackerFileNotifierPrivate *priv = notifier->priv;
+	gint64 folder_count;
+	GError *error = NULL;
+
+	if (!priv->connection) {
+		return;
+	}
+
+	/* The directory being crawled may be left half-checked */
+	if (priv->current_index_root && priv->current_index_root->current_dir) {
+		tracker_crawl_state_remove (priv->crawl_state,
+		                            priv->current_index_root->current_dir);
+	}
+
+	folder_count = file_notifier_query_folder_count (notifier, &error);
+
+	if (!error) {
+		tracker_crawl_state_save (priv->crawl_state, folder_count, &error);
+	}
+
+	if (error) {
+		g_warning ("Could not save crawl state: %s", error->message);
+		g_error_free (error);
+	}
+}
+
 static void
 tracker_file_notifier_finalize (GObject *object)
 {
 	TrackerFileNotifierPrivate *priv;
+	guint64 received, emitted, merged;
 
 	priv = TRACKER_FILE_NOTIFIER (object)->priv;
 
+	if (priv->crawl_state) {
+		file_notifier_save_crawl_state (TRACKER_FILE_NOTIFIER (object));
+		tracker_crawl_state_free (priv->crawl_state);
+	}
+
 	if (priv->indexing_tree) {
 		g_object_unref (priv->indexing_tree);
 	}
@@ -1623,6 +1840,11 @@ tracker_file_notifier_finalize (GObject *object)
 		g_object_unref (priv->cancellable);
 	}
 
+	tracker_monitor_get_event_counts (priv->monitor, &received, &emitted, &merged);
+	g_debug ("Monitor events: %" G_GUINT64_FORMAT " received, %"
+	         G_GUINT64_FORMAT " emitted, %" G_GUINT64_FORMAT " merged",
+	         received, emitted, merged);
+
 	g_object_unref (priv->crawler);
 	g_object_unref (priv->monitor);
 	g_object_unref (priv->file_system);
@@ -1635,6 +1857,13 @@ tracker_file_notifier_finalize (GObject *object)
 	g_list_free (priv->pending_index_roots);
 	g_timer_destroy (priv->timer);
 
+	if (priv->iri_flush_id) {
+		g_source_remove (priv->iri_flush_id);
+	}
+
+	g_hash_table_unref (priv->iri_batches);
+	g_hash_table_unref (priv->iri_pending);
+
 	G_OBJECT_CLASS (tracker_file_notifier_parent_class)->finalize (object);
 }
 
@@ -1642,19 +1871,14 @@ static void
 check_disable_monitor (TrackerFileNotifier *notifier)
 {
 	TrackerFileNotifierPrivate *priv;
-	TrackerSparqlCursor *cursor;
-	gint64 folder_count = 0;
+	gint64 folder_count;
 	GError *error = NULL;
 
 	priv = notifier->priv;
-	cursor = tracker_sparql_connection_query (priv->connection,
-	                                          "SELECT COUNT(?f) { ?f a nfo:Folder }",
-	                                          NULL, &error);
+	folder_count = file_notifier_query_folder_count (notifier, &error);
 
-	if (!error && tracker_sparql_cursor_next (cursor, NULL, &error)) {
-		folder_count = tracker_sparql_cursor_get_integer (cursor, 0);
-		tracker_sparql_cursor_close (cursor);
-	}
+	/* Kept to validate the crawl state */
+	priv->folder_count = folder_count;
 
 	if (error) {
 		g_warning ("Could not get folder count: %s\n", error->message);
@@ -1671,8 +1895,6 @@ check_disable_monitor (TrackerFileNotifier *notifier)
 		        "completed. Too many folders to monitor anyway");
 		tracker_monitor_set_enabled (priv->monitor, FALSE);
 	}
-
-	g_clear_object (&cursor);
 }
 
 static void
@@ -1703,7 +1925,15 @@ tracker_file_notifier_constructed (GObject *object)
 	priv->crawler = tracker_crawler_new (priv->data_provider);
 	tracker_crawler_set_file_attributes (priv->crawler,
 	                                     G_FILE_ATTRIBUTE_TIME_MODIFIED ","
-	                                     G_FILE_ATTRIBUTE_STANDARD_TYPE);
+	                                     G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+	                                     G_FILE_ATTRIBUTE_UNIX_INODE);
+
+	/* Only the default file data provider is known to be
+	 * usable from several threads.
+	 */
+	if (!priv->data_provider) {
+		tracker_crawler_set_n_workers (priv->crawler, crawler_n_workers);
+	}
 
 	g_signal_connect (priv->crawler, "check-file",
 	                  G_CALLBACK (crawler_check_file_cb),
@@ -1746,6 +1976,7 @@ static void
 tracker_file_notifier_class_init (TrackerFileNotifierClass *klass)
 {
 	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	const gchar *crawler_workers, *event_window;
 
 	object_class->finalize = tracker_file_notifier_finalize;
 	object_class->set_property = tracker_file_notifier_set_property;
@@ -1824,6 +2055,16 @@ tracker_file_notifier_class_init (TrackerFileNotifierClass *klass)
 		              NULL, NULL,
 		              NULL,
 		              G_TYPE_NONE, 0, G_TYPE_NONE);
+	signals[FILE_IRI_RESOLVED] =
+		g_signal_new ("file-iri-resolved",
+		              G_TYPE_FROM_CLASS (klass),
+		              G_SIGNAL_RUN_LAST,
+		              G_STRUCT_OFFSET (TrackerFileNotifierClass,
+		                               file_iri_resolved),
+		              NULL, NULL,
+		              NULL,
+		              G_TYPE_NONE,
+		              1, G_TYPE_FILE);
 
 	g_object_class_install_property (object_class,
 	                                 PROP_INDEXING_TREE,
@@ -1857,6 +2098,12 @@ tracker_file_notifier_class_init (TrackerFileNotifierClass *klass)
 	quark_property_iri = g_quark_from_static_string ("tracker-property-iri");
 	tracker_file_system_register_property (quark_property_iri, g_free);
 
+	quark_property_iri_queried = g_quark_from_static_string ("tracker-property-iri-queried");
+	tracker_file_system_register_property (quark_property_iri_queried, NULL);
+
+	quark_property_store_known = g_quark_from_static_string ("tracker-property-store-known");
+	tracker_file_system_register_property (quark_property_store_known, NULL);
+
 	quark_property_store_mtime = g_quark_from_static_string ("tracker-property-store-mtime");
 	tracker_file_system_register_property (quark_property_store_mtime,
 	                                       g_free);
@@ -1866,6 +2113,20 @@ tracker_file_notifier_class_init (TrackerFileNotifierClass *klass)
 	                                       g_free);
 
 	force_check_updated = g_getenv ("TRACKER_MINER_FORCE_CHECK_UPDATED") != NULL;
+
+	crawler_workers = g_getenv ("TRACKER_MINER_CRAWLER_WORKERS");
+
+	if (crawler_workers) {
+		crawler_n_workers = (guint) g_ascii_strtoull (crawler_workers, NULL, 10);
+	} else {
+		crawler_n_workers = CLAMP (g_get_num_processors (), 1, MAX_CRAWLER_WORKERS);
+	}
+
+	event_window = g_getenv ("TRACKER_MINER_MONITOR_EVENT_WINDOW");
+
+	if (event_window) {
+		monitor_event_window = (guint) g_ascii_strtoull (event_window, NULL, 10);
+	}
 }
 
 static void
@@ -1881,9 +2142,19 @@ tracker_file_notifier_init (TrackerFileNotifier *notifier)
 	priv->timer = g_timer_new ();
 	priv->stopped = TRUE;
 
+	priv->iri_batches = g_hash_table_new_full (g_file_hash,
+	                                           (GEqualFunc) g_file_equal,
+	                                           (GDestroyNotify) g_object_unref,
+	                                           (GDestroyNotify) g_ptr_array_unref);
+	priv->iri_pending = g_hash_table_new (NULL, NULL);
+
 	/* Set up monitor */
 	priv->monitor = tracker_monitor_new ();
 
+	if (monitor_event_window > 0) {
+		tracker_monitor_set_event_window (priv->monitor, monitor_event_window);
+	}
+
 	g_signal_connect (priv->monitor, "item-created",
 	                  G_CALLBACK (monitor_item_created_cb),
 	                  notifier);
@@ -1959,6 +2230,32 @@ tracker_file_notifier_stop (TrackerFileNotifier *notifier)
 	}
 }
 
+/* Makes @notifier skip checking the contents of directories that
+ * are unchanged since they were found in sync with the store on a
+ * previous run. The state is kept in @file, which is written when
+ * @notifier is finalized.
+ */
+void
+tracker_file_notifier_set_crawl_state_file (TrackerFileNotifier *notifier,
+                                            GFile               *file)
+{
+	TrackerFileNotifierPrivate *priv;
+
+	g_return_if_fail (TRACKER_IS_FILE_NOTIFIER (notifier));
+	g_return_if_fail (!file || G_IS_FILE (file));
+
+	priv = notifier->priv;
+
+	if (priv->crawl_state) {
+		tracker_crawl_state_free (priv->crawl_state);
+		priv->crawl_state = NULL;
+	}
+
+	if (file) {
+		priv->crawl_state = tracker_crawl_state_new (file, priv->folder_count);
+	}
+}
+
 gboolean
 tracker_file_notifier_is_active (TrackerFileNotifier *notifier)
 {
@@ -2018,6 +2315,12 @@ tracker_file_notifier_get_file_iri (TrackerFileNotifier *notifier,
 		const gchar *str;
 		gchar *sparql;
 
+		/* A batched lookup already found nothing for this file */
+		if (tracker_file_system_steal_property (priv->file_system, canonical,
+		                                        quark_property_iri_queried)) {
+			return NULL;
+		}
+
 		/* Fetch data for this file synchronously */
 		sparql = sparql_files_compose_query (&file, 1);
 		cursor = tracker_sparql_connection_query (priv->connection,
@@ -2042,6 +2345,210 @@ tracker_file_notifier_get_file_iri (TrackerFileNotifier *notifier,
 	return iri;
 }
 
+/* Returns TRUE if tracker_file_notifier_get_file_iri() would
+ * need querying the store for this file.
+ */
+static gboolean
+file_notifier_needs_iri_query (TrackerFileNotifier *notifier,
+                               GFile               *canonical,
+                               gboolean             force)
+{
+	TrackerFileNotifierPrivate *priv;
+	gchar *iri = NULL;
+	gboolean found;
+
+	priv = notifier->priv;
+	found = tracker_file_system_get_property_full (priv->file_system,
+	                                               canonical,
+	                                               quark_property_iri,
+	                                               (gpointer *) &iri);
+	if (iri) {
+		return FALSE;
+	}
+
+	/* A NULL iri forces the query, see tracker_file_notifier_get_file_iri() */
+	if (!found && !force) {
+		return FALSE;
+	}
+
+	return !tracker_file_system_get_property_full (priv->file_system,
+	                                               canonical,
+	                                               quark_property_iri_queried,
+	                                               NULL);
+}
+
+static void
+sparql_iris_query_cb (GObject      *object,
+                      GAsyncResult *result,
+                      gpointer      user_data)
+{
+	SparqlIrisData *data = user_data;
+	TrackerFileNotifierPrivate *priv;
+	TrackerSparqlCursor *cursor;
+	GHashTable *iris;
+	GError *error = NULL;
+	guint i;
+
+	priv = data->notifier->priv;
+	iris = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+	cursor = tracker_sparql_connection_query_finish (TRACKER_SPARQL_CONNECTION (object),
+	                                                 result, &error);
+	if (error) {
+		g_warning ("Could not query file IRIs: %s", error->message);
+		g_error_free (error);
+	} else if (cursor) {
+		while (tracker_sparql_cursor_next (cursor, NULL, NULL)) {
+			g_hash_table_insert (iris,
+			                     g_strdup (tracker_sparql_cursor_get_string (cursor, 0, NULL)),
+			                     g_strdup (tracker_sparql_cursor_get_string (cursor, 1, NULL)));
+		}
+
+		g_object_unref (cursor);
+	}
+
+	for (i = 0; i < data->files->len; i++) {
+		GFile *file;
+		gchar *uri, *iri;
+
+		file = g_ptr_array_index (data->files, i);
+		uri = g_file_get_uri (file);
+		iri = g_hash_table_lookup (iris, uri);
+
+		if (iri) {
+			tracker_file_system_set_property (priv->file_system, file,
+			                                  quark_property_iri,
+			                                  g_strdup (iri));
+		} else {
+			/* Not in the store, remember so it isn't queried again */
+			tracker_file_system_set_property (priv->file_system, file,
+			                                  quark_property_iri_queried,
+			                                  GINT_TO_POINTER (TRUE));
+		}
+
+		g_hash_table_remove (priv->iri_pending, file);
+		g_signal_emit (data->notifier, signals[FILE_IRI_RESOLVED], 0, file);
+		g_free (uri);
+	}
+
+	g_hash_table_unref (iris);
+	g_ptr_array_unref (data->files);
+	g_object_unref (data->notifier);
+	g_free (data);
+}
+
+static void
+sparql_iris_query_start (TrackerFileNotifier *notifier,
+                         GPtrArray           *files)
+{
+	TrackerFileNotifierPrivate *priv;
+	SparqlIrisData *data;
+	gchar *sparql;
+
+	priv = notifier->priv;
+
+	data = g_new (SparqlIrisData, 1);
+	data->notifier = g_object_ref (notifier);
+	data->files = g_ptr_array_ref (files);
+
+	sparql = sparql_files_compose_query ((GFile **) files->pdata, files->len);
+	tracker_sparql_connection_query_async (priv->connection,
+	                                       sparql,
+	                                       NULL,
+	                                       sparql_iris_query_cb,
+	                                       data);
+	g_free (sparql);
+}
+
+static gboolean
+file_notifier_flush_iri_batches_cb (gpointer user_data)
+{
+	TrackerFileNotifier *notifier = user_data;
+	TrackerFileNotifierPrivate *priv;
+	GHashTableIter iter;
+	GPtrArray *files;
+
+	priv = notifier->priv;
+	priv->iri_flush_id = 0;
+
+	g_hash_table_iter_init (&iter, priv->iri_batches);
+
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &files)) {
+		sparql_iris_query_start (notifier, files);
+		g_hash_table_iter_remove (&iter);
+	}
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Returns TRUE if tracker_file_notifier_get_file_iri() can return
+ * the IRI without querying the store. Otherwise the file is queued
+ * for an asynchronous lookup together with other files in the same
+ * directory, and ::file-iri-resolved is emitted once it's known.
+ */
+gboolean
+tracker_file_notifier_prefetch_file_iri (TrackerFileNotifier *notifier,
+                                         GFile               *file,
+                                         gboolean             force)
+{
+	TrackerFileNotifierPrivate *priv;
+	GFile *canonical, *parent;
+	GPtrArray *files;
+
+	g_return_val_if_fail (TRACKER_IS_FILE_NOTIFIER (notifier), TRUE);
+	g_return_val_if_fail (G_IS_FILE (file), TRUE);
+
+	priv = notifier->priv;
+
+	if (G_UNLIKELY (priv->connection == NULL)) {
+		return TRUE;
+	}
+
+	canonical = tracker_file_system_get_file (priv->file_system,
+	                                          file,
+	                                          G_FILE_TYPE_REGULAR,
+	                                          NULL);
+	if (!canonical) {
+		return TRUE;
+	}
+
+	if (g_hash_table_contains (priv->iri_pending, canonical)) {
+		return FALSE;
+	}
+
+	if (!file_notifier_needs_iri_query (notifier, canonical, force)) {
+		return TRUE;
+	}
+
+	parent = g_file_get_parent (canonical);
+
+	if (!parent) {
+		parent = g_object_ref (canonical);
+	}
+
+	files = g_hash_table_lookup (priv->iri_batches, parent);
+
+	if (!files) {
+		files = g_ptr_array_new_with_free_func (g_object_unref);
+		g_hash_table_insert (priv->iri_batches, g_object_ref (parent), files);
+	}
+
+	g_ptr_array_add (files, g_object_ref (canonical));
+	g_hash_table_add (priv->iri_pending, canonical);
+
+	if (files->len >= IRI_BATCH_SIZE) {
+		sparql_iris_query_start (notifier, files);
+		g_hash_table_remove (priv->iri_batches, parent);
+	} else if (priv->iri_flush_id == 0) {
+		priv->iri_flush_id = g_idle_add (file_notifier_flush_iri_batches_cb,
+		                                 notifier);
+	}
+
+	g_object_unref (parent);
+
+	return FALSE;
+}
+
 static gboolean
 file_notifier_invalidate_file_iri_foreach (GFile    *file,
                                            gpointer  user_data)
@@ -2052,6 +2559,9 @@ file_notifier_invalidate_file_iri_foreach (GFile    *file,
 	                                  file,
 	                                  quark_property_iri,
 	                                  NULL);
+	tracker_file_system_unset_property (file_system,
+	                                    file,
+	                                    quark_property_iri_queried);
 
 	return FALSE;
 }
@@ -2082,6 +2592,9 @@ tracker_file_notifier_invalidate_file_iri (TrackerFileNotifier *notifier,
 		                                  canonical,
 		                                  quark_property_iri,
 		                                  NULL);
+		tracker_file_system_unset_property (priv->file_system,
+		                                    canonical,
+		                                    quark_property_iri_queried);
 		return;
 	}
 
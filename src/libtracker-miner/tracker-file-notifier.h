@@ -73,6 +73,9 @@ struct _TrackerFileNotifierClass {
 	                             guint                files_ignored);
 
 	void (* finished)           (TrackerFileNotifier *notifier);
+
+	void (* file_iri_resolved)  (TrackerFileNotifier *notifier,
+	                             GFile               *file);
 };
 
 GType         tracker_file_notifier_get_type     (void) G_GNUC_CONST;
@@ -86,10 +89,17 @@ gboolean      tracker_file_notifier_start        (TrackerFileNotifier     *notif
 void          tracker_file_notifier_stop         (TrackerFileNotifier     *notifier);
 gboolean      tracker_file_notifier_is_active    (TrackerFileNotifier     *notifier);
 
+void          tracker_file_notifier_set_crawl_state_file (TrackerFileNotifier *notifier,
+                                                          GFile               *file);
+
 const gchar * tracker_file_notifier_get_file_iri (TrackerFileNotifier     *notifier,
                                                   GFile                   *file,
                                                   gboolean                 force);
 
+gboolean      tracker_file_notifier_prefetch_file_iri (TrackerFileNotifier *notifier,
+                                                       GFile               *file,
+                                                       gboolean             force);
+
 void          tracker_file_notifier_invalidate_file_iri (TrackerFileNotifier *notifier,
                                                          GFile               *file,
                                                          gboolean             recursive);
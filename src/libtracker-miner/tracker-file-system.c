@@ -45,6 +45,7 @@ struct _FileNodeData {
 	GFile *file;
 	gchar *uri_prefix;
 	GArray *properties;
+	GHashTable *children;
 	guint shallow   : 1;
 	guint unowned : 1;
 	guint file_type : 4;
@@ -105,6 +106,10 @@ file_node_data_free (FileNodeData *data,
 	data->file = NULL;
 	g_free (data->uri_prefix);
 
+	if (data->children) {
+		g_hash_table_unref (data->children);
+	}
+
 	for (i = 0; i < data->properties->len; i++) {
 		FileNodeProperty *property;
 		GDestroyNotify destroy_notify;
@@ -214,6 +219,113 @@ file_node_data_equal_or_child (GNode  *node,
 	}
 }
 
+/* Children are indexed in their parent by uri_prefix, the key is
+ * owned by the child data, so the child must be unlinked from the
+ * index before it is freed or moved elsewhere.
+ */
+static void
+file_node_link_child (GNode *parent,
+                      GNode *node)
+{
+	FileNodeData *parent_data, *data;
+
+	parent_data = parent->data;
+	data = node->data;
+
+	if (!parent_data->children) {
+		parent_data->children = g_hash_table_new (g_str_hash,
+		                                          g_str_equal);
+	}
+
+	/* If a node with the same uri_prefix is already there, keep it */
+	if (!g_hash_table_contains (parent_data->children, data->uri_prefix)) {
+		g_hash_table_insert (parent_data->children,
+		                     data->uri_prefix, node);
+	}
+}
+
+static void
+file_node_unlink_child (GNode *node)
+{
+	FileNodeData *parent_data, *data;
+
+	if (!node->parent) {
+		return;
+	}
+
+	parent_data = node->parent->data;
+	data = node->data;
+
+	if (parent_data->children &&
+	    g_hash_table_lookup (parent_data->children,
+	                         data->uri_prefix) == node) {
+		g_hash_table_remove (parent_data->children, data->uri_prefix);
+	}
+}
+
+static GNode *
+file_node_lookup_child (GNode  *parent,
+                        gchar  *uri_remainder,
+                        gchar  *uri_end,
+                        gchar **next_remainder)
+{
+	FileNodeData *data;
+	gchar *end = uri_end;
+
+	data = parent->data;
+
+	if (!data->children) {
+		return NULL;
+	}
+
+	/* A child uri_prefix may span several path components if the
+	 * nodes in between are not in the tree, so try the longest
+	 * component boundary first, terminating the uri in place.
+	 */
+	while (end > uri_remainder) {
+		GNode *child;
+		gchar c;
+
+		c = *end;
+		*end = '\0';
+		child = g_hash_table_lookup (data->children, uri_remainder);
+		*end = c;
+
+		if (child) {
+			*next_remainder = (c == '/') ? end + 1 : end;
+			return child;
+		}
+
+		do {
+			end--;
+		} while (end > uri_remainder && *end != '/');
+	}
+
+	return NULL;
+}
+
+/* Matches the uri against the uri prefixes of node and its
+ * parents, returns the remainder of the uri after node's.
+ */
+static gchar *
+file_node_match_uri (GNode *node,
+                     gchar *uri)
+{
+	if (!G_NODE_IS_ROOT (node)) {
+		uri = file_node_match_uri (node->parent, uri);
+
+		if (!uri) {
+			return NULL;
+		}
+	}
+
+	if (!file_node_data_equal_or_child (node, uri, &uri)) {
+		return NULL;
+	}
+
+	return uri;
+}
+
 static GNode *
 file_tree_lookup (GNode     *tree,
                   GFile     *file,
@@ -221,14 +333,12 @@ file_tree_lookup (GNode     *tree,
                   gchar    **uri_remainder)
 {
 	GNode *parent, *node_found, *parent_found;
-	FileNodeData *data;
-	gchar *uri, *ptr;
+	gchar *uri, *ptr, *end;
 
-	uri = ptr = g_file_get_uri (file);
 	node_found = parent_found = NULL;
 
-	/* Run through the filesystem tree, comparing chunks of
-	 * uri with the uri prefix in the file nodes, this would
+	/* Run through the filesystem tree, looking up chunks of
+	 * uri in the children of each file node, this would
 	 * get us to the closest registered parent, or the file
 	 * itself.
 	 */
@@ -245,63 +355,33 @@ file_tree_lookup (GNode     *tree,
 		return NULL;
 	}
 
-	if (!G_NODE_IS_ROOT (tree)) {
-		FileNodeData *parent_data;
-		gchar *parent_uri;
+	uri = g_file_get_uri (file);
+	end = uri + strlen (uri);
 
-		parent_data = tree->data;
-		parent_uri = g_file_get_uri (parent_data->file);
+	/* First check the uri is within the tree node */
+	ptr = file_node_match_uri (tree, uri);
 
-		/* Sanity check */
-		if (!g_str_has_prefix (uri, parent_uri)) {
-			g_free (parent_uri);
-			return NULL;
-		}
-
-		ptr += strlen (parent_uri);
-
-		g_assert (ptr[0] == '/');
-		ptr++;
-
-		g_free (parent_uri);
-	} else {
-		/* First check the root node */
-		if (!file_node_data_equal_or_child (tree, uri, &ptr)) {
-			g_free (uri);
-			return NULL;
-		}
+	if (!ptr) {
+		g_free (uri);
+		return NULL;
+	}
 
-		/* Second check there is no basename and if there isn't,
-		 * then this node MUST be the closest registered node
-		 * we can use for the uri. The difference here is that
-		 * we return tree not NULL.
-		 */
-		else if (ptr[0] == '\0') {
-			g_free (uri);
-			return tree;
-                }
+	/* Second check there is no basename and if there isn't,
+	 * then this node MUST be the closest registered node
+	 * we can use for the uri. The difference here is that
+	 * we return tree not NULL.
+	 */
+	else if (ptr[0] == '\0') {
+		g_free (uri);
+		return tree;
 	}
 
 	parent = tree;
 
 	while (parent) {
-		GNode *child, *next = NULL;
-		gchar *ret_ptr;
-
-		for (child = g_node_first_child (parent);
-		     child != NULL;
-		     child = g_node_next_sibling (child)) {
-			data = child->data;
+		GNode *next;
 
-			if (data->uri_prefix[0] != ptr[0])
-				continue;
-
-			if (file_node_data_equal_or_child (child, ptr, &ret_ptr)) {
-				ptr = ret_ptr;
-				next = child;
-				break;
-			}
-		}
+		next = file_node_lookup_child (parent, ptr, end, &ptr);
 
 		if (next) {
 			if (ptr[0] == '\0') {
@@ -494,6 +574,7 @@ reparent_child_nodes_to_parent (GNode *node)
 
 		g_node_unlink (cur);
 		g_node_prepend (parent, cur);
+		file_node_link_child (parent, cur);
 	}
 }
 
@@ -510,6 +591,7 @@ file_weak_ref_notify (gpointer  user_data,
 	g_assert (data->file == (GFile *) prev_location);
 
 	data->file = NULL;
+	file_node_unlink_child (node);
 	reparent_child_nodes_to_parent (node);
 
 	/* Delete node tree here */
@@ -596,6 +678,7 @@ tracker_file_system_get_file (TrackerFileSystem *file_system,
 		data->uri_prefix = uri_prefix;
 
 		g_node_append (parent_node, node);
+		file_node_link_child (parent_node, node);
 	} else {
 		data = node->data;
 		g_free (uri_prefix);
@@ -19,6 +19,8 @@
  * Author: Carlos Garnacho  <carlos@lanedo.com>
  */
 
+#include <string.h>
+
 #include <libtracker-common/tracker-file-utils.h>
 #include "tracker-indexing-tree.h"
 
@@ -35,6 +37,8 @@ G_DEFINE_TYPE (TrackerIndexingTree, tracker_indexing_tree, G_TYPE_OBJECT)
 typedef struct _TrackerIndexingTreePrivate TrackerIndexingTreePrivate;
 typedef struct _NodeData NodeData;
 typedef struct _PatternData PatternData;
+typedef struct _FilterMatcher FilterMatcher;
+typedef struct _TrieNode TrieNode;
 typedef struct _FindNodeData FindNodeData;
 
 struct _NodeData
@@ -48,10 +52,37 @@ struct _NodeData
 struct _PatternData
 {
 	GPatternSpec *pattern;
+	gchar *glob_string;
 	TrackerFilterType type;
 	GFile *file; /* Only filled in in absolute paths */
 };
 
+/* Nodes are kept in an array, the root being the first
+ * element, so 0 doubles as "no node" for links.
+ */
+struct _TrieNode
+{
+	guint child;
+	guint sibling;
+	guchar byte;
+	guchar terminal;
+};
+
+/* All filters of a type, compiled so most basenames are matched in
+ * a single pass. Literal globs go in a hash table, "prefix*" and
+ * "*suffix" ones in tries, only the remaining globs are matched one
+ * by one.
+ */
+struct _FilterMatcher
+{
+	GHashTable *literals;
+	GArray *prefixes;
+	GArray *suffixes;
+	GList *patterns;
+	GList *paths;
+	guint match_all : 1;
+};
+
 struct _FindNodeData
 {
 	GEqualFunc func;
@@ -63,6 +94,7 @@ struct _TrackerIndexingTreePrivate
 {
 	GNode *config_tree;
 	GList *filter_patterns;
+	FilterMatcher *matchers[TRACKER_FILTER_PARENT_DIRECTORY + 1];
 	TrackerFilterPolicy policies[TRACKER_FILTER_PARENT_DIRECTORY + 1];
 
 	GFile *root;
@@ -121,6 +153,7 @@ pattern_data_new (const gchar *glob_string,
 
 	data = g_slice_new0 (PatternData);
 	data->pattern = g_pattern_spec_new (glob_string);
+	data->glob_string = g_strdup (glob_string);
 	data->type = type;
 
 	if (g_path_is_absolute (glob_string)) {
@@ -138,9 +171,228 @@ pattern_data_free (PatternData *data)
 	}
 
 	g_pattern_spec_free (data->pattern);
+	g_free (data->glob_string);
 	g_slice_free (PatternData, data);
 }
 
+static GArray *
+trie_new (void)
+{
+	GArray *trie;
+	TrieNode root = { 0, };
+
+	trie = g_array_new (FALSE, FALSE, sizeof (TrieNode));
+	g_array_append_val (trie, root);
+
+	return trie;
+}
+
+static void
+trie_insert (GArray      *trie,
+             const gchar *str,
+             gsize        len,
+             gboolean     reverse)
+{
+	guint node = 0, i;
+
+	for (i = 0; i < len; i++) {
+		guchar byte;
+		guint child;
+
+		byte = (guchar) str[reverse ? len - i - 1 : i];
+		child = g_array_index (trie, TrieNode, node).child;
+
+		while (child != 0 &&
+		       g_array_index (trie, TrieNode, child).byte != byte) {
+			child = g_array_index (trie, TrieNode, child).sibling;
+		}
+
+		if (child == 0) {
+			TrieNode new_node = { 0, };
+
+			new_node.byte = byte;
+			new_node.sibling = g_array_index (trie, TrieNode, node).child;
+			child = trie->len;
+			g_array_append_val (trie, new_node);
+			g_array_index (trie, TrieNode, node).child = child;
+		}
+
+		node = child;
+	}
+
+	g_array_index (trie, TrieNode, node).terminal = TRUE;
+}
+
+/* Returns TRUE if any string in @trie is a prefix of @str, or
+ * a suffix if @reverse is TRUE.
+ */
+static gboolean
+trie_match (GArray      *trie,
+            const gchar *str,
+            gsize        len,
+            gboolean     reverse)
+{
+	guint node = 0, i;
+
+	for (i = 0; i < len; i++) {
+		guchar byte;
+
+		byte = (guchar) str[reverse ? len - i - 1 : i];
+		node = g_array_index (trie, TrieNode, node).child;
+
+		while (node != 0 &&
+		       g_array_index (trie, TrieNode, node).byte != byte) {
+			node = g_array_index (trie, TrieNode, node).sibling;
+		}
+
+		if (node == 0) {
+			return FALSE;
+		}
+
+		if (g_array_index (trie, TrieNode, node).terminal) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static void
+filter_matcher_add_pattern (FilterMatcher *matcher,
+                            PatternData   *data)
+{
+	const gchar *glob, *start, *end;
+
+	if (data->file) {
+		/* The glob has slashes, so it can only
+		 * match as a path, never as a basename.
+		 */
+		matcher->paths = g_list_prepend (matcher->paths, data);
+		return;
+	}
+
+	glob = data->glob_string;
+
+	if (strchr (glob, '?')) {
+		matcher->patterns = g_list_prepend (matcher->patterns, data);
+		return;
+	}
+
+	/* Find the literal part between leading and trailing stars */
+	start = glob;
+	while (*start == '*') {
+		start++;
+	}
+
+	end = start + strlen (start);
+	while (end > start && end[-1] == '*') {
+		end--;
+	}
+
+	if (memchr (start, '*', end - start)) {
+		matcher->patterns = g_list_prepend (matcher->patterns, data);
+	} else if (start == end && start != glob) {
+		matcher->match_all = TRUE;
+	} else if (start != glob && *end != '\0') {
+		/* Stars on both ends */
+		matcher->patterns = g_list_prepend (matcher->patterns, data);
+	} else if (start != glob) {
+		trie_insert (matcher->suffixes, start, end - start, TRUE);
+	} else if (*end != '\0') {
+		trie_insert (matcher->prefixes, start, end - start, FALSE);
+	} else {
+		g_hash_table_add (matcher->literals, (gpointer) glob);
+	}
+}
+
+static FilterMatcher *
+filter_matcher_new (GList             *filter_patterns,
+                    TrackerFilterType  type)
+{
+	FilterMatcher *matcher;
+	GList *l;
+
+	matcher = g_slice_new0 (FilterMatcher);
+	matcher->literals = g_hash_table_new (g_str_hash, g_str_equal);
+	matcher->prefixes = trie_new ();
+	matcher->suffixes = trie_new ();
+
+	for (l = filter_patterns; l; l = l->next) {
+		PatternData *data = l->data;
+
+		if (data->type == type) {
+			filter_matcher_add_pattern (matcher, data);
+		}
+	}
+
+	return matcher;
+}
+
+static void
+filter_matcher_free (FilterMatcher *matcher)
+{
+	g_hash_table_unref (matcher->literals);
+	g_array_unref (matcher->prefixes);
+	g_array_unref (matcher->suffixes);
+	g_list_free (matcher->patterns);
+	g_list_free (matcher->paths);
+	g_slice_free (FilterMatcher, matcher);
+}
+
+static gboolean
+filter_matcher_match (FilterMatcher *matcher,
+                      GFile         *file)
+{
+	gboolean match = FALSE;
+	gchar *basename;
+	GList *l;
+	gsize len;
+
+	if (matcher->match_all) {
+		return TRUE;
+	}
+
+	for (l = matcher->paths; l; l = l->next) {
+		PatternData *data = l->data;
+
+		if (g_file_equal (file, data->file) ||
+		    g_file_has_prefix (file, data->file)) {
+			return TRUE;
+		}
+	}
+
+	basename = g_file_get_basename (file);
+	len = strlen (basename);
+
+	if (g_hash_table_contains (matcher->literals, basename) ||
+	    trie_match (matcher->prefixes, basename, len, FALSE) ||
+	    trie_match (matcher->suffixes, basename, len, TRUE)) {
+		match = TRUE;
+	}
+
+	for (l = matcher->patterns; l && !match; l = l->next) {
+		PatternData *data = l->data;
+
+		match = g_pattern_match (data->pattern, len, basename, NULL);
+	}
+
+	g_free (basename);
+
+	return match;
+}
+
+static void
+indexing_tree_invalidate_matcher (TrackerIndexingTree *tree,
+                                  TrackerFilterType    type)
+{
+	TrackerIndexingTreePrivate *priv = tree->priv;
+
+	if (priv->matchers[type]) {
+		filter_matcher_free (priv->matchers[type]);
+		priv->matchers[type] = NULL;
+	}
+}
+
 static void
 tracker_indexing_tree_get_property (GObject    *object,
                                     guint       prop_id,
@@ -218,10 +470,15 @@ tracker_indexing_tree_finalize (GObject *object)
 {
 	TrackerIndexingTreePrivate *priv;
 	TrackerIndexingTree *tree;
+	gint i;
 
 	tree = TRACKER_INDEXING_TREE (object);
 	priv = tree->priv;
 
+	for (i = TRACKER_FILTER_FILE; i <= TRACKER_FILTER_PARENT_DIRECTORY; i++) {
+		indexing_tree_invalidate_matcher (tree, i);
+	}
+
 	g_list_foreach (priv->filter_patterns, (GFunc) pattern_data_free, NULL);
 	g_list_free (priv->filter_patterns);
 
@@ -702,6 +959,7 @@ tracker_indexing_tree_add_filter (TrackerIndexingTree *tree,
 
 	data = pattern_data_new (glob_string, filter);
 	priv->filter_patterns = g_list_prepend (priv->filter_patterns, data);
+	indexing_tree_invalidate_matcher (tree, filter);
 }
 
 /**
@@ -721,6 +979,7 @@ tracker_indexing_tree_clear_filters (TrackerIndexingTree *tree,
 	g_return_if_fail (TRACKER_IS_INDEXING_TREE (tree));
 
 	priv = tree->priv;
+	indexing_tree_invalidate_matcher (tree, type);
 
 	for (l = priv->filter_patterns; l; l = l->next) {
 		PatternData *data = l->data;
@@ -752,39 +1011,21 @@ tracker_indexing_tree_file_matches_filter (TrackerIndexingTree *tree,
                                            GFile               *file)
 {
 	TrackerIndexingTreePrivate *priv;
-	GList *filters;
-	gchar *basename;
 
 	g_return_val_if_fail (TRACKER_IS_INDEXING_TREE (tree), FALSE);
 	g_return_val_if_fail (G_IS_FILE (file), FALSE);
 
 	priv = tree->priv;
-	filters = priv->filter_patterns;
-	basename = g_file_get_basename (file);
-
-	while (filters) {
-		PatternData *data = filters->data;
-
-		filters = filters->next;
-
-		if (data->type != type)
-			continue;
 
-		if (data->file &&
-		    (g_file_equal (file, data->file) ||
-		     g_file_has_prefix (file, data->file))) {
-			g_free (basename);
-			return TRUE;
-		}
+	if (!priv->filter_patterns) {
+		return FALSE;
+	}
 
-		if (g_pattern_match_string (data->pattern, basename)) {
-			g_free (basename);
-			return TRUE;
-		}
+	if (!priv->matchers[type]) {
+		priv->matchers[type] = filter_matcher_new (priv->filter_patterns, type);
 	}
 
-	g_free (basename);
-	return FALSE;
+	return filter_matcher_match (priv->matchers[type], file);
 }
 
 static gboolean
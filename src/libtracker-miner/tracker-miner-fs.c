@@ -91,6 +91,12 @@ static gboolean miner_fs_queues_status_trace_timeout_cb (gpointer data);
 #define DEFAULT_WAIT_POOL_LIMIT 1
 #define DEFAULT_READY_POOL_LIMIT 1
 
+/* Commit latency (msec) the ready pool limit is adapted to */
+#define DEFAULT_TARGET_LATENCY 1000
+
+/* Batches of READY tasks committed to the store at once */
+#define DEFAULT_COMMIT_LIMIT 2
+
 /* Put tasks processing at a lower priority so other events
  * (timeouts, monitor events, etc...) are guaranteed to be
  * dispatched promptly.
@@ -164,6 +170,11 @@ struct _TrackerMinerFSPrivate {
 	TrackerPriorityQueue *items_deleted;
 	TrackerPriorityQueue *items_moved;
 
+	/* Items waiting for an IRI lookup, by the file being looked up */
+	GHashTable *items_waiting_iri;
+	/* The same items by their own file, the dest file for moves */
+	GHashTable *items_waiting_file;
+
 	guint item_queues_handler_id;
 	GFile *item_queue_blocker;
 
@@ -176,11 +187,14 @@ struct _TrackerMinerFSPrivate {
 	TrackerIndexingTree *indexing_tree;
 	TrackerFileNotifier *file_notifier;
 	TrackerDataProvider *data_provider;
+	GFile *crawl_state_file;
 
 	/* Sparql insertion tasks */
 	TrackerTaskPool *task_pool;
 	TrackerSparqlBuffer *sparql_buffer;
 	guint sparql_buffer_limit;
+	guint sparql_buffer_target_latency;
+	guint sparql_buffer_commit_limit;
 
 	/* File properties */
 	GQuark quark_ignore_file;
@@ -235,6 +249,18 @@ typedef enum {
 	QUEUE_WAIT,
 } QueueState;
 
+typedef struct {
+	QueueState queue;
+	GFile *file;
+	GFile *source_file;
+	gint priority;
+
+	/* Links in the items_waiting_iri and items_waiting_file lists */
+	GFile *urn_file;
+	GList *urn_link;
+	GList *file_link;
+} ItemWaitingData;
+
 enum {
 	PROCESS_FILE,
 	PROCESS_FILE_ATTRIBUTES,
@@ -252,7 +278,14 @@ enum {
 	PROP_ROOT,
 	PROP_WAIT_POOL_LIMIT,
 	PROP_READY_POOL_LIMIT,
-	PROP_DATA_PROVIDER
+	PROP_DATA_PROVIDER,
+	PROP_CRAWL_STATE_FILE,
+	PROP_TARGET_LATENCY,
+	PROP_COMMIT_LIMIT,
+	PROP_BATCH_SIZE,
+	PROP_BATCHES_IN_FLIGHT,
+	PROP_COMMIT_LATENCY,
+	PROP_COMMIT_THROUGHPUT
 };
 
 static void           miner_fs_initable_iface_init        (GInitableIface       *iface);
@@ -275,6 +308,11 @@ static void           miner_resumed                       (TrackerMiner
 static ItemMovedData *item_moved_data_new                 (GFile                *file,
                                                            GFile                *source_file);
 static void           item_moved_data_free                (ItemMovedData        *data);
+static GFile *        item_moved_data_get_file            (ItemMovedData        *data);
+static void           item_waiting_list_free              (GFile                *file,
+                                                           GList                *list);
+static void           item_waiting_file_list_free         (GFile                *file,
+                                                           GList                *list);
 
 static void           indexing_tree_directory_removed     (TrackerIndexingTree  *indexing_tree,
                                                            GFile                *directory,
@@ -305,8 +343,13 @@ static void           file_notifier_directory_finished    (TrackerFileNotifier *
                                                            gpointer             user_data);
 static void           file_notifier_finished              (TrackerFileNotifier *notifier,
                                                            gpointer             user_data);
+static void           file_notifier_file_iri_resolved     (TrackerFileNotifier *notifier,
+                                                           GFile               *file,
+                                                           gpointer             user_data);
 
 static void           item_queue_handlers_set_up          (TrackerMinerFS       *fs);
+static void           remove_waiting_items                (TrackerMinerFS       *fs,
+                                                           GFile                *directory);
 
 static void           task_pool_cancel_foreach                (gpointer        data,
                                                                gpointer        user_data);
@@ -387,6 +430,121 @@ tracker_miner_fs_class_init (TrackerMinerFSClass *klass)
 	                                                      "Data provider populating data, e.g. like GFileEnumerator",
 	                                                      TRACKER_TYPE_DATA_PROVIDER,
 	                                                      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY));
+	/**
+	 * TrackerMinerFS:crawl-state-file:
+	 *
+	 * File where the state of crawled directories is kept across runs.
+	 * On startup, directories unchanged since they were last found in
+	 * sync with the store skip the check of their contents. The file
+	 * is only written when the miner is finalized, so the state of an
+	 * unclean shutdown is never used. If %NULL, the default, every
+	 * directory is checked on startup.
+	 *
+	 * Since: 2.0
+	 **/
+	g_object_class_install_property (object_class,
+	                                 PROP_CRAWL_STATE_FILE,
+	                                 g_param_spec_object ("crawl-state-file",
+	                                                      "Crawl state file",
+	                                                      "File keeping the state of crawled directories across runs",
+	                                                      G_TYPE_FILE,
+	                                                      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY));
+	/**
+	 * TrackerMinerFS:processing-pool-target-latency:
+	 *
+	 * Time in milliseconds that committing a batch of SPARQL updates
+	 * to the store should take. Starting from
+	 * #TrackerMinerFS:processing-pool-ready-limit, batches grow while
+	 * bigger ones increase throughput, and shrink when commits take
+	 * longer than this. If 0, batches keep the size set in
+	 * #TrackerMinerFS:processing-pool-ready-limit.
+	 *
+	 * Since: 2.0
+	 **/
+	g_object_class_install_property (object_class,
+	                                 PROP_TARGET_LATENCY,
+	                                 g_param_spec_uint ("processing-pool-target-latency",
+	                                                    "Processing pool target latency",
+	                                                    "Time in milliseconds a commit to the store should take, "
+	                                                    "or 0 to keep the ready pool limit fixed",
+	                                                    0, G_MAXUINT, DEFAULT_TARGET_LATENCY,
+	                                                    G_PARAM_READWRITE | G_PARAM_CONSTRUCT));
+	/**
+	 * TrackerMinerFS:processing-pool-commit-limit:
+	 *
+	 * Maximum number of batches of SPARQL updates being committed to
+	 * the store at once. With more than one, the next batch is filled
+	 * while the store commits the previous ones. Updates on the same
+	 * file are still committed in order.
+	 *
+	 * Since: 2.0
+	 **/
+	g_object_class_install_property (object_class,
+	                                 PROP_COMMIT_LIMIT,
+	                                 g_param_spec_uint ("processing-pool-commit-limit",
+	                                                    "Processing pool commit limit",
+	                                                    "Maximum number of batches of SPARQL updates "
+	                                                    "being committed to the store at once",
+	                                                    1, G_MAXUINT, DEFAULT_COMMIT_LIMIT,
+	                                                    G_PARAM_READWRITE | G_PARAM_CONSTRUCT));
+	/**
+	 * TrackerMinerFS:batch-size:
+	 *
+	 * Current maximum number of SPARQL updates merged in a single
+	 * commit to the store.
+	 *
+	 * Since: 2.0
+	 **/
+	g_object_class_install_property (object_class,
+	                                 PROP_BATCH_SIZE,
+	                                 g_param_spec_uint ("batch-size",
+	                                                    "Batch size",
+	                                                    "Current maximum number of SPARQL updates per commit",
+	                                                    0, G_MAXUINT, 0,
+	                                                    G_PARAM_READABLE));
+	/**
+	 * TrackerMinerFS:batches-in-flight:
+	 *
+	 * Number of batches of SPARQL updates being committed to the store.
+	 *
+	 * Since: 2.0
+	 **/
+	g_object_class_install_property (object_class,
+	                                 PROP_BATCHES_IN_FLIGHT,
+	                                 g_param_spec_uint ("batches-in-flight",
+	                                                    "Batches in flight",
+	                                                    "Number of batches being committed to the store",
+	                                                    0, G_MAXUINT, 0,
+	                                                    G_PARAM_READABLE));
+	/**
+	 * TrackerMinerFS:commit-latency:
+	 *
+	 * Average time in milliseconds the last commits to the store took.
+	 *
+	 * Since: 2.0
+	 **/
+	g_object_class_install_property (object_class,
+	                                 PROP_COMMIT_LATENCY,
+	                                 g_param_spec_double ("commit-latency",
+	                                                      "Commit latency",
+	                                                      "Average time in milliseconds of the last commits",
+	                                                      0, G_MAXDOUBLE, 0,
+	                                                      G_PARAM_READABLE));
+	/**
+	 * TrackerMinerFS:commit-throughput:
+	 *
+	 * Average number of SPARQL updates per second committed to the
+	 * store by the last commits.
+	 *
+	 * Since: 2.0
+	 **/
+	g_object_class_install_property (object_class,
+	                                 PROP_COMMIT_THROUGHPUT,
+	                                 g_param_spec_double ("commit-throughput",
+	                                                      "Commit throughput",
+	                                                      "Average number of SPARQL updates per second of the last commits",
+	                                                      0, G_MAXDOUBLE, 0,
+	                                                      G_PARAM_READABLE));
 
 	/**
 	 * TrackerMinerFS::process-file:
@@ -595,10 +753,18 @@ tracker_miner_fs_init (TrackerMinerFS *object)
 	priv->timer_stopped = TRUE;
 	priv->extraction_timer_stopped = TRUE;
 
-	priv->items_created = tracker_priority_queue_new ();
-	priv->items_updated = tracker_priority_queue_new ();
-	priv->items_deleted = tracker_priority_queue_new ();
-	priv->items_moved = tracker_priority_queue_new ();
+	priv->items_created = tracker_priority_queue_new_with_index (NULL);
+	priv->items_updated = tracker_priority_queue_new_with_index (NULL);
+	priv->items_deleted = tracker_priority_queue_new_with_index (NULL);
+	priv->items_moved = tracker_priority_queue_new_with_index ((TrackerPriorityQueueFileFunc) item_moved_data_get_file);
+	priv->items_waiting_iri = g_hash_table_new_full (g_file_hash,
+	                                                 (GEqualFunc) g_file_equal,
+	                                                 (GDestroyNotify) g_object_unref,
+	                                                 NULL);
+	priv->items_waiting_file = g_hash_table_new_full (g_file_hash,
+	                                                  (GEqualFunc) g_file_equal,
+	                                                  (GDestroyNotify) g_object_unref,
+	                                                  NULL);
 
 #ifdef EVENT_QUEUE_ENABLE_TRACE
 	priv->queue_status_timeout_id = g_timeout_add_seconds (EVENT_QUEUE_STATUS_TIMEOUT_SECS,
@@ -649,6 +815,11 @@ miner_fs_initable_init (GInitable     *initable,
 		return FALSE;
 	}
 
+	tracker_sparql_buffer_set_target_latency (priv->sparql_buffer,
+	                                          priv->sparql_buffer_target_latency);
+	tracker_sparql_buffer_set_max_updates (priv->sparql_buffer,
+	                                       priv->sparql_buffer_commit_limit);
+
 	g_signal_connect (priv->sparql_buffer, "notify::limit-reached",
 	                  G_CALLBACK (task_pool_limit_reached_notify_cb),
 	                  initable);
@@ -678,6 +849,11 @@ miner_fs_initable_init (GInitable     *initable,
 		return FALSE;
 	}
 
+	if (priv->crawl_state_file) {
+		tracker_file_notifier_set_crawl_state_file (priv->file_notifier,
+		                                            priv->crawl_state_file);
+	}
+
 	g_signal_connect (priv->file_notifier, "file-created",
 	                  G_CALLBACK (file_notifier_file_created),
 	                  initable);
@@ -699,6 +875,9 @@ miner_fs_initable_init (GInitable     *initable,
 	g_signal_connect (priv->file_notifier, "finished",
 	                  G_CALLBACK (file_notifier_finished),
 	                  initable);
+	g_signal_connect (priv->file_notifier, "file-iri-resolved",
+	                  G_CALLBACK (file_notifier_file_iri_resolved),
+	                  initable);
 
 	return TRUE;
 }
@@ -763,14 +942,28 @@ fs_finalize (GObject *object)
 	                                NULL);
 	tracker_priority_queue_unref (priv->items_created);
 
+	g_hash_table_foreach (priv->items_waiting_file,
+	                      (GHFunc) item_waiting_file_list_free,
+	                      NULL);
+	g_hash_table_unref (priv->items_waiting_file);
+
+	g_hash_table_foreach (priv->items_waiting_iri,
+	                      (GHFunc) item_waiting_list_free,
+	                      NULL);
+	g_hash_table_unref (priv->items_waiting_iri);
+
 	if (priv->indexing_tree) {
 		g_object_unref (priv->indexing_tree);
 	}
 
 	if (priv->file_notifier) {
+		/* IRI lookups may still be in flight */
+		g_signal_handlers_disconnect_by_data (priv->file_notifier, object);
 		g_object_unref (priv->file_notifier);
 	}
 
+	g_clear_object (&priv->crawl_state_file);
+
 	if (priv->roots_to_notify) {
 		g_hash_table_unref (priv->roots_to_notify);
 
@@ -840,13 +1033,32 @@ fs_set_property (GObject      *object,
 		fs->priv->sparql_buffer_limit = g_value_get_uint (value);
 
 		if (fs->priv->sparql_buffer) {
-			tracker_task_pool_set_limit (TRACKER_TASK_POOL (fs->priv->sparql_buffer),
-			                             fs->priv->sparql_buffer_limit);
+			tracker_sparql_buffer_set_batch_size (fs->priv->sparql_buffer,
+			                                      fs->priv->sparql_buffer_limit);
 		}
 		break;
 	case PROP_DATA_PROVIDER:
 		fs->priv->data_provider = g_value_dup_object (value);
 		break;
+	case PROP_CRAWL_STATE_FILE:
+		fs->priv->crawl_state_file = g_value_dup_object (value);
+		break;
+	case PROP_TARGET_LATENCY:
+		fs->priv->sparql_buffer_target_latency = g_value_get_uint (value);
+
+		if (fs->priv->sparql_buffer) {
+			tracker_sparql_buffer_set_target_latency (fs->priv->sparql_buffer,
+			                                          fs->priv->sparql_buffer_target_latency);
+		}
+		break;
+	case PROP_COMMIT_LIMIT:
+		fs->priv->sparql_buffer_commit_limit = g_value_get_uint (value);
+
+		if (fs->priv->sparql_buffer) {
+			tracker_sparql_buffer_set_max_updates (fs->priv->sparql_buffer,
+			                                       fs->priv->sparql_buffer_commit_limit);
+		}
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 		break;
@@ -879,6 +1091,39 @@ fs_get_property (GObject    *object,
 	case PROP_DATA_PROVIDER:
 		g_value_set_object (value, fs->priv->data_provider);
 		break;
+	case PROP_CRAWL_STATE_FILE:
+		g_value_set_object (value, fs->priv->crawl_state_file);
+		break;
+	case PROP_TARGET_LATENCY:
+		g_value_set_uint (value, fs->priv->sparql_buffer_target_latency);
+		break;
+	case PROP_COMMIT_LIMIT:
+		g_value_set_uint (value, fs->priv->sparql_buffer_commit_limit);
+		break;
+	case PROP_BATCH_SIZE:
+		if (fs->priv->sparql_buffer) {
+			g_value_set_uint (value, tracker_sparql_buffer_get_batch_size (fs->priv->sparql_buffer));
+		}
+		break;
+	case PROP_BATCHES_IN_FLIGHT:
+	case PROP_COMMIT_LATENCY:
+	case PROP_COMMIT_THROUGHPUT:
+		if (fs->priv->sparql_buffer) {
+			guint n_updates;
+			gdouble latency, throughput;
+
+			tracker_sparql_buffer_get_statistics (fs->priv->sparql_buffer,
+			                                      &n_updates, &latency, &throughput);
+
+			if (prop_id == PROP_BATCHES_IN_FLIGHT) {
+				g_value_set_uint (value, n_updates);
+			} else if (prop_id == PROP_COMMIT_LATENCY) {
+				g_value_set_double (value, latency);
+			} else {
+				g_value_set_double (value, throughput);
+			}
+		}
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 		break;
@@ -963,16 +1208,6 @@ miner_resumed (TrackerMiner *miner)
 	}
 }
 
-static gboolean
-item_moved_data_has_prefix (gpointer data,
-			    gpointer user_data)
-{
-	ItemMovedData *moved_item = data;
-	GFile *prefix = user_data;
-
-	return g_file_has_prefix (moved_item->file, prefix);
-}
-
 static void
 notify_roots_finished (TrackerMinerFS *fs,
                        gboolean        check_queues)
@@ -1007,10 +1242,10 @@ notify_roots_finished (TrackerMinerFS *fs,
 		 * too frequently)
 		 */
 		if (check_queues &&
-		    (tracker_priority_queue_find (fs->priv->items_created, NULL, (GEqualFunc) g_file_has_prefix, root) ||
-		     tracker_priority_queue_find (fs->priv->items_updated, NULL, (GEqualFunc) g_file_has_prefix, root) ||
-		     tracker_priority_queue_find (fs->priv->items_deleted, NULL, (GEqualFunc) g_file_has_prefix, root) ||
-		     tracker_priority_queue_find (fs->priv->items_moved, NULL, (GEqualFunc) item_moved_data_has_prefix, root))) {
+		    (tracker_priority_queue_has_descendants (fs->priv->items_created, root) ||
+		     tracker_priority_queue_has_descendants (fs->priv->items_updated, root) ||
+		     tracker_priority_queue_has_descendants (fs->priv->items_deleted, root) ||
+		     tracker_priority_queue_has_descendants (fs->priv->items_moved, root))) {
 			continue;
 		}
 
@@ -1115,6 +1350,59 @@ item_moved_data_free (ItemMovedData *data)
 	g_slice_free (ItemMovedData, data);
 }
 
+/* Moved items are indexed by their dest file */
+static GFile *
+item_moved_data_get_file (ItemMovedData *data)
+{
+	return data->file;
+}
+
+static ItemWaitingData *
+item_waiting_data_new (QueueState  queue,
+                       GFile      *urn_file,
+                       GFile      *file,
+                       GFile      *source_file,
+                       gint        priority)
+{
+	ItemWaitingData *data;
+
+	data = g_slice_new0 (ItemWaitingData);
+	data->queue = queue;
+	data->urn_file = g_object_ref (urn_file);
+	data->file = g_object_ref (file);
+	data->source_file = (source_file) ? g_object_ref (source_file) : NULL;
+	data->priority = priority;
+
+	return data;
+}
+
+static void
+item_waiting_data_free (ItemWaitingData *data)
+{
+	g_object_unref (data->urn_file);
+	g_object_unref (data->file);
+
+	if (data->source_file) {
+		g_object_unref (data->source_file);
+	}
+
+	g_slice_free (ItemWaitingData, data);
+}
+
+static void
+item_waiting_list_free (GFile *file,
+                        GList *list)
+{
+	g_list_free_full (list, (GDestroyNotify) item_waiting_data_free);
+}
+
+static void
+item_waiting_file_list_free (GFile *file,
+                             GList *list)
+{
+	g_list_free (list);
+}
+
 static gboolean
 item_queue_is_blocked_by_file (TrackerMinerFS *fs,
                                GFile *file)
@@ -1308,6 +1596,127 @@ on_signal_gtask_complete (GObject      *source,
 	g_free (uri);
 }
 
+/* Returns TRUE if the urn for the file can be looked up without
+ * blocking on the store, otherwise a lookup is queued, and the
+ * item should wait for it through item_wait_for_urn().
+ */
+static gboolean
+file_urn_is_ready (TrackerMinerFS *fs,
+                   GFile          *file,
+                   gboolean        force)
+{
+	if (g_object_get_qdata (G_OBJECT (file), quark_file_iri)) {
+		return TRUE;
+	}
+
+	return tracker_file_notifier_prefetch_file_iri (fs->priv->file_notifier,
+	                                                file, force);
+}
+
+/* Adds data to the items waiting by their file, the items are
+ * unlinked by their stored links so removals don't walk the lists.
+ */
+static void
+item_waiting_data_index_file (TrackerMinerFS  *fs,
+                              ItemWaitingData *data)
+{
+	GList *items;
+
+	items = g_hash_table_lookup (fs->priv->items_waiting_file, data->file);
+	items = g_list_prepend (items, data);
+	data->file_link = items;
+	g_hash_table_insert (fs->priv->items_waiting_file,
+	                     g_object_ref (data->file), items);
+}
+
+static void
+item_waiting_data_unindex_file (TrackerMinerFS  *fs,
+                                ItemWaitingData *data)
+{
+	GList *items;
+
+	items = g_hash_table_lookup (fs->priv->items_waiting_file, data->file);
+	items = g_list_delete_link (items, data->file_link);
+	data->file_link = NULL;
+
+	if (items) {
+		g_hash_table_insert (fs->priv->items_waiting_file,
+		                     g_object_ref (data->file), items);
+	} else {
+		g_hash_table_remove (fs->priv->items_waiting_file, data->file);
+	}
+}
+
+/* Takes data out of both waiting indexes, without freeing it */
+static void
+item_waiting_data_remove (TrackerMinerFS  *fs,
+                          ItemWaitingData *data)
+{
+	GList *items;
+
+	items = g_hash_table_lookup (fs->priv->items_waiting_iri, data->urn_file);
+	items = g_list_delete_link (items, data->urn_link);
+	data->urn_link = NULL;
+
+	if (items) {
+		g_hash_table_insert (fs->priv->items_waiting_iri,
+		                     g_object_ref (data->urn_file), items);
+	} else {
+		g_hash_table_remove (fs->priv->items_waiting_iri, data->urn_file);
+	}
+
+	item_waiting_data_unindex_file (fs, data);
+}
+
+static void
+item_wait_for_urn (TrackerMinerFS *fs,
+                   GFile          *urn_file,
+                   QueueState      queue,
+                   GFile          *file,
+                   GFile          *source_file,
+                   gint            priority)
+{
+	ItemWaitingData *data;
+	GList *items;
+
+	data = item_waiting_data_new (queue, urn_file, file,
+	                              source_file, priority);
+
+	items = g_hash_table_lookup (fs->priv->items_waiting_iri, urn_file);
+	items = g_list_prepend (items, data);
+	data->urn_link = items;
+	g_hash_table_insert (fs->priv->items_waiting_iri,
+	                     g_object_ref (urn_file), items);
+
+	item_waiting_data_index_file (fs, data);
+}
+
+static void
+item_waiting_data_requeue (TrackerMinerFS  *fs,
+                           ItemWaitingData *data)
+{
+	switch (data->queue) {
+	case QUEUE_CREATED:
+		tracker_priority_queue_add (fs->priv->items_created,
+		                            g_object_ref (data->file),
+		                            data->priority);
+		break;
+	case QUEUE_UPDATED:
+		tracker_priority_queue_add (fs->priv->items_updated,
+		                            g_object_ref (data->file),
+		                            data->priority);
+		break;
+	case QUEUE_MOVED:
+		tracker_priority_queue_add (fs->priv->items_moved,
+		                            item_moved_data_new (data->file,
+		                                                 data->source_file),
+		                            data->priority);
+		break;
+	default:
+		g_assert_not_reached ();
+	}
+}
+
 static const gchar *
 lookup_file_urn (TrackerMinerFS *fs,
                  GFile          *file,
@@ -1728,6 +2137,7 @@ item_queue_get_next_file (TrackerMinerFS  *fs,
 	*source_file = NULL;
 
 	if (tracker_file_notifier_is_active (fs->priv->file_notifier) ||
+	    g_hash_table_size (fs->priv->items_waiting_iri) > 0 ||
 	    tracker_task_pool_limit_reached (fs->priv->task_pool) ||
 	    tracker_task_pool_limit_reached (TRACKER_TASK_POOL (fs->priv->sparql_buffer))) {
 		if (tracker_task_pool_get_size (fs->priv->task_pool) == 0) {
@@ -1788,6 +2198,7 @@ miner_handle_next_item (TrackerMinerFS *fs)
 	GTimeVal time_now;
 	static GTimeVal time_last = { 0 };
 	gboolean keep_processing = TRUE;
+	gboolean check_parent;
 	gint priority = 0;
 
 	if (fs->priv->timer_stopped) {
@@ -1926,6 +2337,12 @@ miner_handle_next_item (TrackerMinerFS *fs)
 		keep_processing = FALSE;
 		break;
 	case QUEUE_MOVED:
+		if (!file_urn_is_ready (fs, source_file, TRUE)) {
+			item_wait_for_urn (fs, source_file, queue,
+			                   file, source_file, priority);
+			break;
+		}
+
 		keep_processing = item_move (fs, file, source_file);
 		break;
 	case QUEUE_DELETED:
@@ -1934,11 +2351,18 @@ miner_handle_next_item (TrackerMinerFS *fs)
 	case QUEUE_CREATED:
 	case QUEUE_UPDATED:
 		parent = g_file_get_parent (file);
-
-		if (!parent ||
-		    tracker_indexing_tree_file_is_root (fs->priv->indexing_tree, file) ||
-		    !tracker_indexing_tree_get_root (fs->priv->indexing_tree, file, NULL) ||
-		    lookup_file_urn (fs, parent, TRUE)) {
+		check_parent = (parent &&
+		                !tracker_indexing_tree_file_is_root (fs->priv->indexing_tree, file) &&
+		                tracker_indexing_tree_get_root (fs->priv->indexing_tree, file, NULL));
+
+		if (check_parent && !file_urn_is_ready (fs, parent, TRUE)) {
+			/* Wait for the parent urn lookup */
+			item_wait_for_urn (fs, parent, queue, file, NULL, priority);
+		} else if (!file_urn_is_ready (fs, file, FALSE)) {
+			/* Wait for the file urn lookup */
+			item_wait_for_urn (fs, file, queue, file, NULL, priority);
+		} else if (!check_parent ||
+		           lookup_file_urn (fs, parent, TRUE)) {
 			keep_processing = item_add_or_update (fs, file, priority);
 		} else {
 			TrackerPriorityQueue *item_queue;
@@ -2092,17 +2516,6 @@ should_check_file (TrackerMinerFS *fs,
 	                                                file, file_type);
 }
 
-static gboolean
-moved_files_equal (gconstpointer a,
-                   gconstpointer b)
-{
-	const ItemMovedData *data = a;
-	GFile *file = G_FILE (b);
-
-	/* Compare with dest file */
-	return g_file_equal (data->file, file);
-}
-
 static gint
 miner_fs_get_queue_priority (TrackerMinerFS *fs,
                              GFile          *file)
@@ -2121,10 +2534,17 @@ miner_fs_cache_file_urn (TrackerMinerFS *fs,
                          GFile          *file,
                          gboolean        query_urn)
 {
-	const gchar *urn;
+	const gchar *urn = NULL;
+
+	/* Store urn as qdata, if it's not known yet the lookup
+	 * is started, and the item waits for it when processed.
+	 */
+	if (tracker_file_notifier_prefetch_file_iri (fs->priv->file_notifier,
+	                                             file, query_urn)) {
+		urn = tracker_file_notifier_get_file_iri (fs->priv->file_notifier,
+		                                          file, query_urn);
+	}
 
-	/* Store urn as qdata */
-	urn = tracker_file_notifier_get_file_iri (fs->priv->file_notifier, file, query_urn);
 	g_object_set_qdata_full (G_OBJECT (file), quark_file_iri,
 	                         g_strdup (urn), (GDestroyNotify) g_free);
 }
@@ -2142,9 +2562,65 @@ miner_fs_queue_file (TrackerMinerFS       *fs,
 	tracker_priority_queue_add (item_queue, g_object_ref (file), priority);
 }
 
+/* Returns the first item from queue waiting for an urn on file,
+ * created and updated items are matched on their file, moved items
+ * on their destination file.
+ */
+static ItemWaitingData *
+waiting_item_lookup (TrackerMinerFS *fs,
+                     GFile          *file,
+                     QueueState      queue)
+{
+	GList *l;
+
+	l = g_hash_table_lookup (fs->priv->items_waiting_file, file);
+
+	for (; l; l = l->next) {
+		ItemWaitingData *data = l->data;
+
+		if (data->queue == queue) {
+			return data;
+		}
+	}
+
+	return NULL;
+}
+
+/* Removes the items waiting for an urn on file, matched as in
+ * waiting_item_lookup(), and returns them. Moved items are only
+ * included if include_moved is TRUE.
+ */
+static GList *
+waiting_items_steal (TrackerMinerFS *fs,
+                     GFile          *file,
+                     gboolean        include_moved)
+{
+	GList *l, *stolen = NULL;
+
+	l = g_hash_table_lookup (fs->priv->items_waiting_file, file);
+
+	while (l) {
+		ItemWaitingData *data = l->data;
+		GList *next = l->next;
+
+		if (include_moved || data->queue != QUEUE_MOVED) {
+			item_waiting_data_remove (fs, data);
+			stolen = g_list_prepend (stolen, data);
+		}
+
+		l = next;
+	}
+
+	return g_list_reverse (stolen);
+}
+
 /* Checks previous created/updated/deleted/moved queues for
  * monitor events. Returns TRUE if the item should still
  * be added to the queue.
+ *
+ * Items waiting for an urn lookup are out of the queues, but
+ * will be processed later on, so they are checked too. Otherwise
+ * an item on a file deleted meanwhile would recreate it.
  */
 static gboolean
 check_item_queues (TrackerMinerFS *fs,
@@ -2153,6 +2629,9 @@ check_item_queues (TrackerMinerFS *fs,
                    GFile          *other_file)
 {
 	ItemMovedData *move_data;
+	ItemWaitingData *waiting_data;
+	GList *move_node, *waiting, *l;
+	gboolean created;
 
 	if (!fs->priv->been_crawled) {
 		/* Only do this after initial crawling, so
@@ -2171,51 +2650,74 @@ check_item_queues (TrackerMinerFS *fs,
 		return TRUE;
 	case QUEUE_UPDATED:
 		/* No further updates after a previous created/updated event */
-		if (tracker_priority_queue_find (fs->priv->items_created, NULL,
-		                                 (GEqualFunc) g_file_equal, file) ||
-		    tracker_priority_queue_find (fs->priv->items_updated, NULL,
-		                                 (GEqualFunc) g_file_equal, file)) {
+		if (tracker_priority_queue_find_file_node (fs->priv->items_created, file, NULL) ||
+		    tracker_priority_queue_find_file_node (fs->priv->items_updated, file, NULL)) {
 			g_debug ("  Found previous unhandled CREATED/UPDATED event");
 			return FALSE;
 		}
+
+		if (waiting_item_lookup (fs, file, QUEUE_CREATED) ||
+		    waiting_item_lookup (fs, file, QUEUE_UPDATED)) {
+			g_debug ("  Found previous CREATED/UPDATED event waiting for an urn");
+			return FALSE;
+		}
 		return TRUE;
 	case QUEUE_DELETED:
+		/* Items waiting on the file itself, including moves to it */
+		waiting = waiting_items_steal (fs, file, TRUE);
+
 		if (tracker_file_notifier_get_file_type (fs->priv->file_notifier,
 		                                         file) == G_FILE_TYPE_DIRECTORY) {
-			if (tracker_priority_queue_foreach_remove (fs->priv->items_updated,
-			                                           (GEqualFunc) g_file_has_prefix,
-			                                           file,
-			                                           (GDestroyNotify) g_object_unref)) {
+			if (tracker_priority_queue_remove_descendants (fs->priv->items_updated,
+			                                               file,
+			                                               (GDestroyNotify) g_object_unref)) {
 				g_debug ("  Deleting previous unhandled UPDATED events on children");
 			}
 
-			if (tracker_priority_queue_foreach_remove (fs->priv->items_created,
-			                                           (GEqualFunc) g_file_has_prefix,
-			                                           file,
-			                                           (GDestroyNotify) g_object_unref)) {
+			if (tracker_priority_queue_remove_descendants (fs->priv->items_created,
+			                                               file,
+			                                               (GDestroyNotify) g_object_unref)) {
 				g_debug ("  Deleting previous unhandled CREATED events on children");
 			}
 
-			if (tracker_priority_queue_foreach_remove (fs->priv->items_deleted,
-			                                           (GEqualFunc) g_file_has_prefix,
-			                                           file,
-			                                           (GDestroyNotify) g_object_unref)) {
+			if (tracker_priority_queue_remove_descendants (fs->priv->items_deleted,
+			                                               file,
+			                                               (GDestroyNotify) g_object_unref)) {
 				g_debug ("  Deleting previous unhandled DELETED events on children");
 			}
+
+			remove_waiting_items (fs, file);
 		}
 
+		created = FALSE;
+
+		for (l = waiting; l; l = l->next) {
+			waiting_data = l->data;
+
+			if (waiting_data->queue == QUEUE_CREATED) {
+				created = TRUE;
+			} else if (waiting_data->queue == QUEUE_MOVED) {
+				/* The file was moved here and deleted since,
+				 * delete the move source instead.
+				 */
+				g_debug ("  Found MOVED event waiting for an urn, deleting its source instead");
+				miner_fs_queue_file (fs, fs->priv->items_deleted,
+				                     waiting_data->source_file, FALSE);
+			}
+		}
+
+		g_list_free_full (waiting, (GDestroyNotify) item_waiting_data_free);
+
 		/* Remove all previous updates */
-		if (tracker_priority_queue_foreach_remove (fs->priv->items_updated,
-		                                           (GEqualFunc) g_file_equal,
-		                                           file,
-		                                           (GDestroyNotify) g_object_unref)) {
+		if (tracker_priority_queue_remove_file (fs->priv->items_updated,
+		                                        file,
+		                                        (GDestroyNotify) g_object_unref)) {
 			g_debug ("  Deleting previous unhandled UPDATED event");
 		}
 
-		if (tracker_priority_queue_foreach_remove (fs->priv->items_created,
-		                                           (GEqualFunc) g_file_equal,
-		                                           file,
-		                                           (GDestroyNotify) g_object_unref)) {
+		if (tracker_priority_queue_remove_file (fs->priv->items_created,
+		                                        file,
+		                                        (GDestroyNotify) g_object_unref)) {
 			/* Created event was still in the queue,
 			 * remove it and ignore the current event
 			 */
@@ -2223,28 +2725,37 @@ check_item_queues (TrackerMinerFS *fs,
 			return FALSE;
 		}
 
+		if (created) {
+			g_debug ("  Found matching CREATED event waiting for an urn, removing file altogether");
+			return FALSE;
+		}
+
 		return TRUE;
 	case QUEUE_MOVED:
 		/* Kill any events on other_file (The dest one), since it will be rewritten anyway */
-		if (tracker_priority_queue_foreach_remove (fs->priv->items_created,
-		                                           (GEqualFunc) g_file_equal,
-		                                           other_file,
-		                                           (GDestroyNotify) g_object_unref)) {
+		if (tracker_priority_queue_remove_file (fs->priv->items_created,
+		                                        other_file,
+		                                        (GDestroyNotify) g_object_unref)) {
 			g_debug ("  Removing previous unhandled CREATED event for dest file, will be rewritten anyway");
 		}
 
-		if (tracker_priority_queue_foreach_remove (fs->priv->items_updated,
-		                                           (GEqualFunc) g_file_equal,
-		                                           other_file,
-		                                           (GDestroyNotify) g_object_unref)) {
+		if (tracker_priority_queue_remove_file (fs->priv->items_updated,
+		                                        other_file,
+		                                        (GDestroyNotify) g_object_unref)) {
 			g_debug ("  Removing previous unhandled UPDATED event for dest file, will be rewritten anyway");
 		}
 
+		waiting = waiting_items_steal (fs, other_file, FALSE);
+
+		if (waiting) {
+			g_debug ("  Removing CREATED/UPDATED events waiting for an urn for dest file, will be rewritten anyway");
+			g_list_free_full (waiting, (GDestroyNotify) item_waiting_data_free);
+		}
+
 		/* Now check file (Origin one) */
-		if (tracker_priority_queue_foreach_remove (fs->priv->items_created,
-		                                           (GEqualFunc) g_file_equal,
-		                                           file,
-		                                           (GDestroyNotify) g_object_unref)) {
+		if (tracker_priority_queue_remove_file (fs->priv->items_created,
+		                                        file,
+		                                        (GDestroyNotify) g_object_unref)) {
 			/* If source file was created, replace it with
 			 * a create event for the destination file, and
 			 * discard this event.
@@ -2260,16 +2771,47 @@ check_item_queues (TrackerMinerFS *fs,
 			return FALSE;
 		}
 
-		move_data = tracker_priority_queue_find (fs->priv->items_moved, NULL,
-		                                         (GEqualFunc) moved_files_equal, file);
-		if (move_data) {
+		move_node = tracker_priority_queue_find_file_node (fs->priv->items_moved,
+		                                                   file, NULL);
+		if (move_node) {
 			/* Origin file was the dest of a previous
 			 * move operation, merge these together.
 			 */
 			g_debug ("  Source file is the destination of a previous "
 			         "unhandled MOVED event, merging both events together");
+
+			/* The queue is indexed by dest file, but the
+			 * move must keep its place relative to later ones.
+			 */
+			move_data = move_node->data;
 			g_object_unref (move_data->file);
 			move_data->file = g_object_ref (other_file);
+			tracker_priority_queue_reindex_node (fs->priv->items_moved, move_node);
+			return FALSE;
+		}
+
+		if (waiting_item_lookup (fs, file, QUEUE_CREATED)) {
+			g_debug ("  Found matching CREATED event waiting for an urn "
+			         "for source file, merging both events together");
+			waiting = waiting_items_steal (fs, file, FALSE);
+			g_list_free_full (waiting, (GDestroyNotify) item_waiting_data_free);
+			miner_fs_queue_file (fs, fs->priv->items_created, other_file, FALSE);
+
+			return FALSE;
+		}
+
+		waiting_data = waiting_item_lookup (fs, file, QUEUE_MOVED);
+
+		if (waiting_data) {
+			/* The waiting move keeps waiting for the urn of
+			 * its own source, only its destination changes.
+			 */
+			g_debug ("  Source file is the destination of a MOVED event "
+			         "waiting for an urn, merging both events together");
+			item_waiting_data_unindex_file (fs, waiting_data);
+			g_object_unref (waiting_data->file);
+			waiting_data->file = g_object_ref (other_file);
+			item_waiting_data_index_file (fs, waiting_data);
 			return FALSE;
 		}
 
@@ -2381,6 +2923,32 @@ file_notifier_file_moved (TrackerFileNotifier *notifier,
 	}
 }
 
+static void
+file_notifier_file_iri_resolved (TrackerFileNotifier *notifier,
+                                 GFile               *file,
+                                 gpointer             user_data)
+{
+	TrackerMinerFS *fs = user_data;
+	GList *items, *l;
+
+	items = g_hash_table_lookup (fs->priv->items_waiting_iri, file);
+
+	if (!items) {
+		return;
+	}
+
+	g_hash_table_remove (fs->priv->items_waiting_iri, file);
+	items = g_list_reverse (items);
+
+	for (l = items; l; l = l->next) {
+		item_waiting_data_unindex_file (fs, l->data);
+		item_waiting_data_requeue (fs, l->data);
+	}
+
+	g_list_free_full (items, (GDestroyNotify) item_waiting_data_free);
+	item_queue_handlers_set_up (fs);
+}
+
 static void
 file_notifier_directory_started (TrackerFileNotifier *notifier,
                                  GFile               *directory,
@@ -2502,21 +3070,6 @@ print_file_tree (GNode    *node,
 
 #endif /* CRAWLED_TREE_ENABLE_TRACE */
 
-/* Returns TRUE if file equals to
- * other_file, or is a child of it
- */
-static gboolean
-file_equal_or_descendant (GFile *file,
-                          GFile *prefix)
-{
-	if (g_file_equal (file, prefix) ||
-	    g_file_has_prefix (file, prefix)) {
-		return TRUE;
-	}
-
-	return FALSE;
-}
-
 static void
 task_pool_cancel_foreach (gpointer data,
                           gpointer user_data)
@@ -2538,6 +3091,42 @@ task_pool_cancel_foreach (gpointer data,
 	}
 }
 
+/* Drops created/updated items waiting for an urn within directory */
+static void
+remove_waiting_items (TrackerMinerFS *fs,
+                      GFile          *directory)
+{
+	GHashTableIter iter;
+	GList *items, *l;
+
+	g_hash_table_iter_init (&iter, fs->priv->items_waiting_iri);
+
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &items)) {
+		l = items;
+
+		while (l) {
+			ItemWaitingData *data = l->data;
+			GList *next = l->next;
+
+			if (data->queue != QUEUE_MOVED &&
+			    (g_file_equal (data->file, directory) ||
+			     g_file_has_prefix (data->file, directory))) {
+				item_waiting_data_unindex_file (fs, data);
+				item_waiting_data_free (data);
+				items = g_list_delete_link (items, l);
+			}
+
+			l = next;
+		}
+
+		if (items) {
+			g_hash_table_iter_replace (&iter, items);
+		} else {
+			g_hash_table_iter_remove (&iter);
+		}
+	}
+}
+
 static void
 indexing_tree_directory_removed (TrackerIndexingTree *indexing_tree,
                                  GFile               *directory,
@@ -2557,14 +3146,15 @@ indexing_tree_directory_removed (TrackerIndexingTree *indexing_tree,
 	/* Remove anything contained in the removed directory
 	 * from all relevant processing queues.
 	 */
-	tracker_priority_queue_foreach_remove (priv->items_updated,
-	                                       (GEqualFunc) file_equal_or_descendant,
-	                                       directory,
-	                                       (GDestroyNotify) g_object_unref);
-	tracker_priority_queue_foreach_remove (priv->items_created,
-	                                       (GEqualFunc) file_equal_or_descendant,
-	                                       directory,
-	                                       (GDestroyNotify) g_object_unref);
+	tracker_priority_queue_remove_file (priv->items_updated, directory,
+	                                    (GDestroyNotify) g_object_unref);
+	tracker_priority_queue_remove_descendants (priv->items_updated, directory,
+	                                           (GDestroyNotify) g_object_unref);
+	tracker_priority_queue_remove_file (priv->items_created, directory,
+	                                    (GDestroyNotify) g_object_unref);
+	tracker_priority_queue_remove_descendants (priv->items_created, directory,
+	                                           (GDestroyNotify) g_object_unref);
+	remove_waiting_items (fs, directory);
 
 	g_debug ("  Removed files at %f\n", g_timer_elapsed (timer, NULL));
 
@@ -2861,6 +3451,7 @@ tracker_miner_fs_has_items_to_process (TrackerMinerFS *fs)
 	g_return_val_if_fail (TRACKER_IS_MINER_FS (fs), FALSE);
 
 	if (tracker_file_notifier_is_active (fs->priv->file_notifier) ||
+	    g_hash_table_size (fs->priv->items_waiting_iri) > 0 ||
 	    !tracker_priority_queue_is_empty (fs->priv->items_deleted) ||
 	    !tracker_priority_queue_is_empty (fs->priv->items_created) ||
 	    !tracker_priority_queue_is_empty (fs->priv->items_updated) ||
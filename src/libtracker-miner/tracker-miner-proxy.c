@@ -91,6 +91,9 @@ static const gchar introspection_xml[] =
   "    <method name='GetRemainingTime'>"
   "      <arg type='i' name='remaining_time' direction='out' />"
   "    </method>"
+  "    <method name='GetStatistics'>"
+  "      <arg type='a{sv}' name='statistics' direction='out' />"
+  "    </method>"
   "    <method name='GetPauseDetails'>"
   "      <arg type='as' name='pause_applications' direction='out' />"
   "      <arg type='as' name='pause_reasons' direction='out' />"
@@ -611,6 +614,57 @@ handle_method_call_get_status (TrackerMinerProxy     *proxy,
 	g_free (status);
 }
 
+static void
+handle_method_call_get_statistics (TrackerMinerProxy     *proxy,
+                                   GDBusMethodInvocation *invocation,
+                                   GVariant              *parameters)
+{
+	/* Miner properties reported, if the miner has them */
+	const gchar *property_names[] = {
+		"batch-size",
+		"batches-in-flight",
+		"commit-latency",
+		"commit-throughput",
+		NULL
+	};
+	TrackerDBusRequest *request;
+	TrackerMinerProxyPrivate *priv;
+	GObjectClass *miner_class;
+	GVariantBuilder builder;
+	gint i;
+
+	priv = tracker_miner_proxy_get_instance_private (proxy);
+
+	request = tracker_g_dbus_request_begin (invocation, "%s()", __PRETTY_FUNCTION__);
+
+	tracker_dbus_request_end (request, NULL);
+
+	miner_class = G_OBJECT_GET_CLASS (priv->miner);
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
+
+	for (i = 0; property_names[i]; i++) {
+		GParamSpec *pspec;
+		GValue value = G_VALUE_INIT;
+		GVariant *variant;
+
+		pspec = g_object_class_find_property (miner_class, property_names[i]);
+
+		if (!pspec) {
+			continue;
+		}
+
+		g_value_init (&value, pspec->value_type);
+		g_object_get_property (G_OBJECT (priv->miner), property_names[i], &value);
+		variant = g_dbus_gvalue_to_gvariant (&value, NULL);
+		g_variant_builder_add (&builder, "{sv}", property_names[i], variant);
+		g_variant_unref (variant);
+		g_value_unset (&value);
+	}
+
+	g_dbus_method_invocation_return_value (invocation,
+	                                       g_variant_new ("(a{sv})", &builder));
+}
+
 static void
 handle_method_call (GDBusConnection       *connection,
                     const gchar           *sender,
@@ -639,6 +693,8 @@ handle_method_call (GDBusConnection       *connection,
 		handle_method_call_get_progress (proxy, invocation, parameters);
 	} else if (g_strcmp0 (method_name, "GetStatus") == 0) {
 		handle_method_call_get_status (proxy, invocation, parameters);
+	} else if (g_strcmp0 (method_name, "GetStatistics") == 0) {
+		handle_method_call_get_statistics (proxy, invocation, parameters);
 	} else {
 		g_dbus_method_invocation_return_error (invocation,
 		                                       G_DBUS_ERROR,
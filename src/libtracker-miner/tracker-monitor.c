@@ -30,6 +30,15 @@
 #define TRACKER_MONITOR_KQUEUE
 #endif
 
+#ifdef HAVE_FANOTIFY
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/fanotify.h>
+#include <sys/statfs.h>
+#include <glib-unix.h>
+#endif /* HAVE_FANOTIFY */
+
 #include "tracker-monitor.h"
 
 #define TRACKER_MONITOR_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), TRACKER_TYPE_MONITOR, TrackerMonitorPrivate))
@@ -49,8 +58,10 @@
 #warning Assuming GLib/GIO always sends CHANGES_DONE_HINT after CREATED...
 #endif /* GIO_ALWAYS_SENDS_CHANGES_DONE_HINT_AFTER_CREATED */
 
-/* The life time of an item in the cache */
-#define CACHE_LIFETIME_SECONDS 1
+/* How long events are held back by default, so they can be paired
+ * or merged with the ones following, in milliseconds.
+ */
+#define DEFAULT_EVENT_WINDOW 2000
 
 /* When we receive IO monitor events, we pause sending information to
  * the indexer for a few seconds before continuing. We have to receive
@@ -63,6 +74,16 @@
  */
 #undef  PAUSE_ON_IO
 
+#ifdef HAVE_FANOTIFY
+/* Everything GFileMonitor would tell us about a directory's children,
+ * reported with the parent directory handle and the child name.
+ */
+#define FANOTIFY_EVENT_MASK (FAN_CREATE | FAN_DELETE | FAN_RENAME | \
+                             FAN_MODIFY | FAN_CLOSE_WRITE | FAN_ATTRIB | \
+                             FAN_ONDIR)
+#define FANOTIFY_BUFFER_SIZE 16384
+#endif /* HAVE_FANOTIFY */
+
 struct TrackerMonitorPrivate {
 	GHashTable    *monitors;
 
@@ -87,17 +108,47 @@ struct TrackerMonitorPrivate {
 	GHashTable    *pre_update;
 	GHashTable    *pre_delete;
 	guint          event_pairs_timeout_id;
+	guint          event_window;
+
+	/* Events received from the backend, signals emitted, and
+	 * events folded into an already pending one.
+	 */
+	guint64        events_received;
+	guint64        events_emitted;
+	guint64        events_merged;
 
 	TrackerIndexingTree *tree;
+
+#ifdef HAVE_FANOTIFY
+	/* If fanotify can be used, whole filesystems are marked and
+	 * events are matched to monitored directories by their file
+	 * handle, so no per-directory kernel watches are needed.
+	 */
+	gint           fanotify_fd;
+	guint          fanotify_source_id;
+	GHashTable    *fanotify_filesystems;
+	GHashTable    *fanotify_handles;
+#endif /* HAVE_FANOTIFY */
 };
 
+#ifdef HAVE_FANOTIFY
+typedef struct {
+	TrackerMonitor *monitor;
+	GFile          *file;
+	GBytes         *handle;
+
+	/* Used instead if the filesystem can't be marked */
+	GFileMonitor   *file_monitor;
+} FanotifyWatch;
+#endif /* HAVE_FANOTIFY */
+
 typedef struct {
 	GFile    *file;
 	gchar    *file_uri;
 	GFile    *other_file;
 	gchar    *other_file_uri;
 	gboolean  is_directory;
-	GTimeVal  start_time;
+	gint64    start_time;
 	guint32   event_type;
 	gboolean  expirable;
 } EventData;
@@ -127,9 +178,19 @@ static void           tracker_monitor_get_property (GObject        *object,
                                                     GParamSpec     *pspec);
 static guint          get_kqueue_limit             (void);
 static guint          get_inotify_limit            (void);
-static GFileMonitor * directory_monitor_new        (TrackerMonitor *monitor,
+static gpointer       directory_monitor_new        (TrackerMonitor *monitor,
                                                     GFile          *file);
 static void           directory_monitor_cancel     (GFileMonitor     *dir_monitor);
+static GFileMonitor * file_monitor_new             (TrackerMonitor *monitor,
+                                                    GFile          *file);
+#ifdef HAVE_FANOTIFY
+static gint           fanotify_open                (void);
+static gboolean       fanotify_read_cb             (gint            fd,
+                                                    GIOCondition    condition,
+                                                    gpointer        user_data);
+static void           fanotify_watch_free          (FanotifyWatch  *watch);
+static void           fanotify_watch_cancel        (FanotifyWatch  *watch);
+#endif /* HAVE_FANOTIFY */
 
 
 static void           event_data_free              (gpointer        data);
@@ -230,6 +291,7 @@ tracker_monitor_init (TrackerMonitor *object)
 	GFileMonitor          *monitor;
 	const gchar           *name;
 	GError                *error = NULL;
+	GDestroyNotify         monitor_destroy;
 
 	object->priv = TRACKER_MONITOR_GET_PRIVATE (object);
 
@@ -237,13 +299,38 @@ tracker_monitor_init (TrackerMonitor *object)
 
 	/* By default we enable monitoring */
 	priv->enabled = TRUE;
+	priv->event_window = DEFAULT_EVENT_WINDOW;
+
+	monitor_destroy = (GDestroyNotify) directory_monitor_cancel;
+
+#ifdef HAVE_FANOTIFY
+	priv->fanotify_fd = fanotify_open ();
+
+	if (priv->fanotify_fd >= 0) {
+		priv->fanotify_filesystems =
+			g_hash_table_new_full (g_bytes_hash,
+			                       g_bytes_equal,
+			                       (GDestroyNotify) g_bytes_unref,
+			                       NULL);
+		priv->fanotify_handles =
+			g_hash_table_new_full (g_bytes_hash,
+			                       g_bytes_equal,
+			                       (GDestroyNotify) g_bytes_unref,
+			                       (GDestroyNotify) g_object_unref);
+		priv->fanotify_source_id =
+			g_unix_fd_add (priv->fanotify_fd, G_IO_IN,
+			               fanotify_read_cb, object);
+
+		monitor_destroy = (GDestroyNotify) fanotify_watch_free;
+	}
+#endif /* HAVE_FANOTIFY */
 
 	/* Create monitors table for this module */
 	priv->monitors =
 		g_hash_table_new_full (g_file_hash,
 		                       (GEqualFunc) g_file_equal,
 		                       (GDestroyNotify) g_object_unref,
-		                       (GDestroyNotify) directory_monitor_cancel);
+		                       monitor_destroy);
 
 	priv->pre_update =
 		g_hash_table_new_full (g_file_hash,
@@ -350,6 +437,20 @@ tracker_monitor_init (TrackerMonitor *object)
 	}
 
 	g_object_unref (file);
+
+#ifdef HAVE_FANOTIFY
+	if (priv->fanotify_fd >= 0) {
+		g_message ("Monitor backend is fanotify");
+
+		/* Marks are per filesystem, a monitored directory only
+		 * costs an entry in our own tables. Directories in
+		 * filesystems that can't be marked still fall back to
+		 * the backend above.
+		 */
+		priv->monitor_limit = G_MAXINT;
+	}
+#endif /* HAVE_FANOTIFY */
+
 	g_message ("Monitor limit is %d", priv->monitor_limit);
 }
 
@@ -374,6 +475,18 @@ tracker_monitor_finalize (GObject *object)
 	g_hash_table_unref (priv->pre_delete);
 	g_hash_table_unref (priv->monitors);
 
+#ifdef HAVE_FANOTIFY
+	if (priv->fanotify_fd >= 0) {
+		if (priv->fanotify_source_id) {
+			g_source_remove (priv->fanotify_source_id);
+		}
+
+		g_hash_table_unref (priv->fanotify_handles);
+		g_hash_table_unref (priv->fanotify_filesystems);
+		close (priv->fanotify_fd);
+	}
+#endif /* HAVE_FANOTIFY */
+
 	G_OBJECT_CLASS (tracker_monitor_parent_class)->finalize (object);
 }
 
@@ -514,10 +627,8 @@ event_data_new (GFile    *file,
                 guint32   event_type)
 {
 	EventData *event;
-	GTimeVal now;
 
 	event = g_slice_new0 (EventData);
-	g_get_current_time (&now);
 
 	event->file = g_object_ref (file);
 	event->file_uri = g_file_get_uri (file);
@@ -529,7 +640,7 @@ event_data_new (GFile    *file,
 		event->other_file_uri = NULL;
 	}
 	event->is_directory = is_directory;
-	event->start_time = now;
+	event->start_time = g_get_monotonic_time ();
 	event->event_type = event_type;
 	/* Always expirable when created */
 	event->expirable = TRUE;
@@ -679,6 +790,8 @@ static void
 emit_signal_for_event (TrackerMonitor *monitor,
                        EventData      *event_data)
 {
+	monitor->priv->events_emitted++;
+
 	switch (event_data->event_type) {
 	case G_FILE_MONITOR_EVENT_CREATED:
 		g_debug ("Emitting ITEM_CREATED for (%s) '%s'",
@@ -787,12 +900,12 @@ emit_signal_for_event (TrackerMonitor *monitor,
 static void
 event_pairs_process_in_ht (TrackerMonitor *monitor,
                            GHashTable     *ht,
-                           GTimeVal       *now)
+                           gint64          now)
 {
 	GHashTableIter iter;
 	gpointer key, value;
-	GList *expired_events = NULL;
-	GList *l;
+	GPtrArray *expired_events;
+	guint i;
 
 	/* Start iterating the HT of events, and see if any of them was expired.
 	 * If so, STEAL the item from the HT, add it in an auxiliary list, and
@@ -800,56 +913,59 @@ event_pairs_process_in_ht (TrackerMonitor *monitor,
 	 * items. If the signal is emitted WHILE iterating the HT, we may end up
 	 * with some upper layer action modifying the HT we are iterating, and
 	 * that is not good. */
+	expired_events = g_ptr_array_new ();
+
 	g_hash_table_iter_init (&iter, ht);
 	while (g_hash_table_iter_next (&iter, &key, &value)) {
 		EventData *event_data = value;
-		glong seconds;
+		gint64 elapsed;
 
 		/* If event is not yet expirable, keep it */
 		if (!event_data->expirable)
 			continue;
 
 		/* If event is expirable, but didn't expire yet, keep it */
-		seconds = now->tv_sec - event_data->start_time.tv_sec;
-		if (seconds < 2)
+		elapsed = (now - event_data->start_time) / 1000;
+		if (elapsed < monitor->priv->event_window)
 			continue;
 
-		g_debug ("Event '%s' for URI '%s' has timed out (%ld seconds have elapsed)",
+		g_debug ("Event '%s' for URI '%s' has timed out (%" G_GINT64_FORMAT " ms have elapsed)",
 		         monitor_event_to_string (event_data->event_type),
 		         event_data->file_uri,
-		         seconds);
+		         elapsed);
 		/* STEAL the item from the HT, so that disposal methods
 		 * for key and value are not called. */
 		g_hash_table_iter_steal (&iter);
 		/* Unref the key, as no longer needed */
 		g_object_unref (key);
-		/* Add the expired event to our temp list */
-		expired_events = g_list_append (expired_events, event_data);
+		/* Add the expired event to our temp array */
+		g_ptr_array_add (expired_events, event_data);
 	}
 
-	for (l = expired_events; l; l = g_list_next (l)) {
+	for (i = 0; i < expired_events->len; i++) {
 		/* Emit signal for the expired event */
-		emit_signal_for_event (monitor, l->data);
+		emit_signal_for_event (monitor, g_ptr_array_index (expired_events, i));
 		/* And dispose the event data */
-		event_data_free (l->data);
+		event_data_free (g_ptr_array_index (expired_events, i));
 	}
-	g_list_free (expired_events);
+
+	g_ptr_array_unref (expired_events);
 }
 
 static gboolean
 event_pairs_timeout_cb (gpointer user_data)
 {
 	TrackerMonitor *monitor;
-	GTimeVal now;
+	gint64 now;
 
 	monitor = user_data;
-	g_get_current_time (&now);
+	now = g_get_monotonic_time ();
 
 	/* Process PRE-UPDATE hash table */
-	event_pairs_process_in_ht (monitor, monitor->priv->pre_update, &now);
+	event_pairs_process_in_ht (monitor, monitor->priv->pre_update, now);
 
 	/* Process PRE-DELETE hash table */
-	event_pairs_process_in_ht (monitor, monitor->priv->pre_delete, &now);
+	event_pairs_process_in_ht (monitor, monitor->priv->pre_delete, now);
 
 	if (g_hash_table_size (monitor->priv->pre_update) > 0 ||
 	    g_hash_table_size (monitor->priv->pre_delete) > 0) {
@@ -944,7 +1060,7 @@ monitor_event_file_changed (TrackerMonitor *monitor,
 		                                      G_FILE_MONITOR_EVENT_CHANGED));
 	} else {
 		/* Update the start_time of the previous one */
-		g_get_current_time (&(previous_update_event_data->start_time));
+		previous_update_event_data->start_time = g_get_monotonic_time ();
 	}
 }
 
@@ -970,7 +1086,7 @@ monitor_event_file_attribute_changed (TrackerMonitor *monitor,
 	if (previous_update_event_data->event_type == G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED) {
 		/* Update the start_time of the previous one, if it is an ATTRIBUTE_CHANGED
 		 * event. */
-		g_get_current_time (&(previous_update_event_data->start_time));
+		previous_update_event_data->start_time = g_get_monotonic_time ();
 
 		/* No need to update event time in CREATED, as these events
 		 * only expire when there is a CHANGES_DONE_HINT.
@@ -998,7 +1114,7 @@ monitor_event_file_changes_done (TrackerMonitor *monitor,
 	}
 
 	/* Refresh event timer, and make sure the event is now set as expirable */
-	g_get_current_time (&(previous_update_event_data->start_time));
+	previous_update_event_data->start_time = g_get_monotonic_time ();
 	previous_update_event_data->expirable = TRUE;
 }
 
@@ -1224,19 +1340,87 @@ monitor_event_directory_moved (TrackerMonitor *monitor,
 	                                      G_FILE_MONITOR_EVENT_MOVED));
 }
 
+/* Folds events on files that already have one pending into it, the
+ * same way the handlers below would, but before anything is looked
+ * up or allocated for them. Returns TRUE if the event was consumed.
+ */
+static gboolean
+monitor_event_coalesce (TrackerMonitor    *monitor,
+                        GFile             *file,
+                        GFile             *other_file,
+                        GFileMonitorEvent  event_type)
+{
+	EventData *previous_update_event_data;
+
+	if (other_file || !monitor->priv->enabled) {
+		return FALSE;
+	}
+
+	previous_update_event_data = g_hash_table_lookup (monitor->priv->pre_update, file);
+
+	if (previous_update_event_data && previous_update_event_data->is_directory) {
+		return FALSE;
+	}
+
+	switch (event_type) {
+	case G_FILE_MONITOR_EVENT_CHANGED:
+		if (!monitor->priv->use_changed_event) {
+			/* Only meaningful on top of a pending ATTRIBUTE_CHANGED
+			 * or CREATED, a CHANGES_DONE_HINT will follow.
+			 */
+			if (!previous_update_event_data) {
+				if (g_hash_table_lookup (monitor->priv->monitors, file)) {
+					return FALSE;
+				}
+			} else if (previous_update_event_data->event_type != G_FILE_MONITOR_EVENT_CHANGED &&
+			           previous_update_event_data->event_type != G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT) {
+				return FALSE;
+			}
+		} else if (previous_update_event_data &&
+		           previous_update_event_data->event_type == G_FILE_MONITOR_EVENT_CHANGED) {
+			previous_update_event_data->start_time = g_get_monotonic_time ();
+		} else {
+			return FALSE;
+		}
+		break;
+
+	case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+		if (!previous_update_event_data) {
+			return FALSE;
+		}
+
+		previous_update_event_data->start_time = g_get_monotonic_time ();
+		previous_update_event_data->expirable = TRUE;
+		break;
+
+	case G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED:
+		if (!previous_update_event_data) {
+			return FALSE;
+		}
+
+		if (previous_update_event_data->event_type == G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED) {
+			previous_update_event_data->start_time = g_get_monotonic_time ();
+		}
+		break;
+
+	default:
+		return FALSE;
+	}
+
+	monitor->priv->events_merged++;
+
+	return TRUE;
+}
+
 static void
-monitor_event_cb (GFileMonitor      *file_monitor,
-                  GFile             *file,
-                  GFile             *other_file,
-                  GFileMonitorEvent  event_type,
-                  gpointer           user_data)
+monitor_event_process (TrackerMonitor    *monitor,
+                       GFile             *file,
+                       GFile             *other_file,
+                       gboolean           is_directory,
+                       GFileMonitorEvent  event_type)
 {
-	TrackerMonitor *monitor;
 	gchar *file_uri;
 	gchar *other_file_uri;
-	gboolean is_directory;
-
-	monitor = user_data;
 
 	if (G_UNLIKELY (!monitor->priv->enabled)) {
 		g_debug ("Silently dropping monitor event, monitor disabled for now");
@@ -1247,8 +1431,6 @@ monitor_event_cb (GFileMonitor      *file_monitor,
 	file_uri = g_file_get_uri (file);
 
 	if (!other_file) {
-		is_directory = check_is_directory (monitor, file);
-
 		/* Avoid non-indexable-files */
 		if (monitor->priv->tree &&
 		    !tracker_indexing_tree_file_is_indexable (monitor->priv->tree,
@@ -1267,11 +1449,6 @@ monitor_event_cb (GFileMonitor      *file_monitor,
 		         is_directory ? "directory" : "file",
 		         file_uri);
 	} else {
-		/* If we have other_file, it means an item was moved from file to other_file;
-		 * so, it makes sense to check if the other_file is directory instead of
-		 * the origin file, as this one will not exist any more */
-		is_directory = check_is_directory (monitor, other_file);
-
 		/* Avoid doing anything of both
 		 * file/other_file are non-indexable
 		 */
@@ -1376,9 +1553,9 @@ monitor_event_cb (GFileMonitor      *file_monitor,
 		if (monitor->priv->event_pairs_timeout_id == 0) {
 			g_debug ("Waiting for event pairs");
 			monitor->priv->event_pairs_timeout_id =
-				g_timeout_add_seconds (CACHE_LIFETIME_SECONDS,
-				                       event_pairs_timeout_cb,
-				                       monitor);
+				g_timeout_add (MAX (monitor->priv->event_window / 2, 1),
+				               event_pairs_timeout_cb,
+				               monitor);
 		}
 	} else {
 		if (monitor->priv->event_pairs_timeout_id != 0) {
@@ -1392,9 +1569,39 @@ monitor_event_cb (GFileMonitor      *file_monitor,
 	g_free (other_file_uri);
 }
 
+static void
+monitor_event_cb (GFileMonitor      *file_monitor,
+                  GFile             *file,
+                  GFile             *other_file,
+                  GFileMonitorEvent  event_type,
+                  gpointer           user_data)
+{
+	TrackerMonitor *monitor;
+	gboolean is_directory;
+
+	monitor = user_data;
+	monitor->priv->events_received++;
+
+	if (monitor_event_coalesce (monitor, file, other_file, event_type)) {
+		return;
+	}
+
+	if (!other_file) {
+		is_directory = check_is_directory (monitor, file);
+	} else {
+		/* If we have other_file, it means an item was moved from file to other_file;
+		 * so, it makes sense to check if the other_file is directory instead of
+		 * the origin file, as this one will not exist any more */
+		is_directory = check_is_directory (monitor, other_file);
+	}
+
+	monitor_event_process (monitor, file, other_file,
+	                       is_directory, event_type);
+}
+
 static GFileMonitor *
-directory_monitor_new (TrackerMonitor *monitor,
-                       GFile          *file)
+file_monitor_new (TrackerMonitor *monitor,
+                  GFile          *file)
 {
 	GFileMonitor *file_monitor;
 	GError *error = NULL;
@@ -1433,6 +1640,459 @@ directory_monitor_cancel (GFileMonitor *monitor)
 	}
 }
 
+#ifdef HAVE_FANOTIFY
+
+static gint
+fanotify_open (void)
+{
+	const gchar *home;
+	gint fd;
+
+	fd = fanotify_init (FAN_CLASS_NOTIF | FAN_REPORT_DFID_NAME |
+	                    FAN_CLOEXEC | FAN_NONBLOCK,
+	                    O_RDONLY | O_LARGEFILE);
+
+	if (fd < 0) {
+		g_debug ("fanotify is not available: %s", g_strerror (errno));
+		return -1;
+	}
+
+	/* Filesystem marks need CAP_SYS_ADMIN, and FAN_RENAME needs a
+	 * recent enough kernel, fanotify_init() succeeding is not enough
+	 * to tell either.
+	 */
+	home = g_get_home_dir ();
+
+	if (fanotify_mark (fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM,
+	                   FANOTIFY_EVENT_MASK, AT_FDCWD, home) < 0) {
+		g_debug ("fanotify can't mark filesystems: %s", g_strerror (errno));
+		close (fd);
+		return -1;
+	}
+
+	fanotify_mark (fd, FAN_MARK_REMOVE | FAN_MARK_FILESYSTEM,
+	               FANOTIFY_EVENT_MASK, AT_FDCWD, home);
+
+	return fd;
+}
+
+static GBytes *
+fanotify_handle_key_new (const __kernel_fsid_t     *fsid,
+                         const struct file_handle *handle)
+{
+	GByteArray *key;
+
+	key = g_byte_array_sized_new (sizeof (__kernel_fsid_t) +
+	                              sizeof (handle->handle_type) +
+	                              handle->handle_bytes);
+	g_byte_array_append (key, (const guint8 *) fsid, sizeof (__kernel_fsid_t));
+	g_byte_array_append (key, (const guint8 *) &handle->handle_type,
+	                     sizeof (handle->handle_type));
+	g_byte_array_append (key, handle->f_handle, handle->handle_bytes);
+
+	return g_byte_array_free_to_bytes (key);
+}
+
+/* Returns the key events for @path as a parent directory will be
+ * reported with, also the filesystem it belongs to in @fsid.
+ */
+static GBytes *
+fanotify_handle_key_new_for_path (const gchar *path,
+                                  GBytes     **fsid)
+{
+	struct file_handle *handle;
+	struct statfs st;
+	GBytes *key = NULL;
+	gint mount_id;
+
+	G_STATIC_ASSERT (sizeof (st.f_fsid) == sizeof (__kernel_fsid_t));
+
+	if (statfs (path, &st) < 0) {
+		return NULL;
+	}
+
+	handle = g_malloc (sizeof (struct file_handle) + MAX_HANDLE_SZ);
+	handle->handle_bytes = MAX_HANDLE_SZ;
+
+	if (name_to_handle_at (AT_FDCWD, path, handle, &mount_id, 0) == 0) {
+		key = fanotify_handle_key_new ((const __kernel_fsid_t *) &st.f_fsid,
+		                               handle);
+		*fsid = g_bytes_new (&st.f_fsid, sizeof (st.f_fsid));
+	}
+
+	g_free (handle);
+
+	return key;
+}
+
+static gboolean
+fanotify_mark_filesystem (TrackerMonitor *monitor,
+                          const gchar    *path,
+                          GBytes         *fsid)
+{
+	gpointer marked;
+
+	if (g_hash_table_lookup_extended (monitor->priv->fanotify_filesystems,
+	                                  fsid, NULL, &marked)) {
+		return GPOINTER_TO_INT (marked);
+	}
+
+	/* Marks stay until the monitor is finalized, events from
+	 * directories that aren't monitored are just dropped.
+	 */
+	if (fanotify_mark (monitor->priv->fanotify_fd,
+	                   FAN_MARK_ADD | FAN_MARK_FILESYSTEM,
+	                   FANOTIFY_EVENT_MASK, AT_FDCWD, path) < 0) {
+		g_message ("Could not mark filesystem of '%s' with fanotify, "
+		           "using per-directory monitors there: %s",
+		           path, g_strerror (errno));
+		marked = GINT_TO_POINTER (FALSE);
+	} else {
+		g_debug ("Marked filesystem of '%s' with fanotify", path);
+		marked = GINT_TO_POINTER (TRUE);
+	}
+
+	g_hash_table_insert (monitor->priv->fanotify_filesystems,
+	                     g_bytes_ref (fsid), marked);
+
+	return GPOINTER_TO_INT (marked);
+}
+
+static FanotifyWatch *
+fanotify_watch_new (TrackerMonitor *monitor,
+                    GFile          *file)
+{
+	FanotifyWatch *watch;
+	GBytes *handle = NULL, *fsid = NULL;
+	gchar *path;
+
+	path = g_file_get_path (file);
+
+	if (path) {
+		handle = fanotify_handle_key_new_for_path (path, &fsid);
+	}
+
+	if (handle && !fanotify_mark_filesystem (monitor, path, fsid)) {
+		g_clear_pointer (&handle, g_bytes_unref);
+	}
+
+	watch = g_slice_new0 (FanotifyWatch);
+	watch->monitor = monitor;
+	watch->file = g_object_ref (file);
+
+	if (handle) {
+		/* A directory moved elsewhere keeps its handle, the
+		 * latest path it was added with is the one used.
+		 */
+		watch->handle = handle;
+		g_hash_table_replace (monitor->priv->fanotify_handles,
+		                      g_bytes_ref (handle),
+		                      g_object_ref (file));
+	} else {
+		watch->file_monitor = file_monitor_new (monitor, file);
+
+		if (!watch->file_monitor) {
+			g_object_unref (watch->file);
+			g_slice_free (FanotifyWatch, watch);
+			watch = NULL;
+		}
+	}
+
+	if (fsid) {
+		g_bytes_unref (fsid);
+	}
+
+	g_free (path);
+
+	return watch;
+}
+
+static void
+fanotify_watch_cancel (FanotifyWatch *watch)
+{
+	GFile *current;
+
+	if (watch->file_monitor) {
+		g_file_monitor_cancel (watch->file_monitor);
+		return;
+	}
+
+	if (!watch->handle) {
+		return;
+	}
+
+	/* The handle may have been taken over by the new location
+	 * of this directory already.
+	 */
+	current = g_hash_table_lookup (watch->monitor->priv->fanotify_handles,
+	                               watch->handle);
+
+	if (current && g_file_equal (current, watch->file)) {
+		g_hash_table_remove (watch->monitor->priv->fanotify_handles,
+		                     watch->handle);
+	}
+
+	g_clear_pointer (&watch->handle, g_bytes_unref);
+}
+
+static void
+fanotify_watch_free (FanotifyWatch *watch)
+{
+	if (!watch) {
+		return;
+	}
+
+	fanotify_watch_cancel (watch);
+
+	if (watch->file_monitor) {
+		g_object_unref (watch->file_monitor);
+	}
+
+	g_object_unref (watch->file);
+	g_slice_free (FanotifyWatch, watch);
+}
+
+/* Returns the file a DFID_NAME info record refers to, if its
+ * parent directory is monitored.
+ */
+static GFile *
+fanotify_info_get_file (TrackerMonitor                     *monitor,
+                        const struct fanotify_event_info_fid *fid)
+{
+	const struct file_handle *handle;
+	const gchar *name;
+	GBytes *key;
+	GFile *dir;
+
+	handle = (const struct file_handle *) fid->handle;
+	name = (const gchar *) handle->f_handle + handle->handle_bytes;
+
+	key = fanotify_handle_key_new (&fid->fsid, handle);
+	dir = g_hash_table_lookup (monitor->priv->fanotify_handles, key);
+	g_bytes_unref (key);
+
+	if (!dir) {
+		return NULL;
+	}
+
+	if (name[0] == '\0' || strcmp (name, ".") == 0) {
+		return g_object_ref (dir);
+	}
+
+	return g_file_get_child (dir, name);
+}
+
+static void
+fanotify_event_process (TrackerMonitor    *monitor,
+                        GFile             *file,
+                        GFile             *other_file,
+                        gboolean           is_directory,
+                        GFileMonitorEvent  event_type)
+{
+	monitor->priv->events_received++;
+
+	if (!is_directory &&
+	    monitor_event_coalesce (monitor, file, other_file, event_type)) {
+		return;
+	}
+
+	monitor_event_process (monitor, file, other_file,
+	                       is_directory, event_type);
+}
+
+static void
+fanotify_handle_event (TrackerMonitor                       *monitor,
+                       const struct fanotify_event_metadata *metadata)
+{
+	const guint8 *info, *end;
+	GFile *file = NULL, *old_file = NULL, *new_file = NULL;
+	gboolean is_directory;
+
+	info = (const guint8 *) metadata + metadata->metadata_len;
+	end = (const guint8 *) metadata + metadata->event_len;
+
+	while (info + sizeof (struct fanotify_event_info_header) <= end) {
+		const struct fanotify_event_info_header *header;
+		const struct fanotify_event_info_fid *fid;
+
+		header = (const struct fanotify_event_info_header *) info;
+		fid = (const struct fanotify_event_info_fid *) info;
+
+		if (header->len == 0) {
+			break;
+		}
+
+		switch (header->info_type) {
+		case FAN_EVENT_INFO_TYPE_DFID_NAME:
+			g_clear_object (&file);
+			file = fanotify_info_get_file (monitor, fid);
+			break;
+		case FAN_EVENT_INFO_TYPE_OLD_DFID_NAME:
+			g_clear_object (&old_file);
+			old_file = fanotify_info_get_file (monitor, fid);
+			break;
+		case FAN_EVENT_INFO_TYPE_NEW_DFID_NAME:
+			g_clear_object (&new_file);
+			new_file = fanotify_info_get_file (monitor, fid);
+			break;
+		default:
+			break;
+		}
+
+		info += header->len;
+	}
+
+	is_directory = (metadata->mask & FAN_ONDIR) != 0;
+
+	if (metadata->mask & FAN_RENAME) {
+		/* Moves in or out of monitored directories are
+		 * reported as GFileMonitor does.
+		 */
+		if (old_file && new_file) {
+			fanotify_event_process (monitor, old_file, new_file, is_directory,
+			                        G_FILE_MONITOR_EVENT_MOVED);
+		} else if (old_file) {
+			fanotify_event_process (monitor, old_file, NULL, is_directory,
+			                        G_FILE_MONITOR_EVENT_DELETED);
+		} else if (new_file) {
+			fanotify_event_process (monitor, new_file, NULL, is_directory,
+			                        G_FILE_MONITOR_EVENT_CREATED);
+		}
+	}
+
+	if (file) {
+		/* Events on the same file may have been merged */
+		if (metadata->mask & FAN_CREATE) {
+			fanotify_event_process (monitor, file, NULL, is_directory,
+			                        G_FILE_MONITOR_EVENT_CREATED);
+		}
+
+		if (metadata->mask & FAN_MODIFY) {
+			fanotify_event_process (monitor, file, NULL, is_directory,
+			                        G_FILE_MONITOR_EVENT_CHANGED);
+		}
+
+		if (metadata->mask & FAN_ATTRIB) {
+			fanotify_event_process (monitor, file, NULL, is_directory,
+			                        G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED);
+		}
+
+		if (metadata->mask & FAN_CLOSE_WRITE) {
+			fanotify_event_process (monitor, file, NULL, is_directory,
+			                        G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT);
+		}
+
+		if (metadata->mask & FAN_DELETE) {
+			fanotify_event_process (monitor, file, NULL, is_directory,
+			                        G_FILE_MONITOR_EVENT_DELETED);
+		}
+	}
+
+	g_clear_object (&file);
+	g_clear_object (&old_file);
+	g_clear_object (&new_file);
+}
+
+/* Events were dropped, and there's no telling which directories they
+ * were for, so every indexing root watched through fanotify is asked
+ * to be crawled again.
+ */
+static void
+fanotify_handle_overflow (TrackerMonitor *monitor)
+{
+	GList *roots, *l;
+	guint n_roots = 0;
+
+	if (!monitor->priv->tree) {
+		g_warning ("Too many fanotify events, some changes were missed");
+		return;
+	}
+
+	roots = tracker_indexing_tree_list_roots (monitor->priv->tree);
+
+	for (l = roots; l; l = l->next) {
+		FanotifyWatch *watch;
+
+		watch = g_hash_table_lookup (monitor->priv->monitors, l->data);
+
+		if (!watch || !watch->handle) {
+			continue;
+		}
+
+		tracker_indexing_tree_notify_update (monitor->priv->tree,
+		                                     l->data, FALSE);
+		n_roots++;
+	}
+
+	g_list_free (roots);
+
+	g_message ("Too many fanotify events, crawling %u monitored roots again",
+	           n_roots);
+}
+
+static gboolean
+fanotify_read_cb (gint         fd,
+                  GIOCondition condition,
+                  gpointer     user_data)
+{
+	TrackerMonitor *monitor = user_data;
+	const struct fanotify_event_metadata *metadata;
+	union {
+		struct fanotify_event_metadata metadata;
+		gchar data[FANOTIFY_BUFFER_SIZE];
+	} buffer;
+	gssize len;
+
+	len = read (fd, buffer.data, sizeof (buffer.data));
+
+	if (len < 0) {
+		if (errno == EAGAIN || errno == EINTR) {
+			return G_SOURCE_CONTINUE;
+		}
+
+		g_critical ("Could not read fanotify events: %s, "
+		            "no further changes will be noticed",
+		            g_strerror (errno));
+		monitor->priv->fanotify_source_id = 0;
+		return G_SOURCE_REMOVE;
+	}
+
+	for (metadata = &buffer.metadata;
+	     FAN_EVENT_OK (metadata, len);
+	     metadata = FAN_EVENT_NEXT (metadata, len)) {
+		if (metadata->vers != FANOTIFY_METADATA_VERSION) {
+			g_critical ("Unexpected fanotify metadata version %d",
+			            metadata->vers);
+			monitor->priv->fanotify_source_id = 0;
+			return G_SOURCE_REMOVE;
+		}
+
+		if (metadata->mask & FAN_Q_OVERFLOW) {
+			fanotify_handle_overflow (monitor);
+			continue;
+		}
+
+		fanotify_handle_event (monitor, metadata);
+	}
+
+	return G_SOURCE_CONTINUE;
+}
+
+#endif /* HAVE_FANOTIFY */
+
+static gpointer
+directory_monitor_new (TrackerMonitor *monitor,
+                       GFile          *file)
+{
+#ifdef HAVE_FANOTIFY
+	if (monitor->priv->fanotify_fd >= 0) {
+		return fanotify_watch_new (monitor, file);
+	}
+#endif /* HAVE_FANOTIFY */
+
+	return file_monitor_new (monitor, file);
+}
+
 TrackerMonitor *
 tracker_monitor_new (void)
 {
@@ -1499,7 +2159,7 @@ tracker_monitor_set_enabled (TrackerMonitor *monitor,
 		file = k->data;
 
 		if (enabled) {
-			GFileMonitor *dir_monitor;
+			gpointer dir_monitor;
 
 			dir_monitor = directory_monitor_new (monitor, file);
 			g_hash_table_replace (monitor->priv->monitors,
@@ -1518,7 +2178,7 @@ gboolean
 tracker_monitor_add (TrackerMonitor *monitor,
                      GFile          *file)
 {
-	GFileMonitor *dir_monitor = NULL;
+	gpointer dir_monitor = NULL;
 	gchar *uri;
 
 	g_return_val_if_fail (TRACKER_IS_MONITOR (monitor), FALSE);
@@ -1686,6 +2346,11 @@ monitor_cancel_recursively (TrackerMonitor *monitor,
 		}
 
 		uri = g_file_get_uri (iter_file);
+#ifdef HAVE_FANOTIFY
+		if (monitor->priv->fanotify_fd >= 0) {
+			fanotify_watch_cancel (iter_file_monitor);
+		} else
+#endif /* HAVE_FANOTIFY */
 		g_file_monitor_cancel (G_FILE_MONITOR (iter_file_monitor));
 		g_debug ("Cancelled monitor for path:'%s'", uri);
 		g_free (uri);
@@ -1746,3 +2411,56 @@ tracker_monitor_get_limit (TrackerMonitor *monitor)
 
 	return monitor->priv->monitor_limit;
 }
+
+void
+tracker_monitor_set_event_window (TrackerMonitor *monitor,
+                                  guint           msec)
+{
+	g_return_if_fail (TRACKER_IS_MONITOR (monitor));
+
+	monitor->priv->event_window = msec;
+}
+
+guint
+tracker_monitor_get_event_window (TrackerMonitor *monitor)
+{
+	g_return_val_if_fail (TRACKER_IS_MONITOR (monitor), 0);
+
+	return monitor->priv->event_window;
+}
+
+/* Whether whole filesystems are marked with fanotify, rather than
+ * each directory getting a GFileMonitor.
+ */
+gboolean
+tracker_monitor_uses_fanotify (TrackerMonitor *monitor)
+{
+	g_return_val_if_fail (TRACKER_IS_MONITOR (monitor), FALSE);
+
+#ifdef HAVE_FANOTIFY
+	return monitor->priv->fanotify_fd >= 0;
+#else
+	return FALSE;
+#endif /* HAVE_FANOTIFY */
+}
+
+void
+tracker_monitor_get_event_counts (TrackerMonitor *monitor,
+                                  guint64        *received,
+                                  guint64        *emitted,
+                                  guint64        *merged)
+{
+	g_return_if_fail (TRACKER_IS_MONITOR (monitor));
+
+	if (received) {
+		*received = monitor->priv->events_received;
+	}
+
+	if (emitted) {
+		*emitted = monitor->priv->events_emitted;
+	}
+
+	if (merged) {
+		*merged = monitor->priv->events_merged;
+	}
+}
@@ -79,6 +79,15 @@ guint           tracker_monitor_get_count            (TrackerMonitor *monitor);
 guint           tracker_monitor_get_ignored          (TrackerMonitor *monitor);
 guint           tracker_monitor_get_limit            (TrackerMonitor *monitor);
 
+void            tracker_monitor_set_event_window     (TrackerMonitor *monitor,
+                                                      guint           msec);
+guint           tracker_monitor_get_event_window     (TrackerMonitor *monitor);
+void            tracker_monitor_get_event_counts     (TrackerMonitor *monitor,
+                                                      guint64        *received,
+                                                      guint64        *emitted,
+                                                      guint64        *merged);
+gboolean        tracker_monitor_uses_fanotify        (TrackerMonitor *monitor);
+
 G_END_DECLS
 
 #endif /* __LIBTRACKER_MINER_MONITOR_H__ */
@@ -21,9 +21,13 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include "tracker-priority-queue.h"
 
 typedef struct PrioritySegment PrioritySegment;
+typedef struct IndexNode IndexNode;
+typedef struct IndexElem IndexElem;
 
 struct PrioritySegment
 {
@@ -32,11 +36,38 @@ struct PrioritySegment
 	GList *last_elem;
 };
 
+/* The file index is a trie on the URI path components, each node
+ * holding the queue links whose element file is that URI.
+ */
+struct IndexNode
+{
+	IndexNode *parent;
+	gchar *name;
+	GFile *file;
+	GHashTable *children;
+	GQueue links;
+	/* Number of links in this node and all its descendants */
+	guint n_subtree_links;
+};
+
+struct IndexElem
+{
+	IndexNode *node;
+	GList *node_link;
+	gint priority;
+};
+
 struct _TrackerPriorityQueue
 {
 	GQueue queue;
 	GArray *segments;
 
+	/* File index, only on indexed queues */
+	TrackerPriorityQueueFileFunc file_func;
+	IndexNode *index_root;
+	GHashTable *index_files;
+	GHashTable *index_elems;
+
 	gint ref_count;
 };
 
@@ -50,11 +81,87 @@ tracker_priority_queue_new (void)
 	queue->segments = g_array_new (FALSE, FALSE,
 	                               sizeof (PrioritySegment));
 
+	queue->file_func = NULL;
+	queue->index_root = NULL;
+	queue->index_files = NULL;
+	queue->index_elems = NULL;
+
 	queue->ref_count = 1;
 
 	return queue;
 }
 
+static void
+index_elem_free (IndexElem *elem)
+{
+	g_slice_free (IndexElem, elem);
+}
+
+static IndexNode *
+index_node_new (IndexNode   *parent,
+                const gchar *name)
+{
+	IndexNode *node;
+
+	node = g_slice_new0 (IndexNode);
+	node->parent = parent;
+	node->name = g_strdup (name);
+	g_queue_init (&node->links);
+
+	if (parent) {
+		if (!parent->children) {
+			parent->children = g_hash_table_new (g_str_hash, g_str_equal);
+		}
+
+		g_hash_table_insert (parent->children, node->name, node);
+	}
+
+	return node;
+}
+
+static void
+index_node_free (IndexNode *node)
+{
+	if (node->children) {
+		GHashTableIter iter;
+		gpointer value;
+
+		g_hash_table_iter_init (&iter, node->children);
+		while (g_hash_table_iter_next (&iter, NULL, &value)) {
+			index_node_free (value);
+		}
+
+		g_hash_table_unref (node->children);
+	}
+
+	g_clear_object (&node->file);
+	g_queue_clear (&node->links);
+	g_free (node->name);
+	g_slice_free (IndexNode, node);
+}
+
+/* Creates a queue that additionally indexes its elements by file, so
+ * looking up a file or all files inside a directory doesn't need to
+ * walk the whole queue. With a NULL file_func the elements are GFiles
+ * themselves. If the file of a queued element changes, the queue must
+ * be told through tracker_priority_queue_reindex_node().
+ */
+TrackerPriorityQueue *
+tracker_priority_queue_new_with_index (TrackerPriorityQueueFileFunc file_func)
+{
+	TrackerPriorityQueue *queue;
+
+	queue = tracker_priority_queue_new ();
+	queue->file_func = file_func;
+	queue->index_root = index_node_new (NULL, NULL);
+	queue->index_files = g_hash_table_new (g_file_hash,
+	                                       (GEqualFunc) g_file_equal);
+	queue->index_elems = g_hash_table_new_full (NULL, NULL, NULL,
+	                                            (GDestroyNotify) index_elem_free);
+
+	return queue;
+}
+
 TrackerPriorityQueue *
 tracker_priority_queue_ref (TrackerPriorityQueue *queue)
 {
@@ -68,6 +175,13 @@ tracker_priority_queue_unref (TrackerPriorityQueue *queue)
 	if (g_atomic_int_dec_and_test (&queue->ref_count)) {
 		g_queue_clear (&queue->queue);
 		g_array_free (queue->segments, TRUE);
+
+		if (queue->index_root) {
+			g_hash_table_unref (queue->index_elems);
+			g_hash_table_unref (queue->index_files);
+			index_node_free (queue->index_root);
+		}
+
 		g_slice_free (TrackerPriorityQueue, queue);
 	}
 }
@@ -99,6 +213,159 @@ queue_insert_after_link (GQueue *queue,
 		queue_insert_before_link (queue, sibling->next, link_);
 }
 
+static GFile *
+index_get_file (TrackerPriorityQueue *queue,
+                gpointer              data)
+{
+	if (queue->file_func) {
+		return (queue->file_func) (data);
+	}
+
+	return data;
+}
+
+/* Looks up the trie node for a file, creating it if requested */
+static IndexNode *
+index_lookup (TrackerPriorityQueue *queue,
+              GFile                *file,
+              gboolean              create)
+{
+	IndexNode *node;
+	gchar *uri, *component, *next;
+
+	node = g_hash_table_lookup (queue->index_files, file);
+
+	if (node) {
+		return node;
+	}
+
+	uri = g_file_get_uri (file);
+	node = queue->index_root;
+	component = uri;
+
+	/* Only root URIs end with a slash, which would leave an empty
+	 * last component. Drop it so "file:///" is the parent node of
+	 * "file:///home" rather than its sibling.
+	 */
+	if (g_str_has_suffix (uri, "/")) {
+		uri[strlen (uri) - 1] = '\0';
+	}
+
+	while (node && component) {
+		IndexNode *child = NULL;
+
+		next = strchr (component, '/');
+
+		if (next) {
+			*next = '\0';
+			next++;
+		}
+
+		if (node->children) {
+			child = g_hash_table_lookup (node->children, component);
+		}
+
+		if (!child && create) {
+			child = index_node_new (node, component);
+		}
+
+		node = child;
+		component = next;
+	}
+
+	g_free (uri);
+
+	if (node && create && !node->file) {
+		node->file = g_object_ref (file);
+		g_hash_table_insert (queue->index_files, node->file, node);
+	}
+
+	return node;
+}
+
+static void
+index_add (TrackerPriorityQueue *queue,
+           GList                *link_,
+           gint                  priority)
+{
+	IndexElem *elem;
+	IndexNode *node;
+
+	if (!queue->index_root) {
+		return;
+	}
+
+	elem = g_slice_new (IndexElem);
+	elem->node = index_lookup (queue, index_get_file (queue, link_->data), TRUE);
+	elem->priority = priority;
+
+	g_queue_push_tail (&elem->node->links, link_);
+	elem->node_link = elem->node->links.tail;
+	g_hash_table_insert (queue->index_elems, link_, elem);
+
+	for (node = elem->node; node; node = node->parent) {
+		node->n_subtree_links++;
+	}
+}
+
+static void
+index_remove (TrackerPriorityQueue *queue,
+              GList                *link_)
+{
+	IndexElem *elem;
+	IndexNode *node, *parent;
+
+	if (!queue->index_root) {
+		return;
+	}
+
+	elem = g_hash_table_lookup (queue->index_elems, link_);
+	g_assert (elem != NULL);
+
+	node = elem->node;
+	g_queue_delete_link (&node->links, elem->node_link);
+	g_hash_table_remove (queue->index_elems, link_);
+
+	if (g_queue_is_empty (&node->links) && node->file) {
+		g_hash_table_remove (queue->index_files, node->file);
+		g_clear_object (&node->file);
+	}
+
+	/* Drop the nodes left without links */
+	while (node) {
+		parent = node->parent;
+		node->n_subtree_links--;
+
+		if (parent && node->n_subtree_links == 0) {
+			g_hash_table_remove (parent->children, node->name);
+			index_node_free (node);
+		}
+
+		node = parent;
+	}
+}
+
+static void
+index_collect_links (IndexNode *node,
+                     GPtrArray *links)
+{
+	GList *l;
+
+	for (l = node->links.head; l; l = l->next) {
+		g_ptr_array_add (links, l->data);
+	}
+
+	if (node->children) {
+		GHashTableIter iter;
+		gpointer value;
+
+		g_hash_table_iter_init (&iter, node->children);
+		while (g_hash_table_iter_next (&iter, NULL, &value)) {
+			index_collect_links (value, links);
+		}
+	}
+}
+
 static void
 insert_node (TrackerPriorityQueue *queue,
              gint                  priority,
@@ -237,6 +504,7 @@ tracker_priority_queue_foreach_remove (TrackerPriorityQueue *queue,
 				(destroy_notify) (elem->data);
 			}
 
+			index_remove (queue, elem);
 			g_queue_delete_link (&queue->queue, elem);
 			updated = TRUE;
 		} else {
@@ -289,6 +557,7 @@ tracker_priority_queue_add (TrackerPriorityQueue *queue,
 	node = g_list_alloc ();
 	node->data = data;
 	insert_node (queue, priority, node);
+	index_add (queue, node, priority);
 
 	return node;
 }
@@ -302,6 +571,7 @@ tracker_priority_queue_add_node (TrackerPriorityQueue *queue,
 	g_return_if_fail (node != NULL);
 
 	insert_node (queue, priority, node);
+	index_add (queue, node, priority);
 }
 
 void
@@ -332,6 +602,7 @@ tracker_priority_queue_remove_node (TrackerPriorityQueue *queue,
 		}
 	}
 
+	index_remove (queue, node);
 	g_queue_delete_link (&queue->queue, node);
 }
 
@@ -443,6 +714,8 @@ tracker_priority_queue_pop_node (TrackerPriorityQueue *queue,
 		segment->first_elem = segment->first_elem->next;
 	}
 
+	index_remove (queue, node);
+
 	return g_queue_pop_head_link (&queue->queue);
 }
 
@@ -453,3 +726,165 @@ tracker_priority_queue_get_head (TrackerPriorityQueue *queue)
 
 	return queue->queue.head;
 }
+
+/* Returns the node of the first element added for file */
+GList *
+tracker_priority_queue_find_file_node (TrackerPriorityQueue *queue,
+                                       GFile                *file,
+                                       gint                 *priority_out)
+{
+	IndexNode *node;
+	IndexElem *elem;
+	GList *link_;
+
+	g_return_val_if_fail (queue != NULL, NULL);
+	g_return_val_if_fail (queue->index_root != NULL, NULL);
+	g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+	node = g_hash_table_lookup (queue->index_files, file);
+
+	if (!node) {
+		return NULL;
+	}
+
+	link_ = g_queue_peek_head (&node->links);
+
+	if (priority_out) {
+		elem = g_hash_table_lookup (queue->index_elems, link_);
+		*priority_out = elem->priority;
+	}
+
+	return link_;
+}
+
+/* Updates the file index after the file of the element in node
+ * changed. The node keeps its priority and position in the queue.
+ */
+void
+tracker_priority_queue_reindex_node (TrackerPriorityQueue *queue,
+                                     GList                *node)
+{
+	IndexElem *elem;
+	gint priority;
+
+	g_return_if_fail (queue != NULL);
+	g_return_if_fail (queue->index_root != NULL);
+	g_return_if_fail (node != NULL);
+
+	elem = g_hash_table_lookup (queue->index_elems, node);
+	g_return_if_fail (elem != NULL);
+
+	/* index_remove() goes through the old trie node, not the file */
+	priority = elem->priority;
+	index_remove (queue, node);
+	index_add (queue, node, priority);
+}
+
+/* Whether there are elements for files inside prefix */
+gboolean
+tracker_priority_queue_has_descendants (TrackerPriorityQueue *queue,
+                                        GFile                *prefix)
+{
+	IndexNode *node;
+
+	g_return_val_if_fail (queue != NULL, FALSE);
+	g_return_val_if_fail (queue->index_root != NULL, FALSE);
+	g_return_val_if_fail (G_IS_FILE (prefix), FALSE);
+
+	node = index_lookup (queue, prefix, FALSE);
+
+	if (!node) {
+		return FALSE;
+	}
+
+	return node->n_subtree_links > node->links.length;
+}
+
+static gboolean
+remove_links (TrackerPriorityQueue *queue,
+              GPtrArray            *links,
+              GDestroyNotify        destroy_notify)
+{
+	guint i;
+
+	for (i = 0; i < links->len; i++) {
+		GList *link_ = g_ptr_array_index (links, i);
+		gpointer data = link_->data;
+
+		tracker_priority_queue_remove_node (queue, link_);
+
+		if (destroy_notify) {
+			(destroy_notify) (data);
+		}
+	}
+
+	return links->len > 0;
+}
+
+/* Removes all elements for file */
+gboolean
+tracker_priority_queue_remove_file (TrackerPriorityQueue *queue,
+                                    GFile                *file,
+                                    GDestroyNotify        destroy_notify)
+{
+	IndexNode *node;
+	GPtrArray *links;
+	GList *l;
+	gboolean updated;
+
+	g_return_val_if_fail (queue != NULL, FALSE);
+	g_return_val_if_fail (queue->index_root != NULL, FALSE);
+	g_return_val_if_fail (G_IS_FILE (file), FALSE);
+
+	node = g_hash_table_lookup (queue->index_files, file);
+
+	if (!node) {
+		return FALSE;
+	}
+
+	links = g_ptr_array_sized_new (node->links.length);
+
+	for (l = node->links.head; l; l = l->next) {
+		g_ptr_array_add (links, l->data);
+	}
+
+	updated = remove_links (queue, links, destroy_notify);
+	g_ptr_array_unref (links);
+
+	return updated;
+}
+
+/* Removes all elements for files inside prefix, but not for prefix itself */
+gboolean
+tracker_priority_queue_remove_descendants (TrackerPriorityQueue *queue,
+                                           GFile                *prefix,
+                                           GDestroyNotify        destroy_notify)
+{
+	GHashTableIter iter;
+	IndexNode *node;
+	GPtrArray *links;
+	gpointer value;
+	gboolean updated;
+
+	g_return_val_if_fail (queue != NULL, FALSE);
+	g_return_val_if_fail (queue->index_root != NULL, FALSE);
+	g_return_val_if_fail (G_IS_FILE (prefix), FALSE);
+
+	node = index_lookup (queue, prefix, FALSE);
+
+	if (!node || !node->children) {
+		return FALSE;
+	}
+
+	links = g_ptr_array_sized_new (node->n_subtree_links);
+
+	g_hash_table_iter_init (&iter, node->children);
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		index_collect_links (value, links);
+	}
+
+	updated = remove_links (queue, links, destroy_notify);
+	g_ptr_array_unref (links);
+
+	return updated;
+}
@@ -22,13 +22,16 @@
 #ifndef __LIBTRACKER_MINER_PRIORITY_QUEUE_H__
 #define __LIBTRACKER_MINER_PRIORITY_QUEUE_H__
 
-#include <glib.h>
+#include <gio/gio.h>
 
 G_BEGIN_DECLS
 
 typedef struct _TrackerPriorityQueue TrackerPriorityQueue;
 
+typedef GFile * (* TrackerPriorityQueueFileFunc) (gpointer data);
+
 TrackerPriorityQueue *tracker_priority_queue_new   (void);
+TrackerPriorityQueue *tracker_priority_queue_new_with_index (TrackerPriorityQueueFileFunc file_func);
 
 TrackerPriorityQueue *tracker_priority_queue_ref   (TrackerPriorityQueue *queue);
 void                  tracker_priority_queue_unref (TrackerPriorityQueue *queue);
@@ -68,6 +71,21 @@ void     tracker_priority_queue_remove_node (TrackerPriorityQueue  *queue,
 GList *  tracker_priority_queue_pop_node    (TrackerPriorityQueue *queue,
                                              gint                 *priority_out);
 
+/* Indexed queues only */
+GList *  tracker_priority_queue_find_file_node     (TrackerPriorityQueue *queue,
+                                                    GFile                *file,
+                                                    gint                 *priority_out);
+void     tracker_priority_queue_reindex_node       (TrackerPriorityQueue *queue,
+                                                    GList                *node);
+gboolean tracker_priority_queue_has_descendants    (TrackerPriorityQueue *queue,
+                                                    GFile                *prefix);
+gboolean tracker_priority_queue_remove_file        (TrackerPriorityQueue *queue,
+                                                    GFile                *file,
+                                                    GDestroyNotify        destroy_notify);
+gboolean tracker_priority_queue_remove_descendants (TrackerPriorityQueue *queue,
+                                                    GFile                *prefix,
+                                                    GDestroyNotify        destroy_notify);
+
 
 G_END_DECLS
 
@@ -21,13 +21,25 @@
 
 #include "config.h"
 
+#include <libtracker-common/tracker-dbus.h>
 #include <libtracker-sparql/tracker-sparql.h>
 
 #include "tracker-sparql-buffer.h"
 
+#define TRACKER_SERVICE          "org.freedesktop.Tracker1"
+#define TRACKER_STATUS_PATH      "/org/freedesktop/Tracker1/Status"
+#define TRACKER_STATUS_INTERFACE "org.freedesktop.Tracker1.Status"
+
 /* Maximum time (seconds) before forcing a sparql buffer flush */
 #define MAX_SPARQL_BUFFER_TIME  15
 
+/* Bounds for the limit when it's adapted to commit latency */
+#define MIN_ADAPTIVE_LIMIT      1
+#define MAX_ADAPTIVE_LIMIT      1000
+
+/* Weight given to the last batch in the latency/throughput averages */
+#define STATS_SMOOTHING         0.25
+
 typedef struct _TrackerSparqlBufferPrivate TrackerSparqlBufferPrivate;
 typedef struct _SparqlTaskData SparqlTaskData;
 typedef struct _UpdateArrayData UpdateArrayData;
@@ -51,6 +63,31 @@ struct _TrackerSparqlBufferPrivate
 	guint flush_timeout_id;
 	GPtrArray *tasks;
 	gint n_updates;
+
+	/* The pool limit leaves room for updates_limit batches of
+	 * batch_size tasks, all but one of them being committed.
+	 * updates_limit is max_updates unless adapted to latency.
+	 */
+	guint batch_size;
+	guint max_updates;
+	guint updates_limit;
+
+	/* GFile -> number of batches being committed with a task on it */
+	GHashTable *files_in_flight;
+	guint flush_delayed : 1;
+
+	/* Commit statistics, and the latency the limit is adapted to */
+	guint target_latency;
+	gdouble latency;
+	gdouble throughput;
+	gdouble last_throughput;
+
+	/* Updates queued in the store, as of the last poll */
+	GDBusConnection *store_bus;
+	GCancellable *store_poll_cancellable;
+	guint store_queued;
+	guint store_poll_pending : 1;
+	guint store_poll_disabled : 1;
 };
 
 struct _SparqlTaskData
@@ -79,6 +116,8 @@ struct _UpdateArrayData {
 	TrackerSparqlBuffer *buffer;
 	GPtrArray *tasks;
 	GArray *sparql_array;
+	gint64 start_time;
+	guint limit;
 };
 
 struct _BulkOperationMerge {
@@ -101,6 +140,12 @@ tracker_sparql_buffer_finalize (GObject *object)
 		g_source_remove (priv->flush_timeout_id);
 	}
 
+	g_hash_table_unref (priv->files_in_flight);
+
+	g_cancellable_cancel (priv->store_poll_cancellable);
+	g_object_unref (priv->store_poll_cancellable);
+	g_clear_object (&priv->store_bus);
+
 	G_OBJECT_CLASS (tracker_sparql_buffer_parent_class)->finalize (object);
 }
 
@@ -201,16 +246,107 @@ tracker_sparql_buffer_init (TrackerSparqlBuffer *buffer)
 	buffer->priv = G_TYPE_INSTANCE_GET_PRIVATE (buffer,
 	                                            TRACKER_TYPE_SPARQL_BUFFER,
 	                                            TrackerSparqlBufferPrivate);
+	buffer->priv->batch_size = 1;
+	buffer->priv->max_updates = 1;
+	buffer->priv->updates_limit = 1;
+	buffer->priv->files_in_flight =
+		g_hash_table_new_full ((GHashFunc) g_file_hash,
+		                       (GEqualFunc) g_file_equal,
+		                       (GDestroyNotify) g_object_unref,
+		                       NULL);
+	buffer->priv->store_poll_cancellable = g_cancellable_new ();
 }
 
 TrackerSparqlBuffer *
 tracker_sparql_buffer_new (TrackerSparqlConnection *connection,
                            guint                    limit)
 {
-	return g_object_new (TRACKER_TYPE_SPARQL_BUFFER,
-	                     "connection", connection,
-	                     "limit", limit,
-	                     NULL);
+	TrackerSparqlBuffer *buffer;
+
+	buffer = g_object_new (TRACKER_TYPE_SPARQL_BUFFER,
+	                       "connection", connection,
+	                       NULL);
+	tracker_sparql_buffer_set_batch_size (buffer, limit);
+
+	return buffer;
+}
+
+static void
+sparql_buffer_update_limit (TrackerSparqlBuffer *buffer)
+{
+	TrackerSparqlBufferPrivate *priv = buffer->priv;
+
+	tracker_task_pool_set_limit (TRACKER_TASK_POOL (buffer),
+	                             priv->batch_size * priv->updates_limit);
+}
+
+static void
+files_in_flight_add (TrackerSparqlBuffer *buffer,
+                     GPtrArray           *tasks)
+{
+	TrackerSparqlBufferPrivate *priv = buffer->priv;
+	gint i;
+
+	for (i = 0; i < tasks->len; i++) {
+		GFile *file;
+		gpointer count;
+
+		file = tracker_task_get_file (g_ptr_array_index (tasks, i));
+		count = g_hash_table_lookup (priv->files_in_flight, file);
+		g_hash_table_insert (priv->files_in_flight, g_object_ref (file),
+		                     GUINT_TO_POINTER (GPOINTER_TO_UINT (count) + 1));
+	}
+}
+
+static void
+files_in_flight_remove (TrackerSparqlBuffer *buffer,
+                        GPtrArray           *tasks)
+{
+	TrackerSparqlBufferPrivate *priv = buffer->priv;
+	gint i;
+
+	for (i = 0; i < tasks->len; i++) {
+		GFile *file;
+		guint count;
+
+		file = tracker_task_get_file (g_ptr_array_index (tasks, i));
+		count = GPOINTER_TO_UINT (g_hash_table_lookup (priv->files_in_flight, file));
+
+		if (count > 1) {
+			g_hash_table_insert (priv->files_in_flight, g_object_ref (file),
+			                     GUINT_TO_POINTER (count - 1));
+		} else {
+			g_hash_table_remove (priv->files_in_flight, file);
+		}
+	}
+}
+
+/* Updates on a file must reach the store in the order they were
+ * pushed, so a batch is held back while an earlier one touching
+ * any of its files is still being committed.
+ */
+static gboolean
+files_in_flight_contains_any (TrackerSparqlBuffer *buffer,
+                              GPtrArray           *tasks)
+{
+	TrackerSparqlBufferPrivate *priv = buffer->priv;
+	gint i;
+
+	if (g_hash_table_size (priv->files_in_flight) == 0) {
+		return FALSE;
+	}
+
+	for (i = 0; i < tasks->len; i++) {
+		GFile *file;
+
+		file = tracker_task_get_file (g_ptr_array_index (tasks, i));
+
+		if (g_hash_table_contains (priv->files_in_flight, file)) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
 }
 
 static void
@@ -240,6 +376,187 @@ update_array_data_free (UpdateArrayData *update_data)
 	g_slice_free (UpdateArrayData, update_data);
 }
 
+/* Adapts the batch size and the number of batches in flight to a
+ * finished commit of n_tasks tasks, taken from a pool whose batch size
+ * was batch_limit, with store_queued updates queued in the store.
+ *
+ * Latency includes the time batches spend queued in the store, so
+ * when commits take longer than the target, batches in flight are
+ * cut down first, then the batch size shrinks. They are also cut down
+ * while the store queues more updates than we keep in flight, as more
+ * batches would only wait longer there. While full batches keep
+ * increasing throughput, batches in flight are let up to max_updates
+ * first if the store queue is empty, then the batch size grows.
+ */
+void
+tracker_sparql_buffer_adapt_limit (TrackerSparqlBuffer *buffer,
+                                   guint                n_tasks,
+                                   guint                batch_limit,
+                                   gdouble              latency,
+                                   gdouble              throughput,
+                                   guint                store_queued)
+{
+	TrackerSparqlBufferPrivate *priv;
+	guint limit, new_limit, updates_limit;
+	gboolean full_batch;
+
+	g_return_if_fail (TRACKER_IS_SPARQL_BUFFER (buffer));
+
+	priv = buffer->priv;
+	limit = priv->batch_size;
+	new_limit = limit;
+	updates_limit = priv->updates_limit;
+
+	/* Only full batches tell whether the limit holds us back */
+	full_batch = n_tasks >= batch_limit;
+
+	if (latency > priv->target_latency) {
+		if (updates_limit > 1) {
+			updates_limit--;
+		} else {
+			new_limit = MAX (limit * 3 / 4, MIN_ADAPTIVE_LIMIT);
+		}
+	} else if (updates_limit > 1 && store_queued >= updates_limit) {
+		updates_limit--;
+	} else if (full_batch && throughput >= priv->last_throughput) {
+		if (updates_limit < priv->max_updates && store_queued == 0) {
+			updates_limit++;
+		} else {
+			new_limit = MIN (limit + MAX (limit / 4, 1), MAX_ADAPTIVE_LIMIT);
+		}
+	}
+
+	if (full_batch) {
+		priv->last_throughput = throughput;
+	}
+
+	if (new_limit != limit || updates_limit != priv->updates_limit) {
+		g_debug ("(Sparql buffer) Adapting batch size from %u to %u, "
+		         "batches in flight from %u to %u "
+		         "(%.0f ms latency, %.1f tasks/s, %u updates queued in the store)",
+		         limit, new_limit, priv->updates_limit, updates_limit,
+		         latency, throughput, store_queued);
+		priv->batch_size = new_limit;
+		priv->updates_limit = updates_limit;
+		sparql_buffer_update_limit (buffer);
+	}
+}
+
+static void
+store_queue_poll_cb (GObject      *object,
+                     GAsyncResult *result,
+                     gpointer      user_data)
+{
+	TrackerSparqlBufferPrivate *priv;
+	GVariantIter *iter;
+	GVariant *reply;
+	GError *error = NULL;
+	guint n_updates, store_queued = 0;
+
+	reply = g_dbus_connection_call_finish (G_DBUS_CONNECTION (object),
+	                                       result, &error);
+
+	if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		/* The buffer is gone */
+		g_error_free (error);
+		return;
+	}
+
+	priv = TRACKER_SPARQL_BUFFER (user_data)->priv;
+	priv->store_poll_pending = FALSE;
+
+	if (error) {
+		/* No store with queue statistics, go by latency alone */
+		g_debug ("(Sparql buffer) Not polling the store queue: %s",
+		         error->message);
+		priv->store_poll_disabled = TRUE;
+		priv->store_queued = 0;
+		g_error_free (error);
+		return;
+	}
+
+	/* Updates of every priority wait for the same writer */
+	g_variant_get (reply, "((uua(suuxxx)))", NULL, NULL, &iter);
+
+	while (g_variant_iter_next (iter, "(&suuxxx)",
+	                            NULL, NULL, &n_updates, NULL, NULL, NULL)) {
+		store_queued += n_updates;
+	}
+
+	g_variant_iter_free (iter);
+	g_variant_unref (reply);
+
+	priv->store_queued = store_queued;
+}
+
+/* Updates always go through the bus, so the store queue can be
+ * looked up there. The answer is used on the next commit.
+ */
+static void
+sparql_buffer_poll_store_queue (TrackerSparqlBuffer *buffer)
+{
+	TrackerSparqlBufferPrivate *priv = buffer->priv;
+	GError *error = NULL;
+
+	if (priv->store_poll_pending || priv->store_poll_disabled)
+		return;
+
+	if (!priv->store_bus) {
+		priv->store_bus = g_bus_get_sync (TRACKER_IPC_BUS, NULL, &error);
+
+		if (!priv->store_bus) {
+			g_debug ("(Sparql buffer) Not polling the store queue: %s",
+			         error->message);
+			priv->store_poll_disabled = TRUE;
+			g_error_free (error);
+			return;
+		}
+	}
+
+	priv->store_poll_pending = TRUE;
+	g_dbus_connection_call (priv->store_bus,
+	                        TRACKER_SERVICE,
+	                        TRACKER_STATUS_PATH,
+	                        TRACKER_STATUS_INTERFACE,
+	                        "GetQueueStatistics",
+	                        NULL,
+	                        G_VARIANT_TYPE ("((uua(suuxxx)))"),
+	                        G_DBUS_CALL_FLAGS_NO_AUTO_START,
+	                        -1,
+	                        priv->store_poll_cancellable,
+	                        store_queue_poll_cb,
+	                        buffer);
+}
+
+static void
+sparql_buffer_update_stats (TrackerSparqlBuffer *buffer,
+                            UpdateArrayData     *update_data)
+{
+	TrackerSparqlBufferPrivate *priv = buffer->priv;
+	gdouble latency, throughput;
+
+	/* In milliseconds, and tasks per second */
+	latency = MAX (g_get_monotonic_time () - update_data->start_time, 1) / 1000.0;
+	throughput = update_data->tasks->len * 1000.0 / latency;
+
+	if (priv->latency == 0) {
+		priv->latency = latency;
+		priv->throughput = throughput;
+	} else {
+		priv->latency += STATS_SMOOTHING * (latency - priv->latency);
+		priv->throughput += STATS_SMOOTHING * (throughput - priv->throughput);
+	}
+
+	if (priv->target_latency > 0) {
+		tracker_sparql_buffer_adapt_limit (buffer,
+		                                   update_data->tasks->len,
+		                                   update_data->limit,
+		                                   latency, throughput,
+		                                   priv->store_queued);
+		sparql_buffer_poll_store_queue (buffer);
+	}
+}
+
 static void
 tracker_sparql_buffer_update_array_cb (GObject      *object,
                                        GAsyncResult *result,
@@ -261,12 +578,16 @@ tracker_sparql_buffer_update_array_cb (GObject      *object,
 	g_debug ("(Sparql buffer) Finished array-update with %u tasks",
 	         update_data->tasks->len);
 
+	files_in_flight_remove (buffer, update_data->tasks);
+
 	sparql_array_errors = tracker_sparql_connection_update_array_finish (priv->connection,
 	                                                                     result,
 	                                                                     &global_error);
 	if (global_error) {
 		g_critical ("  (Sparql buffer) Error in array-update: %s",
 		            global_error->message);
+	} else {
+		sparql_buffer_update_stats (buffer, update_data);
 	}
 
 	/* Report status on each task of the batch update */
@@ -337,8 +658,10 @@ tracker_sparql_buffer_update_array_cb (GObject      *object,
 		g_error_free (global_error);
 	}
 
-	if (tracker_task_pool_limit_reached (TRACKER_TASK_POOL (buffer))) {
+	if (priv->tasks && priv->tasks->len >= priv->batch_size) {
 		tracker_sparql_buffer_flush (buffer, "SPARQL buffer limit reached (after flush)");
+	} else if (priv->flush_delayed) {
+		tracker_sparql_buffer_flush (buffer, "Delayed flush");
 	}
 }
 
@@ -475,7 +798,8 @@ tracker_sparql_buffer_flush (TrackerSparqlBuffer *buffer,
 
 	priv = buffer->priv;
 
-	if (priv->n_updates > 0) {
+	if (priv->n_updates >= priv->updates_limit) {
+		priv->flush_delayed = TRUE;
 		return FALSE;
 	}
 
@@ -484,7 +808,16 @@ tracker_sparql_buffer_flush (TrackerSparqlBuffer *buffer,
 		return FALSE;
 	}
 
+	if (files_in_flight_contains_any (buffer, priv->tasks)) {
+		/* Flushed again when the earlier batch is finished */
+		g_debug ("Delaying SPARQL buffer flush (%s), "
+		         "files are still being committed", reason);
+		priv->flush_delayed = TRUE;
+		return FALSE;
+	}
+
 	g_debug ("Flushing SPARQL buffer, reason: %s", reason);
+	priv->flush_delayed = FALSE;
 
 	if (priv->flush_timeout_id != 0) {
 		g_source_remove (priv->flush_timeout_id);
@@ -529,6 +862,8 @@ tracker_sparql_buffer_flush (TrackerSparqlBuffer *buffer,
 	update_data->buffer = buffer;
 	update_data->tasks = g_ptr_array_ref (priv->tasks);
 	update_data->sparql_array = sparql_array;
+	update_data->start_time = g_get_monotonic_time ();
+	update_data->limit = priv->batch_size;
 
 	/* Empty pool, update_data will keep
 	 * references to the tasks to keep
@@ -538,6 +873,8 @@ tracker_sparql_buffer_flush (TrackerSparqlBuffer *buffer,
 	priv->tasks = NULL;
 	priv->n_updates++;
 
+	files_in_flight_add (buffer, update_data->tasks);
+
 	/* Start the update */
 	tracker_sparql_connection_update_array_async (priv->connection,
 	                                              (gchar **) update_data->sparql_array->data,
@@ -634,9 +971,9 @@ sparql_buffer_push_to_pool (TrackerSparqlBuffer *buffer,
 	 * the GPtrArray. */
 	g_ptr_array_add (priv->tasks, tracker_task_ref (task));
 
-	if (tracker_task_pool_limit_reached (TRACKER_TASK_POOL (buffer))) {
+	if (priv->tasks->len >= priv->batch_size) {
 		tracker_sparql_buffer_flush (buffer, "SPARQL buffer limit reached");
-	} else if (priv->tasks->len > tracker_task_pool_get_limit (TRACKER_TASK_POOL (buffer)) / 2) {
+	} else if (priv->tasks->len > priv->batch_size / 2) {
 		/* We've filled half of the buffer, flush it as we receive more tasks */
 		tracker_sparql_buffer_flush (buffer, "SPARQL buffer half-full");
 	}
@@ -789,3 +1126,123 @@ tracker_sparql_buffer_push_finish (TrackerSparqlBuffer  *buffer,
 
 	return task;
 }
+
+void
+tracker_sparql_buffer_set_batch_size (TrackerSparqlBuffer *buffer,
+                                      guint                batch_size)
+{
+	TrackerSparqlBufferPrivate *priv;
+
+	g_return_if_fail (TRACKER_IS_SPARQL_BUFFER (buffer));
+	g_return_if_fail (batch_size > 0);
+
+	priv = buffer->priv;
+	priv->batch_size = batch_size;
+	sparql_buffer_update_limit (buffer);
+}
+
+guint
+tracker_sparql_buffer_get_batch_size (TrackerSparqlBuffer *buffer)
+{
+	TrackerSparqlBufferPrivate *priv;
+
+	g_return_val_if_fail (TRACKER_IS_SPARQL_BUFFER (buffer), 0);
+
+	priv = buffer->priv;
+
+	return priv->batch_size;
+}
+
+/* Sets how many batches may be committed at once, so the next
+ * batch is filled while the store is busy with the previous ones.
+ * With a target latency, this is the most batches let in flight.
+ */
+void
+tracker_sparql_buffer_set_max_updates (TrackerSparqlBuffer *buffer,
+                                       guint                max_updates)
+{
+	TrackerSparqlBufferPrivate *priv;
+
+	g_return_if_fail (TRACKER_IS_SPARQL_BUFFER (buffer));
+	g_return_if_fail (max_updates > 0);
+
+	priv = buffer->priv;
+	priv->max_updates = max_updates;
+	priv->updates_limit = max_updates;
+	sparql_buffer_update_limit (buffer);
+}
+
+guint
+tracker_sparql_buffer_get_max_updates (TrackerSparqlBuffer *buffer)
+{
+	TrackerSparqlBufferPrivate *priv;
+
+	g_return_val_if_fail (TRACKER_IS_SPARQL_BUFFER (buffer), 0);
+
+	priv = buffer->priv;
+
+	return priv->max_updates;
+}
+
+/* Makes the buffer adapt its batch size and the batches in flight so
+ * commits take about @msec milliseconds, starting from the current
+ * batch size. 0 leaves the batch size as it is from then on, and lets
+ * max_updates batches in flight.
+ */
+void
+tracker_sparql_buffer_set_target_latency (TrackerSparqlBuffer *buffer,
+                                          guint                msec)
+{
+	TrackerSparqlBufferPrivate *priv;
+
+	g_return_if_fail (TRACKER_IS_SPARQL_BUFFER (buffer));
+
+	priv = buffer->priv;
+	priv->target_latency = msec;
+	priv->last_throughput = 0;
+
+	if (msec == 0) {
+		priv->updates_limit = priv->max_updates;
+		sparql_buffer_update_limit (buffer);
+	}
+}
+
+guint
+tracker_sparql_buffer_get_target_latency (TrackerSparqlBuffer *buffer)
+{
+	TrackerSparqlBufferPrivate *priv;
+
+	g_return_val_if_fail (TRACKER_IS_SPARQL_BUFFER (buffer), 0);
+
+	priv = buffer->priv;
+
+	return priv->target_latency;
+}
+
+/* Returns the number of batches being committed, and the average
+ * latency (msec) and throughput (tasks/s) of the last commits.
+ */
+void
+tracker_sparql_buffer_get_statistics (TrackerSparqlBuffer *buffer,
+                                      guint               *n_updates,
+                                      gdouble             *latency,
+                                      gdouble             *throughput)
+{
+	TrackerSparqlBufferPrivate *priv;
+
+	g_return_if_fail (TRACKER_IS_SPARQL_BUFFER (buffer));
+
+	priv = buffer->priv;
+
+	if (n_updates) {
+		*n_updates = priv->n_updates;
+	}
+
+	if (latency) {
+		*latency = priv->latency;
+	}
+
+	if (throughput) {
+		*throughput = priv->throughput;
+	}
+}
@@ -77,6 +77,26 @@ TrackerTask *        tracker_sparql_buffer_push_finish (TrackerSparqlBuffer  *bu
                                                         GAsyncResult         *res,
                                                         GError              **error);
 
+void                 tracker_sparql_buffer_set_batch_size     (TrackerSparqlBuffer *buffer,
+                                                               guint                batch_size);
+guint                tracker_sparql_buffer_get_batch_size     (TrackerSparqlBuffer *buffer);
+void                 tracker_sparql_buffer_set_max_updates    (TrackerSparqlBuffer *buffer,
+                                                               guint                max_updates);
+guint                tracker_sparql_buffer_get_max_updates    (TrackerSparqlBuffer *buffer);
+void                 tracker_sparql_buffer_set_target_latency (TrackerSparqlBuffer *buffer,
+                                                               guint                msec);
+guint                tracker_sparql_buffer_get_target_latency (TrackerSparqlBuffer *buffer);
+void                 tracker_sparql_buffer_get_statistics     (TrackerSparqlBuffer *buffer,
+                                                               guint               *n_updates,
+                                                               gdouble             *latency,
+                                                               gdouble             *throughput);
+void                 tracker_sparql_buffer_adapt_limit        (TrackerSparqlBuffer *buffer,
+                                                               guint                n_tasks,
+                                                               guint                batch_limit,
+                                                               gdouble              latency,
+                                                               gdouble              throughput,
+                                                               guint                store_queued);
+
 TrackerTask *        tracker_sparql_task_new_take_sparql_str (GFile                *file,
                                                               gchar                *sparql_str);
 TrackerTask *        tracker_sparql_task_new_with_sparql_str (GFile                *file,
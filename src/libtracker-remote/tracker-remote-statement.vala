@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2017, Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+// Generic SPARQL endpoints know nothing about ~parameters, so they are
+// replaced by properly escaped literals before the query is sent
+public class Tracker.Remote.Statement : Tracker.Sparql.Statement {
+	HashTable<string,string> values;
+
+	const string XSD_NS = "http://www.w3.org/2001/XMLSchema#";
+
+	public Statement (Remote.Connection conn, string sparql) {
+		Object (connection: conn, sparql: sparql);
+		this.values = new HashTable<string,string> (str_hash, str_equal);
+	}
+
+	public override void bind_int (string name, int64 value) {
+		values.insert (name, value.to_string ());
+	}
+
+	public override void bind_boolean (string name, bool value) {
+		values.insert (name, value ? "true" : "false");
+	}
+
+	public override void bind_string (string name, string value) {
+		values.insert (name, "\"%s\"".printf (Sparql.escape_string (value)));
+	}
+
+	public override void bind_double (string name, double value) {
+		string str;
+
+		if (value.is_nan ()) {
+			str = "NaN";
+		} else if (value.is_infinity () != 0) {
+			str = (value > 0) ? "INF" : "-INF";
+		} else {
+			// not affected by the locale, and with enough digits to
+			// read back the same value
+			char[] buf = new char[double.DTOSTR_BUF_SIZE];
+			str = value.to_str (buf);
+		}
+
+		values.insert (name, "\"%s\"^^<%sdouble>".printf (str, XSD_NS));
+	}
+
+	public override void bind_datetime (string name, DateTime value) {
+		values.insert (name, "\"%s\"^^<%sdateTime>".printf (value.format ("%FT%T%:z"), XSD_NS));
+	}
+
+	public override void clear_bindings () {
+		values.remove_all ();
+	}
+
+	static bool is_varname_char (char c) {
+		return (c.isalnum () || c == '_');
+	}
+
+	static bool is_iri_char (char c) {
+		return ((uchar) c > ' ' && c != '<' && c != '>' && c != '"' && c != '{' &&
+		        c != '}' && c != '|' && c != '^' && c != '`' && c != '\\');
+	}
+
+	// Copies the query, replacing every ~parameter outside of strings,
+	// IRIs and comments with its bound value
+	string apply_bindings () throws Sparql.Error {
+		var result = new StringBuilder ();
+		unowned string query = sparql;
+		int len = query.length;
+		int i = 0;
+
+		while (i < len) {
+			char c = query[i];
+
+			if (c == '\'' || c == '"') {
+				int begin = i;
+				bool long_string = (i + 2 < len && query[i + 1] == c && query[i + 2] == c);
+
+				i += long_string ? 3 : 1;
+				while (i < len) {
+					if (query[i] == '\\') {
+						i += 2;
+					} else if (query[i] == c &&
+					           (!long_string || (i + 2 < len && query[i + 1] == c && query[i + 2] == c))) {
+						i += long_string ? 3 : 1;
+						break;
+					} else {
+						i++;
+					}
+				}
+
+				result.append (query.substring (begin, int.min (i, len) - begin));
+			} else if (c == '<') {
+				int end = i + 1;
+
+				while (end < len && is_iri_char (query[end])) {
+					end++;
+				}
+
+				if (end < len && query[end] == '>') {
+					// IRI reference
+					end++;
+				} else {
+					// less-than operator
+					end = i + 1;
+				}
+
+				result.append (query.substring (i, end - i));
+				i = end;
+			} else if (c == '#') {
+				int begin = i;
+
+				while (i < len && query[i] != '\n') {
+					i++;
+				}
+
+				result.append (query.substring (begin, i - begin));
+			} else if (c == '~' && i + 1 < len && is_varname_char (query[i + 1])) {
+				int begin = ++i;
+
+				while (i < len && is_varname_char (query[i])) {
+					i++;
+				}
+
+				string name = query.substring (begin, i - begin);
+				string? value = values.lookup (name);
+
+				if (value == null) {
+					throw new Sparql.Error.TYPE ("Parameter `%s' has no bound value", name);
+				}
+
+				result.append (value);
+			} else {
+				result.append_c (c);
+				i++;
+			}
+		}
+
+		return result.str;
+	}
+
+	public override Sparql.Cursor execute (Cancellable? cancellable = null) throws GLib.Error, Sparql.Error, IOError {
+		return connection.query (apply_bindings (), cancellable);
+	}
+
+	public async override Sparql.Cursor execute_async (Cancellable? cancellable = null) throws GLib.Error, Sparql.Error, IOError {
+		return yield connection.query_async (apply_bindings (), cancellable);
+	}
+}
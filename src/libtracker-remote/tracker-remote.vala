@@ -32,7 +32,8 @@ public class Tracker.Remote.Connection : Tracker.Sparql.Connection {
 	}
 
 	private Soup.Message create_request (string sparql) {
-		var uri = _base_uri + sparql;
+		// the query may contain '#', '&' or '+', e.g. in IRIs
+		var uri = _base_uri + Uri.escape_string (sparql, null, false);
 		var message = new Soup.Message ("GET", uri);
 		var headers = message.request_headers;
 
@@ -81,4 +82,8 @@ public class Tracker.Remote.Connection : Tracker.Sparql.Connection {
 
 		return create_cursor (message);
 	}
+
+	public override Sparql.Statement? query_statement (string sparql, Cancellable? cancellable = null) throws Sparql.Error {
+		return new Remote.Statement (this, sparql);
+	}
 }
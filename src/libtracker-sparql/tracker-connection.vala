@@ -79,6 +79,23 @@ public enum Tracker.Sparql.ConnectionFlags {
 	READONLY = 1 << 0,
 }
 
+/**
+ * TrackerSparqlLoadFlags:
+ * @TRACKER_SPARQL_LOAD_FLAGS_NONE: No flags.
+ * @TRACKER_SPARQL_LOAD_FLAGS_BULK: Load the file as a bulk import. Index
+ * maintenance is deferred to the end of the load, which makes it much
+ * faster when seeding large data sets, but other updates wait for the
+ * whole file.
+ *
+ * Flags for tracker_sparql_connection_load_with_flags().
+ *
+ * Since: 2.0
+ */
+public enum Tracker.Sparql.LoadFlags {
+	NONE = 0,
+	BULK = 1 << 0,
+}
+
 /**
  * TrackerSparqlConnection:
  *
@@ -289,6 +306,30 @@ public abstract class Tracker.Sparql.Connection : Object {
 	 */
 	public async abstract Cursor query_async (string sparql, Cancellable? cancellable = null) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError;
 
+	/**
+	 * tracker_sparql_connection_query_statement:
+	 * @self: a #TrackerSparqlConnection
+	 * @sparql: string containing the SPARQL query
+	 * @cancellable: a #GCancellable used to cancel the operation
+	 * @error: #GError for error reporting.
+	 *
+	 * Prepares the given SPARQL query as a #TrackerSparqlStatement. The
+	 * query may contain parameters, written as <literal>~name</literal>,
+	 * whose values are given through the tracker_sparql_statement_bind_*()
+	 * functions before each execution. This is both faster than building
+	 * a different query string for each set of values and immune to
+	 * SPARQL injection.
+	 *
+	 * Returns: a #TrackerSparqlStatement, or #NULL on error.
+	 * Call g_object_unref() on the returned statement when no longer needed.
+	 *
+	 * Since: 2.0
+	 */
+	public virtual Statement? query_statement (string sparql, Cancellable? cancellable = null) throws Sparql.Error {
+		warning ("Interface 'query_statement' not implemented");
+		return null;
+	}
+
 	/**
 	 * tracker_sparql_connection_update:
 	 * @self: a #TrackerSparqlConnection
@@ -508,6 +549,53 @@ public abstract class Tracker.Sparql.Connection : Object {
 		warning ("Interface 'load_async' not implemented");
 	}
 
+	/**
+	 * tracker_sparql_connection_load_with_flags:
+	 * @self: a #TrackerSparqlConnection
+	 * @file: a #GFile
+	 * @flags: #TrackerSparqlLoadFlags for the load
+	 * @cancellable: a #GCancellable used to cancel the operation
+	 * @error: #GError for error reporting.
+	 *
+	 * Loads a Turtle file (TTL) into the store, as tracker_sparql_connection_load()
+	 * does. Connections that don't support bulk loading ignore
+	 * %TRACKER_SPARQL_LOAD_FLAGS_BULK.
+	 *
+	 * Since: 2.0
+	 */
+	public virtual void load_with_flags (File file, LoadFlags flags, Cancellable? cancellable = null) throws Sparql.Error, IOError, DBusError {
+		load (file, cancellable);
+	}
+
+	/**
+	 * tracker_sparql_connection_load_with_flags_async:
+	 * @self: a #TrackerSparqlConnection
+	 * @file: a #GFile
+	 * @flags: #TrackerSparqlLoadFlags for the load
+	 * @cancellable: a #GCancellable used to cancel the operation
+	 * @_callback_: user-defined #GAsyncReadyCallback to be called when
+	 *              asynchronous operation is finished.
+	 * @_user_data_: user-defined data to be passed to @_callback_
+	 *
+	 * Loads, asynchronously, a Turtle file (TTL) into the store.
+	 *
+	 * Since: 2.0
+	 */
+
+	/**
+	 * tracker_sparql_connection_load_with_flags_finish:
+	 * @self: a #TrackerSparqlConnection
+	 * @_res_: a #GAsyncResult with the result of the operation
+	 * @error: #GError for error reporting.
+	 *
+	 * Finishes the asynchronous load of the Turtle file.
+	 *
+	 * Since: 2.0
+	 */
+	public async virtual void load_with_flags_async (File file, LoadFlags flags, Cancellable? cancellable = null) throws Sparql.Error, IOError, DBusError {
+		yield load_async (file, cancellable);
+	}
+
 	/**
 	 * tracker_sparql_connection_statistics:
 	 * @self: a #TrackerSparqlConnection
@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2017, Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * SECTION: tracker-sparql-statement
+ * @short_description: Prepared SPARQL queries
+ * @title: TrackerSparqlStatement
+ * @stability: Stable
+ * @include: tracker-sparql.h
+ *
+ * <para>
+ * #TrackerSparqlStatement represents a SPARQL query that is parsed once
+ * and executed many times with different values. The query refers to
+ * these values through parameters, written as <literal>~name</literal>
+ * in places where a literal would otherwise be used:
+ * </para>
+ *
+ * <programlisting>
+ * SELECT ?url WHERE { ?f a nfo:FileDataObject ; nfo:fileName ~name ; nie:url ?url }
+ * </programlisting>
+ *
+ * <para>
+ * Values are given through tracker_sparql_statement_bind_string() and
+ * related functions before calling tracker_sparql_statement_execute().
+ * Bound values are never interpreted as SPARQL, so there is no need to
+ * escape them.
+ * </para>
+ */
+
+/**
+ * TrackerSparqlStatement:
+ *
+ * The <structname>TrackerSparqlStatement</structname> object represents
+ * a prepared SPARQL query.
+ */
+public abstract class Tracker.Sparql.Statement : Object {
+	/**
+	 * TrackerSparqlStatement:sparql:
+	 *
+	 * The SPARQL query of this statement.
+	 *
+	 * Since: 2.0
+	 */
+	public string sparql {
+		/**
+		 * tracker_sparql_statement_get_sparql:
+		 * @self: a #TrackerSparqlStatement
+		 *
+		 * Returns: the SPARQL query of this #TrackerSparqlStatement.
+		 * The returned string must not be freed.
+		 *
+		 * Since: 2.0
+		 */
+		get;
+		construct set;
+	}
+
+	/**
+	 * TrackerSparqlStatement:connection:
+	 *
+	 * The #TrackerSparqlConnection the statement was created for.
+	 *
+	 * Since: 2.0
+	 */
+	public Connection connection {
+		/**
+		 * tracker_sparql_statement_get_connection:
+		 * @self: a #TrackerSparqlStatement
+		 *
+		 * Returns: the #TrackerSparqlConnection associated with this
+		 * #TrackerSparqlStatement. The returned object must not be
+		 * unreferenced by the caller.
+		 *
+		 * Since: 2.0
+		 */
+		get;
+		construct set;
+	}
+
+	/**
+	 * tracker_sparql_statement_bind_int:
+	 * @self: a #TrackerSparqlStatement
+	 * @name: variable name, without the leading <literal>~</literal>
+	 * @value: value
+	 *
+	 * Binds the integer @value to the parameter @name.
+	 *
+	 * Since: 2.0
+	 */
+	public abstract void bind_int (string name, int64 value);
+
+	/**
+	 * tracker_sparql_statement_bind_boolean:
+	 * @self: a #TrackerSparqlStatement
+	 * @name: variable name, without the leading <literal>~</literal>
+	 * @value: value
+	 *
+	 * Binds the boolean @value to the parameter @name.
+	 *
+	 * Since: 2.0
+	 */
+	public abstract void bind_boolean (string name, bool value);
+
+	/**
+	 * tracker_sparql_statement_bind_string:
+	 * @self: a #TrackerSparqlStatement
+	 * @name: variable name, without the leading <literal>~</literal>
+	 * @value: value
+	 *
+	 * Binds the string @value to the parameter @name. Resources are
+	 * given as strings too, through their URI.
+	 *
+	 * Since: 2.0
+	 */
+	public abstract void bind_string (string name, string value);
+
+	/**
+	 * tracker_sparql_statement_bind_double:
+	 * @self: a #TrackerSparqlStatement
+	 * @name: variable name, without the leading <literal>~</literal>
+	 * @value: value
+	 *
+	 * Binds the double @value to the parameter @name.
+	 *
+	 * Since: 2.0
+	 */
+	public abstract void bind_double (string name, double value);
+
+	/**
+	 * tracker_sparql_statement_bind_datetime:
+	 * @self: a #TrackerSparqlStatement
+	 * @name: variable name, without the leading <literal>~</literal>
+	 * @value: value
+	 *
+	 * Binds the #GDateTime @value to the parameter @name.
+	 *
+	 * Since: 2.0
+	 */
+	public abstract void bind_datetime (string name, DateTime value);
+
+	/**
+	 * tracker_sparql_statement_clear_bindings:
+	 * @self: a #TrackerSparqlStatement
+	 *
+	 * Clears all bindings set with the tracker_sparql_statement_bind_*()
+	 * functions.
+	 *
+	 * Since: 2.0
+	 */
+	public abstract void clear_bindings ();
+
+	/**
+	 * tracker_sparql_statement_execute:
+	 * @self: a #TrackerSparqlStatement
+	 * @cancellable: a #GCancellable used to cancel the operation
+	 * @error: #GError for error reporting.
+	 *
+	 * Executes the statement with the currently bound values. All
+	 * parameters in the query must have a bound value. The API call is
+	 * completely synchronous, so it may block.
+	 *
+	 * Returns: a #TrackerSparqlCursor if results were found, #NULL otherwise.
+	 * On error, #NULL is returned and the @error is set accordingly.
+	 * Call g_object_unref() on the returned cursor when no longer needed.
+	 *
+	 * Since: 2.0
+	 */
+	public abstract Cursor execute (Cancellable? cancellable = null) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError;
+
+	/**
+	 * tracker_sparql_statement_execute_finish:
+	 * @self: a #TrackerSparqlStatement
+	 * @_res_: a #GAsyncResult with the result of the operation
+	 * @error: #GError for error reporting.
+	 *
+	 * Finishes the asynchronous execution of the statement.
+	 *
+	 * Returns: a #TrackerSparqlCursor if results were found, #NULL otherwise.
+	 * On error, #NULL is returned and the @error is set accordingly.
+	 * Call g_object_unref() on the returned cursor when no longer needed.
+	 *
+	 * Since: 2.0
+	 */
+
+	/**
+	 * tracker_sparql_statement_execute_async:
+	 * @self: a #TrackerSparqlStatement
+	 * @cancellable: a #GCancellable used to cancel the operation
+	 * @_callback_: user-defined #GAsyncReadyCallback to be called when
+	 *              asynchronous operation is finished.
+	 * @_user_data_: user-defined data to be passed to @_callback_
+	 *
+	 * Executes asynchronously the statement with the currently bound
+	 * values. Changing the bindings after this call does not affect the
+	 * running operation.
+	 *
+	 * Since: 2.0
+	 */
+	public async abstract Cursor execute_async (Cancellable? cancellable = null) throws Sparql.Error, GLib.Error, GLib.IOError, DBusError;
+}
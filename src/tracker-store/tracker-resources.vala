@@ -91,8 +91,8 @@ public class Tracker.Resources : Object {
 			var builder = new VariantBuilder ((VariantType) "aas");
 			var data_manager = Tracker.Main.get_data_manager ();
 
-			yield Tracker.Store.sparql_query (data_manager, query, Tracker.Store.Priority.HIGH, cursor => {
-				while (cursor.next ()) {
+			yield Tracker.Store.sparql_query (data_manager, query, Tracker.Store.Priority.HIGH, (cursor, context) => {
+				while (cursor.next (context.cancellable)) {
 					builder.open ((VariantType) "as");
 
 					for (int i = 0; i < cursor.n_columns; i++) {
@@ -106,6 +106,7 @@ public class Tracker.Resources : Object {
 					}
 
 					builder.close ();
+					context.row_done ();
 				}
 			}, sender);
 
@@ -109,6 +109,11 @@ public class Tracker.Status : Object {
 		return this.status;
 	}
 
+	[DBus (signature = "(uua(suuxxx))")]
+	public Variant get_queue_statistics () {
+		return Tracker.Store.get_queue_statistics ();
+	}
+
 	public async void wait () throws Error {
 		if (status == "Idle") {
 			/* tracker-store is idle */
@@ -24,70 +24,216 @@ public class Tracker.Steroids : Object {
 
 	public const int BUFFER_SIZE = 65536;
 
+	// Limits of the string dictionary of the v2 format
+	const uint MAX_DICTIONARY_SIZE = 65536;
+	const int MAX_DICTIONARY_STRING_LENGTH = 512;
+
 	public async string[] query (BusName sender, string query, UnixOutputStream output_stream) throws Error {
-		var request = DBusRequest.begin (sender, "Steroids.Query");
+		return yield query_internal (sender, "Steroids.Query", query, null, false, output_stream);
+	}
+
+	// Same as query, with the values for the ~parameters in the query
+	public async string[] query_statement (BusName sender, string query, HashTable<string,Variant> arguments, UnixOutputStream output_stream) throws Error {
+		return yield query_internal (sender, "Steroids.QueryStatement", query, arguments, false, output_stream);
+	}
+
+	// Same as query_statement, with the results in the v2 format, see
+	// write_cursor_v2. Clients fall back to Query if the method is unknown
+	public async string[] query_v2 (BusName sender, string query, HashTable<string,Variant> arguments, UnixOutputStream output_stream) throws Error {
+		return yield query_internal (sender, "Steroids.QueryV2", query, arguments, true, output_stream);
+	}
+
+	async string[] query_internal (BusName sender, string method, string query, HashTable<string,Variant>? arguments, bool v2, UnixOutputStream output_stream) throws Error {
+		var request = DBusRequest.begin (sender, method);
 		request.debug ("query: %s", query);
 		try {
 			string[] variable_names = null;
 			var data_manager = Tracker.Main.get_data_manager ();
 
-			yield Tracker.Store.sparql_query (data_manager, query, Tracker.Store.Priority.HIGH, cursor => {
-				var data_output_stream = new DataOutputStream (new BufferedOutputStream.sized (output_stream, BUFFER_SIZE));
-				data_output_stream.set_byte_order (DataStreamByteOrder.HOST_ENDIAN);
+			yield Tracker.Store.sparql_query (data_manager, query, Tracker.Store.Priority.HIGH, (cursor, context) => {
+				try {
+					if (v2) {
+						variable_names = write_cursor_v2 (cursor, context, output_stream);
+					} else {
+						variable_names = write_cursor (cursor, context, output_stream);
+					}
+				} catch (Error e) {
+					/* the rows still buffered are dropped rather than
+					   left blocking on a client that stopped reading */
+					output_stream.close ();
+					throw e;
+				}
+			}, sender, arguments);
 
-				int n_columns = cursor.n_columns;
+			request.end ();
 
-				int[] column_sizes = new int[n_columns];
-				int[] column_offsets = new int[n_columns];
-				string[] column_data = new string[n_columns];
+			return variable_names;
+		} catch (Error e) {
+			request.end (e);
+			if (e is Sparql.Error) {
+				throw e;
+			} else {
+				throw new Sparql.Error.INTERNAL (e.message);
+			}
+		}
+	}
 
-				variable_names = new string[n_columns];
-				for (int i = 0; i < n_columns; i++) {
-					variable_names[i] = cursor.get_variable_name (i);
-				}
+	// Writes all rows of the cursor to the stream, returns the variable names
+	static string[] write_cursor (Sparql.Cursor cursor, Tracker.Store.QueryContext context, UnixOutputStream output_stream) throws Error {
+		unowned Cancellable cancellable = context.cancellable;
+		var data_output_stream = new DataOutputStream (new BufferedOutputStream.sized (output_stream, BUFFER_SIZE));
+		data_output_stream.set_byte_order (DataStreamByteOrder.HOST_ENDIAN);
 
-				while (cursor.next ()) {
-					int last_offset = -1;
+		int n_columns = cursor.n_columns;
 
-					for (int i = 0; i < n_columns ; i++) {
-						unowned string str = cursor.get_string (i);
+		int[] column_sizes = new int[n_columns];
+		int[] column_offsets = new int[n_columns];
+		string[] column_data = new string[n_columns];
 
-						column_sizes[i] = str != null ? str.length : 0;
-						column_data[i]  = str;
+		string[] variable_names = new string[n_columns];
+		for (int i = 0; i < n_columns; i++) {
+			variable_names[i] = cursor.get_variable_name (i);
+		}
 
-						last_offset += column_sizes[i] + 1;
-						column_offsets[i] = last_offset;
-					}
+		while (cursor.next (cancellable)) {
+			int last_offset = -1;
 
-					data_output_stream.put_int32 (n_columns);
+			for (int i = 0; i < n_columns ; i++) {
+				unowned string str = cursor.get_string (i);
 
-					for (int i = 0; i < n_columns ; i++) {
-						/* Cast from enum to int */
-						data_output_stream.put_int32 ((int) cursor.get_value_type (i));
-					}
+				column_sizes[i] = str != null ? str.length : 0;
+				column_data[i]  = str;
 
-					for (int i = 0; i < n_columns ; i++) {
-						data_output_stream.put_int32 (column_offsets[i]);
-					}
+				last_offset += column_sizes[i] + 1;
+				column_offsets[i] = last_offset;
+			}
 
-					for (int i = 0; i < n_columns ; i++) {
-						data_output_stream.put_string (column_data[i] != null ? column_data[i] : "");
-						data_output_stream.put_byte (0);
-					}
-				}
-			}, sender);
+			data_output_stream.put_int32 (n_columns, cancellable);
 
-			request.end ();
+			for (int i = 0; i < n_columns ; i++) {
+				/* Cast from enum to int */
+				data_output_stream.put_int32 ((int) cursor.get_value_type (i), cancellable);
+			}
 
-			return variable_names;
-		} catch (Error e) {
-			request.end (e);
-			if (e is Sparql.Error) {
-				throw e;
-			} else {
-				throw new Sparql.Error.INTERNAL (e.message);
+			for (int i = 0; i < n_columns ; i++) {
+				data_output_stream.put_int32 (column_offsets[i], cancellable);
+			}
+
+			for (int i = 0; i < n_columns ; i++) {
+				data_output_stream.put_string (column_data[i] != null ? column_data[i] : "", cancellable);
+				data_output_stream.put_byte (0, cancellable);
 			}
+
+			context.row_done ();
 		}
+
+		data_output_stream.close (cancellable);
+
+		return variable_names;
+	}
+
+	static void put_varint (DataOutputStream stream, uint64 value, Cancellable? cancellable) throws Error {
+		while (value >= 0x80) {
+			stream.put_byte ((uint8) (value | 0x80), cancellable);
+			value >>= 7;
+		}
+		stream.put_byte ((uint8) value, cancellable);
+	}
+
+	/* Writes all rows of the cursor in the v2 format, returns the
+	 * variable names. Integers are varints, in host byte order like
+	 * everything else on the pipe:
+	 *
+	 * header = [n_columns, n_columns x (name length, name, NUL)]
+	 * row    = n_columns x [1 byte value type, value]
+	 *
+	 * with values
+	 *
+	 * UNBOUND           nothing
+	 * INTEGER           zigzag encoded varint
+	 * DOUBLE            8 raw bytes
+	 * BOOLEAN           1 byte, 0 or 1
+	 * anything else     string: varint tag, the low 2 bits say what follows
+	 *                   0: literal of tag >> 2 bytes and NUL
+	 *                   1: same, and appended to the dictionary
+	 *                   2: nothing, dictionary entry number tag >> 2
+	 *
+	 * URIs are added to the dictionary, as the same ones (e.g. classes)
+	 * usually show up in many rows.
+	 */
+	static string[] write_cursor_v2 (Sparql.Cursor cursor, Tracker.Store.QueryContext context, UnixOutputStream output_stream) throws Error {
+		unowned Cancellable cancellable = context.cancellable;
+		var data_output_stream = new DataOutputStream (new BufferedOutputStream.sized (output_stream, BUFFER_SIZE));
+		data_output_stream.set_byte_order (DataStreamByteOrder.HOST_ENDIAN);
+
+		int n_columns = cursor.n_columns;
+		var dictionary = new HashTable<string,int> (str_hash, str_equal);
+
+		string[] variable_names = new string[n_columns];
+		put_varint (data_output_stream, n_columns, cancellable);
+		for (int i = 0; i < n_columns; i++) {
+			variable_names[i] = cursor.get_variable_name (i);
+			put_varint (data_output_stream, variable_names[i].length, cancellable);
+			data_output_stream.put_string (variable_names[i], cancellable);
+			data_output_stream.put_byte (0, cancellable);
+		}
+
+		while (cursor.next (cancellable)) {
+			for (int i = 0; i < n_columns; i++) {
+				var type = cursor.get_value_type (i);
+
+				/* Cast from enum to int */
+				data_output_stream.put_byte ((uint8) type, cancellable);
+
+				switch (type) {
+				case Sparql.ValueType.UNBOUND:
+					break;
+				case Sparql.ValueType.INTEGER:
+					int64 int_value = cursor.get_integer (i);
+					put_varint (data_output_stream, (uint64) ((int_value << 1) ^ (int_value >> 63)), cancellable);
+					break;
+				case Sparql.ValueType.DOUBLE:
+					double double_value = cursor.get_double (i);
+					data_output_stream.put_int64 (*((int64*) (&double_value)), cancellable);
+					break;
+				case Sparql.ValueType.BOOLEAN:
+					data_output_stream.put_byte (cursor.get_boolean (i) ? 1 : 0, cancellable);
+					break;
+				default:
+					unowned string str = cursor.get_string (i);
+					int length = str != null ? str.length : 0;
+
+					if (type == Sparql.ValueType.URI && str != null) {
+						int index = dictionary.lookup (str);
+
+						if (index > 0) {
+							put_varint (data_output_stream, ((uint64) (index - 1) << 2) | 2, cancellable);
+							break;
+						}
+
+						if (length <= MAX_DICTIONARY_STRING_LENGTH &&
+						    dictionary.size () < MAX_DICTIONARY_SIZE) {
+							dictionary.insert (str, (int) dictionary.size () + 1);
+							put_varint (data_output_stream, ((uint64) length << 2) | 1, cancellable);
+							data_output_stream.put_string (str, cancellable);
+							data_output_stream.put_byte (0, cancellable);
+							break;
+						}
+					}
+
+					put_varint (data_output_stream, (uint64) length << 2, cancellable);
+					data_output_stream.put_string (length > 0 ? str : "", cancellable);
+					data_output_stream.put_byte (0, cancellable);
+					break;
+				}
+			}
+
+			context.row_done ();
+		}
+
+		data_output_stream.close (cancellable);
+
+		return variable_names;
 	}
 
 	async Variant? update_internal (BusName sender, Tracker.Store.Priority priority, bool blank, UnixInputStream input_stream) throws Error {
@@ -20,12 +20,25 @@
  */
 
 public class Tracker.Store {
-	const int MAX_CONCURRENT_QUERIES = 2;
+	const int MIN_CONCURRENT_QUERIES = 2;
 
 	const int MAX_TASK_TIME = 30;
 
+	/* time after which a waiting task is treated as if it had
+	   the next higher priority, so LOW and TURTLE can't starve */
+	const int64 PRIORITY_AGING_TIME = 2 * TimeSpan.SECOND;
+
+	const string[] PRIORITY_NAMES = { "high", "low", "turtle" };
+
+	/* resources indexed by a single FTS task while FTS indexing is
+	   deferred, and how long updates may keep it waiting */
+	const int FTS_BATCH_SIZE = 1000;
+	const int64 FTS_FLUSH_INTERVAL = 10 * TimeSpan.SECOND;
+
 	static Queue<Task> query_queues[3 /* TRACKER_STORE_N_PRIORITIES */];
 	static Queue<Task> update_queues[3 /* TRACKER_STORE_N_PRIORITIES */];
+	static QueueStats queue_stats[3 /* TRACKER_STORE_N_PRIORITIES */];
+	static int max_concurrent_queries;
 	static int n_queries_running;
 	static bool update_running;
 	static ThreadPool<Task> update_pool;
@@ -35,6 +48,12 @@ public class Tracker.Store {
 	static int max_task_time;
 	static bool active;
 	static SourceFunc active_callback;
+	static bool fts_deferred;
+	static bool fts_pending;
+	static int64 fts_pending_since;
+	static Tracker.Data.Manager fts_manager;
+	/* queries using FTS held until pending FTS updates are indexed */
+	static Queue<Task> fts_waiting;
 
 	public enum Priority {
 		HIGH,
@@ -48,9 +67,27 @@ public class Tracker.Store {
 		UPDATE,
 		UPDATE_BLANK,
 		TURTLE,
+		FTS,
 	}
 
-	public delegate void SparqlQueryInThread (DBCursor cursor) throws Error;
+	/* Passed to the code reading the cursor of a query, which fetches
+	   rows with the cancellable and calls row_done () for every row
+	   handed to the client. The watchdog cancels a query when no row
+	   was done within max_task_time: either the first row takes that
+	   long to compute, or the client stopped reading the rows that
+	   were streamed to it. A slow but steady reader is not cancelled,
+	   and a stalled one holds its query slot and database snapshot
+	   for at most twice max_task_time. */
+	public class QueryContext {
+		public Cancellable cancellable;
+		internal int n_rows;
+
+		public void row_done () {
+			AtomicInt.inc (ref n_rows);
+		}
+	}
+
+	public delegate void SparqlQueryInThread (DBCursor cursor, QueryContext context) throws Error;
 
 	abstract class Task {
 		public TaskType type;
@@ -58,11 +95,21 @@ public class Tracker.Store {
 		public Error error;
 		public SourceFunc callback;
 		public Tracker.Data.Manager data_manager;
+		public int64 queued_time;
+	}
+
+	struct QueueStats {
+		public uint64 n_dispatched;
+		public int64 total_wait_time;
+		public int64 max_wait_time;
 	}
 
 	class QueryTask : Task {
 		public string query;
+		public Priority priority;
+		public HashTable<string,Variant>? parameters;
 		public Cancellable cancellable;
+		public QueryContext context;
 		public uint watchdog_id;
 		public unowned SparqlQueryInThread in_thread;
 
@@ -83,6 +130,76 @@ public class Tracker.Store {
 		public string path;
 	}
 
+	class FtsTask : Task {
+		public int n_flushed;
+	}
+
+	static void push_task (Queue<Task> queue, Task task) {
+		task.queued_time = get_monotonic_time ();
+		queue.push_tail (task);
+	}
+
+	/* Pops the task to run next. The rank of a queue head is its
+	   priority, raised by one level for every PRIORITY_AGING_TIME it
+	   has been waiting; on equal rank the higher priority wins. */
+	static Task? pop_task (bool update) {
+		int64 now = get_monotonic_time ();
+		int64 best_rank = int64.MAX;
+		int best = -1;
+
+		for (int i = 0; i < Priority.N_PRIORITIES; i++) {
+			unowned Queue<Task> queue = update ? update_queues[i] : query_queues[i];
+			unowned Task? head = queue.peek_head ();
+			if (head == null) {
+				continue;
+			}
+
+			int64 rank = i - (now - head.queued_time) / PRIORITY_AGING_TIME;
+			if (rank < best_rank) {
+				best_rank = rank;
+				best = i;
+			}
+		}
+
+		if (best < 0) {
+			return null;
+		}
+
+		var task = (update ? update_queues[best] : query_queues[best]).pop_head ();
+		int64 wait_time = now - task.queued_time;
+
+		queue_stats[best].n_dispatched++;
+		queue_stats[best].total_wait_time += wait_time;
+		if (wait_time > queue_stats[best].max_wait_time) {
+			queue_stats[best].max_wait_time = wait_time;
+		}
+
+		return task;
+	}
+
+	/* FTS indexing is caught up with once updates are idle, when
+	   a query needs it, or when it was left waiting for too long */
+	static bool fts_flush_due () {
+		if (!fts_pending) {
+			return false;
+		}
+
+		return (fts_waiting.get_length () > 0 ||
+		        get_monotonic_time () - fts_pending_since >= FTS_FLUSH_INTERVAL);
+	}
+
+	static bool query_needs_fts (string query) {
+		return ("fts:" in query || "/ontologies/fts#" in query);
+	}
+
+	static void release_fts_waiting () {
+		Task task;
+
+		while ((task = fts_waiting.pop_head ()) != null) {
+			push_task (query_queues[((QueryTask) task).priority], task);
+		}
+	}
+
 	static void sched () {
 		Task task = null;
 
@@ -90,13 +207,11 @@ public class Tracker.Store {
 			return;
 		}
 
-		while (n_queries_running < MAX_CONCURRENT_QUERIES) {
-			for (int i = 0; i < Priority.N_PRIORITIES; i++) {
-				task = query_queues[i].pop_head ();
-				if (task != null) {
-					break;
-				}
-			}
+		/* the query pool is not exclusive, so threads are only
+		   spawned while queries are pending and go back to the
+		   global pool once the queues drain */
+		while (n_queries_running < max_concurrent_queries) {
+			task = pop_task (false);
 			if (task == null) {
 				/* no pending query */
 				break;
@@ -105,7 +220,17 @@ public class Tracker.Store {
 
 			if (max_task_time != 0) {
 				var query_task = (QueryTask) task;
+				int n_rows = 0;
+
 				query_task.watchdog_id = Timeout.add_seconds (max_task_time, () => {
+					int current = AtomicInt.get (ref query_task.context.n_rows);
+
+					if (current != n_rows) {
+						/* still streaming rows */
+						n_rows = current;
+						return true;
+					}
+
 					query_task.cancellable.cancel ();
 					query_task.watchdog_id = 0;
 					return false;
@@ -121,12 +246,14 @@ public class Tracker.Store {
 		}
 
 		if (!update_running) {
-			for (int i = 0; i < Priority.N_PRIORITIES; i++) {
-				task = update_queues[i].pop_head ();
-				if (task != null) {
-					break;
-				}
+			task = fts_flush_due () ? null : pop_task (true);
+
+			if (task == null && fts_pending) {
+				task = new FtsTask ();
+				task.type = TaskType.FTS;
+				task.data_manager = fts_manager;
 			}
+
 			if (task != null) {
 				update_running = true;
 				try {
@@ -161,18 +288,33 @@ public class Tracker.Store {
 		}
 	}
 
+	static void mark_fts_pending (Task task) {
+		if (!fts_deferred) {
+			return;
+		}
+
+		if (!fts_pending) {
+			fts_pending = true;
+			fts_pending_since = get_monotonic_time ();
+		}
+
+		fts_manager = task.data_manager;
+	}
+
 	static bool task_finish_cb (Task task) {
 		var data = task.data_manager.get_data ();
 
 		if (task.type == TaskType.QUERY) {
 			var query_task = (QueryTask) task;
 
-			if (task.error == null &&
-			    query_task.cancellable != null &&
-			    query_task.cancellable.is_cancelled ()) {
-				task.error = new IOError.CANCELLED ("Operation was cancelled");
+			if (query_task.watchdog_id > 0) {
+				Source.remove (query_task.watchdog_id);
+				query_task.watchdog_id = 0;
 			}
 
+			/* a cancelled query fails in the query thread, once all
+			   rows were handed out it is done even if the watchdog
+			   fired meanwhile */
 			task.callback ();
 			task.error = null;
 
@@ -181,6 +323,7 @@ public class Tracker.Store {
 		} else if (task.type == TaskType.UPDATE || task.type == TaskType.UPDATE_BLANK) {
 			if (task.error == null) {
 				data.notify_transaction (commit_type (task));
+				mark_fts_pending (task);
 			}
 
 			task.callback ();
@@ -190,11 +333,27 @@ public class Tracker.Store {
 		} else if (task.type == TaskType.TURTLE) {
 			if (task.error == null) {
 				data.notify_transaction (commit_type (task));
+				mark_fts_pending (task);
 			}
 
 			task.callback ();
 			task.error = null;
 
+			update_running = false;
+		} else if (task.type == TaskType.FTS) {
+			var fts_task = (FtsTask) task;
+
+			if (task.error != null) {
+				warning ("Could not index pending FTS updates: %s", task.error.message);
+			}
+
+			/* a short batch means nothing is left, on errors give
+			   up until the next update rather than retry in a loop */
+			if (task.error != null || fts_task.n_flushed < FTS_BATCH_SIZE) {
+				fts_pending = false;
+				release_fts_waiting ();
+			}
+
 			update_running = false;
 		}
 
@@ -212,15 +371,24 @@ public class Tracker.Store {
 			if (task.type == TaskType.QUERY) {
 				var query_task = (QueryTask) task;
 
-				var cursor = Tracker.Data.query_sparql_cursor (task.data_manager, query_task.query);
+				var query = new Sparql.Query (task.data_manager, query_task.query);
+				var cursor = query.execute_cursor_with_parameters (query_task.parameters);
 
-				query_task.in_thread (cursor);
+				query_task.in_thread (cursor, query_task.context);
 			} else {
 				var data = task.data_manager.get_data ();
 				var iface = task.data_manager.get_writable_db_interface ();
 				iface.sqlite_wal_hook (wal_hook);
 
-				if (task.type == TaskType.UPDATE) {
+				if (data.get_fts_deferred () != fts_deferred) {
+					data.set_fts_deferred (fts_deferred);
+				}
+
+				if (task.type == TaskType.FTS) {
+					var fts_task = (FtsTask) task;
+
+					fts_task.n_flushed = data.flush_fts (FTS_BATCH_SIZE);
+				} else if (task.type == TaskType.UPDATE) {
 					var update_task = (UpdateTask) task;
 
 					data.update_sparql (update_task.query);
@@ -301,16 +469,36 @@ public class Tracker.Store {
 			max_task_time = MAX_TASK_TIME;
 		}
 
+		/* queries run on the read-only interfaces of the data
+		   manager, which allows many of those per core, so the
+		   number of cores is what limits useful concurrency */
+		string max_queries_env = Environment.get_variable ("TRACKER_STORE_MAX_CONCURRENT_QUERIES");
+		if (max_queries_env != null) {
+			max_concurrent_queries = int.max (1, int.parse (max_queries_env));
+		} else {
+			max_concurrent_queries = int.max (MIN_CONCURRENT_QUERIES, (int) get_num_processors ());
+		}
+
+		/* updates may leave FTS indexing to batches run in between,
+		   queries using FTS wait for those to catch up. That only
+		   holds for queries coming through here, clients reading the
+		   database directly would see a stale FTS index, so it is
+		   off unless asked for */
+		string fts_deferred_env = Environment.get_variable ("TRACKER_STORE_FTS_DEFERRED");
+		fts_deferred = (fts_deferred_env != null && fts_deferred_env != "0");
+
 		running_tasks = new GenericArray<Task> ();
+		fts_waiting = new Queue<Task> ();
 
 		for (int i = 0; i < Priority.N_PRIORITIES; i++) {
 			query_queues[i] = new Queue<Task> ();
 			update_queues[i] = new Queue<Task> ();
+			queue_stats[i] = QueueStats ();
 		}
 
 		try {
 			update_pool = new ThreadPool<Task>.with_owned_data (pool_dispatch_cb, 1, true);
-			query_pool = new ThreadPool<Task>.with_owned_data (pool_dispatch_cb, MAX_CONCURRENT_QUERIES, true);
+			query_pool = new ThreadPool<Task>.with_owned_data (pool_dispatch_cb, max_concurrent_queries, false);
 			checkpoint_pool = new ThreadPool<DBInterface> (checkpoint_dispatch_cb, 1, true);
 		} catch (Error e) {
 			warning (e.message);
@@ -320,7 +508,7 @@ public class Tracker.Store {
 		   let's use the same settings as gio, otherwise the used settings
 		   are rather random */
 		ThreadPool.set_max_idle_time (15 * 1000);
-		ThreadPool.set_max_unused_threads (2);
+		ThreadPool.set_max_unused_threads (MIN_CONCURRENT_QUERIES);
 	}
 
 	public static void shutdown () {
@@ -332,19 +520,30 @@ public class Tracker.Store {
 			query_queues[i] = null;
 			update_queues[i] = null;
 		}
+
+		fts_waiting = null;
+		fts_manager = null;
 	}
 
-	public static async void sparql_query (Tracker.Data.Manager manager, string sparql, Priority priority, SparqlQueryInThread in_thread, string client_id) throws Error {
+	public static async void sparql_query (Tracker.Data.Manager manager, string sparql, Priority priority, SparqlQueryInThread in_thread, string client_id, HashTable<string,Variant>? parameters = null) throws Error {
 		var task = new QueryTask ();
 		task.type = TaskType.QUERY;
 		task.query = sparql;
+		task.priority = priority;
+		task.parameters = parameters;
 		task.cancellable = new Cancellable ();
+		task.context = new QueryContext ();
+		task.context.cancellable = task.cancellable;
 		task.in_thread = in_thread;
 		task.callback = sparql_query.callback;
 		task.client_id = client_id;
 		task.data_manager = manager;
 
-		query_queues[priority].push_tail (task);
+		if (fts_pending && query_needs_fts (sparql)) {
+			push_task (fts_waiting, task);
+		} else {
+			push_task (query_queues[priority], task);
+		}
 
 		sched ();
 
@@ -364,7 +563,7 @@ public class Tracker.Store {
 		task.client_id = client_id;
 		task.data_manager = manager;
 
-		update_queues[priority].push_tail (task);
+		push_task (update_queues[priority], task);
 
 		sched ();
 
@@ -384,7 +583,7 @@ public class Tracker.Store {
 		task.client_id = client_id;
 		task.data_manager = manager;
 
-		update_queues[priority].push_tail (task);
+		push_task (update_queues[priority], task);
 
 		sched ();
 
@@ -405,7 +604,7 @@ public class Tracker.Store {
 		task.client_id = client_id;
 		task.data_manager = manager;
 
-		update_queues[Priority.TURTLE].push_tail (task);
+		push_task (update_queues[Priority.TURTLE], task);
 
 		sched ();
 
@@ -423,13 +622,65 @@ public class Tracker.Store {
 			result += query_queues[i].get_length ();
 			result += update_queues[i].get_length ();
 		}
+		result += fts_waiting.get_length ();
 		return result;
 	}
 
-	public static void unreg_batches (string client_id) {
+	/* Returns the number of running queries, the query concurrency
+	   limit and one (priority, queued queries, queued updates, average
+	   wait, longest wait, current oldest wait) entry per priority,
+	   times in microseconds */
+	public static Variant get_queue_statistics () {
+		var builder = new VariantBuilder ((VariantType) "a(suuxxx)");
+		int64 now = get_monotonic_time ();
+
+		for (int i = 0; i < Priority.N_PRIORITIES; i++) {
+			var stats = queue_stats[i];
+			int64 oldest = 0;
+
+			unowned Task? head = query_queues[i].peek_head ();
+			if (head != null) {
+				oldest = now - head.queued_time;
+			}
+			head = update_queues[i].peek_head ();
+			if (head != null) {
+				oldest = int64.max (oldest, now - head.queued_time);
+			}
+
+			builder.add ("(suuxxx)",
+			             PRIORITY_NAMES[i],
+			             query_queues[i].get_length (),
+			             update_queues[i].get_length (),
+			             stats.n_dispatched > 0 ? stats.total_wait_time / (int64) stats.n_dispatched : (int64) 0,
+			             stats.max_wait_time,
+			             oldest);
+		}
+
+		return new Variant ("(uu@a(suuxxx))",
+		                    (uint) n_queries_running,
+		                    (uint) max_concurrent_queries,
+		                    builder.end ());
+	}
+
+	static void unreg_queued_tasks (Queue<Task> queue, string client_id) {
 		unowned List<Task> list, cur;
-		unowned Queue<Task> queue;
 
+		list = queue.head;
+		while (list != null) {
+			cur = list;
+			list = list.next;
+			unowned Task task = cur.data;
+
+			if (task != null && task.client_id == client_id) {
+				queue.delete_link (cur);
+
+				task.error = new DBusError.FAILED ("Client disappeared");
+				task.callback ();
+			}
+		}
+	}
+
+	public static void unreg_batches (string client_id) {
 		for (int i = 0; i < running_tasks.length; i++) {
 			unowned QueryTask task = running_tasks[i] as QueryTask;
 			if (task != null && task.client_id == client_id && task.cancellable != null) {
@@ -438,37 +689,12 @@ public class Tracker.Store {
 		}
 
 		for (int i = 0; i < Priority.N_PRIORITIES; i++) {
-			queue = query_queues[i];
-			list = queue.head;
-			while (list != null) {
-				cur = list;
-				list = list.next;
-				unowned Task task = cur.data;
-
-				if (task != null && task.client_id == client_id) {
-					queue.delete_link (cur);
-
-					task.error = new DBusError.FAILED ("Client disappeared");
-					task.callback ();
-				}
-			}
-
-			queue = update_queues[i];
-			list = queue.head;
-			while (list != null) {
-				cur = list;
-				list = list.next;
-				unowned Task task = cur.data;
-
-				if (task != null && task.client_id == client_id) {
-					queue.delete_link (cur);
-
-					task.error = new DBusError.FAILED ("Client disappeared");
-					task.callback ();
-				}
-			}
+			unreg_queued_tasks (query_queues[i], client_id);
+			unreg_queued_tasks (update_queues[i], client_id);
 		}
 
+		unreg_queued_tasks (fts_waiting, client_id);
+
 		sched ();
 	}
 
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2017, Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+/* Measures query throughput of a direct connection with an increasing
+ * number of reader threads, while another thread keeps running a bulk
+ * update. Queries don't wait for updates, so throughput should grow
+ * with the number of threads up to the number of cores.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <libtracker-sparql/tracker-sparql.h>
+
+#define N_RESOURCES 2000
+#define BATCH_SIZE 200
+#define RUN_SECONDS 2
+
+static TrackerSparqlConnection *connection;
+static volatile gint stop_readers;
+static volatile gint stop_writer;
+static volatile gint n_queries;
+static volatile gint n_updates;
+
+static const gchar *query =
+	"SELECT ?m nie:title(?m) WHERE { ?m a nmo:Message ; nmo:messageId ?id } "
+	"ORDER BY ?id LIMIT 50";
+
+static gchar *
+create_batch (gint first)
+{
+	GString *str;
+	gint i;
+
+	str = g_string_new ("INSERT {");
+
+	for (i = first; i < first + BATCH_SIZE; i++) {
+		g_string_append_printf (str,
+		                        " <urn:perf:%d> a nmo:Message ;"
+		                        " nmo:messageId \"%d\" ;"
+		                        " nie:title \"Message %d\" .",
+		                        i, i, i);
+	}
+
+	g_string_append (str, " }");
+
+	return g_string_free (str, FALSE);
+}
+
+static gpointer
+writer_thread (gpointer data)
+{
+	gint first = N_RESOURCES;
+
+	while (!g_atomic_int_get (&stop_writer)) {
+		GError *error = NULL;
+		gchar *update;
+
+		update = create_batch (first);
+		tracker_sparql_connection_update (connection, update, 0, NULL, &error);
+		g_assert_no_error (error);
+		g_free (update);
+
+		first += BATCH_SIZE;
+		g_atomic_int_inc (&n_updates);
+	}
+
+	return NULL;
+}
+
+static gpointer
+reader_thread (gpointer data)
+{
+	while (!g_atomic_int_get (&stop_readers)) {
+		TrackerSparqlCursor *cursor;
+		GError *error = NULL;
+
+		cursor = tracker_sparql_connection_query (connection, query, NULL, &error);
+		g_assert_no_error (error);
+
+		while (tracker_sparql_cursor_next (cursor, NULL, &error))
+			;
+
+		g_assert_no_error (error);
+		g_object_unref (cursor);
+
+		g_atomic_int_inc (&n_queries);
+	}
+
+	return NULL;
+}
+
+static gdouble
+run_readers (guint n_threads)
+{
+	GThread **threads;
+	GTimer *timer;
+	gdouble elapsed;
+	guint i;
+
+	g_atomic_int_set (&stop_readers, FALSE);
+	g_atomic_int_set (&n_queries, 0);
+
+	threads = g_new0 (GThread *, n_threads);
+	timer = g_timer_new ();
+
+	for (i = 0; i < n_threads; i++) {
+		threads[i] = g_thread_new ("reader", reader_thread, NULL);
+	}
+
+	g_usleep (RUN_SECONDS * G_USEC_PER_SEC);
+	g_atomic_int_set (&stop_readers, TRUE);
+
+	for (i = 0; i < n_threads; i++) {
+		g_thread_join (threads[i]);
+	}
+
+	elapsed = g_timer_elapsed (timer, NULL);
+	g_timer_destroy (timer);
+	g_free (threads);
+
+	return g_atomic_int_get (&n_queries) / elapsed;
+}
+
+gint
+main (gint argc, gchar **argv)
+{
+	GFile *data_loc, *ontology;
+	GThread *writer;
+	GError *error = NULL;
+	gchar *test_path, *cmd;
+	guint n_threads, n_cpus;
+	gint i;
+
+	test_path = g_build_filename (g_get_tmp_dir (), "tracker-test-XXXXXX", NULL);
+	test_path = g_mkdtemp (test_path);
+
+	data_loc = g_file_new_for_path (test_path);
+	ontology = g_file_new_for_path (TEST_ONTOLOGIES_DIR);
+	connection = tracker_sparql_connection_local_new (0, data_loc, data_loc, ontology, NULL, &error);
+	g_assert_no_error (error);
+
+	for (i = 0; i < N_RESOURCES; i += BATCH_SIZE) {
+		gchar *update;
+
+		update = create_batch (i);
+		tracker_sparql_connection_update (connection, update, 0, NULL, &error);
+		g_assert_no_error (error);
+		g_free (update);
+	}
+
+	n_cpus = g_get_num_processors ();
+
+	g_print ("Idle:\n");
+	for (n_threads = 1; n_threads <= n_cpus; n_threads *= 2) {
+		g_print ("  %2u threads: %8.1f queries/s\n", n_threads, run_readers (n_threads));
+	}
+
+	writer = g_thread_new ("writer", writer_thread, NULL);
+
+	g_print ("During bulk update:\n");
+	for (n_threads = 1; n_threads <= n_cpus; n_threads *= 2) {
+		g_print ("  %2u threads: %8.1f queries/s\n", n_threads, run_readers (n_threads));
+	}
+
+	g_atomic_int_set (&stop_writer, TRUE);
+	g_thread_join (writer);
+
+	g_print ("%d update batches of %d resources committed meanwhile\n",
+	         g_atomic_int_get (&n_updates), BATCH_SIZE);
+
+	g_object_unref (connection);
+	g_object_unref (ontology);
+	g_object_unref (data_loc);
+
+	cmd = g_strdup_printf ("rm -rf %s", test_path);
+	if (system (cmd) != 0) {
+		g_warning ("Could not remove %s", test_path);
+	}
+	g_free (cmd);
+	g_free (test_path);
+
+	return 0;
+}
@@ -84,6 +84,31 @@ public class TestApp : GLib.Object {
 		res = iter_cursor (cursor);
 	}
 
+	// Typed values must read the same through get_string () and the
+	// typed getters, whichever format the results came in
+	private void test_typed_query () {
+		Cursor cursor;
+
+		print ("Typed values test\n");
+		try {
+			cursor = con.query ("SELECT ?u (COUNT(?o) AS ?n) (COUNT(?o) / 2.0 AS ?h) WHERE { ?u a rdfs:Class ; ?p ?o } GROUP BY ?u LIMIT 10");
+
+			while (cursor.next ()) {
+				if (cursor.get_value_type (1) != Sparql.ValueType.INTEGER ||
+				    cursor.get_integer (1).to_string () != cursor.get_string (1) ||
+				    cursor.get_value_type (2) != Sparql.ValueType.DOUBLE ||
+				    cursor.get_double (2) != double.parse (cursor.get_string (2))) {
+					warning ("Typed values don't match: %s %s", cursor.get_string (1), cursor.get_string (2));
+					res = -1;
+					return;
+				}
+			}
+		} catch (GLib.Error e) {
+			warning ("Couldn't perform query: %s", e.message);
+			res = -1;
+		}
+	}
+
 	private async void test_query_async () {
 		Cursor cursor;
 
@@ -110,6 +135,9 @@ public class TestApp : GLib.Object {
 
 	void do_sync_tests () {
 		test_query ();
+
+		if (res != -1)
+			test_typed_query ();
 	}
 
 	async void do_async_tests () {
@@ -20,6 +20,7 @@
 #include "config.h"
 
 #include <string.h>
+#include <locale.h>
 
 #include <glib.h>
 #include <gio/gio.h>
@@ -336,6 +337,8 @@ static const TestDataExpectedNWords test_data_nwords[] = {
 	{ "Американские суда находятся в международных водах.",     TRUE,   6, -1 }, /* russian */
 	{ "Bần chỉ là một anh nghèo xác",                            TRUE,   7, -1 }, /* vietnamese */
 	{ "ホモ・サピエンス 喂人类 katakana, chinese, english",          TRUE,   7, 8 }, /* mixed */
+	{ "don't stop at 1,000 user@example.org foo_bar",           TRUE,   6, -1 }, /* ascii */
+	{ "don't stop at 1,000 user@example.org foo_bar",           FALSE,  7, -1 },
 	{ NULL,                                                     FALSE,  0, 0 }
 };
 
@@ -348,6 +351,159 @@ static const TestDataStopWord test_data_stop_words[] = {
 	{ NULL,    FALSE, FALSE }
 };
 
+/* -------------- ASCII WORD-BREAK TESTS ----------------- */
+
+#define ASCII_LOCALE_TEXT "don't stop at 1,000 user@example.org foo_bar a:b x'y c;d 3.14"
+
+/* Locales with and without tailored word-break rules, those not
+ * available in the system are skipped */
+static const gchar *test_data_ascii_locales[] = {
+	"C",
+	"en_US.UTF-8",
+	"fi_FI.UTF-8",
+	"sv_SE.UTF-8",
+	NULL
+};
+
+static GPtrArray *
+parse_words (TrackerParserTestFixture *fixture,
+             const gchar              *text)
+{
+	GPtrArray *words;
+	const gchar *word;
+	gint position;
+	gint byte_offset_start;
+	gint byte_offset_end;
+	gboolean stop_word;
+	gint word_length;
+
+	words = g_ptr_array_new_with_free_func (g_free);
+
+	tracker_parser_reset (fixture->parser,
+	                      text,
+	                      strlen (text),
+	                      fixture->max_word_length,
+	                      fixture->enable_stemmer,
+	                      fixture->enable_unaccent,
+	                      fixture->ignore_stop_words,
+	                      fixture->ignore_reserved_words,
+	                      FALSE);
+
+	while ((word = tracker_parser_next (fixture->parser,
+	                                    &position,
+	                                    &byte_offset_start,
+	                                    &byte_offset_end,
+	                                    &stop_word,
+	                                    &word_length)) != NULL) {
+		g_ptr_array_add (words, g_strdup (word));
+	}
+
+	return words;
+}
+
+/* ASCII-only text must be split the same as any other text */
+static void
+ascii_locale_check (TrackerParserTestFixture *fixture,
+                    gconstpointer             data)
+{
+	const gchar *locale = data;
+	GPtrArray *ascii_words, *words;
+	gchar *old_locale;
+	guint i;
+
+	old_locale = g_strdup (setlocale (LC_CTYPE, NULL));
+
+	if (!setlocale (LC_CTYPE, locale)) {
+		g_test_skip ("Locale not available");
+		g_free (old_locale);
+		return;
+	}
+
+	ascii_words = parse_words (fixture, ASCII_LOCALE_TEXT);
+	/* A non-ASCII word at the end takes the whole text through libicu */
+	words = parse_words (fixture, ASCII_LOCALE_TEXT " ünïcode");
+
+	g_assert_cmpuint (words->len, ==, ascii_words->len + 1);
+
+	for (i = 0; i < ascii_words->len; i++) {
+		g_assert_cmpstr (g_ptr_array_index (ascii_words, i), ==,
+		                 g_ptr_array_index (words, i));
+	}
+
+	g_ptr_array_unref (ascii_words);
+	g_ptr_array_unref (words);
+
+	setlocale (LC_CTYPE, old_locale);
+	g_free (old_locale);
+}
+
+/* -------------- THROUGHPUT BENCHMARK ----------------- */
+
+#define N_PERF_BYTES (16 * 1024 * 1024)
+
+static const gchar *test_data_perf[] = {
+	/* short, as most FTS column values */
+	"Holiday pictures 2017.jpg",
+	/* ASCII-only */
+	"The quick brown fox jumps over the lazy dog while the five boxing "
+	"wizards jump quickly. Pack my box with five dozen liquor jugs, "
+	"it's 1,000 jugs in total according to the_file_name.txt report.",
+	/* Latin-1 */
+	"Le cœur déçu mais l'âme plutôt naïve, Louÿs rêva de crapaüter en "
+	"canoë au delà des îles, près du mälström où brûlent les novæ. "
+	"El pingüino Wenceslao hizo kilómetros bajo exhaustiva lluvia.",
+	NULL
+};
+
+static void
+parser_perf (TrackerParserTestFixture *fixture,
+             gconstpointer             data)
+{
+	const gchar *text = data;
+	gint position;
+	gint byte_offset_start;
+	gint byte_offset_end;
+	gboolean stop_word;
+	gint word_length;
+	gsize text_length, n_bytes = 0;
+	guint nwords = 0;
+	gdouble elapsed;
+
+	text_length = strlen (text);
+
+	g_test_timer_start ();
+
+	while (n_bytes < N_PERF_BYTES) {
+		tracker_parser_reset (fixture->parser,
+		                      text,
+		                      text_length,
+		                      fixture->max_word_length,
+		                      fixture->enable_stemmer,
+		                      fixture->enable_unaccent,
+		                      fixture->ignore_stop_words,
+		                      fixture->ignore_reserved_words,
+		                      fixture->ignore_numbers);
+
+		while (tracker_parser_next (fixture->parser,
+		                            &position,
+		                            &byte_offset_start,
+		                            &byte_offset_end,
+		                            &stop_word,
+		                            &word_length)) {
+			nwords++;
+		}
+
+		n_bytes += text_length;
+	}
+
+	elapsed = g_test_timer_elapsed ();
+
+	g_test_maximized_result (n_bytes / elapsed / (1024 * 1024),
+	                         "Tokenized %u words in %.3f s, %.2f MB/s",
+	                         nwords, elapsed,
+	                         n_bytes / elapsed / (1024 * 1024));
+}
+
 int
 main (int argc, char **argv)
 {
@@ -446,5 +602,35 @@ main (int argc, char **argv)
 		g_free (testpath);
 	}
 
+	/* Add ASCII word-break checks */
+	for (i = 0; test_data_ascii_locales[i] != NULL; i++) {
+		gchar *testpath;
+
+		testpath = g_strdup_printf ("/libtracker-fts/parser/ascii_locale_%d", i);
+		g_test_add (testpath,
+		            TrackerParserTestFixture,
+		            test_data_ascii_locales[i],
+		            test_common_setup,
+		            ascii_locale_check,
+		            test_common_teardown);
+		g_free (testpath);
+	}
+
+	/* Add throughput benchmarks */
+	if (g_test_perf ()) {
+		for (i = 0; test_data_perf[i] != NULL; i++) {
+			gchar *testpath;
+
+			testpath = g_strdup_printf ("/libtracker-fts/parser/perf_%d", i);
+			g_test_add (testpath,
+			            TrackerParserTestFixture,
+			            test_data_perf[i],
+			            test_common_setup,
+			            parser_perf,
+			            test_common_teardown);
+			g_free (testpath);
+		}
+	}
+
 	return g_test_run ();
 }
@@ -374,6 +374,103 @@ test_read_functions (void)
 	tracker_db_journal_reader_free (reader);
 }
 
+static void
+write_transaction (TrackerDBJournal *writer,
+                   gint              id)
+{
+	GError *error = NULL;
+	gboolean result;
+
+	result = tracker_db_journal_start_transaction (writer, id);
+	g_assert_cmpint (result, ==, TRUE);
+	result = tracker_db_journal_append_resource (writer, id, "http://resource");
+	g_assert_cmpint (result, ==, TRUE);
+	result = tracker_db_journal_commit_db_transaction (writer, &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (result, ==, TRUE);
+}
+
+static void
+test_snapshots (void)
+{
+	GError *error = NULL;
+	gchar *path, *data_dir;
+	GFile *data_location, *snapshot;
+	TrackerDBJournal *writer;
+	TrackerDBJournalReader *reader;
+	gint chunk, i;
+
+	data_dir = g_build_filename (g_get_tmp_dir (), "tracker-journal-test-XXXXXX", NULL);
+	data_dir = g_mkdtemp (data_dir);
+	data_location = g_file_new_for_path (data_dir);
+
+	/* Every commit rotates the journal */
+	tracker_db_journal_set_rotating (TRUE, 1, NULL);
+	writer = tracker_db_journal_new (data_location, FALSE, &error);
+	g_assert_no_error (error);
+
+	for (i = 1; i <= 3; i++) {
+		write_transaction (writer, i);
+		g_assert_cmpint (tracker_db_journal_get_chunk (writer), ==, i);
+	}
+
+	g_assert_null (tracker_db_journal_find_snapshot (data_location, &chunk));
+
+	for (i = 2; i <= 3; i++) {
+		snapshot = tracker_db_journal_get_snapshot_file (data_location, i);
+		path = g_file_get_path (snapshot);
+		g_assert_true (g_file_set_contents (path, "", -1, NULL));
+		g_object_unref (snapshot);
+		g_free (path);
+	}
+
+	snapshot = tracker_db_journal_find_snapshot (data_location, &chunk);
+	g_assert_nonnull (snapshot);
+	g_assert_cmpint (chunk, ==, 3);
+	g_object_unref (snapshot);
+
+	/* Older chunks and snapshots go away, the snapshotted chunk stays */
+	tracker_db_journal_prune (data_location, 3);
+
+	path = g_build_filename (data_dir, "tracker-store.journal.1", NULL);
+	g_assert_false (g_file_test (path, G_FILE_TEST_EXISTS));
+	g_free (path);
+	path = g_build_filename (data_dir, "tracker-store.journal.2.snapshot", NULL);
+	g_assert_false (g_file_test (path, G_FILE_TEST_EXISTS));
+	g_free (path);
+	path = g_build_filename (data_dir, "tracker-store.journal.3", NULL);
+	g_assert_true (g_file_test (path, G_FILE_TEST_EXISTS));
+	g_free (path);
+
+	/* Reading starts at the requested chunk */
+	reader = tracker_db_journal_reader_new_from_chunk (data_location, 3, &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (reader);
+	g_assert_true (tracker_db_journal_reader_next (reader, &error));
+	g_assert_no_error (error);
+	g_assert_cmpint (tracker_db_journal_reader_get_time (reader), ==, 3);
+	tracker_db_journal_reader_free (reader);
+
+	/* Chunks after the last rotated one are in the active journal */
+	write_transaction (writer, 4);
+	tracker_db_journal_set_rotating (FALSE, G_MAXSIZE, NULL);
+	write_transaction (writer, 5);
+
+	reader = tracker_db_journal_reader_new_from_chunk (data_location, 5, &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (reader);
+	g_assert_true (tracker_db_journal_reader_next (reader, &error));
+	g_assert_no_error (error);
+	g_assert_cmpint (tracker_db_journal_reader_get_time (reader), ==, 5);
+	tracker_db_journal_reader_free (reader);
+
+	tracker_db_journal_remove (writer);
+	g_rmdir (data_dir);
+
+	g_object_unref (data_location);
+	g_free (data_dir);
+}
+
 #endif /* DISABLE_JOURNAL */
 
 int
@@ -392,6 +489,8 @@ main (int argc, char **argv)
 	                 test_read_functions);
 	g_test_add_func ("/libtracker-db/tracker-db-journal/init-and-shutdown",
 	                 test_init_and_shutdown);
+	g_test_add_func ("/libtracker-db/tracker-db-journal/snapshots",
+	                 test_snapshots);
 #endif /* DISABLE_JOURNAL */
 
 	result = g_test_run ();
@@ -0,0 +1,409 @@
+/*
+ * Copyright (C) 2018, Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <locale.h>
+
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include <libtracker-common/tracker-common.h>
+#include <libtracker-data/tracker-data.h>
+
+#define TEST_PREFIX "http://www.example.org/test#"
+#define RDF_TYPE "http://www.w3.org/1999/02/22-rdf-syntax-ns#type"
+
+static gchar *tests_data_dir = NULL;
+
+typedef struct _TestInfo TestInfo;
+
+struct _TestInfo {
+	gchar *data_location;
+};
+
+static TrackerDataManager *
+create_manager (TestInfo              *info,
+                TrackerDBManagerFlags  flags)
+{
+	TrackerDataManager *manager;
+	GFile *data_location, *ontology;
+	GError *error = NULL;
+	gchar *path;
+
+	data_location = g_file_new_for_path (info->data_location);
+
+	path = g_build_path (G_DIR_SEPARATOR_S, TOP_SRCDIR, "tests", "libtracker-data", "replay", NULL);
+	ontology = g_file_new_for_path (path);
+	g_free (path);
+
+	tracker_db_journal_set_rotating (FALSE, G_MAXSIZE, NULL);
+
+	manager = tracker_data_manager_new (flags, data_location, data_location, ontology,
+	                                    TRUE, FALSE, 100, 100);
+	g_initable_init (G_INITABLE (manager), NULL, &error);
+	g_assert_no_error (error);
+
+	g_object_unref (data_location);
+	g_object_unref (ontology);
+
+	return manager;
+}
+
+static gint
+count_results (TrackerDataManager *manager,
+               const gchar        *query)
+{
+	TrackerDBCursor *cursor;
+	GError *error = NULL;
+	gint n_rows = 0;
+
+	cursor = tracker_data_query_sparql_cursor (manager, query, &error);
+	g_assert_no_error (error);
+
+	while (tracker_db_cursor_iter_next (cursor, NULL, &error)) {
+		n_rows++;
+	}
+
+	g_assert_no_error (error);
+	g_object_unref (cursor);
+
+	return n_rows;
+}
+
+/* Returns the names of the tables or indexes in the database */
+static gchar *
+get_schema_names (TrackerDataManager *manager,
+                  const gchar        *type)
+{
+	TrackerDBInterface *iface;
+	TrackerDBStatement *stmt;
+	TrackerDBCursor *cursor;
+	GError *error = NULL;
+	GString *names;
+
+	iface = tracker_data_manager_get_writable_db_interface (manager);
+	stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_NONE, &error,
+	                                              "SELECT name FROM sqlite_master "
+	                                              "WHERE type = ? AND sql IS NOT NULL "
+	                                              "ORDER BY name");
+	g_assert_no_error (error);
+
+	tracker_db_statement_bind_text (stmt, 0, type);
+	cursor = tracker_db_statement_start_cursor (stmt, &error);
+	g_assert_no_error (error);
+	g_object_unref (stmt);
+
+	names = g_string_new (NULL);
+
+	while (tracker_db_cursor_iter_next (cursor, NULL, &error)) {
+		g_string_append_printf (names, "%s\n", tracker_db_cursor_get_string (cursor, 0, NULL));
+	}
+
+	g_assert_no_error (error);
+	g_object_unref (cursor);
+
+	return g_string_free (names, FALSE);
+}
+
+static gboolean
+has_bulk_load_table (TrackerDataManager *manager)
+{
+	gchar *tables;
+	gboolean found;
+
+	tables = get_schema_names (manager, "table");
+	found = strstr (tables, "BulkLoadIndexes\n") != NULL;
+	g_free (tables);
+
+	return found;
+}
+
+static void
+insert_resources (TrackerData *data,
+                  gint         first,
+                  gint         n)
+{
+	GError *error = NULL;
+	GString *query;
+	gint i;
+
+	query = g_string_new ("INSERT {");
+
+	for (i = first; i < first + n; i++) {
+		g_string_append_printf (query,
+		                        " test:r%d a test:A ; test:title \"title %d\" ;"
+		                        " test:tag \"tag%d\", \"common\" ; test:text \"word%d common\" .",
+		                        i, i, i, i);
+	}
+
+	g_string_append (query, " }");
+
+	tracker_data_update_sparql (data, query->str, &error);
+	g_assert_no_error (error);
+	g_string_free (query, TRUE);
+}
+
+static void
+check_content (TrackerDataManager *manager,
+               gint                n)
+{
+	g_assert_cmpint (count_results (manager, "SELECT ?u WHERE { ?u a test:A }"), ==, n);
+	g_assert_cmpint (count_results (manager, "SELECT ?u WHERE { ?u test:tag \"common\" }"), ==, n);
+	g_assert_cmpint (count_results (manager, "SELECT ?u WHERE { ?u test:title \"title 3\" }"), ==, 1);
+#if HAVE_TRACKER_FTS
+	g_assert_cmpint (count_results (manager, "SELECT ?u WHERE { ?u fts:match \"common\" }"), ==, n);
+	g_assert_cmpint (count_results (manager, "SELECT ?u WHERE { ?u fts:match \"word3\" }"), ==, 1);
+#endif
+}
+
+static void
+remove_database (TestInfo *info)
+{
+	const gchar *files[] = { "meta.db", "meta.db-wal", "meta.db-shm" };
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS (files); i++) {
+		gchar *path;
+
+		path = g_build_filename (info->data_location, files[i], NULL);
+		g_unlink (path);
+		g_free (path);
+	}
+}
+
+#ifndef DISABLE_JOURNAL
+/* The database is created again from the journal, with the same
+ * indexes it had before. */
+static void
+test_journal_replay (TestInfo      *info,
+                     gconstpointer  context)
+{
+	TrackerDataManager *manager;
+	gchar *indexes, *replayed_indexes;
+
+	manager = create_manager (info, TRACKER_DB_MANAGER_FORCE_REINDEX);
+	insert_resources (tracker_data_manager_get_data (manager), 0, 50);
+	insert_resources (tracker_data_manager_get_data (manager), 50, 50);
+	check_content (manager, 100);
+	indexes = get_schema_names (manager, "index");
+	g_object_unref (manager);
+
+	remove_database (info);
+
+	manager = create_manager (info, 0);
+	check_content (manager, 100);
+	replayed_indexes = get_schema_names (manager, "index");
+	g_assert_cmpstr (replayed_indexes, ==, indexes);
+	g_assert_false (has_bulk_load_table (manager));
+	g_object_unref (manager);
+
+	g_free (indexes);
+	g_free (replayed_indexes);
+}
+
+/* A snapshot is taken when the journal is rotated, the database is
+ * then restored from it, and only the journal after it is replayed. */
+static void
+test_journal_replay_snapshot (TestInfo      *info,
+                              gconstpointer  context)
+{
+	TrackerDataManager *manager;
+	TrackerData *data;
+	GFile *data_location, *snapshot;
+	gchar *indexes, *restored_indexes, *path;
+	gint chunk;
+
+	manager = create_manager (info, TRACKER_DB_MANAGER_FORCE_REINDEX);
+	data = tracker_data_manager_get_data (manager);
+
+	/* Every commit rotates the journal, the first one in a session
+	 * gets no snapshot */
+	tracker_db_journal_set_rotating (TRUE, 1, NULL);
+	insert_resources (data, 0, 10);
+	tracker_data_wait_snapshot (data);
+	insert_resources (data, 10, 10);
+	tracker_data_wait_snapshot (data);
+
+	/* The tail only lives in the journal */
+	tracker_db_journal_set_rotating (FALSE, G_MAXSIZE, NULL);
+	insert_resources (data, 20, 10);
+
+	indexes = get_schema_names (manager, "index");
+	g_object_unref (manager);
+
+	data_location = g_file_new_for_path (info->data_location);
+	snapshot = tracker_db_journal_find_snapshot (data_location, &chunk);
+	g_assert_nonnull (snapshot);
+	g_object_unref (snapshot);
+
+	/* Chunks in the snapshot were pruned */
+	path = g_strdup_printf ("%s/tracker-store.journal.%d", info->data_location, chunk - 1);
+	g_assert_false (g_file_test (path, G_FILE_TEST_EXISTS));
+	g_free (path);
+
+	remove_database (info);
+
+	manager = create_manager (info, 0);
+	check_content (manager, 30);
+	restored_indexes = get_schema_names (manager, "index");
+	g_assert_cmpstr (restored_indexes, ==, indexes);
+	g_object_unref (manager);
+
+	g_object_unref (data_location);
+	g_free (indexes);
+	g_free (restored_indexes);
+}
+#endif /* DISABLE_JOURNAL */
+
+/* A replay commits every so many statements while indexes are dropped,
+ * this leaves the database as a replay interrupted after such a commit
+ * would, and checks the indexes and the FTS index come back on the
+ * next start. */
+static void
+test_journal_replay_interrupted (TestInfo      *info,
+                                 gconstpointer  context)
+{
+	TrackerDataManager *manager;
+	TrackerData *data;
+	GError *error = NULL;
+	gchar *indexes, *bulk_indexes, *recovered_indexes;
+	gint i;
+
+	manager = create_manager (info, TRACKER_DB_MANAGER_FORCE_REINDEX);
+	data = tracker_data_manager_get_data (manager);
+	insert_resources (data, 0, 10);
+	indexes = get_schema_names (manager, "index");
+
+	tracker_data_begin_transaction (data, &error);
+	g_assert_no_error (error);
+	tracker_data_begin_bulk_load (data, &error);
+	g_assert_no_error (error);
+
+	for (i = 10; i < 20; i++) {
+		gchar *subject, *value;
+
+		subject = g_strdup_printf (TEST_PREFIX "r%d", i);
+
+		tracker_data_insert_statement (data, NULL, subject, RDF_TYPE, TEST_PREFIX "A", &error);
+		g_assert_no_error (error);
+
+		value = g_strdup_printf ("title %d", i);
+		tracker_data_insert_statement (data, NULL, subject, TEST_PREFIX "title", value, &error);
+		g_assert_no_error (error);
+		g_free (value);
+
+		value = g_strdup_printf ("tag%d", i);
+		tracker_data_insert_statement (data, NULL, subject, TEST_PREFIX "tag", value, &error);
+		g_assert_no_error (error);
+		g_free (value);
+
+		tracker_data_insert_statement (data, NULL, subject, TEST_PREFIX "tag", "common", &error);
+		g_assert_no_error (error);
+
+		value = g_strdup_printf ("word%d common", i);
+		tracker_data_insert_statement (data, NULL, subject, TEST_PREFIX "text", value, &error);
+		g_assert_no_error (error);
+		g_free (value);
+
+		g_free (subject);
+	}
+
+	tracker_data_update_buffer_flush (data, &error);
+	g_assert_no_error (error);
+	tracker_data_commit_transaction (data, &error);
+	g_assert_no_error (error);
+
+	/* Only unique and "_ID" indexes are left, the others are recorded */
+	bulk_indexes = get_schema_names (manager, "index");
+	g_assert_cmpstr (bulk_indexes, !=, indexes);
+	g_assert_null (strstr (bulk_indexes, "test:A_test:title\n"));
+	g_assert_nonnull (strstr (bulk_indexes, "test:A_test:tag_ID\n"));
+	g_assert_nonnull (strstr (bulk_indexes, "test:A_test:tag_ID_ID\n"));
+	g_assert_true (has_bulk_load_table (manager));
+
+	/* Stop without ending the bulk load */
+	g_object_unref (manager);
+
+	manager = create_manager (info, 0);
+	recovered_indexes = get_schema_names (manager, "index");
+	g_assert_cmpstr (recovered_indexes, ==, indexes);
+	g_assert_false (has_bulk_load_table (manager));
+	check_content (manager, 20);
+	g_object_unref (manager);
+
+	g_free (indexes);
+	g_free (bulk_indexes);
+	g_free (recovered_indexes);
+}
+
+static void
+setup (TestInfo      *info,
+       gconstpointer  context)
+{
+	gchar *basename;
+
+	basename = g_strdup_printf ("%d", g_test_rand_int_range (0, G_MAXINT));
+	info->data_location = g_build_path (G_DIR_SEPARATOR_S, tests_data_dir, basename, NULL);
+	g_free (basename);
+}
+
+static void
+teardown (TestInfo      *info,
+          gconstpointer  context)
+{
+	gchar *cleanup_command;
+
+	/* clean up */
+	g_print ("Removing temporary data (%s)\n", info->data_location);
+
+	cleanup_command = g_strdup_printf ("rm -Rf %s/", info->data_location);
+	g_spawn_command_line_sync (cleanup_command, NULL, NULL, NULL, NULL);
+	g_free (cleanup_command);
+
+	g_free (info->data_location);
+}
+
+int
+main (int argc, char **argv)
+{
+	gint result;
+	gchar *current_dir;
+
+	setlocale (LC_COLLATE, "en_US.utf8");
+
+	current_dir = g_get_current_dir ();
+	tests_data_dir = g_build_path (G_DIR_SEPARATOR_S, current_dir, "test-data", NULL);
+	g_free (current_dir);
+
+	g_test_init (&argc, &argv, NULL);
+
+#ifndef DISABLE_JOURNAL
+	g_test_add ("/libtracker-data/journal-replay/replay", TestInfo, NULL, setup, test_journal_replay, teardown);
+	g_test_add ("/libtracker-data/journal-replay/snapshot", TestInfo, NULL, setup, test_journal_replay_snapshot, teardown);
+#endif /* DISABLE_JOURNAL */
+	g_test_add ("/libtracker-data/journal-replay/interrupted", TestInfo, NULL, setup, test_journal_replay_interrupted, teardown);
+
+	result = g_test_run ();
+
+	g_free (tests_data_dir);
+
+	return result;
+}
@@ -323,6 +323,13 @@ test_sparql_query (TestInfo      *test_info,
 
 	check_result (cursor, test_info, results_filename, error);
 
+	if (!test_info->expect_query_error) {
+		/* Run it again, this time through the query cache */
+		g_object_unref (cursor);
+		cursor = tracker_data_query_sparql_cursor (manager, query, &error);
+		check_result (cursor, test_info, results_filename, error);
+	}
+
 	g_free (query_filename);
 	g_free (query);
 
@@ -354,6 +361,251 @@ test_sparql_query (TestInfo      *test_info,
 	g_object_unref (manager);
 }
 
+static void
+test_sparql_query_cache (TestInfo      *test_info,
+                         gconstpointer  context)
+{
+	TrackerSparqlQueryCache *cache;
+	TrackerDBCursor *cursor;
+	GError *error = NULL;
+	gchar *prefix;
+	GFile *test_schemas, *data_location;
+	TrackerDataManager *manager;
+	const gchar *query = "SELECT ?u WHERE { ?u a rdfs:Resource } LIMIT 1";
+	guint hits;
+
+	prefix = g_build_path (G_DIR_SEPARATOR_S, TOP_SRCDIR, "tests", "libtracker-data", "basic", NULL);
+	test_schemas = g_file_new_for_path (prefix);
+	g_free (prefix);
+
+	data_location = g_file_new_for_path (test_info->data_location);
+
+	tracker_db_journal_set_rotating (FALSE, G_MAXSIZE, NULL);
+
+	manager = tracker_data_manager_new (TRACKER_DB_MANAGER_FORCE_REINDEX,
+	                                    data_location, data_location, test_schemas,
+	                                    FALSE, FALSE, 100, 100);
+	g_initable_init (G_INITABLE (manager), NULL, &error);
+	g_assert_no_error (error);
+
+	cache = tracker_data_manager_get_query_cache (manager);
+	tracker_sparql_query_cache_clear (cache);
+	g_assert_cmpuint (tracker_sparql_query_cache_get_size (cache), ==, 0);
+	hits = tracker_sparql_query_cache_get_hits (cache);
+
+	cursor = tracker_data_query_sparql_cursor (manager, query, &error);
+	g_assert_no_error (error);
+	g_object_unref (cursor);
+
+	g_assert_cmpuint (tracker_sparql_query_cache_get_size (cache), ==, 1);
+	g_assert_cmpuint (tracker_sparql_query_cache_get_hits (cache), ==, hits);
+
+	cursor = tracker_data_query_sparql_cursor (manager, query, &error);
+	g_assert_no_error (error);
+	g_object_unref (cursor);
+
+	g_assert_cmpuint (tracker_sparql_query_cache_get_size (cache), ==, 1);
+	g_assert_cmpuint (tracker_sparql_query_cache_get_hits (cache), ==, hits + 1);
+
+	/* Invalid queries are never cached */
+	cursor = tracker_data_query_sparql_cursor (manager, "SELECT ?u WHERE { ?u a", &error);
+	g_assert (cursor == NULL);
+	g_assert (error != NULL);
+	g_clear_error (&error);
+
+	g_assert_cmpuint (tracker_sparql_query_cache_get_size (cache), ==, 1);
+
+	g_object_unref (test_schemas);
+	g_object_unref (data_location);
+	g_object_unref (manager);
+}
+
+static void
+assert_single_result (TrackerSparqlQuery *query,
+                      GHashTable         *parameters,
+                      const gchar        *expected)
+{
+	TrackerDBCursor *cursor;
+	GError *error = NULL;
+
+	cursor = tracker_sparql_query_execute_cursor_with_parameters (query, parameters, &error);
+	g_assert_no_error (error);
+
+	g_assert (tracker_db_cursor_iter_next (cursor, NULL, &error));
+	g_assert_no_error (error);
+	g_assert_cmpstr (tracker_db_cursor_get_string (cursor, 0, NULL), ==, expected);
+	g_assert (!tracker_db_cursor_iter_next (cursor, NULL, &error));
+	g_assert_no_error (error);
+
+	g_object_unref (cursor);
+}
+
+static void
+test_sparql_query_parameters (TestInfo      *test_info,
+                              gconstpointer  context)
+{
+	TrackerSparqlQuery *query;
+	TrackerDBCursor *cursor;
+	GHashTable *parameters;
+	GError *error = NULL;
+	gchar *prefix;
+	GFile *test_schemas, *data_location;
+	TrackerDataManager *manager;
+
+	prefix = g_build_path (G_DIR_SEPARATOR_S, TOP_SRCDIR, "tests", "libtracker-data", "basic", NULL);
+	test_schemas = g_file_new_for_path (prefix);
+	g_free (prefix);
+
+	data_location = g_file_new_for_path (test_info->data_location);
+
+	tracker_db_journal_set_rotating (FALSE, G_MAXSIZE, NULL);
+
+	manager = tracker_data_manager_new (TRACKER_DB_MANAGER_FORCE_REINDEX,
+	                                    data_location, data_location, test_schemas,
+	                                    FALSE, FALSE, 100, 100);
+	g_initable_init (G_INITABLE (manager), NULL, &error);
+	g_assert_no_error (error);
+
+	tracker_data_update_sparql (tracker_data_manager_get_data (manager),
+	                            "INSERT { <urn:a> a x:A ; x:p 1 ; ns:p 'foo' . "
+	                            "         <urn:b> a x:A ; x:p 2 ; ns:p 'bar' }",
+	                            &error);
+	g_assert_no_error (error);
+
+	parameters = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+	                                    (GDestroyNotify) g_variant_unref);
+
+	/* The same query object executed with different values */
+	query = tracker_sparql_query_new (manager, "SELECT ?u WHERE { ?u ns:p ~name }");
+
+	g_hash_table_insert (parameters, "name", g_variant_ref_sink (g_variant_new_string ("foo")));
+	assert_single_result (query, parameters, "urn:a");
+
+	g_hash_table_insert (parameters, "name", g_variant_ref_sink (g_variant_new_string ("bar")));
+	assert_single_result (query, parameters, "urn:b");
+
+	/* Values are never parsed as SPARQL */
+	g_hash_table_insert (parameters, "name", g_variant_ref_sink (g_variant_new_string ("bar' || 'x")));
+	cursor = tracker_sparql_query_execute_cursor_with_parameters (query, parameters, &error);
+	g_assert_no_error (error);
+	g_assert (!tracker_db_cursor_iter_next (cursor, NULL, &error));
+	g_assert_no_error (error);
+	g_object_unref (cursor);
+
+	/* All parameters need a value */
+	g_hash_table_remove_all (parameters);
+	cursor = tracker_sparql_query_execute_cursor_with_parameters (query, parameters, &error);
+	g_assert_error (error, TRACKER_SPARQL_ERROR, TRACKER_SPARQL_ERROR_TYPE);
+	g_assert (cursor == NULL);
+	g_clear_error (&error);
+
+	g_object_unref (query);
+
+	/* Parameters in filter expressions */
+	query = tracker_sparql_query_new (manager, "SELECT ?u WHERE { ?u x:p ?v FILTER (?v > ~min) }");
+
+	g_hash_table_insert (parameters, "min", g_variant_ref_sink (g_variant_new_int64 (1)));
+	assert_single_result (query, parameters, "urn:b");
+
+	/* String values take the type of the other operand */
+	g_hash_table_insert (parameters, "min", g_variant_ref_sink (g_variant_new_string ("1")));
+	assert_single_result (query, parameters, "urn:b");
+
+	g_object_unref (query);
+
+	query = tracker_sparql_query_new (manager, "SELECT ?u WHERE { ?u x:p ?v FILTER (~max > ?v) }");
+
+	g_hash_table_insert (parameters, "max", g_variant_ref_sink (g_variant_new_string ("2")));
+	assert_single_result (query, parameters, "urn:a");
+
+	g_object_unref (query);
+	g_hash_table_unref (parameters);
+
+	g_object_unref (test_schemas);
+	g_object_unref (data_location);
+	g_object_unref (manager);
+}
+
+static gchar *
+load_and_dump (TestInfo *test_info,
+               gboolean  bulk)
+{
+	TrackerDataManager *manager;
+	TrackerDBCursor *cursor;
+	GFile *file, *test_schemas, *data_location;
+	GError *error = NULL;
+	GString *dump;
+	gchar *prefix, *location;
+	guint i;
+
+	prefix = g_build_path (G_DIR_SEPARATOR_S, TOP_SRCDIR, "tests", "libtracker-data", "algebra", NULL);
+	test_schemas = g_file_new_for_path (prefix);
+	file = g_file_get_child (test_schemas, "data-2.ttl");
+	g_free (prefix);
+
+	location = g_build_filename (test_info->data_location, bulk ? "bulk" : "regular", NULL);
+	data_location = g_file_new_for_path (location);
+	g_free (location);
+
+	tracker_db_journal_set_rotating (FALSE, G_MAXSIZE, NULL);
+
+	manager = tracker_data_manager_new (TRACKER_DB_MANAGER_FORCE_REINDEX,
+	                                    data_location, data_location, test_schemas,
+	                                    FALSE, FALSE, 100, 100);
+	g_initable_init (G_INITABLE (manager), NULL, &error);
+	g_assert_no_error (error);
+
+	if (bulk) {
+		tracker_data_load_turtle_file_bulk (tracker_data_manager_get_data (manager), file, &error);
+	} else {
+		tracker_data_load_turtle_file (tracker_data_manager_get_data (manager), file, &error);
+	}
+	g_assert_no_error (error);
+
+	/* IDs are part of the dump, both paths must assign the same ones,
+	 * tracker:added depends on the time of the load */
+	cursor = tracker_data_query_sparql_cursor (manager,
+	                                           "SELECT tracker:id(?s) ?s ?p ?o WHERE { ?s ?p ?o "
+	                                           "FILTER (?p != tracker:added) } "
+	                                           "ORDER BY tracker:id(?s) ?p ?o",
+	                                           &error);
+	g_assert_no_error (error);
+
+	dump = g_string_new (NULL);
+
+	while (tracker_db_cursor_iter_next (cursor, NULL, &error)) {
+		for (i = 0; i < tracker_db_cursor_get_n_columns (cursor); i++) {
+			g_string_append_printf (dump, "%s\t", tracker_db_cursor_get_string (cursor, i, NULL));
+		}
+		g_string_append_c (dump, '\n');
+	}
+	g_assert_no_error (error);
+
+	g_object_unref (cursor);
+	g_object_unref (file);
+	g_object_unref (test_schemas);
+	g_object_unref (data_location);
+	g_object_unref (manager);
+
+	return g_string_free (dump, FALSE);
+}
+
+static void
+test_sparql_bulk_load (TestInfo      *test_info,
+                       gconstpointer  context)
+{
+	gchar *regular, *bulk;
+
+	regular = load_and_dump (test_info, FALSE);
+	bulk = load_and_dump (test_info, TRUE);
+
+	g_assert_cmpstr (regular, !=, "");
+	g_assert_cmpstr (bulk, ==, regular);
+
+	g_free (regular);
+	g_free (bulk);
+}
+
 static void
 setup (TestInfo      *info,
        gconstpointer  context)
@@ -420,6 +672,10 @@ main (int argc, char **argv)
 		g_free (testpath);
 	}
 
+	g_test_add ("/libtracker-data/sparql/query-cache", TestInfo, &tests[0], setup, test_sparql_query_cache, teardown);
+	g_test_add ("/libtracker-data/sparql/query-parameters", TestInfo, &tests[0], setup, test_sparql_query_parameters, teardown);
+	g_test_add ("/libtracker-data/sparql/bulk-load", TestInfo, &tests[0], setup, test_sparql_bulk_load, teardown);
+
 	/* run tests */
 	result = g_test_run ();
 
@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2018, Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include <libtracker-data/tracker-data.h>
+#include <libtracker-sparql/tracker-sparql.h>
+
+#include "tracker-fts-test-utils.h"
+
+#define N_PERF_RESOURCES 10000
+#define N_PERF_BATCH 200
+
+static gchar *datadir = NULL;
+
+static gint
+count_matches (TrackerDataManager *manager,
+               const gchar        *match)
+{
+	TrackerDBCursor *cursor;
+	GError *error = NULL;
+	gchar *query;
+	gint n = 0;
+
+	query = g_strdup_printf ("SELECT ?u WHERE { ?u fts:match \"%s\" }", match);
+	cursor = tracker_data_query_sparql_cursor (manager, query, &error);
+	g_assert_no_error (error);
+	g_free (query);
+
+	while (tracker_db_cursor_iter_next (cursor, NULL, &error))
+		n++;
+
+	g_assert_no_error (error);
+	g_object_unref (cursor);
+
+	return n;
+}
+
+static void
+update (TrackerData *data,
+        const gchar *query)
+{
+	GError *error = NULL;
+
+	tracker_data_update_sparql (data, query, &error);
+	g_assert_no_error (error);
+}
+
+static gint
+flush (TrackerData *data)
+{
+	GError *error = NULL;
+	gint n_flushed;
+
+	n_flushed = tracker_data_flush_fts (data, 100, &error);
+	g_assert_no_error (error);
+
+	return n_flushed;
+}
+
+static void
+test_deferred_index (void)
+{
+	TrackerDataManager *manager;
+	TrackerData *data;
+
+	manager = tracker_fts_test_create_manager (datadir, TRACKER_DB_MANAGER_FORCE_REINDEX);
+	data = tracker_data_manager_get_data (manager);
+
+	tracker_data_set_fts_deferred (data, TRUE);
+	g_assert_true (tracker_data_get_fts_deferred (data));
+
+	/* Nothing is indexed until flushed */
+	update (data, "INSERT { test:1 a test:A ; test:p \"apple banana\" }");
+	g_assert_cmpint (count_matches (manager, "apple"), ==, 0);
+	g_assert_cmpint (flush (data), ==, 1);
+	g_assert_cmpint (count_matches (manager, "apple"), ==, 1);
+	g_assert_cmpint (flush (data), ==, 0);
+
+	/* Changes are indexed once, from the text as last updated */
+	update (data, "DELETE { test:1 test:p ?p } INSERT { test:1 test:p \"cherry\" } "
+	        "WHERE { test:1 test:p ?p }");
+	update (data, "DELETE { test:1 test:p ?p } INSERT { test:1 test:p \"kiwi\" } "
+	        "WHERE { test:1 test:p ?p }");
+	g_assert_cmpint (count_matches (manager, "apple"), ==, 1);
+	g_assert_cmpint (flush (data), ==, 1);
+	g_assert_cmpint (count_matches (manager, "apple"), ==, 0);
+	g_assert_cmpint (count_matches (manager, "cherry"), ==, 0);
+	g_assert_cmpint (count_matches (manager, "kiwi"), ==, 1);
+
+	/* Resources inserted and deleted meanwhile leave nothing behind */
+	update (data, "INSERT { test:2 a test:A ; test:p \"kiwi\" }");
+	update (data, "DELETE { test:2 a rdfs:Resource }");
+	update (data, "DELETE { test:1 a rdfs:Resource }");
+	g_assert_cmpint (flush (data), ==, 2);
+	g_assert_cmpint (count_matches (manager, "kiwi"), ==, 0);
+
+	/* Going back to synchronous indexing catches up first */
+	update (data, "INSERT { test:3 a test:A ; test:o \"grape\" }");
+	tracker_data_set_fts_deferred (data, FALSE);
+	g_assert_cmpint (count_matches (manager, "grape"), ==, 1);
+
+	update (data, "INSERT { test:4 a test:A ; test:o \"grape\" }");
+	g_assert_cmpint (count_matches (manager, "grape"), ==, 2);
+
+	g_object_unref (manager);
+}
+
+static gdouble
+time_batched_inserts (TrackerDataManager *manager,
+                      gboolean            deferred)
+{
+	TrackerData *data;
+	gdouble elapsed;
+
+	data = tracker_data_manager_get_data (manager);
+	tracker_data_set_fts_deferred (data, deferred);
+
+	g_test_timer_start ();
+
+	tracker_fts_test_insert_random (data, N_PERF_RESOURCES, N_PERF_BATCH);
+
+	if (deferred) {
+		GError *error = NULL;
+		gint n_flushed;
+
+		do {
+			n_flushed = tracker_data_flush_fts (data, 1000, &error);
+			g_assert_no_error (error);
+		} while (n_flushed > 0);
+	}
+
+	elapsed = g_test_timer_elapsed ();
+
+	g_assert_cmpint (count_matches (manager, "alpha"), >, 0);
+
+	return elapsed;
+}
+
+static void
+test_deferred_perf (void)
+{
+	TrackerDataManager *manager;
+	gdouble elapsed;
+
+	manager = tracker_fts_test_create_manager (datadir, TRACKER_DB_MANAGER_FORCE_REINDEX);
+	elapsed = time_batched_inserts (manager, FALSE);
+	g_test_minimized_result (elapsed, "synchronous: %d resources in batches of %d in %.3f s",
+	                         N_PERF_RESOURCES, N_PERF_BATCH, elapsed);
+	g_object_unref (manager);
+
+	manager = tracker_fts_test_create_manager (datadir, TRACKER_DB_MANAGER_FORCE_REINDEX);
+	elapsed = time_batched_inserts (manager, TRUE);
+	g_test_minimized_result (elapsed, "deferred: %d resources in batches of %d in %.3f s",
+	                         N_PERF_RESOURCES, N_PERF_BATCH, elapsed);
+	g_object_unref (manager);
+}
+
+int
+main (int argc, char **argv)
+{
+	gchar *current_dir;
+	gint result;
+
+	g_test_init (&argc, &argv, NULL);
+
+	current_dir = g_get_current_dir ();
+	datadir = g_build_filename (current_dir, "tracker-deferred", NULL);
+	g_free (current_dir);
+
+	g_test_add_func ("/libtracker-fts/deferred/index", test_deferred_index);
+
+	if (g_test_perf ()) {
+		g_test_add_func ("/libtracker-fts/deferred/perf", test_deferred_perf);
+	}
+
+	result = g_test_run ();
+
+	tracker_fts_test_remove_datadir (datadir);
+	g_free (datadir);
+
+	return result;
+}
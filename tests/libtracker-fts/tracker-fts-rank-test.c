@@ -0,0 +1,278 @@
+/*
+ * Copyright (C) 2018, Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include <libtracker-data/tracker-data.h>
+#include <libtracker-sparql/tracker-sparql.h>
+
+#include "tracker-fts-test-utils.h"
+
+#define RANKED_QUERY \
+	"SELECT ?u WHERE { ?u fts:match \"%s\" } " \
+	"ORDER BY DESC(fts:rank(?u)) LIMIT %d"
+
+#define N_PERF_RESOURCES 5000
+#define N_PERF_QUERIES 100
+
+static gchar *datadir = NULL;
+
+static GPtrArray *
+query_ranked (TrackerDataManager *manager,
+              const gchar        *match,
+              gint                limit)
+{
+	TrackerDBCursor *cursor;
+	GError *error = NULL;
+	GPtrArray *results;
+	gchar *query;
+
+	query = g_strdup_printf (RANKED_QUERY, match, limit);
+	cursor = tracker_data_query_sparql_cursor (manager, query, &error);
+	g_assert_no_error (error);
+	g_free (query);
+
+	results = g_ptr_array_new_with_free_func (g_free);
+
+	while (tracker_db_cursor_iter_next (cursor, NULL, &error)) {
+		g_ptr_array_add (results,
+		                 g_strdup (tracker_db_cursor_get_string (cursor, 0, NULL)));
+	}
+
+	g_assert_no_error (error);
+	g_object_unref (cursor);
+
+	return results;
+}
+
+static void
+test_rank_bm25 (void)
+{
+	TrackerDataManager *manager;
+	TrackerData *data;
+	GPtrArray *results;
+	GError *error = NULL;
+
+	manager = tracker_fts_test_create_manager (datadir, TRACKER_DB_MANAGER_FORCE_REINDEX);
+	data = tracker_data_manager_get_data (manager);
+
+	/* test:2 has more hits than test:1 in a text of the same length,
+	 * test:3 has a single hit in a longer text, test:5 has a single
+	 * hit in a column with lower weight.
+	 */
+	tracker_data_update_sparql (data,
+	                            "INSERT {"
+	                            "  test:1 a test:A ; test:p \"apple banana cherry\" ."
+	                            "  test:2 a test:A ; test:p \"apple apple banana\" ."
+	                            "  test:3 a test:A ; test:p \"apple banana cherry date elderberry fig grape kiwi\" ."
+	                            "  test:4 a test:A ; test:p \"banana cherry\" ."
+	                            "  test:5 a test:A ; test:p \"banana cherry date\" ; test:o \"apple banana cherry\" ."
+	                            "}",
+	                            &error);
+	g_assert_no_error (error);
+
+	results = query_ranked (manager, "apple", 10);
+	g_assert_cmpint (results->len, ==, 4);
+	g_assert_cmpstr (g_ptr_array_index (results, 0), ==, "http://www.example.org/test#2");
+	g_assert_cmpstr (g_ptr_array_index (results, 1), ==, "http://www.example.org/test#1");
+	g_assert_cmpstr (g_ptr_array_index (results, 2), ==, "http://www.example.org/test#3");
+	g_assert_cmpstr (g_ptr_array_index (results, 3), ==, "http://www.example.org/test#5");
+	g_ptr_array_unref (results);
+
+	/* A hit on a rare phrase outweighs the length of the text */
+	results = query_ranked (manager, "apple OR kiwi", 10);
+	g_assert_cmpint (results->len, ==, 4);
+	g_assert_cmpstr (g_ptr_array_index (results, 0), ==, "http://www.example.org/test#3");
+	g_ptr_array_unref (results);
+
+	g_object_unref (manager);
+}
+
+static gchar *
+get_rank_function (TrackerDataManager *manager)
+{
+	TrackerDBInterface *iface;
+	TrackerDBStatement *stmt;
+	TrackerDBCursor *cursor;
+	GError *error = NULL;
+	gchar *rank_function = NULL;
+
+	iface = tracker_data_manager_get_writable_db_interface (manager);
+	stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_NONE,
+	                                              &error,
+	                                              "SELECT v FROM fts5_config WHERE k = 'rank'");
+	g_assert_no_error (error);
+
+	cursor = tracker_db_statement_start_cursor (stmt, &error);
+	g_assert_no_error (error);
+
+	if (tracker_db_cursor_iter_next (cursor, NULL, &error))
+		rank_function = g_strdup (tracker_db_cursor_get_string (cursor, 0, NULL));
+
+	g_assert_no_error (error);
+	g_object_unref (cursor);
+	g_object_unref (stmt);
+
+	return rank_function;
+}
+
+static void
+set_rank_function (TrackerDataManager *manager,
+                   const gchar        *rank_function)
+{
+	GError *error = NULL;
+
+	tracker_db_interface_execute_query (tracker_data_manager_get_writable_db_interface (manager),
+	                                    &error,
+	                                    "INSERT INTO fts5(fts5, rank) VALUES('rank', '%s')",
+	                                    rank_function);
+	g_assert_no_error (error);
+}
+
+static void
+assert_rank_function (TrackerDataManager *manager,
+                      const gchar        *expected)
+{
+	gchar *rank_function;
+
+	rank_function = get_rank_function (manager);
+	g_assert_cmpstr (rank_function, ==, expected);
+	g_free (rank_function);
+}
+
+static void
+test_rank_select (void)
+{
+	TrackerDataManager *manager;
+
+	/* A ranker selected on a current table is kept when opened again */
+	manager = tracker_fts_test_create_manager (datadir, TRACKER_DB_MANAGER_FORCE_REINDEX);
+	assert_rank_function (manager, "tracker_bm25()");
+	set_rank_function (manager, "tracker_rank()");
+	g_object_unref (manager);
+
+	manager = tracker_fts_test_create_manager (datadir, 0);
+	assert_rank_function (manager, "tracker_rank()");
+	g_object_unref (manager);
+}
+
+static void
+test_rank_upgrade (void)
+{
+	TrackerDataManager *manager;
+	GError *error = NULL;
+
+	/* Tables created before fts_metadata rank with tracker_rank() */
+	manager = tracker_fts_test_create_manager (datadir, TRACKER_DB_MANAGER_FORCE_REINDEX);
+	set_rank_function (manager, "tracker_rank()");
+	tracker_db_interface_execute_query (tracker_data_manager_get_writable_db_interface (manager),
+	                                    &error,
+	                                    "DROP TABLE fts_metadata");
+	g_assert_no_error (error);
+	g_object_unref (manager);
+
+	/* And are switched over when opened again */
+	manager = tracker_fts_test_create_manager (datadir, 0);
+	assert_rank_function (manager, "tracker_bm25()");
+	set_rank_function (manager, "tracker_rank()");
+	g_object_unref (manager);
+
+	/* But only once */
+	manager = tracker_fts_test_create_manager (datadir, 0);
+	assert_rank_function (manager, "tracker_rank()");
+	g_object_unref (manager);
+}
+
+static void
+time_ranked_queries (TrackerDataManager *manager,
+                     const gchar        *rank_function)
+{
+	TrackerDBInterface *iface;
+	GError *error = NULL;
+	GPtrArray *results;
+	gdouble elapsed;
+	gint i;
+
+	iface = tracker_data_manager_get_writable_db_interface (manager);
+	tracker_db_interface_execute_query (iface, &error,
+	                                    "INSERT INTO fts5(fts5, rank) VALUES('rank', '%s')",
+	                                    rank_function);
+	g_assert_no_error (error);
+
+	g_test_timer_start ();
+
+	for (i = 0; i < N_PERF_QUERIES; i++) {
+		results = query_ranked (manager, tracker_fts_test_get_word (i), 20);
+		g_assert_cmpint (results->len, ==, 20);
+		g_ptr_array_unref (results);
+	}
+
+	elapsed = g_test_timer_elapsed ();
+	g_test_minimized_result (elapsed, "%s: %d ranked queries over %d resources in %.3f s",
+	                         rank_function, N_PERF_QUERIES, N_PERF_RESOURCES, elapsed);
+}
+
+static void
+test_rank_perf (void)
+{
+	TrackerDataManager *manager;
+
+	manager = tracker_fts_test_create_manager (datadir, TRACKER_DB_MANAGER_FORCE_REINDEX);
+	tracker_fts_test_insert_random (tracker_data_manager_get_data (manager),
+	                                N_PERF_RESOURCES, N_PERF_RESOURCES);
+
+	time_ranked_queries (manager, "tracker_rank()");
+	time_ranked_queries (manager, "tracker_bm25()");
+
+	g_object_unref (manager);
+}
+
+int
+main (int argc, char **argv)
+{
+	gchar *current_dir;
+	gint result;
+
+	g_test_init (&argc, &argv, NULL);
+
+	current_dir = g_get_current_dir ();
+	datadir = g_build_filename (current_dir, "tracker-rank", NULL);
+	g_free (current_dir);
+
+	g_test_add_func ("/libtracker-fts/rank/bm25", test_rank_bm25);
+	g_test_add_func ("/libtracker-fts/rank/select", test_rank_select);
+	g_test_add_func ("/libtracker-fts/rank/upgrade", test_rank_upgrade);
+
+	if (g_test_perf ()) {
+		g_test_add_func ("/libtracker-fts/rank/perf", test_rank_perf);
+	}
+
+	result = g_test_run ();
+
+	tracker_fts_test_remove_datadir (datadir);
+	g_free (datadir);
+
+	return result;
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2018, Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+
+#include "tracker-fts-test-utils.h"
+
+static const gchar *words[] = {
+	"alpha", "bravo", "charlie", "delta", "echo", "foxtrot",
+	"golf", "hotel", "india", "juliet", "kilo", "lima",
+	"mike", "november", "oscar", "papa", "quebec", "romeo",
+	"sierra", "tango", "uniform", "victor", "whiskey", "xray",
+	NULL
+};
+
+/* Opens a data manager on @datadir with the test ontology */
+TrackerDataManager *
+tracker_fts_test_create_manager (const gchar           *datadir,
+                                 TrackerDBManagerFlags  flags)
+{
+	TrackerDataManager *manager;
+	GFile *ontology, *data_location;
+	GError *error = NULL;
+	gchar *prefix;
+
+	prefix = g_build_path (G_DIR_SEPARATOR_S, TOP_SRCDIR, "tests", "libtracker-fts", NULL);
+	ontology = g_file_new_for_path (prefix);
+	g_free (prefix);
+
+	data_location = g_file_new_for_path (datadir);
+
+	tracker_db_journal_set_rotating (FALSE, G_MAXSIZE, NULL);
+	manager = tracker_data_manager_new (flags,
+	                                    data_location, data_location, ontology,
+	                                    FALSE, FALSE, 100, 100);
+	g_initable_init (G_INITABLE (manager), NULL, &error);
+	g_assert_no_error (error);
+
+	g_object_unref (ontology);
+	g_object_unref (data_location);
+
+	return manager;
+}
+
+/* Inserts @n_resources test:A resources, test:0 onwards, with 4 to 64
+ * words each, in updates of @batch_size resources. The words are the
+ * same on every run.
+ */
+void
+tracker_fts_test_insert_random (TrackerData *data,
+                                gint         n_resources,
+                                gint         batch_size)
+{
+	GError *error = NULL;
+	GString *query;
+	GRand *rand;
+	gint i, j;
+
+	rand = g_rand_new_with_seed (42);
+	query = g_string_new (NULL);
+
+	for (i = 0; i < n_resources; i++) {
+		gint n_words = g_rand_int_range (rand, 4, 64);
+
+		if (i % batch_size == 0)
+			g_string_assign (query, "INSERT {");
+
+		g_string_append_printf (query, " test:%d a test:A ; test:p \"", i);
+
+		for (j = 0; j < n_words; j++) {
+			gint word = g_rand_int_range (rand, 0, G_N_ELEMENTS (words) - 1);
+
+			g_string_append_printf (query, "%s ", words[word]);
+		}
+
+		g_string_append (query, "\" .");
+
+		if (i % batch_size == batch_size - 1 || i == n_resources - 1) {
+			g_string_append (query, " }");
+			tracker_data_update_sparql (data, query->str, &error);
+			g_assert_no_error (error);
+		}
+	}
+
+	g_string_free (query, TRUE);
+	g_rand_free (rand);
+}
+
+/* Returns one of the words inserted by tracker_fts_test_insert_random(),
+ * cycling through all of them as @i grows.
+ */
+const gchar *
+tracker_fts_test_get_word (gint i)
+{
+	return words[i % (G_N_ELEMENTS (words) - 1)];
+}
+
+void
+tracker_fts_test_remove_datadir (const gchar *datadir)
+{
+	gchar *quoted, *command;
+
+	g_print ("Removing temporary data\n");
+	quoted = g_shell_quote (datadir);
+	command = g_strdup_printf ("rm -R %s", quoted);
+	g_spawn_command_line_sync (command, NULL, NULL, NULL, NULL);
+	g_free (command);
+	g_free (quoted);
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2018, Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __TRACKER_FTS_TEST_UTILS_H__
+#define __TRACKER_FTS_TEST_UTILS_H__
+
+#include <glib.h>
+
+#include <libtracker-data/tracker-data.h>
+
+G_BEGIN_DECLS
+
+TrackerDataManager *tracker_fts_test_create_manager  (const gchar           *datadir,
+                                                      TrackerDBManagerFlags  flags);
+void                tracker_fts_test_insert_random   (TrackerData           *data,
+                                                      gint                   n_resources,
+                                                      gint                   batch_size);
+const gchar *       tracker_fts_test_get_word        (gint                   i);
+void                tracker_fts_test_remove_datadir  (const gchar           *datadir);
+
+G_END_DECLS
+
+#endif /* __TRACKER_FTS_TEST_UTILS_H__ */
@@ -28,6 +28,8 @@
 #include <libtracker-data/tracker-data.h>
 #include <libtracker-sparql/tracker-sparql.h>
 
+#include "tracker-fts-test-utils.h"
+
 typedef struct _TestInfo TestInfo;
 
 struct _TestInfo {
@@ -36,7 +38,7 @@ struct _TestInfo {
 };
 
 const TestInfo tests[] = {
-	{ "fts3aa", 2 },
+	{ "fts3aa", 3 },
 	{ "fts3ae", 1 },
 	{ "prefix/fts3prefix", 3 },
 	{ "limits/fts3limits", 4 },
@@ -174,6 +176,77 @@ test_sparql_query (gconstpointer test_data)
 	g_object_unref (manager);
 }
 
+/* Ranked, limited fts:match queries should be driven by the fts5
+ * table, which returns rows by rank, so SQLite stops after LIMIT rows
+ * instead of sorting every match.
+ */
+static void
+test_ranked_query_plan (void)
+{
+	TrackerDataManager *manager;
+	TrackerSparqlQuery *sparql_query;
+	TrackerDBInterface *iface;
+	TrackerDBStatement *stmt;
+	TrackerDBCursor *cursor;
+	GError *error = NULL;
+	gchar *prefix, *filename, *update, *query, *sql;
+	gboolean first_loop = TRUE;
+
+	manager = tracker_fts_test_create_manager (datadir, TRACKER_DB_MANAGER_FORCE_REINDEX);
+	prefix = g_build_path (G_DIR_SEPARATOR_S, TOP_SRCDIR, "tests", "libtracker-fts", NULL);
+
+	filename = g_build_filename (prefix, "fts3aa-data.rq", NULL);
+	g_file_get_contents (filename, &update, NULL, &error);
+	g_assert_no_error (error);
+	g_free (filename);
+
+	tracker_data_update_sparql (tracker_data_manager_get_data (manager), update, &error);
+	g_assert_no_error (error);
+	g_free (update);
+
+	filename = g_build_filename (prefix, "fts3aa-3.rq", NULL);
+	g_file_get_contents (filename, &query, NULL, &error);
+	g_assert_no_error (error);
+	g_free (filename);
+	g_free (prefix);
+
+	sparql_query = tracker_sparql_query_new (manager, query);
+	sql = tracker_sparql_query_get_sql (sparql_query, &error);
+	g_assert_no_error (error);
+
+	iface = tracker_data_manager_get_db_interface (manager);
+	stmt = tracker_db_interface_create_statement (iface, TRACKER_DB_STATEMENT_CACHE_TYPE_NONE,
+	                                              &error, "EXPLAIN QUERY PLAN %s", sql);
+	g_assert_no_error (error);
+
+	cursor = tracker_db_statement_start_cursor (stmt, &error);
+	g_assert_no_error (error);
+
+	while (tracker_db_cursor_iter_next (cursor, NULL, &error)) {
+		const gchar *detail;
+
+		detail = tracker_db_cursor_get_string (cursor, 3, NULL);
+		g_assert (strstr (detail, "TEMP B-TREE FOR ORDER BY") == NULL);
+
+		/* The outermost loop comes first */
+		if (first_loop &&
+		    (g_str_has_prefix (detail, "SCAN") || g_str_has_prefix (detail, "SEARCH"))) {
+			g_assert (strstr (detail, "fts5") != NULL);
+			first_loop = FALSE;
+		}
+	}
+
+	g_assert_no_error (error);
+	g_assert (!first_loop);
+
+	g_object_unref (cursor);
+	g_object_unref (stmt);
+	g_object_unref (sparql_query);
+	g_free (sql);
+	g_free (query);
+	g_object_unref (manager);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -198,6 +271,8 @@ main (int argc, char **argv)
 		g_free (testpath);
 	}
 
+	g_test_add_func ("/libtracker-fts/fts3aa/ranked-query-plan", test_ranked_query_plan);
+
 	/* run tests */
 	result = g_test_run ();
 
@@ -321,6 +321,57 @@ test_crawler_crawl_n_signals_non_recursive (void)
 	g_object_unref (file);
 }
 
+static void
+crawl_with_workers (CrawlerTest *test,
+                    guint        n_workers)
+{
+	TrackerCrawler *crawler;
+	GFile *file;
+
+	test->main_loop = g_main_loop_new (NULL, FALSE);
+
+	crawler = tracker_crawler_new (NULL);
+	tracker_crawler_set_n_workers (crawler, n_workers);
+	g_signal_connect (crawler, "finished",
+			  G_CALLBACK (crawler_finished_cb), test);
+	g_signal_connect (crawler, "directory-crawled",
+			  G_CALLBACK (crawler_directory_crawled_cb), test);
+	g_signal_connect (crawler, "check-directory",
+			  G_CALLBACK (crawler_check_directory_cb), test);
+	g_signal_connect (crawler, "check-directory-contents",
+			  G_CALLBACK (crawler_check_directory_contents_cb), test);
+	g_signal_connect (crawler, "check-file",
+			  G_CALLBACK (crawler_check_file_cb), test);
+
+	file = g_file_new_for_path (TEST_DATA_DIR);
+
+	tracker_crawler_start (crawler, file, TRACKER_DIRECTORY_FLAG_NONE, -1);
+
+	g_main_loop_run (test->main_loop);
+
+	g_main_loop_unref (test->main_loop);
+	g_object_unref (crawler);
+	g_object_unref (file);
+}
+
+static void
+test_crawler_crawl_parallel (void)
+{
+	CrawlerTest serial = { 0 };
+	CrawlerTest parallel = { 0 };
+
+	crawl_with_workers (&serial, 0);
+	crawl_with_workers (&parallel, 4);
+
+	g_assert_cmpint (parallel.directories_found, ==, parallel.n_check_directory);
+	g_assert_cmpint (parallel.directories_found, ==, parallel.n_check_directory_contents);
+	g_assert_cmpint (parallel.files_found, ==, parallel.n_check_file);
+
+	g_assert_cmpint (parallel.directories_found, ==, serial.directories_found);
+	g_assert_cmpint (parallel.files_found, ==, serial.files_found);
+	g_assert_cmpint (parallel.interrupted, ==, 0);
+}
+
 int
 main (int    argc,
       char **argv)
@@ -346,5 +397,8 @@ main (int    argc,
 	g_test_add_func ("/libtracker-miner/tracker-crawler/crawl-n-signals-non-recursive",
 	                 test_crawler_crawl_n_signals_non_recursive);
 
+	g_test_add_func ("/libtracker-miner/tracker-crawler/crawl-parallel",
+	                 test_crawler_crawl_parallel);
+
 	return g_test_run ();
 }
@@ -258,6 +258,24 @@ test_common_context_remove_dir (TestCommonContext     *fixture,
 	g_object_unref (file);
 }
 
+static void
+test_common_context_create_notifier (TestCommonContext *fixture)
+{
+	fixture->notifier = tracker_file_notifier_new (fixture->indexing_tree, FALSE,
+						       fixture->connection);
+
+	g_signal_connect (fixture->notifier, "file-created",
+	                  G_CALLBACK (file_notifier_file_created_cb), fixture);
+	g_signal_connect (fixture->notifier, "file-updated",
+	                  G_CALLBACK (file_notifier_file_updated_cb), fixture);
+	g_signal_connect (fixture->notifier, "file-deleted",
+	                  G_CALLBACK (file_notifier_file_deleted_cb), fixture);
+	g_signal_connect (fixture->notifier, "file-moved",
+	                  G_CALLBACK (file_notifier_file_moved_cb), fixture);
+	g_signal_connect (fixture->notifier, "finished",
+	                  G_CALLBACK (file_notifier_finished_cb), fixture);
+}
+
 static void
 test_common_context_setup (TestCommonContext *fixture,
                            gconstpointer      data)
@@ -287,19 +305,7 @@ test_common_context_setup (TestCommonContext *fixture,
 	tracker_indexing_tree_set_filter_hidden (fixture->indexing_tree, TRUE);
 
 	fixture->main_loop = g_main_loop_new (NULL, FALSE);
-	fixture->notifier = tracker_file_notifier_new (fixture->indexing_tree, FALSE,
-						       fixture->connection);
-
-	g_signal_connect (fixture->notifier, "file-created",
-	                  G_CALLBACK (file_notifier_file_created_cb), fixture);
-	g_signal_connect (fixture->notifier, "file-updated",
-	                  G_CALLBACK (file_notifier_file_updated_cb), fixture);
-	g_signal_connect (fixture->notifier, "file-deleted",
-	                  G_CALLBACK (file_notifier_file_deleted_cb), fixture);
-	g_signal_connect (fixture->notifier, "file-moved",
-	                  G_CALLBACK (file_notifier_file_moved_cb), fixture);
-	g_signal_connect (fixture->notifier, "finished",
-	                  G_CALLBACK (file_notifier_finished_cb), fixture);
+	test_common_context_create_notifier (fixture);
 }
 
 static void
@@ -754,6 +760,212 @@ test_file_notifier_monitor_updates_recursive (TestCommonContext *fixture,
 	tracker_file_notifier_stop (fixture->notifier);
 }
 
+static void
+file_notifier_file_iri_resolved_cb (TrackerFileNotifier *notifier,
+                                    GFile               *file,
+                                    gpointer             user_data)
+{
+	guint *n_resolved = user_data;
+
+	(*n_resolved)++;
+}
+
+static void
+test_file_notifier_prefetch_iris (TestCommonContext *fixture,
+                                  gconstpointer      data)
+{
+	GFile *files[3];
+	GError *error = NULL;
+	guint n_resolved = 0, i;
+	gchar *uri, *sparql;
+
+	for (i = 0; i < G_N_ELEMENTS (files); i++) {
+		gchar *path;
+
+		path = g_strdup_printf ("%s/recursive/file%d",
+		                        fixture->test_path, i);
+		files[i] = g_file_new_for_path (path);
+		g_free (path);
+	}
+
+	/* Only the first two files are in the store */
+	for (i = 0; i < 2; i++) {
+		uri = g_file_get_uri (files[i]);
+		sparql = g_strdup_printf ("INSERT { <urn:test:file%d> a nfo:FileDataObject ;"
+		                          " nie:url \"%s\" }", i, uri);
+		tracker_sparql_connection_update (fixture->connection, sparql,
+		                                  G_PRIORITY_DEFAULT, NULL, &error);
+		g_assert_no_error (error);
+		g_free (sparql);
+		g_free (uri);
+	}
+
+	g_signal_connect (fixture->notifier, "file-iri-resolved",
+	                  G_CALLBACK (file_notifier_file_iri_resolved_cb),
+	                  &n_resolved);
+
+	for (i = 0; i < G_N_ELEMENTS (files); i++) {
+		g_assert (!tracker_file_notifier_prefetch_file_iri (fixture->notifier,
+		                                                    files[i], TRUE));
+	}
+
+	/* Lookups are pending, not started again */
+	g_assert (!tracker_file_notifier_prefetch_file_iri (fixture->notifier,
+	                                                    files[0], TRUE));
+
+	while (n_resolved < G_N_ELEMENTS (files)) {
+		g_main_context_iteration (NULL, TRUE);
+	}
+
+	g_assert_cmpuint (n_resolved, ==, G_N_ELEMENTS (files));
+
+	for (i = 0; i < G_N_ELEMENTS (files); i++) {
+		g_assert (tracker_file_notifier_prefetch_file_iri (fixture->notifier,
+		                                                   files[i], TRUE));
+	}
+
+	g_assert_cmpstr (tracker_file_notifier_get_file_iri (fixture->notifier,
+	                                                     files[0], TRUE),
+	                 ==, "urn:test:file0");
+	g_assert_cmpstr (tracker_file_notifier_get_file_iri (fixture->notifier,
+	                                                     files[1], TRUE),
+	                 ==, "urn:test:file1");
+	g_assert (tracker_file_notifier_get_file_iri (fixture->notifier,
+	                                              files[2], TRUE) == NULL);
+
+	for (i = 0; i < G_N_ELEMENTS (files); i++) {
+		g_object_unref (files[i]);
+	}
+}
+
+static void
+insert_in_store (TestCommonContext *fixture,
+                 const gchar       *filename,
+                 gboolean           is_folder)
+{
+	GFileInfo *info;
+	GDateTime *mtime;
+	GError *error = NULL;
+	gchar *path, *uri, *date, *sparql;
+	GFile *file;
+
+	path = g_build_filename (fixture->test_path, filename, NULL);
+	file = g_file_new_for_path (path);
+	info = g_file_query_info (file, G_FILE_ATTRIBUTE_TIME_MODIFIED,
+	                          G_FILE_QUERY_INFO_NONE, NULL, &error);
+	g_assert_no_error (error);
+
+	mtime = g_date_time_new_from_unix_utc (g_file_info_get_attribute_uint64 (info,
+	                                                                         G_FILE_ATTRIBUTE_TIME_MODIFIED));
+	date = g_date_time_format (mtime, "%Y-%m-%dT%H:%M:%SZ");
+	uri = g_file_get_uri (file);
+
+	sparql = g_strdup_printf ("INSERT { _:f a nfo:FileDataObject %s ;"
+	                          " nie:url \"%s\" ; nfo:fileLastModified \"%s\" }",
+	                          is_folder ? ", nfo:Folder" : "", uri, date);
+	tracker_sparql_connection_update (fixture->connection, sparql,
+	                                  G_PRIORITY_DEFAULT, NULL, &error);
+	g_assert_no_error (error);
+
+	g_free (sparql);
+	g_free (uri);
+	g_free (date);
+	g_date_time_unref (mtime);
+	g_object_unref (info);
+	g_object_unref (file);
+	g_free (path);
+}
+
+static void
+delete_from_store (TestCommonContext *fixture,
+                   const gchar       *filename)
+{
+	GError *error = NULL;
+	gchar *path, *uri, *sparql;
+	GFile *file;
+
+	path = g_build_filename (fixture->test_path, filename, NULL);
+	file = g_file_new_for_path (path);
+	uri = g_file_get_uri (file);
+
+	sparql = g_strdup_printf ("DELETE { ?f a rdfs:Resource } "
+	                          "WHERE { ?f nie:url \"%s\" }", uri);
+	tracker_sparql_connection_update (fixture->connection, sparql,
+	                                  G_PRIORITY_DEFAULT, NULL, &error);
+	g_assert_no_error (error);
+
+	g_free (sparql);
+	g_free (uri);
+	g_object_unref (file);
+	g_free (path);
+}
+
+#define SET_OLD_MTIME(fixture,p) perform_file_operation((fixture),"touch -d 2000-01-01",(p),NULL)
+
+static void
+test_file_notifier_crawl_state (TestCommonContext *fixture,
+                                gconstpointer      data)
+{
+	FilesystemOperation expected_results[] = {
+		{ OPERATION_CREATE, "recursive/folder/bbb", NULL },
+	};
+	GFile *state_file;
+
+	CREATE_FOLDER (fixture, "recursive/folder");
+	CREATE_FOLDER (fixture, "recursive/other");
+	CREATE_UPDATE_FILE (fixture, "recursive/folder/aaa");
+	CREATE_UPDATE_FILE (fixture, "recursive/other/ccc");
+	SET_OLD_MTIME (fixture, "recursive/folder");
+	SET_OLD_MTIME (fixture, "recursive/other");
+	SET_OLD_MTIME (fixture, "recursive");
+
+	/* Store is in sync with the filesystem */
+	insert_in_store (fixture, "recursive", TRUE);
+	insert_in_store (fixture, "recursive/folder", TRUE);
+	insert_in_store (fixture, "recursive/other", TRUE);
+	insert_in_store (fixture, "recursive/folder/aaa", FALSE);
+	insert_in_store (fixture, "recursive/other/ccc", FALSE);
+
+	state_file = g_file_get_child (fixture->test_file, "crawl-state");
+	tracker_file_notifier_set_crawl_state_file (fixture->notifier, state_file);
+
+	test_common_context_index_dir (fixture, "recursive",
+	                               TRACKER_DIRECTORY_FLAG_RECURSE |
+	                               TRACKER_DIRECTORY_FLAG_CHECK_MTIME);
+
+	/* Nothing to notify, wait for crawling to finish */
+	fixture->expect_finished = TRUE;
+	tracker_file_notifier_start (fixture->notifier);
+	g_main_loop_run (fixture->main_loop);
+	test_common_context_expect_results (fixture, NULL, 0, 0, TRUE);
+	tracker_file_notifier_stop (fixture->notifier);
+
+	/* State is written on finalization, and consumed when loaded */
+	g_object_unref (fixture->notifier);
+	g_assert (g_file_query_exists (state_file, NULL));
+
+	test_common_context_create_notifier (fixture);
+	tracker_file_notifier_set_crawl_state_file (fixture->notifier, state_file);
+	g_assert (!g_file_query_exists (state_file, NULL));
+
+	/* Unchanged directories are not checked against the store
+	 * again, so this goes unnoticed.
+	 */
+	delete_from_store (fixture, "recursive/other/ccc");
+
+	/* But modified ones are */
+	CREATE_UPDATE_FILE (fixture, "recursive/folder/bbb");
+	SET_OLD_MTIME (fixture, "recursive/folder");
+
+	tracker_file_notifier_start (fixture->notifier);
+	test_common_context_expect_results (fixture, expected_results,
+	                                    G_N_ELEMENTS (expected_results),
+	                                    2, TRUE);
+	tracker_file_notifier_stop (fixture->notifier);
+
+	g_object_unref (state_file);
+}
+
 gint
 main (gint    argc,
       gchar **argv)
@@ -790,5 +1002,13 @@ main (gint    argc,
 	test_add ("/libtracker-miner/file-notifier/monitor-updates-recursive",
 		  test_file_notifier_monitor_updates_recursive);
 
+	/* IRI lookups */
+	test_add ("/libtracker-miner/file-notifier/prefetch-iris",
+		  test_file_notifier_prefetch_iris);
+
+	/* Crawl state */
+	test_add ("/libtracker-miner/file-notifier/crawl-state",
+		  test_file_notifier_crawl_state);
+
 	return g_test_run ();
 }
@@ -231,6 +231,77 @@ test_file_system_properties (TestCommonContext *fixture,
 	g_assert (ret_value == NULL);
 }
 
+static gdouble
+time_lookups (TrackerFileSystem *file_system,
+              GFile             *dir,
+              guint              width)
+{
+	GFile **files;
+	GTimer *timer;
+	gdouble elapsed;
+	guint i;
+
+	files = g_new0 (GFile *, width);
+
+	for (i = 0; i < width; i++) {
+		gchar *name;
+		GFile *file;
+
+		name = g_strdup_printf ("child-%u", i);
+		file = g_file_get_child (dir, name);
+		files[i] = tracker_file_system_get_file (file_system, file,
+		                                         G_FILE_TYPE_REGULAR,
+		                                         dir);
+		g_object_unref (file);
+		g_free (name);
+	}
+
+	/* Look up copies, so the canonical file shortcut isn't taken */
+	timer = g_timer_new ();
+
+	for (i = 0; i < width; i++) {
+		GFile *file, *canonical;
+
+		file = g_file_dup (files[i]);
+		canonical = tracker_file_system_peek_file (file_system, file);
+		g_assert (canonical == files[i]);
+		g_object_unref (file);
+	}
+
+	elapsed = g_timer_elapsed (timer, NULL);
+	g_timer_destroy (timer);
+	g_free (files);
+
+	return elapsed / width;
+}
+
+static void
+test_file_system_lookup_width (TestCommonContext *fixture,
+                               gconstpointer      data)
+{
+	guint width;
+
+	for (width = 100; width <= 100000; width *= 10) {
+		GFile *file, *dir;
+		gchar *uri;
+		gdouble cost;
+
+		uri = g_strdup_printf ("file:///width-%u", width);
+		file = g_file_new_for_uri (uri);
+		dir = tracker_file_system_get_file (fixture->file_system, file,
+		                                    G_FILE_TYPE_DIRECTORY, NULL);
+		g_object_unref (file);
+		g_free (uri);
+
+		cost = time_lookups (fixture->file_system, dir, width);
+		g_test_message ("%6u children: %.3f us per lookup",
+		                width, cost * G_USEC_PER_SEC);
+
+		tracker_file_system_forget_files (fixture->file_system, dir,
+		                                  G_FILE_TYPE_REGULAR);
+	}
+}
+
 gint
 main (gint    argc,
       gchar **argv)
@@ -249,6 +320,8 @@ main (gint    argc,
 		  test_file_system_reparenting);
 	test_add ("/libtracker-miner/file-system/file-properties",
 	          test_file_system_properties);
+	test_add ("/libtracker-miner/file-system/lookup-width",
+	          test_file_system_lookup_width);
 
 	return g_test_run ();
 }
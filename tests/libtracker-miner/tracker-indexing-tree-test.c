@@ -67,6 +67,14 @@ typedef struct {
 	                                                   fixture->test_dir[id], \
 	                                                   G_FILE_TYPE_DIRECTORY) == FALSE)
 
+#define ASSERT_MATCHES(fixture, path, result) G_STMT_START { \
+	GFile *file = g_file_new_for_path (path); \
+	g_assert (tracker_indexing_tree_file_matches_filter (fixture->tree, \
+	                                                     TRACKER_FILTER_FILE, \
+	                                                     file) == result); \
+	g_object_unref (file); \
+} G_STMT_END
+
 #define test_add(path,fun)	  \
 	g_test_add (path, \
 	            TestCommonContext, \
@@ -943,6 +951,53 @@ test_indexing_tree_030 (TestCommonContext *fixture,
 	ASSERT_INDEXABLE (fixture, TEST_DIRECTORY_ABA);
 }
 
+/* File filters of each kind match the same basenames
+ * GPatternSpec would, and clearing them takes effect.
+ */
+static void
+test_indexing_tree_031 (TestCommonContext *fixture,
+                        gconstpointer      data)
+{
+	tracker_indexing_tree_add_filter (fixture->tree, TRACKER_FILTER_FILE, "core");
+	tracker_indexing_tree_add_filter (fixture->tree, TRACKER_FILTER_FILE, "*.o");
+	tracker_indexing_tree_add_filter (fixture->tree, TRACKER_FILTER_FILE, "*~");
+	tracker_indexing_tree_add_filter (fixture->tree, TRACKER_FILTER_FILE, "#*");
+	tracker_indexing_tree_add_filter (fixture->tree, TRACKER_FILTER_FILE, "*.sw?");
+	tracker_indexing_tree_add_filter (fixture->tree, TRACKER_FILTER_FILE, "*cache*");
+	tracker_indexing_tree_add_filter (fixture->tree, TRACKER_FILTER_FILE, "a*z");
+	tracker_indexing_tree_add_filter (fixture->tree, TRACKER_FILTER_FILE, "/A/B");
+	tracker_indexing_tree_add_filter (fixture->tree, TRACKER_FILTER_DIRECTORY, "*");
+
+	ASSERT_MATCHES (fixture, "/A/core", TRUE);
+	ASSERT_MATCHES (fixture, "/A/cores", FALSE);
+	ASSERT_MATCHES (fixture, "/A/main.o", TRUE);
+	ASSERT_MATCHES (fixture, "/A/main.ob", FALSE);
+	ASSERT_MATCHES (fixture, "/A/.o", TRUE);
+	ASSERT_MATCHES (fixture, "/A/notes~", TRUE);
+	ASSERT_MATCHES (fixture, "/A/#notes#", TRUE);
+	ASSERT_MATCHES (fixture, "/A/notes#", FALSE);
+	ASSERT_MATCHES (fixture, "/A/.notes.swp", TRUE);
+	ASSERT_MATCHES (fixture, "/A/.notes.sw", FALSE);
+	ASSERT_MATCHES (fixture, "/A/thumbnail-cache.db", TRUE);
+	ASSERT_MATCHES (fixture, "/A/az", TRUE);
+	ASSERT_MATCHES (fixture, "/A/abcz", TRUE);
+	ASSERT_MATCHES (fixture, "/A/za", FALSE);
+	ASSERT_MATCHES (fixture, "/A/B", TRUE);
+	ASSERT_MATCHES (fixture, "/A/B/A", TRUE);
+	ASSERT_MATCHES (fixture, "/A/A", FALSE);
+
+	tracker_indexing_tree_clear_filters (fixture->tree, TRACKER_FILTER_FILE);
+
+	ASSERT_MATCHES (fixture, "/A/core", FALSE);
+	ASSERT_MATCHES (fixture, "/A/main.o", FALSE);
+	ASSERT_MATCHES (fixture, "/A/B", FALSE);
+
+	tracker_indexing_tree_add_filter (fixture->tree, TRACKER_FILTER_FILE, "*.o");
+
+	ASSERT_MATCHES (fixture, "/A/core", FALSE);
+	ASSERT_MATCHES (fixture, "/A/main.o", TRUE);
+}
+
 gint
 main (gint    argc,
       gchar **argv)
@@ -981,6 +1036,7 @@ main (gint    argc,
 	test_add ("/libtracker-miner/indexing-tree/028", test_indexing_tree_028);
 	test_add ("/libtracker-miner/indexing-tree/029", test_indexing_tree_029);
 	test_add ("/libtracker-miner/indexing-tree/030", test_indexing_tree_030);
+	test_add ("/libtracker-miner/indexing-tree/031", test_indexing_tree_031);
 
 	return g_test_run ();
 }
@@ -19,6 +19,7 @@
 
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
 
 #include <glib.h>
 #include <glib/gstdio.h>
@@ -482,6 +483,61 @@ test_monitor_file_event_updated (TrackerMonitorTestFixture *fixture,
 	g_object_unref (test_file);
 }
 
+static void
+test_monitor_file_event_updated_merged (TrackerMonitorTestFixture *fixture,
+                                        gconstpointer              data)
+{
+	GFile *test_file;
+	guint file_events;
+	guint64 received, emitted, merged;
+	gint i;
+
+	/* Create file to test with, before setting up environment */
+	set_file_contents (fixture->monitored_directory, "created.txt", "foo", NULL);
+
+	/* Set up environment */
+	tracker_monitor_set_event_window (fixture->monitor, 500);
+	g_assert_cmpuint (tracker_monitor_get_event_window (fixture->monitor), ==, 500);
+	tracker_monitor_set_enabled (fixture->monitor, TRUE);
+
+	/* Now, update the already created file several times in a row */
+	for (i = 0; i < 10; i++) {
+		set_file_contents (fixture->monitored_directory, "created.txt", "barrrr", NULL);
+	}
+
+	set_file_contents (fixture->monitored_directory, "created.txt", "barrrr", &test_file);
+	g_hash_table_insert (fixture->events,
+	                     g_object_ref (test_file),
+	                     GUINT_TO_POINTER (MONITOR_SIGNAL_NONE));
+
+	/* Wait for events */
+	events_wait (fixture);
+
+	/* Get events in the file */
+	file_events = GPOINTER_TO_UINT (g_hash_table_lookup (fixture->events, test_file));
+
+	/* Fail if we didn't get the UPDATE signal */
+	g_assert_cmpuint ((file_events & MONITOR_SIGNAL_ITEM_UPDATED), >, 0);
+
+	/* Fail if we got a CREATE, MOVE or DELETE signal */
+	g_assert_cmpuint ((file_events & MONITOR_SIGNAL_ITEM_CREATED), ==, 0);
+	g_assert_cmpuint ((file_events & MONITOR_SIGNAL_ITEM_MOVED_FROM), ==, 0);
+	g_assert_cmpuint ((file_events & MONITOR_SIGNAL_ITEM_MOVED_TO), ==, 0);
+	g_assert_cmpuint ((file_events & MONITOR_SIGNAL_ITEM_DELETED), ==, 0);
+
+	/* All updates should have been merged into a few signals */
+	tracker_monitor_get_event_counts (fixture->monitor, &received, &emitted, &merged);
+	g_assert_cmpuint (merged, >, 0);
+	g_assert_cmpuint (emitted, <, received);
+
+	/* Cleanup environment */
+	tracker_monitor_set_enabled (fixture->monitor, FALSE);
+
+	/* Remove the test file */
+	g_assert_cmpint (g_file_delete (test_file, NULL, NULL), ==, TRUE);
+	g_object_unref (test_file);
+}
+
 static void
 test_monitor_file_event_attribute_updated (TrackerMonitorTestFixture *fixture,
                                            gconstpointer              data)
@@ -1792,6 +1848,135 @@ test_monitor_directory_event_moved_from_not_monitored (TrackerMonitorTestFixture
 	g_free (dest_path);
 }
 
+/* ----------------------------- FANOTIFY TESTS --------------------------------- */
+
+/* More than the default fanotify queue size (max_queued_events) */
+#define N_OVERFLOW_FILES 20000
+
+static void
+test_monitor_fanotify_not_monitored (TrackerMonitorTestFixture *fixture,
+                                     gconstpointer              data)
+{
+	GFile *test_file, *other_file;
+	gchar *other_filename;
+	guint file_events;
+
+	if (!tracker_monitor_uses_fanotify (fixture->monitor)) {
+		g_test_skip ("fanotify can't mark filesystems here");
+		return;
+	}
+
+	/* Directories don't take kernel watches of their own */
+	g_assert_cmpuint (tracker_monitor_get_limit (fixture->monitor), ==, G_MAXINT);
+
+	/* Set up environment */
+	tracker_monitor_set_enabled (fixture->monitor, TRUE);
+
+	/* The whole filesystem is marked, but only files in
+	 * monitored directories get signals.
+	 */
+	other_filename = g_strdup_printf ("monitor-test-other-%d.txt", getpid ());
+	set_file_contents (fixture->monitored_directory, "created.txt", "foo", &test_file);
+	set_file_contents (fixture->not_monitored_directory, other_filename, "foo", &other_file);
+	g_hash_table_insert (fixture->events,
+	                     g_object_ref (test_file),
+	                     GUINT_TO_POINTER (MONITOR_SIGNAL_NONE));
+	g_hash_table_insert (fixture->events,
+	                     g_object_ref (other_file),
+	                     GUINT_TO_POINTER (MONITOR_SIGNAL_NONE));
+
+	/* Wait for events */
+	events_wait (fixture);
+
+	file_events = GPOINTER_TO_UINT (g_hash_table_lookup (fixture->events, test_file));
+	g_assert_cmpuint ((file_events & MONITOR_SIGNAL_ITEM_CREATED), >, 0);
+
+	file_events = GPOINTER_TO_UINT (g_hash_table_lookup (fixture->events, other_file));
+	g_assert_cmpuint (file_events, ==, MONITOR_SIGNAL_NONE);
+
+	/* Cleanup environment */
+	tracker_monitor_set_enabled (fixture->monitor, FALSE);
+	g_assert_cmpint (g_file_delete (test_file, NULL, NULL), ==, TRUE);
+	g_assert_cmpint (g_file_delete (other_file, NULL, NULL), ==, TRUE);
+	g_object_unref (test_file);
+	g_object_unref (other_file);
+	g_free (other_filename);
+}
+
+static void
+test_monitor_fanotify_directory_updated_cb (TrackerIndexingTree *tree,
+                                            GFile               *directory,
+                                            gpointer             user_data)
+{
+	TrackerMonitorTestFixture *fixture = user_data;
+
+	if (g_file_equal (directory, fixture->monitored_directory_file)) {
+		g_main_loop_quit (fixture->main_loop);
+	}
+}
+
+static void
+test_monitor_fanotify_overflow (TrackerMonitorTestFixture *fixture,
+                                gconstpointer              data)
+{
+	TrackerIndexingTree *tree;
+	gboolean updated = FALSE;
+	guint timeout_id;
+	gint i;
+
+	if (!tracker_monitor_uses_fanotify (fixture->monitor)) {
+		g_test_skip ("fanotify can't mark filesystems here");
+		return;
+	}
+
+	/* Set up environment */
+	tree = tracker_indexing_tree_new ();
+	tracker_indexing_tree_add (tree, fixture->monitored_directory_file,
+	                           TRACKER_DIRECTORY_FLAG_MONITOR);
+	tracker_monitor_set_indexing_tree (fixture->monitor, tree);
+	tracker_monitor_set_enabled (fixture->monitor, TRUE);
+
+	g_signal_connect (tree, "directory-updated",
+	                  G_CALLBACK (test_monitor_fanotify_directory_updated_cb),
+	                  fixture);
+
+	/* Overflow the event queue, nothing is read meanwhile */
+	for (i = 0; i < N_OVERFLOW_FILES; i++) {
+		gchar *filename;
+		gint fd;
+
+		filename = g_strdup_printf ("%s/overflow-%d", fixture->monitored_directory, i);
+		fd = g_open (filename, O_CREAT | O_WRONLY, 0644);
+		g_assert_cmpint (fd, >=, 0);
+		close (fd);
+		g_free (filename);
+	}
+
+	/* The root must be crawled again */
+	timeout_id = g_timeout_add_seconds (TEST_TIMEOUT * 6, timeout_cb, fixture->main_loop);
+	g_main_loop_run (fixture->main_loop);
+
+	if (g_main_context_find_source_by_id (NULL, timeout_id)) {
+		g_source_remove (timeout_id);
+		updated = TRUE;
+	}
+
+	g_assert (updated);
+
+	/* Cleanup environment */
+	tracker_monitor_set_enabled (fixture->monitor, FALSE);
+	tracker_monitor_set_indexing_tree (fixture->monitor, NULL);
+	g_object_unref (tree);
+
+	for (i = 0; i < N_OVERFLOW_FILES; i++) {
+		gchar *filename;
+
+		filename = g_strdup_printf ("%s/overflow-%d", fixture->monitored_directory, i);
+		g_assert_cmpint (g_unlink (filename), ==, 0);
+		g_free (filename);
+	}
+}
+
 /* ----------------------------- BASIC API TESTS --------------------------------- */
 
 static void
@@ -1897,6 +2082,12 @@ main (gint    argc,
 	            test_monitor_common_setup,
 	            test_monitor_file_event_updated,
 	            test_monitor_common_teardown);
+	g_test_add ("/libtracker-miner/tracker-monitor/file-event/updated-merged",
+	            TrackerMonitorTestFixture,
+	            NULL,
+	            test_monitor_common_setup,
+	            test_monitor_file_event_updated_merged,
+	            test_monitor_common_teardown);
 	g_test_add ("/libtracker-miner/tracker-monitor/file-event/attribute-updated",
 	            TrackerMonitorTestFixture,
 	            NULL,
@@ -2016,5 +2207,19 @@ main (gint    argc,
 		    test_monitor_directory_event_moved_from_not_monitored,
 	            test_monitor_common_teardown);
 
+	/* fanotify backend tests, skipped if it's not in use */
+	g_test_add ("/libtracker-miner/tracker-monitor/fanotify/not-monitored",
+	            TrackerMonitorTestFixture,
+	            NULL,
+	            test_monitor_common_setup,
+	            test_monitor_fanotify_not_monitored,
+	            test_monitor_common_teardown);
+	g_test_add ("/libtracker-miner/tracker-monitor/fanotify/overflow",
+	            TrackerMonitorTestFixture,
+	            NULL,
+	            test_monitor_common_setup,
+	            test_monitor_fanotify_overflow,
+	            test_monitor_common_teardown);
+
 	return g_test_run ();
 }
@@ -224,6 +224,184 @@ test_priority_queue_branches (void)
         tracker_priority_queue_unref (queue);
 }
 
+static void
+test_priority_queue_file_index (void)
+{
+        TrackerPriorityQueue *queue;
+        GFile                *dir, *file, *other;
+        GList                *node;
+        gint                  priority;
+
+        queue = tracker_priority_queue_new_with_index (NULL);
+        dir = g_file_new_for_path ("/tmp/a");
+        file = g_file_new_for_path ("/tmp/a/b/c");
+        other = g_file_new_for_path ("/tmp/ab");
+
+        tracker_priority_queue_add (queue, g_object_ref (dir), 1);
+        tracker_priority_queue_add (queue, g_file_new_for_path ("/tmp/a/b/c"), 2);
+        tracker_priority_queue_add (queue, g_file_new_for_path ("/tmp/a/b/d"), 1);
+        tracker_priority_queue_add (queue, g_object_ref (other), 3);
+        g_assert_cmpint (tracker_priority_queue_get_length (queue), ==, 4);
+
+        /* Lookups by file */
+        node = tracker_priority_queue_find_file_node (queue, file, &priority);
+        g_assert (node != NULL);
+        g_assert (g_file_equal (node->data, file));
+        g_assert_cmpint (priority, ==, 2);
+        g_assert (tracker_priority_queue_has_descendants (queue, dir));
+        g_assert (!tracker_priority_queue_has_descendants (queue, file));
+        g_assert (!tracker_priority_queue_has_descendants (queue, other));
+
+        /* Sibling with a common name prefix stays */
+        g_assert (tracker_priority_queue_remove_descendants (queue, dir, g_object_unref));
+        g_assert_cmpint (tracker_priority_queue_get_length (queue), ==, 2);
+        g_assert (tracker_priority_queue_find_file_node (queue, file, NULL) == NULL);
+        g_assert (!tracker_priority_queue_has_descendants (queue, dir));
+        g_assert (tracker_priority_queue_find_file_node (queue, other, NULL) != NULL);
+
+        /* Index follows pops */
+        node = tracker_priority_queue_pop_node (queue, &priority);
+        g_assert (g_file_equal (node->data, dir));
+        g_object_unref (node->data);
+        g_list_free_1 (node);
+        g_assert (tracker_priority_queue_find_file_node (queue, dir, NULL) == NULL);
+
+        g_assert (tracker_priority_queue_remove_file (queue, other, g_object_unref));
+        g_assert (!tracker_priority_queue_remove_file (queue, other, g_object_unref));
+        g_assert (tracker_priority_queue_is_empty (queue));
+
+        g_object_unref (dir);
+        g_object_unref (file);
+        g_object_unref (other);
+        tracker_priority_queue_unref (queue);
+}
+
+static void
+test_priority_queue_file_index_root (void)
+{
+        TrackerPriorityQueue *queue;
+        GFile                *root, *file;
+
+        queue = tracker_priority_queue_new_with_index (NULL);
+        root = g_file_new_for_path ("/");
+        file = g_file_new_for_path ("/tmp/a");
+
+        tracker_priority_queue_add (queue, g_object_ref (file), 1);
+        g_assert (tracker_priority_queue_has_descendants (queue, root));
+
+        /* The root can be queued itself */
+        tracker_priority_queue_add (queue, g_object_ref (root), 1);
+        g_assert (tracker_priority_queue_find_file_node (queue, root, NULL) != NULL);
+        g_assert (!tracker_priority_queue_has_descendants (queue, file));
+
+        g_assert (tracker_priority_queue_remove_descendants (queue, root, g_object_unref));
+        g_assert_cmpint (tracker_priority_queue_get_length (queue), ==, 1);
+        g_assert (tracker_priority_queue_find_file_node (queue, file, NULL) == NULL);
+        g_assert (!tracker_priority_queue_has_descendants (queue, root));
+
+        g_assert (tracker_priority_queue_remove_file (queue, root, g_object_unref));
+        g_assert (tracker_priority_queue_is_empty (queue));
+
+        g_object_unref (root);
+        g_object_unref (file);
+        tracker_priority_queue_unref (queue);
+}
+
+typedef struct {
+        GFile *file;
+        GFile *source_file;
+} TestMove;
+
+static GFile *
+test_move_get_file (gpointer data)
+{
+        return ((TestMove *) data)->file;
+}
+
+static TestMove *
+test_move_new (const gchar *source,
+               const gchar *dest)
+{
+        TestMove *move;
+
+        move = g_new0 (TestMove, 1);
+        move->source_file = g_file_new_for_path (source);
+        move->file = g_file_new_for_path (dest);
+
+        return move;
+}
+
+static void
+test_move_free (TestMove *move)
+{
+        g_object_unref (move->source_file);
+        g_object_unref (move->file);
+        g_free (move);
+}
+
+static void
+assert_pop_move (TrackerPriorityQueue *queue,
+                 const gchar          *source,
+                 const gchar          *dest)
+{
+        TestMove *move;
+        gchar *path;
+
+        move = tracker_priority_queue_pop (queue, NULL);
+        g_assert (move != NULL);
+
+        path = g_file_get_path (move->source_file);
+        g_assert_cmpstr (path, ==, source);
+        g_free (path);
+
+        path = g_file_get_path (move->file);
+        g_assert_cmpstr (path, ==, dest);
+        g_free (path);
+
+        test_move_free (move);
+}
+
+static void
+test_priority_queue_file_index_reindex (void)
+{
+        TrackerPriorityQueue *queue;
+        GFile                *file;
+        GList                *node;
+        TestMove             *move;
+
+        /* mv A B; mv C A; mv B E, the last one merged into the first */
+        queue = tracker_priority_queue_new_with_index (test_move_get_file);
+        tracker_priority_queue_add (queue, test_move_new ("/tmp/A", "/tmp/B"), 1);
+        tracker_priority_queue_add (queue, test_move_new ("/tmp/C", "/tmp/A"), 1);
+
+        file = g_file_new_for_path ("/tmp/B");
+        node = tracker_priority_queue_find_file_node (queue, file, NULL);
+        g_assert (node != NULL);
+        g_object_unref (file);
+
+        move = node->data;
+        g_object_unref (move->file);
+        move->file = g_file_new_for_path ("/tmp/E");
+        tracker_priority_queue_reindex_node (queue, node);
+
+        file = g_file_new_for_path ("/tmp/B");
+        g_assert (tracker_priority_queue_find_file_node (queue, file, NULL) == NULL);
+        g_object_unref (file);
+
+        file = g_file_new_for_path ("/tmp/E");
+        g_assert (tracker_priority_queue_find_file_node (queue, file, NULL) == node);
+        g_object_unref (file);
+
+        /* The merged move still comes first, so A is free before C moves in */
+        tracker_priority_queue_add (queue, test_move_new ("/tmp/F", "/tmp/G"), 1);
+        assert_pop_move (queue, "/tmp/A", "/tmp/E");
+        assert_pop_move (queue, "/tmp/C", "/tmp/A");
+        assert_pop_move (queue, "/tmp/F", "/tmp/G");
+        g_assert (tracker_priority_queue_is_empty (queue));
+
+        tracker_priority_queue_unref (queue);
+}
+
 int
 main (int    argc,
       char **argv)
@@ -247,6 +425,12 @@ main (int    argc,
 
         g_test_add_func ("/libtracker-miner/tracker-priority-queue/branches",
                          test_priority_queue_branches);
+        g_test_add_func ("/libtracker-miner/tracker-priority-queue/file_index",
+                         test_priority_queue_file_index);
+        g_test_add_func ("/libtracker-miner/tracker-priority-queue/file_index_root",
+                         test_priority_queue_file_index_root);
+        g_test_add_func ("/libtracker-miner/tracker-priority-queue/file_index_reindex",
+                         test_priority_queue_file_index_reindex);
 
 	return g_test_run ();
 }
@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2018, Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#include <glib-object.h>
+
+/* NOTE: We're not including tracker-miner.h here because this is private. */
+#include <libtracker-miner/tracker-sparql-buffer.h>
+
+#define TARGET_LATENCY 1000
+#define SLOW           (TARGET_LATENCY * 2)
+#define FAST           (TARGET_LATENCY / 2)
+
+static TrackerSparqlBuffer *
+create_buffer (void)
+{
+	TrackerSparqlBuffer *buffer;
+
+	buffer = tracker_sparql_buffer_new (NULL, 10);
+	tracker_sparql_buffer_set_max_updates (buffer, 2);
+	tracker_sparql_buffer_set_target_latency (buffer, TARGET_LATENCY);
+
+	return buffer;
+}
+
+static void
+assert_limits (TrackerSparqlBuffer *buffer,
+               guint                batch_size,
+               guint                updates)
+{
+	g_assert_cmpuint (tracker_sparql_buffer_get_batch_size (buffer), ==, batch_size);
+	g_assert_cmpuint (tracker_task_pool_get_limit (TRACKER_TASK_POOL (buffer)), ==,
+	                  batch_size * updates);
+}
+
+static void
+test_sparql_buffer_adapt_slow (void)
+{
+	TrackerSparqlBuffer *buffer;
+
+	buffer = create_buffer ();
+	assert_limits (buffer, 10, 2);
+
+	/* Batches in flight are cut down first */
+	tracker_sparql_buffer_adapt_limit (buffer, 10, 10, SLOW, 5, 0);
+	assert_limits (buffer, 10, 1);
+
+	/* Then the batch size shrinks */
+	tracker_sparql_buffer_adapt_limit (buffer, 10, 10, SLOW, 5, 0);
+	assert_limits (buffer, 7, 1);
+	tracker_sparql_buffer_adapt_limit (buffer, 3, 7, SLOW, 1, 0);
+	assert_limits (buffer, 5, 1);
+
+	/* Down to a single task */
+	tracker_sparql_buffer_adapt_limit (buffer, 5, 5, SLOW, 1, 0);
+	tracker_sparql_buffer_adapt_limit (buffer, 5, 5, SLOW, 1, 0);
+	tracker_sparql_buffer_adapt_limit (buffer, 5, 5, SLOW, 1, 0);
+	assert_limits (buffer, 1, 1);
+	tracker_sparql_buffer_adapt_limit (buffer, 1, 1, SLOW, 1, 0);
+	assert_limits (buffer, 1, 1);
+
+	g_object_unref (buffer);
+}
+
+static void
+test_sparql_buffer_adapt_fast (void)
+{
+	TrackerSparqlBuffer *buffer;
+
+	buffer = create_buffer ();
+	tracker_sparql_buffer_adapt_limit (buffer, 10, 10, SLOW, 5, 0);
+	assert_limits (buffer, 10, 1);
+
+	/* Batches in flight are let up to max_updates first */
+	tracker_sparql_buffer_adapt_limit (buffer, 10, 10, FAST, 100, 0);
+	assert_limits (buffer, 10, 2);
+
+	/* Then the batch size grows */
+	tracker_sparql_buffer_adapt_limit (buffer, 10, 10, FAST, 110, 0);
+	assert_limits (buffer, 12, 2);
+	tracker_sparql_buffer_adapt_limit (buffer, 12, 12, FAST, 120, 0);
+	assert_limits (buffer, 15, 2);
+
+	/* Up to the maximum batch size */
+	tracker_sparql_buffer_set_batch_size (buffer, 1000);
+	tracker_sparql_buffer_adapt_limit (buffer, 1000, 1000, FAST, 1000, 0);
+	assert_limits (buffer, 1000, 2);
+
+	g_object_unref (buffer);
+}
+
+static void
+test_sparql_buffer_adapt_steady (void)
+{
+	TrackerSparqlBuffer *buffer;
+
+	buffer = create_buffer ();
+	tracker_sparql_buffer_adapt_limit (buffer, 10, 10, FAST, 100, 0);
+	assert_limits (buffer, 12, 2);
+
+	/* Partial batches don't tell whether the limit holds us back */
+	tracker_sparql_buffer_adapt_limit (buffer, 5, 12, FAST, 1000, 0);
+	assert_limits (buffer, 12, 2);
+
+	/* Nor do full batches with less throughput */
+	tracker_sparql_buffer_adapt_limit (buffer, 12, 12, FAST, 50, 0);
+	assert_limits (buffer, 12, 2);
+
+	g_object_unref (buffer);
+}
+
+static void
+test_sparql_buffer_adapt_store_queue (void)
+{
+	TrackerSparqlBuffer *buffer;
+
+	buffer = create_buffer ();
+
+	/* Updates queued in the store cut down batches in flight */
+	tracker_sparql_buffer_adapt_limit (buffer, 10, 10, FAST, 100, 2);
+	assert_limits (buffer, 10, 1);
+
+	/* And keep them from growing, while the batch size may */
+	tracker_sparql_buffer_adapt_limit (buffer, 10, 10, FAST, 110, 1);
+	assert_limits (buffer, 12, 1);
+
+	/* Until the store queue is empty */
+	tracker_sparql_buffer_adapt_limit (buffer, 12, 12, FAST, 120, 0);
+	assert_limits (buffer, 12, 2);
+
+	g_object_unref (buffer);
+}
+
+static void
+test_sparql_buffer_adapt_disabled (void)
+{
+	TrackerSparqlBuffer *buffer;
+
+	buffer = create_buffer ();
+	tracker_sparql_buffer_adapt_limit (buffer, 10, 10, SLOW, 5, 0);
+	tracker_sparql_buffer_adapt_limit (buffer, 10, 10, SLOW, 5, 0);
+	assert_limits (buffer, 7, 1);
+
+	/* Without a target latency, max_updates batches are in flight */
+	tracker_sparql_buffer_set_target_latency (buffer, 0);
+	assert_limits (buffer, 7, 2);
+
+	g_object_unref (buffer);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/libtracker-miner/tracker-sparql-buffer/adapt-slow",
+	                 test_sparql_buffer_adapt_slow);
+	g_test_add_func ("/libtracker-miner/tracker-sparql-buffer/adapt-fast",
+	                 test_sparql_buffer_adapt_fast);
+	g_test_add_func ("/libtracker-miner/tracker-sparql-buffer/adapt-steady",
+	                 test_sparql_buffer_adapt_steady);
+	g_test_add_func ("/libtracker-miner/tracker-sparql-buffer/adapt-store-queue",
+	                 test_sparql_buffer_adapt_store_queue);
+	g_test_add_func ("/libtracker-miner/tracker-sparql-buffer/adapt-disabled",
+	                 test_sparql_buffer_adapt_disabled);
+
+	return g_test_run ();
+}
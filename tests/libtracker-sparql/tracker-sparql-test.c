@@ -19,9 +19,11 @@
 
 #include "config.h"
 
+#include <string.h>
 #include <locale.h>
 
 #include <glib-object.h>
+#include <libsoup/soup.h>
 
 #include <libtracker-sparql/tracker-sparql.h>
 
@@ -390,6 +392,285 @@ test_tracker_sparql_connection_interleaved (void)
 	g_object_unref(cursor1);
 }
 
+/* Executes @stmt and checks it gives @expected as its only result, or
+ * no result if @expected is %NULL */
+static void
+assert_statement_result (TrackerSparqlStatement *stmt,
+                         const gchar            *expected)
+{
+	TrackerSparqlCursor *cursor;
+	GError *error = NULL;
+
+	cursor = tracker_sparql_statement_execute (stmt, NULL, &error);
+	g_assert_no_error (error);
+
+	if (expected) {
+		g_assert (tracker_sparql_cursor_next (cursor, NULL, &error));
+		g_assert_no_error (error);
+		g_assert_cmpstr (tracker_sparql_cursor_get_string (cursor, 0, NULL), ==, expected);
+	}
+
+	g_assert (!tracker_sparql_cursor_next (cursor, NULL, &error));
+	g_assert_no_error (error);
+
+	g_object_unref (cursor);
+}
+
+static void
+test_tracker_sparql_statement_direct (void)
+{
+	TrackerSparqlConnection *direct;
+	TrackerSparqlStatement *stmt;
+	GFile *store, *ontology;
+	GDateTime *date;
+	GError *error = NULL;
+	gchar *path, *command;
+
+	path = g_dir_make_tmp ("tracker-statement-XXXXXX", &error);
+	g_assert_no_error (error);
+
+	store = g_file_new_for_path (path);
+	ontology = g_file_new_for_path (TEST_ONTOLOGIES_DIR);
+
+	direct = tracker_sparql_connection_local_new (TRACKER_SPARQL_CONNECTION_FLAGS_NONE,
+	                                              store, NULL, ontology, NULL, &error);
+	g_assert_no_error (error);
+
+	tracker_sparql_connection_update (direct,
+	                                  "INSERT { <test://statement-a> a slo:GeoLocation ; "
+	                                  "           nie:title \"Århus\" ; slo:latitude 56.15 ; "
+	                                  "           nie:contentCreated \"2018-01-01T10:00:00Z\" . "
+	                                  "         <test://statement-b> a slo:GeoLocation ; "
+	                                  "           nie:title \"Kraków\" ; slo:latitude 50.06 ; "
+	                                  "           nie:contentCreated \"2018-06-01T10:00:00Z\" }",
+	                                  G_PRIORITY_DEFAULT, NULL, &error);
+	g_assert_no_error (error);
+
+	/* The same statement executed with different values */
+	stmt = tracker_sparql_connection_query_statement (direct,
+	                                                  "SELECT ?u WHERE { ?u nie:title ~title }",
+	                                                  NULL, &error);
+	g_assert_no_error (error);
+
+	tracker_sparql_statement_bind_string (stmt, "title", "Århus");
+	assert_statement_result (stmt, "test://statement-a");
+	tracker_sparql_statement_bind_string (stmt, "title", "Kraków");
+	assert_statement_result (stmt, "test://statement-b");
+
+	/* Values are never parsed as SPARQL */
+	tracker_sparql_statement_bind_string (stmt, "title", "Kraków\" || \"");
+	assert_statement_result (stmt, NULL);
+	g_object_unref (stmt);
+
+	stmt = tracker_sparql_connection_query_statement (direct,
+	                                                  "SELECT ?u WHERE { ?u slo:latitude ?lat FILTER (?lat > ~min) }",
+	                                                  NULL, &error);
+	g_assert_no_error (error);
+
+	tracker_sparql_statement_bind_double (stmt, "min", 50.06);
+	assert_statement_result (stmt, "test://statement-a");
+	tracker_sparql_statement_bind_int (stmt, "min", 57);
+	assert_statement_result (stmt, NULL);
+	g_object_unref (stmt);
+
+	/* Datetimes are compared as such, not as strings */
+	stmt = tracker_sparql_connection_query_statement (direct,
+	                                                  "SELECT ?u WHERE { ?u nie:contentCreated ?d FILTER (?d > ~since) }",
+	                                                  NULL, &error);
+	g_assert_no_error (error);
+
+	date = g_date_time_new_utc (2018, 3, 1, 0, 0, 0);
+	tracker_sparql_statement_bind_datetime (stmt, "since", date);
+	assert_statement_result (stmt, "test://statement-b");
+	g_date_time_unref (date);
+	g_object_unref (stmt);
+
+	g_object_unref (direct);
+	g_object_unref (store);
+	g_object_unref (ontology);
+
+	command = g_strdup_printf ("rm -Rf %s/", path);
+	g_spawn_command_line_sync (command, NULL, NULL, NULL, NULL);
+	g_free (command);
+	g_free (path);
+}
+
+#define REMOTE_RESPONSE \
+	"{ \"head\": { \"vars\": [ \"u\" ] }, " \
+	"  \"results\": { \"bindings\": [ { \"u\": { \"type\": \"uri\", \"value\": \"test://remote\" } } ] } }"
+
+static void
+remote_server_cb (SoupServer        *server,
+                  SoupMessage       *message,
+                  const char        *path,
+                  GHashTable        *query,
+                  SoupClientContext *client,
+                  gpointer           user_data)
+{
+	gchar **received = user_data;
+
+	g_free (*received);
+	*received = g_strdup (query ? g_hash_table_lookup (query, "query") : NULL);
+
+	soup_message_set_status (message, SOUP_STATUS_OK);
+	soup_message_set_response (message, "application/sparql-results+json",
+	                           SOUP_MEMORY_STATIC, REMOTE_RESPONSE, strlen (REMOTE_RESPONSE));
+}
+
+static gpointer
+remote_server_thread (gpointer user_data)
+{
+	GMainLoop *loop = user_data;
+
+	g_main_context_push_thread_default (g_main_loop_get_context (loop));
+	g_main_loop_run (loop);
+	g_main_context_pop_thread_default (g_main_loop_get_context (loop));
+
+	return NULL;
+}
+
+/* The remote backend puts the values in the query text, check what a
+ * SPARQL endpoint gets */
+static void
+test_tracker_sparql_statement_remote (void)
+{
+	TrackerSparqlConnection *remote;
+	TrackerSparqlStatement *stmt;
+	SoupServer *server;
+	SoupAddress *address;
+	GMainContext *context;
+	GMainLoop *loop;
+	GThread *thread;
+	GError *error = NULL;
+	gchar *received = NULL, *uri, *numeric_locale, *end;
+	const gchar *value;
+
+	context = g_main_context_new ();
+	loop = g_main_loop_new (context, FALSE);
+
+	address = soup_address_new ("127.0.0.1", SOUP_ADDRESS_ANY_PORT);
+	soup_address_resolve_sync (address, NULL);
+
+	G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+	server = soup_server_new (SOUP_SERVER_INTERFACE, address,
+	                          SOUP_SERVER_ASYNC_CONTEXT, context,
+	                          NULL);
+	g_assert (server != NULL);
+	soup_server_add_handler (server, "/sparql", remote_server_cb, &received, NULL);
+	soup_server_run_async (server);
+	uri = g_strdup_printf ("http://127.0.0.1:%u/sparql?query=", soup_server_get_port (server));
+	G_GNUC_END_IGNORE_DEPRECATIONS
+
+	thread = g_thread_new ("remote-server", remote_server_thread, loop);
+
+	/* Doubles are written the same in every locale */
+	numeric_locale = g_strdup (setlocale (LC_NUMERIC, NULL));
+	setlocale (LC_NUMERIC, "de_DE.UTF-8");
+
+	remote = tracker_sparql_connection_remote_new (uri);
+	stmt = tracker_sparql_connection_query_statement (remote,
+	                                                  "SELECT ?u WHERE { ?u nie:title ~title ; slo:latitude ?v FILTER (?v = ~v) }",
+	                                                  NULL, &error);
+	g_assert_no_error (error);
+
+	tracker_sparql_statement_bind_string (stmt, "title", "a&b#c \"d\"");
+	tracker_sparql_statement_bind_double (stmt, "v", 0.1);
+	assert_statement_result (stmt, "test://remote");
+
+	setlocale (LC_NUMERIC, numeric_locale);
+	g_free (numeric_locale);
+
+	g_assert (received != NULL);
+	g_assert (strstr (received, "nie:title \"a&b#c \\\"d\\\"\" ;") != NULL);
+
+	value = strstr (received, "?v = \"");
+	g_assert (value != NULL);
+	value += strlen ("?v = \"");
+	g_assert_cmpfloat (g_ascii_strtod (value, &end), ==, 0.1);
+	g_assert (g_str_has_prefix (end, "\"^^<http://www.w3.org/2001/XMLSchema#double>)"));
+
+	g_object_unref (stmt);
+	g_object_unref (remote);
+
+	g_main_loop_quit (loop);
+	g_thread_join (thread);
+
+	soup_server_disconnect (server);
+	g_object_unref (server);
+	g_object_unref (address);
+	g_main_loop_unref (loop);
+	g_main_context_unref (context);
+	g_free (received);
+	g_free (uri);
+}
+
+#if HAVE_TRACKER_FTS
+
+static gint
+count_fts_matches (TrackerSparqlConnection *connection,
+                   const gchar             *word)
+{
+	TrackerSparqlCursor *cursor;
+	GError *error = NULL;
+	gchar *query;
+	gint n = 0;
+
+	query = g_strdup_printf ("SELECT ?u fts:snippet(?u) "
+	                         "WHERE { ?u fts:match \"%s\" }", word);
+	cursor = tracker_sparql_connection_query (connection, query, NULL, &error);
+	g_assert_no_error (error);
+	g_free (query);
+
+	while (tracker_sparql_cursor_next (cursor, NULL, &error)) {
+		/* the snippet comes from the same text as the match */
+		g_assert (strstr (tracker_sparql_cursor_get_string (cursor, 1, NULL), word) != NULL);
+		n++;
+	}
+
+	g_assert_no_error (error);
+	g_object_unref (cursor);
+
+	return n;
+}
+
+/* Full text search through the default backend sees the text of
+ * updates made right before */
+static void
+test_tracker_sparql_fts_read_your_writes (void)
+{
+	TrackerSparqlConnection *connection;
+	GError *error = NULL;
+
+	connection = tracker_sparql_connection_get (NULL, &error);
+	g_assert_no_error (error);
+
+	tracker_sparql_connection_update (connection,
+	                                  "INSERT { <test://fts-read-your-writes> a nie:InformationElement ; "
+	                                  "nie:title \"xylophonist\" }",
+	                                  G_PRIORITY_DEFAULT, NULL, &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (count_fts_matches (connection, "xylophonist"), ==, 1);
+
+	tracker_sparql_connection_update (connection,
+	                                  "DELETE { <test://fts-read-your-writes> nie:title ?t } "
+	                                  "INSERT { <test://fts-read-your-writes> nie:title \"zitherist\" } "
+	                                  "WHERE { <test://fts-read-your-writes> nie:title ?t }",
+	                                  G_PRIORITY_DEFAULT, NULL, &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (count_fts_matches (connection, "xylophonist"), ==, 0);
+	g_assert_cmpint (count_fts_matches (connection, "zitherist"), ==, 1);
+
+	tracker_sparql_connection_update (connection,
+	                                  "DELETE { <test://fts-read-your-writes> a rdfs:Resource }",
+	                                  G_PRIORITY_DEFAULT, NULL, &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (count_fts_matches (connection, "zitherist"), ==, 0);
+
+	g_object_unref (connection);
+}
+
+#endif /* HAVE_TRACKER_FTS */
+
 gint
 main (gint argc, gchar **argv)
 {
@@ -424,8 +705,14 @@ main (gint argc, gchar **argv)
 	                 test_tracker_sparql_connection_locking_sync);
 	g_test_add_func ("/libtracker-sparql/tracker-sparql/tracker_sparql_connection_locking_async",
 	                 test_tracker_sparql_connection_locking_async);
+	g_test_add_func ("/libtracker-sparql/tracker-sparql/tracker_sparql_statement_direct",
+	                 test_tracker_sparql_statement_direct);
+	g_test_add_func ("/libtracker-sparql/tracker-sparql/tracker_sparql_statement_remote",
+	                 test_tracker_sparql_statement_remote);
 
 #if HAVE_TRACKER_FTS
+	g_test_add_func ("/libtracker-sparql/tracker-sparql/tracker_sparql_fts_read_your_writes",
+	                 test_tracker_sparql_fts_read_your_writes);
 	g_test_add_func ("/libtracker-sparql/tracker-sparql/tracker_sparql_cursor_next_async",
 	                 test_tracker_sparql_cursor_next_async);
 #endif
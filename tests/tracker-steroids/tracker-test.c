@@ -43,6 +43,7 @@ delete_test_data ()
 	                           "<urn:testdata2> a rdfs:Resource ."
 	                           "<urn:testdata3> a rdfs:Resource ."
 	                           "<urn:testdata4> a rdfs:Resource ."
+	                           "<urn:testdata5> a rdfs:Resource ."
 	                           "}";
 
 	tracker_sparql_connection_update (connection, delete_query, 0, NULL, &error);
@@ -68,6 +69,7 @@ insert_test_data ()
 	                                "    <urn:testdata2> a nfo:FileDataObject ; nie:url \"/plop/coin\" ."
 	                                "    <urn:testdata3> a nmm:Artist ; nmm:artistName \"testArtist\" ."
 	                                "    <urn:testdata4> a nmm:Photo ; nao:identifier \"%s\" ."
+	                                "    <urn:testdata5> a slo:GeoLocation ; slo:latitude 0.1 ."
 	                                "}", longName);
 
 	tracker_sparql_connection_update (connection, filled_query, 0, NULL, &error);
@@ -278,6 +280,54 @@ test_tracker_sparql_query_iterate_sigpipe ()
 	g_object_unref (cursor);
 }
 
+static void
+assert_statement_result (TrackerSparqlStatement *stmt,
+                         const gchar            *expected)
+{
+	TrackerSparqlCursor *cursor;
+	GError *error = NULL;
+
+	cursor = tracker_sparql_statement_execute (stmt, NULL, &error);
+	g_assert_no_error (error);
+
+	g_assert (tracker_sparql_cursor_next (cursor, NULL, &error));
+	g_assert_no_error (error);
+	g_assert_cmpstr (tracker_sparql_cursor_get_string (cursor, 0, NULL), ==, expected);
+	g_assert (!tracker_sparql_cursor_next (cursor, NULL, &error));
+	g_assert_no_error (error);
+
+	g_object_unref (cursor);
+}
+
+/* Runs a prepared query with values sent along to the store */
+static void
+test_tracker_sparql_statement ()
+{
+	TrackerSparqlStatement *stmt;
+	GError *error = NULL;
+
+	stmt = tracker_sparql_connection_query_statement (connection,
+	                                                  "SELECT ?u WHERE { ?u nie:url ~url }",
+	                                                  NULL, &error);
+	g_assert_no_error (error);
+
+	tracker_sparql_statement_bind_string (stmt, "url", "/foo/bar");
+	assert_statement_result (stmt, "urn:testdata1");
+	tracker_sparql_statement_bind_string (stmt, "url", "/plop/coin");
+	assert_statement_result (stmt, "urn:testdata2");
+	g_object_unref (stmt);
+
+	/* Doubles reach the store unchanged */
+	stmt = tracker_sparql_connection_query_statement (connection,
+	                                                  "SELECT ?u WHERE { ?u slo:latitude ~latitude }",
+	                                                  NULL, &error);
+	g_assert_no_error (error);
+
+	tracker_sparql_statement_bind_double (stmt, "latitude", 0.1);
+	assert_statement_result (stmt, "urn:testdata5");
+	g_object_unref (stmt);
+}
+
 static void
 test_tracker_sparql_update_fast_small ()
 {
@@ -706,6 +756,7 @@ main (gint argc, gchar **argv)
 	g_test_add_func ("/steroids/tracker/tracker_sparql_query_iterate_empty", test_tracker_sparql_query_iterate_empty);
 	g_test_add_func ("/steroids/tracker/tracker_sparql_query_iterate_empty/subprocess", test_tracker_sparql_query_iterate_empty_subprocess);
 	g_test_add_func ("/steroids/tracker/tracker_sparql_query_iterate_sigpipe", test_tracker_sparql_query_iterate_sigpipe);
+	g_test_add_func ("/steroids/tracker/tracker_sparql_statement", test_tracker_sparql_statement);
 	g_test_add_func ("/steroids/tracker/tracker_sparql_update_fast_small", test_tracker_sparql_update_fast_small);
 	g_test_add_func ("/steroids/tracker/tracker_sparql_update_fast_large", test_tracker_sparql_update_fast_large);
 	g_test_add_func ("/steroids/tracker/tracker_sparql_update_fast_error", test_tracker_sparql_update_fast_error);